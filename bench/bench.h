@@ -0,0 +1,251 @@
+/*!
+ *  Copyright (c) 2014 by Contributors
+ * \file bench.h
+ * \brief shared utilities of the benchmark programs: argument parsing,
+ *  timing, machine peak estimation and machine readable reports
+ * \author Tianqi Chen
+ */
+#ifndef MSHADOW_BENCH_H_
+#define MSHADOW_BENCH_H_
+#include <stdint.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace bench {
+/*! \return current time in seconds */
+inline double GetTime(void) {
+  return std::chrono::duration<double>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+/*!
+ * \brief command line arguments in the form of name=value,
+ *  the same convention as the SetParam of mshadow-ps
+ */
+class Config {
+ public:
+  Config(int argc, char *argv[]) {
+    for (int i = 1; i < argc; ++i) {
+      const char *eq = strchr(argv[i], '=');
+      if (eq == NULL) {
+        fprintf(stderr, "ignore argument %s, must be name=value\n", argv[i]);
+        continue;
+      }
+      kv_[std::string(argv[i], eq - argv[i])] = std::string(eq + 1);
+    }
+  }
+  inline std::string GetStr(const char *name, const char *def) const {
+    std::map<std::string, std::string>::const_iterator it = kv_.find(name);
+    return it == kv_.end() ? std::string(def) : it->second;
+  }
+  inline int GetInt(const char *name, int def) const {
+    std::map<std::string, std::string>::const_iterator it = kv_.find(name);
+    return it == kv_.end() ? def : atoi(it->second.c_str());
+  }
+  inline double GetFloat(const char *name, double def) const {
+    std::map<std::string, std::string>::const_iterator it = kv_.find(name);
+    return it == kv_.end() ? def : atof(it->second.c_str());
+  }
+  /*!
+   * \brief get all the arguments whose name starts with prefix
+   * \return list of (name without prefix, value)
+   */
+  inline std::vector<std::pair<std::string, std::string> >
+  GetPrefixed(const char *prefix) const {
+    std::vector<std::pair<std::string, std::string> > ret;
+    const size_t n = strlen(prefix);
+    for (std::map<std::string, std::string>::const_iterator
+             it = kv_.begin(); it != kv_.end(); ++it) {
+      if (it->first.compare(0, n, prefix) == 0) {
+        ret.push_back(std::make_pair(it->first.substr(n), it->second));
+      }
+    }
+    return ret;
+  }
+
+ private:
+  std::map<std::string, std::string> kv_;
+};
+/*!
+ * \brief get the q-th quantile of the values, the values are reordered
+ * \param q quantile in [0, 1]
+ */
+inline double Quantile(std::vector<double> *values, double q) {
+  if (values->size() == 0) return 0.0;
+  size_t k = static_cast<size_t>(q * (values->size() - 1) + 0.5);
+  std::nth_element(values->begin(), values->begin() + k, values->end());
+  return (*values)[k];
+}
+/*!
+ * \brief run f repeatedly until at least min_time seconds and min_repeat
+ *  runs are spent, after one warm up run
+ * \return the average seconds of one run
+ */
+template<typename F>
+inline double TimeIt(F f, double min_time, int min_repeat) {
+  f();
+  int nrep = 0;
+  double tstart = GetTime(), tnow = tstart;
+  while (nrep < min_repeat || tnow - tstart < min_time) {
+    f(); ++nrep;
+    tnow = GetTime();
+  }
+  return (tnow - tstart) / nrep;
+}
+/*!
+ * \brief estimate the memory bandwidth of one core in GB/s by copying
+ *  a buffer much larger than the last level cache
+ */
+inline double MeasurePeakBandwidth(void) {
+  const size_t n = 64UL << 20;
+  char *a = static_cast<char*>(malloc(n));
+  char *b = static_cast<char*>(malloc(n));
+  memset(a, 1, n); memset(b, 0, n);
+  volatile char *sink = b;
+  double sec = TimeIt([&]() { memcpy(b, a, n); sink[n / 2] += 1; }, 0.2, 3);
+  free(a); free(b);
+  // read and write of each byte
+  return 2.0 * n / sec * 1e-9;
+}
+/*!
+ * \brief estimate the peak single precision GFLOP/s of one core with
+ *  independent chains of multiply and add, so that latency is hidden
+ */
+inline double MeasurePeakFlops(void) {
+  const int niter = 1 << 20;
+#if defined(__SSE2__)
+  __m128 acc[8], mul = _mm_set1_ps(0.999999f), add = _mm_set1_ps(1e-6f);
+  for (int k = 0; k < 8; ++k) acc[k] = _mm_set1_ps(static_cast<float>(k));
+  double sec = TimeIt([&]() {
+      for (int i = 0; i < niter; ++i) {
+        for (int k = 0; k < 8; ++k) {
+          acc[k] = _mm_add_ps(_mm_mul_ps(acc[k], mul), add);
+        }
+      }
+    }, 0.2, 3);
+  float sink[4];
+  _mm_storeu_ps(sink, acc[0]);
+  if (sink[0] == 12345.0f) printf("\n");
+  // eight chains of four lanes, each with one multiply and one add
+  return 8.0 * 4 * 2 * niter / sec * 1e-9;
+#else
+  float acc[8];
+  for (int k = 0; k < 8; ++k) acc[k] = static_cast<float>(k);
+  double sec = TimeIt([&]() {
+      for (int i = 0; i < niter; ++i) {
+        for (int k = 0; k < 8; ++k) acc[k] = acc[k] * 0.999999f + 1e-6f;
+      }
+    }, 0.2, 3);
+  if (acc[0] == 12345.0f) printf("\n");
+  return 8.0 * 2 * niter / sec * 1e-9;
+#endif
+}
+/*! \brief result of one benchmark case */
+struct Result {
+  /*! \brief group of the case, e.g. map, dot */
+  std::string group;
+  /*! \brief name of the case */
+  std::string name;
+  /*! \brief shape of the case */
+  std::string shape;
+  /*! \brief seconds of one run */
+  double sec;
+  /*! \brief number of bytes moved in one run */
+  double bytes;
+  /*! \brief number of floating point operations in one run */
+  double flops;
+};
+/*!
+ * \brief collects the results and prints them as a human readable table,
+ *  json or csv, the bandwidth and flops are also reported as the fraction
+ *  of machine peak so that results of different machines are comparable
+ */
+class Reporter {
+ public:
+  /*! \brief peak bandwidth in GB/s and peak GFLOP/s */
+  double peak_gbps, peak_gflops;
+  explicit Reporter(const Config &cfg) {
+    peak_gbps = cfg.GetFloat("peak_gbps", 0.0);
+    peak_gflops = cfg.GetFloat("peak_gflops", 0.0);
+    if (peak_gbps <= 0.0) peak_gbps = MeasurePeakBandwidth();
+    if (peak_gflops <= 0.0) peak_gflops = MeasurePeakFlops();
+    fprintf(stderr, "peak: %.2f GB/s, %.2f GFLOP/s\n", peak_gbps, peak_gflops);
+  }
+  /*! \brief set a build or run property recorded in the report */
+  inline void SetMeta(const std::string &key, const std::string &value) {
+    meta_.push_back(std::make_pair(key, value));
+  }
+  inline void Add(const Result &r) {
+    results_.push_back(r);
+    fprintf(stderr, "%-8s %-28s %-24s %10.3f us %8.2f GB/s (%5.1f%%) "
+            "%8.2f GFLOP/s (%5.1f%%)\n",
+            r.group.c_str(), r.name.c_str(), r.shape.c_str(), r.sec * 1e6,
+            GBps(r), 100.0 * GBps(r) / peak_gbps,
+            GFlops(r), 100.0 * GFlops(r) / peak_gflops);
+  }
+  /*!
+   * \brief print all the results
+   * \param format json or csv
+   * \param fo output file
+   */
+  inline void Print(const std::string &format, FILE *fo) const {
+    if (format == "csv") {
+      fprintf(fo, "group,name,shape,usec,gbps,gflops,bw_frac,flops_frac\n");
+      for (size_t i = 0; i < results_.size(); ++i) {
+        const Result &r = results_[i];
+        fprintf(fo, "%s,%s,\"%s\",%.3f,%.4f,%.4f,%.4f,%.4f\n",
+                r.group.c_str(), r.name.c_str(), r.shape.c_str(), r.sec * 1e6,
+                GBps(r), GFlops(r), GBps(r) / peak_gbps, GFlops(r) / peak_gflops);
+      }
+    } else {
+      fprintf(fo, "{");
+      for (size_t i = 0; i < meta_.size(); ++i) {
+        fprintf(fo, "\"%s\": \"%s\", ", meta_[i].first.c_str(), meta_[i].second.c_str());
+      }
+      fprintf(fo, "\"peak_gbps\": %.4f, \"peak_gflops\": %.4f, \"results\": [",
+              peak_gbps, peak_gflops);
+      for (size_t i = 0; i < results_.size(); ++i) {
+        const Result &r = results_[i];
+        fprintf(fo, "%s\n {\"group\": \"%s\", \"name\": \"%s\", \"shape\": \"%s\", "
+                "\"usec\": %.3f, \"gbps\": %.4f, \"gflops\": %.4f, "
+                "\"bw_frac\": %.4f, \"flops_frac\": %.4f}",
+                i == 0 ? "" : ",", r.group.c_str(), r.name.c_str(), r.shape.c_str(),
+                r.sec * 1e6, GBps(r), GFlops(r),
+                GBps(r) / peak_gbps, GFlops(r) / peak_gflops);
+      }
+      fprintf(fo, "\n]}\n");
+    }
+  }
+
+ private:
+  std::vector<Result> results_;
+  std::vector<std::pair<std::string, std::string> > meta_;
+  inline static double GBps(const Result &r) {
+    return r.bytes / r.sec * 1e-9;
+  }
+  inline static double GFlops(const Result &r) {
+    return r.flops / r.sec * 1e-9;
+  }
+};
+/*! \return string representation of a shape, e.g. 32x64 */
+template<typename TShape>
+inline std::string ShapeStr(const TShape &s) {
+  std::string ret;
+  for (int i = 0; i < TShape::kDimension; ++i) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), i == 0 ? "%u" : "x%u", static_cast<unsigned>(s[i]));
+    ret += buf;
+  }
+  return ret;
+}
+}  // namespace bench
+#endif  // MSHADOW_BENCH_H_
@@ -0,0 +1,620 @@
+// microbenchmark of the cpu expression engine
+// usage: bench_op [filter=substr] [format=json|csv] [out=file]
+//                 [min_time=sec] [min_repeat=n] [peak_gbps=x] [peak_gflops=x]
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+#include "mshadow/tensor.h"
+#include "./bench.h"
+
+using namespace mshadow;
+using namespace mshadow::expr;
+
+// sigmoid, a map with transcendental function
+struct sigmoid {
+  MSHADOW_XINLINE static default_real_t Map(default_real_t a) {
+    return 1.0f / (1.0f + expf(-a));
+  }
+};
+
+// relu gradient and clipping written as user ops, they can not use SSE
+struct relu_grad {
+  MSHADOW_XINLINE static default_real_t Map(default_real_t x, default_real_t g) {
+    return x > 0.0f ? g : 0.0f;
+  }
+};
+struct clip_unit {
+  MSHADOW_XINLINE static default_real_t Map(default_real_t x) {
+    return x < -1.0f ? -1.0f : (x > 1.0f ? 1.0f : x);
+  }
+};
+
+class OpBench {
+ public:
+  OpBench(const bench::Config &cfg, bench::Reporter *rep)
+      : rep_(rep), rnd_(0) {
+    filter_ = cfg.GetStr("filter", "");
+    min_time_ = cfg.GetFloat("min_time", 0.2);
+    min_repeat_ = cfg.GetInt("min_repeat", 3);
+  }
+  inline void RunAll(void) {
+    this->BenchMap(false);
+    this->BenchMap(true);
+    this->BenchMapNarrow();
+    this->BenchStream();
+    this->BenchSelect();
+    this->BenchReduce();
+    this->BenchDot();
+    this->BenchPacked();
+    this->BenchCSR();
+    this->BenchPatch();
+    this->BenchGroupConv();
+    this->BenchPool();
+    this->BenchChannelPool();
+    this->BenchConcat();
+    this->BenchResize();
+    this->BenchTake();
+    this->BenchSoftmax();
+    this->BenchArgReduce();
+    this->BenchBatchNorm();
+    this->BenchLayerNorm();
+    this->BenchRNNCell();
+    this->BenchOptimizer();
+    this->BenchRandom();
+    this->BenchCopy();
+  }
+
+ private:
+  bench::Reporter *rep_;
+  Random<cpu> rnd_;
+  std::string filter_;
+  double min_time_;
+  int min_repeat_;
+  // time f and add the result, skip the case if it does not match the filter
+  template<typename F>
+  inline void Run(const char *group, const std::string &name,
+                  const std::string &shape, double bytes, double flops, F f) {
+    std::string full = std::string(group) + "/" + name;
+    if (filter_.length() != 0 && full.find(filter_) == std::string::npos) return;
+    bench::Result r;
+    r.group = group; r.name = name; r.shape = shape;
+    r.bytes = bytes; r.flops = flops;
+    r.sec = bench::TimeIt(f, min_time_, min_repeat_);
+    rep_->Add(r);
+  }
+  // elementwise maps, the unaligned version uses views that start at an odd
+  // offset, so that the SSE path can not be taken
+  inline void BenchMap(bool unaligned) {
+    const index_t nrow = 1024, ncol = 4096;
+    const double n = static_cast<double>(nrow) * ncol, s = sizeof(default_real_t);
+    const index_t off = unaligned ? 1 : 0;
+    TensorContainer<cpu, 2> da(Shape2(nrow, ncol + 1), 0.5f);
+    TensorContainer<cpu, 2> db(Shape2(nrow, ncol + 1), 0.25f);
+    TensorContainer<cpu, 2> dc(Shape2(nrow, ncol + 1), 0.0f);
+    Tensor<cpu, 2> a(da.dptr_ + off, Shape2(nrow, ncol), da.stride_, NULL);
+    Tensor<cpu, 2> b(db.dptr_ + off, Shape2(nrow, ncol), db.stride_, NULL);
+    Tensor<cpu, 2> c(dc.dptr_ + off, Shape2(nrow, ncol), dc.stride_, NULL);
+    const std::string sfx = unaligned ? "_unaligned" : "_aligned";
+    const std::string shape = bench::ShapeStr(a.shape_);
+    this->Run("map", "assign" + sfx, shape, 2 * n * s, 0, [&]() {
+        c = F<op::identity>(a);
+      });
+    this->Run("map", "scalar_mul" + sfx, shape, 2 * n * s, n, [&]() {
+        c = a * 2.0f;
+      });
+    this->Run("map", "mul_add" + sfx, shape, 3 * n * s, 2 * n, [&]() {
+        c = a * b + 1.0f;
+      });
+    this->Run("map", "axpy" + sfx, shape, 3 * n * s, 2 * n, [&]() {
+        c += a * 2.0f;
+      });
+    this->Run("map", "sigmoid" + sfx, shape, 2 * n * s, 4 * n, [&]() {
+        c = F<sigmoid>(a);
+      });
+  }
+  // maps of contiguous tensors with a short last dimension, they are
+  // evaluated as one flat vector instead of row by row
+  inline void BenchMapNarrow(void) {
+    const Shape<2> shapes[2] = {Shape2(1 << 20, 3), Shape2(1 << 16, 49)};
+    const char *names[2] = {"_nx3", "_nx49"};
+    for (int k = 0; k < 2; ++k) {
+      Tensor<cpu, 2> a = NewTensor<cpu>(shapes[k], 0.5f, false);
+      Tensor<cpu, 2> b = NewTensor<cpu>(shapes[k], 0.25f, false);
+      Tensor<cpu, 2> c = NewTensor<cpu>(shapes[k], 0.0f, false);
+      const double n = shapes[k].Size(), s = sizeof(default_real_t);
+      const std::string shape = bench::ShapeStr(shapes[k]);
+      this->Run("map", std::string("mul_add") + names[k], shape, 3 * n * s, 2 * n, [&]() {
+          c = a * b + 1.0f;
+        });
+      this->Run("map", std::string("sigmoid") + names[k], shape, 2 * n * s, 4 * n, [&]() {
+          c = F<sigmoid>(a);
+        });
+      FreeSpace(&a);
+      FreeSpace(&b);
+      FreeSpace(&c);
+    }
+  }
+  // saveto of arrays much larger than the cache, with non-temporal stores
+  // and with normal stores, the threshold is restored after the cases
+  inline void BenchStream(void) {
+    const Shape<1> shape1 = Shape1(1 << 25);
+    Tensor<cpu, 1> a = NewTensor<cpu>(shape1, 0.5f, false);
+    Tensor<cpu, 1> b = NewTensor<cpu>(shape1, 0.25f, false);
+    Tensor<cpu, 1> c = NewTensor<cpu>(shape1, 0.0f, false);
+    const double n = shape1.Size(), s = sizeof(default_real_t);
+    const std::string shape = bench::ShapeStr(shape1);
+#if MSHADOW_USE_SSE
+    const size_t threshold = sse2::StreamThreshold();
+    const size_t thresholds[2] = {0, static_cast<size_t>(-1)};
+    const char *names[2] = {"_stream", "_cached"};
+    for (int k = 0; k < 2; ++k) {
+      sse2::StreamThreshold() = thresholds[k];
+      const std::string sfx = names[k];
+#else
+    {
+      const std::string sfx = "_cached";
+#endif
+      this->Run("stream", "copy" + sfx, shape, 2 * n * s, 0, [&]() {
+          c = F<op::identity>(a);
+        });
+      this->Run("stream", "scale" + sfx, shape, 2 * n * s, n, [&]() {
+          c = a * 2.0f;
+        });
+      this->Run("stream", "axpy" + sfx, shape, 3 * n * s, 2 * n, [&]() {
+          c = a * 2.0f + b;
+        });
+      // reads the destination, so it keeps cached stores with either threshold
+      this->Run("stream", "inplace" + sfx, shape, 3 * n * s, 2 * n, [&]() {
+          c = c * 0.5f + b;
+        });
+    }
+#if MSHADOW_USE_SSE
+    sse2::StreamThreshold() = threshold;
+#endif
+    FreeSpace(&a);
+    FreeSpace(&b);
+    FreeSpace(&c);
+  }
+  // masking and clipping with the built-in ops, against the same maps
+  // written as user ops
+  inline void BenchSelect(void) {
+    const index_t nrow = 1024, ncol = 4096;
+    TensorContainer<cpu, 2> x(Shape2(nrow, ncol)), g(Shape2(nrow, ncol), 0.25f);
+    TensorContainer<cpu, 2> c(Shape2(nrow, ncol), 0.0f);
+    rnd_.SampleUniform(&x, -2.0f, 2.0f);
+    const double n = static_cast<double>(nrow) * ncol, s = sizeof(default_real_t);
+    const std::string shape = bench::ShapeStr(x.shape_);
+    this->Run("select", "relu_grad_user", shape, 3 * n * s, n, [&]() {
+        c = F<relu_grad>(x, g);
+      });
+    this->Run("select", "relu_grad_where", shape, 3 * n * s, n, [&]() {
+        c = where(F<op::gt>(x, 0.0f), g, 0.0f);
+      });
+    this->Run("select", "clip_user", shape, 2 * n * s, 2 * n, [&]() {
+        c = F<clip_unit>(x);
+      });
+    this->Run("select", "clip", shape, 2 * n * s, 2 * n, [&]() {
+        c = clip(x, -1.0f, 1.0f);
+      });
+    this->Run("select", "sign", shape, 2 * n * s, 2 * n, [&]() {
+        c = F<op::sign>(x);
+      });
+  }
+  inline void BenchReduce(void) {
+    const double s = sizeof(default_real_t);
+    {
+      TensorContainer<cpu, 4> src(Shape4(64, 64, 32, 32), 1.0f);
+      TensorContainer<cpu, 1> dst(Shape1(64), 0.0f);
+      const double n = src.shape_.Size();
+      this->Run("reduce", "sumall_except_dim1", bench::ShapeStr(src.shape_),
+                n * s, n, [&]() {
+                  dst = sumall_except_dim<1>(src);
+                });
+    }
+    {
+      TensorContainer<cpu, 2> src(Shape2(4096, 1024), 1.0f);
+      TensorContainer<cpu, 1> dst(Shape1(1024), 0.0f);
+      const double n = src.shape_.Size();
+      this->Run("reduce", "sum_rows", bench::ShapeStr(src.shape_),
+                n * s, n, [&]() {
+                  dst = sum_rows(src);
+                });
+    }
+  }
+  inline void BenchDot(void) {
+#if MSHADOW_USE_CBLAS || MSHADOW_USE_MKL
+    const index_t shapes[][3] = {
+      {512, 512, 512}, {1024, 1024, 1024}, {64, 1024, 1024},
+      {8, 4096, 1024}, {1, 4096, 4096}, {4096, 64, 4096}
+    };
+    const double s = sizeof(default_real_t);
+    for (size_t i = 0; i < sizeof(shapes) / sizeof(shapes[0]); ++i) {
+      const index_t m = shapes[i][0], k = shapes[i][1], n = shapes[i][2];
+      TensorContainer<cpu, 2> lhs(Shape2(m, k), 0.5f);
+      TensorContainer<cpu, 2> lhs_t(Shape2(k, m), 0.5f);
+      TensorContainer<cpu, 2> rhs(Shape2(k, n), 0.5f);
+      TensorContainer<cpu, 2> rhs_t(Shape2(n, k), 0.5f);
+      TensorContainer<cpu, 2> out(Shape2(m, n), 0.0f);
+      const double flops = 2.0 * m * k * n;
+      const double bytes = (static_cast<double>(m) * k + k * n + 2.0 * m * n) * s;
+      const std::string shape = bench::ShapeStr(Shape3(m, k, n));
+      this->Run("dot", "nn", shape, bytes, flops, [&]() {
+          out = dot(lhs, rhs);
+        });
+      this->Run("dot", "tn", shape, bytes, flops, [&]() {
+          out = dot(lhs_t.T(), rhs);
+        });
+      this->Run("dot", "nt", shape, bytes, flops, [&]() {
+          out = dot(lhs, rhs_t.T());
+        });
+    }
+#else
+    fprintf(stderr, "dot: skipped, compiled without BLAS\n");
+#endif
+  }
+  // small batch dot with prepacked rhs, runs without BLAS as well
+  inline void BenchPacked(void) {
+    const index_t shapes[][3] = {
+      {1, 1024, 1024}, {8, 1024, 1024}, {1, 4096, 4096}, {64, 1024, 1024}
+    };
+    const double s = sizeof(default_real_t);
+    for (size_t i = 0; i < sizeof(shapes) / sizeof(shapes[0]); ++i) {
+      const index_t m = shapes[i][0], k = shapes[i][1], n = shapes[i][2];
+      TensorContainer<cpu, 2> lhs(Shape2(m, k), 0.5f);
+      TensorContainer<cpu, 2> rhs(Shape2(k, n), 0.5f);
+      TensorContainer<cpu, 2> out(Shape2(m, n), 0.0f);
+      PackedMatrix<default_real_t> packed(rhs);
+      const double flops = 2.0 * m * k * n;
+      const double bytes = (static_cast<double>(m) * k + k * n + 2.0 * m * n) * s;
+      this->Run("dot", "nn_packed", bench::ShapeStr(Shape3(m, k, n)), bytes, flops, [&]() {
+          out = dot(lhs, packed);
+        });
+    }
+  }
+  inline void BenchCSR(void) {
+    // bag of words like input, 32 nonzeros per row
+    const index_t m = 1024, k = 65536, n = 256, nnz_row = 32;
+    CSRTensor<cpu, default_real_t> lhs;
+    lhs.Resize(Shape2(m, k), m * nnz_row);
+    for (index_t i = 0; i < m; ++i) {
+      lhs.indptr_[i + 1] = (i + 1) * nnz_row;
+      for (index_t t = 0; t < nnz_row; ++t) {
+        lhs.indices_[i * nnz_row + t] = static_cast<index_t>((i * 7919U + t * 2048U) % k);
+        lhs.data_[i * nnz_row + t] = 1.0f;
+      }
+    }
+    for (index_t i = 0; i < m; ++i) {
+      std::sort(lhs.indices_.begin() + i * nnz_row, lhs.indices_.begin() + (i + 1) * nnz_row);
+    }
+    TensorContainer<cpu, 2> rhs(Shape2(k, n), 0.5f), out(Shape2(m, n), 0.0f);
+    TensorContainer<cpu, 2> grad(Shape2(k, n), 0.0f);
+    const double s = sizeof(default_real_t), nnz = lhs.nnz();
+    const std::string sshape = bench::ShapeStr(Shape3(m, k, n));
+    this->Run("dot", "csr_nn", sshape, (2.0 * nnz * n + m * n) * s, 2.0 * nnz * n, [&]() {
+        out = dot(lhs, rhs);
+      });
+    this->Run("dot", "csr_tn", sshape, (2.0 * nnz * n + k * n) * s, 2.0 * nnz * n, [&]() {
+        grad = dot(lhs.T(), out);
+      });
+  }
+  inline void BenchPatch(void) {
+    const index_t ksize = 5, kstride = 1;
+    TensorContainer<cpu, 4> img(Shape4(16, 64, 28, 28), 1.0f);
+    const index_t oh = (img.size(2) - ksize) / kstride + 1;
+    const index_t ow = (img.size(3) - ksize) / kstride + 1;
+    TensorContainer<cpu, 2> col(Shape2(img.size(1) * ksize * ksize,
+                                       img.size(0) * oh * ow), 0.0f);
+    const double s = sizeof(default_real_t);
+    const double ncol = col.shape_.Size(), nimg = img.shape_.Size();
+    this->Run("patch", "unpack_patch2col", bench::ShapeStr(img.shape_),
+              (ncol + nimg) * s, 0, [&]() {
+                col = unpack_patch2col(img, ksize, ksize, kstride);
+              });
+    this->Run("patch", "pack_col2patch", bench::ShapeStr(img.shape_),
+              (ncol + nimg) * s, ncol, [&]() {
+                img = pack_col2patch(col, img.shape_, ksize, ksize, kstride);
+              });
+  }
+  // a 3x3 depthwise layer of MobileNet, direct and as groups of im2col + dot,
+  // and a grouped 3x3 layer with 8 groups
+  inline void BenchGroupConv(void) {
+    const index_t batch = 8, nchannel = 128, size = 28, ngroup = 8;
+    TensorContainer<cpu, 4> data(Shape4(batch, nchannel, size, size));
+    TensorContainer<cpu, 4> out(data.shape_), grad_out(data.shape_), grad_data(data.shape_);
+    TensorContainer<cpu, 3> dweight(Shape3(nchannel, 3, 3)), grad_dweight(dweight.shape_);
+    TensorContainer<cpu, 2> dwmat(Shape2(nchannel, 9));
+    TensorContainer<cpu, 2> gweight(Shape2(nchannel, nchannel / ngroup * 9));
+    TensorContainer<cpu, 2> grad_gweight(gweight.shape_);
+    rnd_.SampleGaussian(&data);
+    rnd_.SampleGaussian(&grad_out);
+    rnd_.SampleGaussian(&dweight);
+    rnd_.SampleGaussian(&gweight);
+    dwmat = 0.1f;
+    const double n = data.shape_.Size(), s = sizeof(default_real_t);
+    const std::string shape = bench::ShapeStr(data.shape_);
+    this->Run("conv", "depthwise_3x3", shape, 2 * n * s, 18 * n, [&]() {
+        DepthwiseConvForward(out, data, dweight, 1, 1);
+      });
+    this->Run("conv", "depthwise_3x3_backward", shape, 4 * n * s, 36 * n, [&]() {
+        DepthwiseConvBackward(grad_data, grad_dweight, grad_out, data, dweight, 1, 1);
+      });
+    this->Run("conv", "depthwise_3x3_as_groups", shape, 2 * n * s, 18 * n, [&]() {
+        GroupConvForward(out, data, dwmat, nchannel, 3, 3, 1, 1);
+      });
+    const double gflops = 18.0 * n * nchannel / ngroup;
+    this->Run("conv", "group8_3x3", shape, 2 * n * s, gflops, [&]() {
+        GroupConvForward(out, data, gweight, ngroup, 3, 3, 1, 1);
+      });
+    this->Run("conv", "group8_3x3_backward", shape, 4 * n * s, 2 * gflops, [&]() {
+        GroupConvBackward(grad_data, grad_gweight, grad_out, data, gweight, ngroup, 3, 3, 1, 1);
+      });
+  }
+  inline void BenchPool(void) {
+    const index_t ksize = 3, kstride = 2;
+    TensorContainer<cpu, 4> src(Shape4(32, 64, 56, 56), 1.0f);
+    TensorContainer<cpu, 4> dst(Shape4(32, 64, (56 - ksize) / kstride + 1,
+                                       (56 - ksize) / kstride + 1), 0.0f);
+    const double s = sizeof(default_real_t);
+    const double nsrc = src.shape_.Size(), ndst = dst.shape_.Size();
+    this->Run("pool", "max_3x3_s2", bench::ShapeStr(src.shape_),
+              (nsrc + ndst) * s, ndst * ksize * ksize, [&]() {
+                dst = pool<red::maximum>(src, ksize, ksize, kstride);
+              });
+    this->Run("pool", "sum_3x3_s2", bench::ShapeStr(src.shape_),
+              (nsrc + ndst) * s, ndst * ksize * ksize, [&]() {
+                dst = pool<red::sum>(src, ksize, ksize, kstride);
+              });
+  }
+  // sum over neighbor channels, as in local response normalization
+  inline void BenchChannelPool(void) {
+    const index_t nsize = 5;
+    TensorContainer<cpu, 4> src(Shape4(16, 256, 13, 13), 1.0f);
+    TensorContainer<cpu, 4> dst(Shape4(16, 256, 13, 13), 0.0f);
+    const double n = src.shape_.Size(), s = sizeof(default_real_t);
+    this->Run("chpool", "sum_5", bench::ShapeStr(src.shape_), 2 * n * s, n * nsize, [&]() {
+        dst = chpool<red::sum>(src, nsize);
+      });
+    this->Run("chpool", "unpool_sum_5", bench::ShapeStr(src.shape_), 2 * n * s, n * nsize, [&]() {
+        dst = ch_unpool<red::sum>(src, src, src, nsize);
+      });
+  }
+  inline void BenchConcat(void) {
+    TensorContainer<cpu, 4> a(Shape4(32, 64, 28, 28), 1.0f);
+    TensorContainer<cpu, 4> b(Shape4(32, 64, 28, 28), 2.0f);
+    TensorContainer<cpu, 4> dc(Shape4(32, 128, 28, 28), 0.0f);
+    Tensor<cpu, 4> c = dc;
+    const double n = c.shape_.Size(), s = sizeof(default_real_t);
+    this->Run("concat", "channel", bench::ShapeStr(c.shape_), 2 * n * s, 0, [&]() {
+        c = concat<1>(a, b);
+      });
+    this->Run("concat", "split_channel", bench::ShapeStr(c.shape_), 2 * n * s, 0, [&]() {
+        concat<1>(a, b) = c;
+      });
+  }
+  inline void BenchResize(void) {
+    TensorContainer<cpu, 4> src(Shape4(8, 64, 32, 32));
+    TensorContainer<cpu, 4> dst(Shape4(8, 64, 64, 64), 0.0f), grad_src(src.shape_);
+    rnd_.SampleGaussian(&src);
+    const double s = sizeof(default_real_t);
+    const double nsrc = src.shape_.Size(), ndst = dst.shape_.Size();
+    const std::string shape = bench::ShapeStr(src.shape_);
+    this->Run("resize", "nearest_x2", shape, (nsrc + ndst) * s, 0, [&]() {
+        dst = upsample_nearest(src, 2);
+      });
+    this->Run("resize", "nearest_x2_backward", shape, (nsrc + ndst) * s, ndst, [&]() {
+        UpSampleNearestBackward(grad_src, dst, 2);
+      });
+    this->Run("resize", "bilinear_x2", shape, (nsrc + ndst) * s, 3 * ndst, [&]() {
+        dst = resize_bilinear(src, 64, 64);
+      });
+    this->Run("resize", "bilinear_x2_backward", shape, (2 * nsrc + ndst) * s, 4 * ndst, [&]() {
+        ResizeBilinearBackward(grad_src, dst);
+      });
+  }
+  inline void BenchTake(void) {
+    const index_t nvocab = 100000, nlookup = 8192, ncol = 256;
+    TensorContainer<cpu, 2> table(Shape2(nvocab, ncol), 1.0f), grad(Shape2(nvocab, ncol), 0.0f);
+    TensorContainer<cpu, 2> out(Shape2(nlookup, ncol), 0.0f);
+    TensorContainer<cpu, 1, int> index(Shape1(nlookup));
+    for (index_t i = 0; i < nlookup; ++i) {
+      index[i] = static_cast<int>((i * 2654435761U) % nvocab);
+    }
+    const double n = out.shape_.Size(), s = sizeof(default_real_t);
+    const std::string sshape = bench::ShapeStr(out.shape_);
+    this->Run("take", "rows", sshape, 2 * n * s, 0, [&]() {
+        out = take(table, index);
+      });
+    this->Run("take", "scatter_add", sshape, 3 * n * s, n, [&]() {
+        ScatterAdd(grad, index, out);
+      });
+  }
+  inline void BenchSoftmax(void) {
+    TensorContainer<cpu, 2> energy(Shape2(256, 1000), 0.0f);
+    TensorContainer<cpu, 2> prob(Shape2(256, 1000), 0.0f);
+    rnd_.SampleGaussian(&energy);
+    const double n = energy.shape_.Size(), s = sizeof(default_real_t);
+    // max, subtract, exp, sum and normalize
+    this->Run("softmax", "forward", bench::ShapeStr(energy.shape_),
+              2 * n * s, 5 * n, [&]() {
+                Softmax(prob, energy);
+              });
+  }
+  inline void BenchArgReduce(void) {
+    TensorContainer<cpu, 2> src(Shape2(256, 32000), 0.0f);
+    TensorContainer<cpu, 1> index(Shape1(256), 0.0f);
+    TensorContainer<cpu, 2> values(Shape2(256, 8), 0.0f);
+    TensorContainer<cpu, 2, int> indices(Shape2(256, 8));
+    rnd_.SampleGaussian(&src);
+    const double n = src.shape_.Size(), s = sizeof(default_real_t);
+    const std::string sshape = bench::ShapeStr(src.shape_);
+    this->Run("argreduce", "argmax", sshape, n * s, n, [&]() {
+        index = argmax<1>(src);
+      });
+    this->Run("argreduce", "topk_8", sshape, n * s, n, [&]() {
+        TopK(values, indices, src);
+      });
+  }
+  inline void BenchBatchNorm(void) {
+    const Shape<4> shape = Shape4(32, 64, 28, 28);
+    TensorContainer<cpu, 4> data(shape, 1.0f), out(shape, 0.0f);
+    TensorContainer<cpu, 4> grad_out(shape, 1.0f), grad_in(shape, 0.0f);
+    TensorContainer<cpu, 1> gamma(Shape1(shape[1]), 1.0f), beta(Shape1(shape[1]), 0.0f);
+    TensorContainer<cpu, 1> mean(Shape1(shape[1])), var(Shape1(shape[1]));
+    TensorContainer<cpu, 1> grad_gamma(Shape1(shape[1])), grad_beta(Shape1(shape[1]));
+    const double n = shape.Size(), s = sizeof(default_real_t);
+    const std::string sshape = bench::ShapeStr(shape);
+    this->Run("batchnorm", "forward", sshape, 3 * n * s, 5 * n, [&]() {
+        BatchNormForward(out, mean, var, data, gamma, beta, 1e-5f);
+      });
+    this->Run("batchnorm", "backward", sshape, 5 * n * s, 8 * n, [&]() {
+        BatchNormBackward(grad_in, grad_gamma, grad_beta, grad_out, data,
+                          mean, var, gamma, 1e-5f);
+      });
+    this->Run("batchnorm", "inference", sshape, 2 * n * s, 2 * n, [&]() {
+        BatchNormInference(out, data, mean, var, gamma, beta, 1e-5f);
+      });
+  }
+  inline void BenchLayerNorm(void) {
+    const Shape<2> shape = Shape2(256, 4096);
+    TensorContainer<cpu, 2> data(shape, 1.0f), out(shape, 0.0f);
+    TensorContainer<cpu, 2> grad_out(shape, 1.0f), grad_in(shape, 0.0f);
+    TensorContainer<cpu, 1> gamma(Shape1(shape[1]), 1.0f), beta(Shape1(shape[1]), 0.0f);
+    TensorContainer<cpu, 1> grad_gamma(Shape1(shape[1])), grad_beta(Shape1(shape[1]));
+    TensorContainer<cpu, 1> mean(Shape1(shape[0])), rstd(Shape1(shape[0]));
+    rnd_.SampleGaussian(&data);
+    const double n = shape.Size(), s = sizeof(default_real_t);
+    const std::string sshape = bench::ShapeStr(shape);
+    this->Run("layernorm", "forward", sshape, 2 * n * s, 6 * n, [&]() {
+        LayerNormForward(out, mean, rstd, data, gamma, beta, 1e-5f);
+      });
+    this->Run("layernorm", "backward", sshape, 3 * n * s, 12 * n, [&]() {
+        LayerNormBackward(grad_in, grad_gamma, grad_beta, grad_out, data, mean, rstd, gamma);
+      });
+    this->Run("rmsnorm", "forward", sshape, 2 * n * s, 4 * n, [&]() {
+        RMSNormForward(out, rstd, data, gamma, 1e-5f);
+      });
+    this->Run("rmsnorm", "backward", sshape, 3 * n * s, 9 * n, [&]() {
+        RMSNormBackward(grad_in, grad_gamma, grad_out, data, rstd, gamma);
+      });
+  }
+  inline void BenchRNNCell(void) {
+    const index_t batch = 64, nhidden = 1024;
+    TensorContainer<cpu, 2> gates(Shape2(batch, 4 * nhidden)), grad_gates(Shape2(batch, 4 * nhidden));
+    TensorContainer<cpu, 2> c(Shape2(batch, nhidden)), h(Shape2(batch, nhidden), 0.0f);
+    TensorContainer<cpu, 2> c_prev(Shape2(batch, nhidden), 0.5f), grad(Shape2(batch, nhidden), 1.0f);
+    TensorContainer<cpu, 2> grad_prev(Shape2(batch, nhidden));
+    TensorContainer<cpu, 1> bias(Shape1(4 * nhidden), 0.0f);
+    rnd_.SampleGaussian(&gates);
+    const double n = c.shape_.Size(), s = sizeof(default_real_t);
+    const std::string sshape = bench::ShapeStr(gates.shape_);
+    this->Run("rnn", "lstm_forward", sshape, 11 * n * s, 0, [&]() {
+        LSTMCellForward(c, h, gates, c_prev, bias);
+      });
+    this->Run("rnn", "lstm_backward", sshape, 13 * n * s, 0, [&]() {
+        LSTMCellBackward(grad_gates, grad_prev, grad, grad, gates, c_prev, c);
+      });
+    TensorContainer<cpu, 2> gates_x(Shape2(batch, 3 * nhidden)), gates_h(Shape2(batch, 3 * nhidden));
+    TensorContainer<cpu, 2> grad_x(Shape2(batch, 3 * nhidden)), grad_h(Shape2(batch, 3 * nhidden));
+    TensorContainer<cpu, 1> bias_x(Shape1(3 * nhidden), 0.0f), bias_h(Shape1(3 * nhidden), 0.0f);
+    rnd_.SampleGaussian(&gates_x);
+    rnd_.SampleGaussian(&gates_h);
+    this->Run("rnn", "gru_forward", bench::ShapeStr(gates_x.shape_), 11 * n * s, 0, [&]() {
+        GRUCellForward(h, gates_x, gates_h, c_prev, bias_x, bias_h);
+      });
+    this->Run("rnn", "gru_backward", bench::ShapeStr(gates_x.shape_), 15 * n * s, 0, [&]() {
+        GRUCellBackward(grad_x, grad_h, grad_prev, grad, gates_x, gates_h, bias_h, c_prev);
+      });
+  }
+  // optimizer updates of many small parameters, the per tensor version is
+  // the loop of expressions used by the training examples
+  inline void BenchOptimizer(void) {
+    const int ntensor = 256;
+    std::vector<TensorContainer<cpu, 2>*> data;
+    std::vector<Tensor<cpu, 2> > w, g, m, v;
+    double n = 0;
+    for (int i = 0; i < ntensor; ++i) {
+      const Shape<2> shape = Shape2(1 + i % 7, 64 + 97 * (i % 13));
+      for (int k = 0; k < 4; ++k) data.push_back(new TensorContainer<cpu, 2>(shape, 0.01f));
+      w.push_back(*data[4 * i]); g.push_back(*data[4 * i + 1]);
+      m.push_back(*data[4 * i + 2]); v.push_back(*data[4 * i + 3]);
+      n += shape.Size();
+    }
+    const double s = sizeof(default_real_t);
+    const std::string shape = "256 tensors";
+    SGDParam sgd;
+    sgd.momentum = 0.0f;
+    this->Run("optimizer", "sgd_mom_per_tensor", shape, 5 * n * s, 6 * n, [&]() {
+        for (int i = 0; i < ntensor; ++i) {
+          m[i] = sgd.momentum * m[i] - sgd.lr * (sgd.rescale_grad * g[i] + sgd.wd * w[i]);
+          w[i] += m[i];
+        }
+      });
+    this->Run("optimizer", "sgd_mom", shape, 5 * n * s, 6 * n, [&]() {
+        MultiSGDMomUpdate(w, g, m, sgd);
+      });
+    AdamParam adam;
+    this->Run("optimizer", "adam", shape, 7 * n * s, 14 * n, [&]() {
+        MultiAdamUpdate(w, g, m, v, adam);
+      });
+    this->Run("optimizer", "lamb", shape, 10 * n * s, 24 * n, [&]() {
+        MultiLAMBUpdate(w, g, m, v, adam);
+      });
+    for (size_t i = 0; i < data.size(); ++i) delete data[i];
+  }
+  inline void BenchRandom(void) {
+    TensorContainer<cpu, 2> dst(Shape2(1024, 4096), 0.0f);
+    const double n = dst.shape_.Size(), s = sizeof(default_real_t);
+    this->Run("random", "uniform", bench::ShapeStr(dst.shape_), n * s, 0, [&]() {
+        rnd_.SampleUniform(&dst);
+      });
+    this->Run("random", "gaussian", bench::ShapeStr(dst.shape_), n * s, 0, [&]() {
+        rnd_.SampleGaussian(&dst);
+      });
+  }
+  inline void BenchCopy(void) {
+    const index_t nrow = 4096, ncol = 1024;
+    TensorContainer<cpu, 2> src(Shape2(nrow, ncol), 1.0f);
+    TensorContainer<cpu, 2> dst(Shape2(nrow, ncol), 0.0f);
+    TensorContainer<cpu, 2> dsrc(Shape2(nrow, ncol + 1), 1.0f);
+    Tensor<cpu, 2> strided(dsrc.dptr_, Shape2(nrow, ncol), dsrc.stride_, NULL);
+    const double n = static_cast<double>(nrow) * ncol, s = sizeof(default_real_t);
+    const std::string shape = bench::ShapeStr(dst.shape_);
+    this->Run("copy", "contiguous", shape, 2 * n * s, 0, [&]() {
+        Copy(dst, src);
+      });
+    this->Run("copy", "strided", shape, 2 * n * s, 0, [&]() {
+        Copy(dst, strided);
+      });
+  }
+};
+
+int main(int argc, char *argv[]) {
+  InitTensorEngine<cpu>();
+  bench::Config cfg(argc, argv);
+  bench::Reporter rep(cfg);
+  rep.SetMeta("bench", "bench_op");
+  rep.SetMeta("sse", MSHADOW_USE_SSE ? "1" : "0");
+  rep.SetMeta("blas", MSHADOW_USE_MKL ? "mkl" : (MSHADOW_USE_CBLAS ? "cblas" : "none"));
+  #if defined(_OPENMP)
+  rep.SetMeta("omp_threads", std::to_string(omp_get_max_threads()));
+  #else
+  rep.SetMeta("omp_threads", "0");
+  #endif
+  {
+    OpBench b(cfg, &rep);
+    b.RunAll();
+  }
+  std::string out = cfg.GetStr("out", "");
+  FILE *fo = out.length() != 0 ? fopen(out.c_str(), "w") : stdout;
+  if (fo == NULL) {
+    fprintf(stderr, "cannot open %s\n", out.c_str()); return -1;
+  }
+  rep.Print(cfg.GetStr("format", "json"), fo);
+  if (fo != stdout) fclose(fo);
+  ShutdownTensorEngine<cpu>();
+  return 0;
+}
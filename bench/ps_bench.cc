@@ -0,0 +1,275 @@
+// benchmark and load generator of mshadow-ps
+// a synthetic model with nkey layers is trained by nworker threads on the cpu,
+// each iteration runs backprop from the last layer to the first one, pushing the
+// gradient of each layer once it is computed, then runs the forward pass,
+// waiting for the weight of each layer right before it is used
+//
+// usage: ps_bench [name=value]...
+//   type=local         type of the parameter server, passed to CreateSharedModel
+//   nworker=4          number of workers (devices)
+//   nkey=16            number of keys (layers)
+//   key_size=262144    mean number of floats of each key
+//   size_dist=fixed    fixed, uniform in [1, 2*key_size) or exp(onential)
+//   priority=layer     layer: -key, as in guide/neuralnet, none: 0,
+//                      reverse: key, random
+//   compute_us=500     simulated compute time of each layer in backward,
+//                      forward takes half of it, scaled by the relative key size
+//   compute=sleep      sleep or spin, spin keeps the core busy
+//   niter=20 warmup=3 seed=0
+//   stats=json         print the statistics of the server, json or prometheus
+//   format=json        json or csv, out=file
+//   ps.<name>=<value>  passed to ISharedModel::SetParam, e.g. ps.push_thread=ndev
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+#include "mshadow/tensor.h"
+#include "mshadow-ps/mshadow_ps.h"
+#include "./bench.h"
+
+using namespace mshadow;
+
+namespace mshadow {
+namespace ps {
+// sum aggregation only, no server side updater
+template<>
+IModelUpdater<float> *CreateModelUpdater(void) {
+  return NULL;
+}
+}  // namespace ps
+}  // namespace mshadow
+
+// timestamps of one request, the pull callback writes tdone
+struct Slot {
+  double tpush, tdone;
+};
+// the measurements of one worker
+struct WorkerLog {
+  // time of each iteration
+  std::vector<double> iter_time;
+  // latency from push to the end of pull of each key
+  std::vector<std::vector<double> > latency;
+  // time spent in simulated compute and blocked in PullWait
+  double compute_time, wait_time;
+};
+
+class PSBench {
+ public:
+  explicit PSBench(const bench::Config &cfg) : cfg_(cfg) {
+    type_ = cfg.GetStr("type", "local");
+    nworker_ = cfg.GetInt("nworker", 4);
+    nkey_ = cfg.GetInt("nkey", 16);
+    niter_ = cfg.GetInt("niter", 20);
+    warmup_ = cfg.GetInt("warmup", 3);
+    compute_us_ = cfg.GetFloat("compute_us", 500.0);
+    spin_ = cfg.GetStr("compute", "sleep") == "spin";
+    priority_ = cfg.GetStr("priority", "layer");
+    srand(cfg.GetInt("seed", 0));
+    const double mean = cfg.GetFloat("key_size", 262144);
+    const std::string dist = cfg.GetStr("size_dist", "fixed");
+    total_size_ = 0;
+    for (int k = 0; k < nkey_; ++k) {
+      const double u = (rand() + 0.5) / (RAND_MAX + 1.0);
+      double sz = mean;
+      if (dist == "uniform") sz = 1.0 + u * (2.0 * mean - 1.0);
+      if (dist == "exp") sz = -mean * std::log(u);
+      sizes_.push_back(std::max(static_cast<index_t>(sz), static_cast<index_t>(1)));
+      total_size_ += sizes_.back();
+      prio_.push_back(this->Priority(k));
+    }
+  }
+  /*!
+   * \brief run the benchmark
+   * \param compute whether simulate compute, when false, the pure
+   *   communication time is measured
+   */
+  inline void Run(bool compute, std::vector<WorkerLog> *logs) {
+    ps::ISharedModel<cpu, float> *ps =
+        ps::CreateSharedModel<cpu, float>(type_.c_str());
+    std::vector<std::pair<std::string, std::string> > params = cfg_.GetPrefixed("ps.");
+    for (size_t i = 0; i < params.size(); ++i) {
+      ps->SetParam(params[i].first.c_str(), params[i].second.c_str());
+    }
+    std::vector<int> devs;
+    for (int i = 0; i < nworker_; ++i) devs.push_back(i);
+    ps->Init(devs);
+    logs->clear();
+    logs->resize(nworker_);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < nworker_; ++i) {
+      threads.push_back(std::thread(&PSBench::RunWorker, this, ps, i,
+                                    compute, &(*logs)[i]));
+    }
+    for (int i = 0; i < nworker_; ++i) threads[i].join();
+    if (compute && cfg_.GetStr("stats", "").length() != 0) {
+      fprintf(stderr, "%s", ps->GetStats(cfg_.GetStr("stats", "").c_str()).c_str());
+    }
+    delete ps;
+  }
+  /*! \brief run the benchmark and print the report */
+  inline void Report(FILE *fo, const std::string &format) {
+    std::vector<WorkerLog> comm, full;
+    this->Run(false, &comm);
+    this->Run(true, &full);
+    std::vector<double> tcomm, titer, all_lat;
+    double compute = 0.0, wait = 0.0;
+    for (int i = 0; i < nworker_; ++i) {
+      tcomm.insert(tcomm.end(), comm[i].iter_time.begin(), comm[i].iter_time.end());
+      titer.insert(titer.end(), full[i].iter_time.begin(), full[i].iter_time.end());
+      compute += full[i].compute_time;
+      wait += full[i].wait_time;
+    }
+    const double nrecord = static_cast<double>(nworker_) * niter_;
+    compute /= nrecord; wait /= nrecord;
+    const double comm_mean = Mean(tcomm), iter_mean = Mean(titer);
+    // bytes pushed and pulled by all the workers in one iteration
+    const double bytes = 2.0 * nworker_ * total_size_ * sizeof(float);
+    // fraction of the communication hidden behind compute
+    double overlap = (compute + comm_mean - iter_mean) / std::min(compute, comm_mean);
+    overlap = std::max(0.0, std::min(1.0, overlap));
+    // per key tail latency
+    std::vector<double> p50(nkey_), p99(nkey_), pmax(nkey_);
+    for (int k = 0; k < nkey_; ++k) {
+      std::vector<double> lat;
+      for (int i = 0; i < nworker_; ++i) {
+        lat.insert(lat.end(), full[i].latency[k].begin(), full[i].latency[k].end());
+      }
+      all_lat.insert(all_lat.end(), lat.begin(), lat.end());
+      p50[k] = bench::Quantile(&lat, 0.5);
+      p99[k] = bench::Quantile(&lat, 0.99);
+      pmax[k] = bench::Quantile(&lat, 1.0);
+    }
+    fprintf(stderr, "iteration: %.3f ms (p99 %.3f ms), comm only: %.3f ms, "
+            "compute: %.3f ms, blocked: %.3f ms\n",
+            iter_mean * 1e3, bench::Quantile(&titer, 0.99) * 1e3, comm_mean * 1e3,
+            compute * 1e3, wait * 1e3);
+    fprintf(stderr, "bandwidth: %.3f GB/s, overlap efficiency: %.1f%%, "
+            "latency p50 %.3f ms, p99 %.3f ms\n",
+            bytes / comm_mean * 1e-9, overlap * 100.0,
+            bench::Quantile(&all_lat, 0.5) * 1e3, bench::Quantile(&all_lat, 0.99) * 1e3);
+    if (format == "csv") {
+      fprintf(fo, "key,size,priority,p50_ms,p99_ms,max_ms\n");
+      for (int k = 0; k < nkey_; ++k) {
+        fprintf(fo, "%d,%u,%d,%.4f,%.4f,%.4f\n", k, sizes_[k], prio_[k],
+                p50[k] * 1e3, p99[k] * 1e3, pmax[k] * 1e3);
+      }
+      return;
+    }
+    fprintf(fo, "{\"bench\": \"ps_bench\", \"type\": \"%s\", \"nworker\": %d, "
+            "\"nkey\": %d, \"total_size\": %.0f, \"priority\": \"%s\",\n",
+            type_.c_str(), nworker_, nkey_, total_size_, priority_.c_str());
+    fprintf(fo, " \"iter_ms\": %.4f, \"iter_p99_ms\": %.4f, \"comm_ms\": %.4f, "
+            "\"compute_ms\": %.4f, \"wait_ms\": %.4f,\n",
+            iter_mean * 1e3, bench::Quantile(&titer, 0.99) * 1e3, comm_mean * 1e3,
+            compute * 1e3, wait * 1e3);
+    fprintf(fo, " \"comm_gbps\": %.4f, \"iter_gbps\": %.4f, \"overlap\": %.4f,\n",
+            bytes / comm_mean * 1e-9, bytes / iter_mean * 1e-9, overlap);
+    fprintf(fo, " \"keys\": [");
+    for (int k = 0; k < nkey_; ++k) {
+      fprintf(fo, "%s\n  {\"key\": %d, \"size\": %u, \"priority\": %d, "
+              "\"p50_ms\": %.4f, \"p99_ms\": %.4f, \"max_ms\": %.4f}",
+              k == 0 ? "" : ",", k, sizes_[k], prio_[k],
+              p50[k] * 1e3, p99[k] * 1e3, pmax[k] * 1e3);
+    }
+    fprintf(fo, "\n]}\n");
+  }
+
+ private:
+  const bench::Config &cfg_;
+  std::string type_, priority_;
+  int nworker_, nkey_, niter_, warmup_;
+  double compute_us_, total_size_;
+  bool spin_;
+  std::vector<index_t> sizes_;
+  std::vector<int> prio_;
+
+  inline int Priority(int key) const {
+    if (priority_ == "none") return 0;
+    if (priority_ == "reverse") return key;
+    if (priority_ == "random") return rand() % nkey_;
+    return -key;
+  }
+  inline static double Mean(const std::vector<double> &v) {
+    double sum = 0.0;
+    for (size_t i = 0; i < v.size(); ++i) sum += v[i];
+    return v.size() == 0 ? 0.0 : sum / v.size();
+  }
+  inline static void OnPullDone(Stream<cpu> *stream, void *arg) {
+    static_cast<Slot*>(arg)->tdone = bench::GetTime();
+  }
+  // simulate the computation of a layer
+  inline void Compute(int key, double scale) const {
+    const double sec = compute_us_ * 1e-6 * scale * sizes_[key] * nkey_ / total_size_;
+    if (sec <= 0.0) return;
+    if (spin_) {
+      const double tend = bench::GetTime() + sec;
+      while (bench::GetTime() < tend) {}
+    } else {
+      std::this_thread::sleep_for(std::chrono::duration<double>(sec));
+    }
+  }
+  inline void RunWorker(ps::ISharedModel<cpu, float> *ps, int devid,
+                        bool compute, WorkerLog *log) {
+    InitTensorEngine<cpu>();
+    std::vector<TensorContainer<cpu, 1> *> data(nkey_);
+    std::vector<Slot> slots(nkey_);
+    for (int k = 0; k < nkey_; ++k) {
+      data[k] = new TensorContainer<cpu, 1>(Shape1(sizes_[k]), 1.0f);
+      ps->InitKey(data[k]->shape_, k, devid);
+    }
+    log->latency.resize(nkey_);
+    log->compute_time = log->wait_time = 0.0;
+    for (int it = 0; it < warmup_ + niter_; ++it) {
+      const bool record = it >= warmup_;
+      double tstart = bench::GetTime(), tcompute = 0.0, twait = 0.0;
+      // backprop, from the last layer to the first one
+      for (int k = nkey_ - 1; k >= 0; --k) {
+        double t = bench::GetTime();
+        if (compute) this->Compute(k, 1.0);
+        tcompute += bench::GetTime() - t;
+        slots[k].tpush = bench::GetTime();
+        ps->Push(*data[k], k, devid, prio_[k]);
+        ps->PullReq(*data[k], k, devid, prio_[k], OnPullDone, &slots[k]);
+      }
+      // forward, wait for the weight right before it is used
+      for (int k = 0; k < nkey_; ++k) {
+        double t = bench::GetTime();
+        ps->PullWait(k, devid);
+        twait += bench::GetTime() - t;
+        t = bench::GetTime();
+        if (compute) this->Compute(k, 0.5);
+        tcompute += bench::GetTime() - t;
+        if (record) log->latency[k].push_back(slots[k].tdone - slots[k].tpush);
+      }
+      if (record) {
+        log->iter_time.push_back(bench::GetTime() - tstart);
+        log->compute_time += tcompute;
+        log->wait_time += twait;
+      }
+    }
+    for (int k = 0; k < nkey_; ++k) delete data[k];
+    ShutdownTensorEngine<cpu>();
+  }
+};
+
+int main(int argc, char *argv[]) {
+  bench::Config cfg(argc, argv);
+#if MSHADOW_RABIT_PS
+  rabit::Init(argc, argv);
+#endif
+  std::string out = cfg.GetStr("out", "");
+  FILE *fo = out.length() != 0 ? fopen(out.c_str(), "w") : stdout;
+  if (fo == NULL) {
+    fprintf(stderr, "cannot open %s\n", out.c_str()); return -1;
+  }
+  {
+    PSBench b(cfg);
+    b.Report(fo, cfg.GetStr("format", "json"));
+  }
+  if (fo != stdout) fclose(fo);
+#if MSHADOW_RABIT_PS
+  rabit::Finalize();
+#endif
+  return 0;
+}
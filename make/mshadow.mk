@@ -12,6 +12,9 @@ MSHADOW_CFLAGS = -msse3 -funroll-loops -Wno-unused-parameter -Wno-unknown-pragma
 MSHADOW_LDFLAGS = -lm
 MSHADOW_NVCCFLAGS =
 MKLROOT =
+ifeq ($(USE_FMA), 1)
+	MSHADOW_CFLAGS += -mfma -DMSHADOW_USE_FMA=1
+endif
 ifeq ($(USE_CUDA), 0)
 	MSHADOW_CFLAGS += -DMSHADOW_USE_CUDA=0
 else
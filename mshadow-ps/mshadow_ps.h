@@ -10,6 +10,7 @@
 #ifndef MSHADOW_PS_H_  // NOLINT(*)
 #define MSHADOW_PS_H_  // NOLINT(*)
 #include <vector>
+#include <string>
 // optionally support of lambda function in C++11, if available
 #if __cplusplus >= 201103L
 #include <functional>
@@ -41,7 +42,11 @@ class ISharedModel {
   /*!
    * \brief callback function that will be executed when pull request finishes
    *        before calling the callback, the thread context is already switched
-   *        to the device of pullrequest
+   *        to the device of pullrequest.
+   *        For data on cpu, the callback of an array of at least bigarray_bound
+   *        elements runs in one of the reduction threads of the server, so the
+   *        callbacks of different requests can run concurrently and share the
+   *        stream passed to them, the callback must be thread safe
    * \param stream the stream of callback thread, it is recommended to operate using this stream
    * \param arg the argument of callback function
    */
@@ -91,6 +96,15 @@ class ISharedModel {
    * \param devid the device id this tensor lies in
    */
   virtual void PullWait(int key, int devid) = 0;
+  /*!
+   * \brief export the runtime statistics of the parameter server,
+   *  such as latency histograms of each key and queue depth of each device
+   * \param format the output format, can be "json" or "prometheus"
+   * \return the statistics, empty string if not supported by the implementation
+   */
+  virtual std::string GetStats(const char *format) {
+    return std::string();
+  }
   /*!
    * \brief check if the weight was correct on the current device
    *
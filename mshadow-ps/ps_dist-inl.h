@@ -83,6 +83,8 @@ class DistModel : public LocalModel<xpu, DType> {
     Tensor<cpu, 2> sendrecv = data[0];
     CHECK_EQ(data[0].CheckContiguous(), true) << "data must be contiguous";
 
+    // keep the staging buffer until the pull from server finishes
+    this->RetainStaging(sendrecv.dptr_);
     int ts = shared_model_.Push(
         ::ps::Parameter::Request(key), sendrecv.dptr_, sendrecv.MSize(), false);
 
@@ -92,6 +94,7 @@ class DistModel : public LocalModel<xpu, DType> {
         [this, sendrecv, key]() {
           // call PullReady to notify LocalServer pulling is ready
           this->PullReady(sendrecv, key);
+          this->ReleaseStaging(sendrecv.dptr_);
         });
   }
 
@@ -7,21 +7,19 @@
  */
 #ifndef MSHADOW_PS_LOCAL_INL_H_  // NOLINT(*)
 #define MSHADOW_PS_LOCAL_INL_H_  // NOLINT(*)
+#include <algorithm>
+#include <cstring>
 #include <map>
+#include <sstream>
+#include <thread>
 #include <utility>
 #include <string>
 #include <vector>
-#if defined(_OPENMP)
-#include <omp.h>
-#ifdef _MSC_VER
-typedef int ms_omp_uint;
-#else
-typedef unsigned ms_omp_uint;
-#endif
-#endif
 
 #include "./thread.h"
 #include "./thread_util.h"
+#include "./staging_pool.h"
+#include "./telemetry.h"
 
 namespace mshadow {
 namespace ps {
@@ -40,6 +38,12 @@ class LocalModel : public ISharedModel<xpu, DType> {
     use_fifo_push_queue = 0;
     bigarray_bound = 1000 * 1000;
     nthread_reduction = 8;
+    use_autotune = -1;
+    tune_reduce_thread = 1;
+    tune_bigarray_bound = 1;
+    max_push_version = 3;
+    max_pull_batch = 16;
+    use_telemetry = 0;
     use_pin_memory = 1;
     test_on_server = 0;
     update_on_server = 0;
@@ -53,6 +57,7 @@ class LocalModel : public ISharedModel<xpu, DType> {
   inline void Destroy(void) {
     if (init_end != 0) {
       destroy_signal = true;
+      staging.Abort();
       for (size_t i = 0; i < push_queues.size(); ++i) {
         push_queues[i].Abort(1);
       }
@@ -65,6 +70,8 @@ class LocalModel : public ISharedModel<xpu, DType> {
       for (size_t i = 0; i < thread_pull_handler.size(); ++i) {
         thread_pull_handler[i].Join();
       }
+      // finish the copies still in flight before the maps go away
+      worker_pool.Destroy();
       for (size_t i = 0; i < push_queues.size(); ++i) {
         push_queues[i].Destroy();
       }
@@ -74,6 +81,7 @@ class LocalModel : public ISharedModel<xpu, DType> {
         pull_queues[i].Destroy();
       }
       pull_map.Destroy();
+      staging.Destroy();
       request_lock.Destroy();
       wait_lock.Destroy();
       wait_cond.Destroy();
@@ -100,12 +108,29 @@ class LocalModel : public ISharedModel<xpu, DType> {
     }
     if (!strcmp(name, "reduce_thread")) {
       nthread_reduction = atoi(val);
+      tune_reduce_thread = 0;
     }
     if (!strcmp(name, "use_pin_memory")) {
       use_pin_memory = atoi(val);
     }
     if (!strcmp(name, "bigarray_bound")) {
       bigarray_bound = static_cast<size_t>(atol(val));
+      tune_bigarray_bound = 0;
+    }
+    if (!strcmp(name, "autotune")) {
+      use_autotune = atoi(val);
+    }
+    if (!strcmp(name, "telemetry")) {
+      use_telemetry = atoi(val);
+    }
+    if (!strcmp(name, "pull_batch")) {
+      max_pull_batch = atoi(val);
+      CHECK_GE(max_pull_batch, 1) << "pull_batch must be positive";
+    }
+    if (!strcmp(name, "push_version")) {
+      max_push_version = atoi(val);
+      CHECK_GE(max_push_version, 2)
+          << "push_version must be at least 2, one being copied in, one being pulled";
     }
     if (!strcmp(name, "pull_thread")) {
       if (!strcmp(val, "ndev")) {
@@ -145,6 +170,8 @@ class LocalModel : public ISharedModel<xpu, DType> {
     CHECK_EQ(e.wait.size(), devices.size()) << "PullWait: must initialize the wait";
     PullWaitRecord &w = e.wait[wid];
     if (!w.finished) {
+      MSHADOW_TRACE_SCOPE("PullWait", "ps", Shape1(key), 0, 0);
+      const uint64_t tstart = this->Now();
       wait_lock.Lock();
       w.nwait += 1;
       while (!w.finished) {
@@ -153,8 +180,19 @@ class LocalModel : public ISharedModel<xpu, DType> {
       w.nwait -= 1;
       CHECK_GE(w.nwait, 0) << "boundary check";
       wait_lock.Unlock();
+      if (use_telemetry != 0) {
+        const uint64_t dt = this->Now() - tstart;
+        e.stats->pull_wait.Add(dt);
+        stats.Device(wid)->pull_wait.Add(dt);
+      }
     }
   }
+  virtual std::string GetStats(const char *format) {
+    if (!strcmp(format, "json")) return stats.ExportJSON();
+    if (!strcmp(format, "prometheus")) return stats.ExportPrometheus();
+    LOG(FATAL) << "unknown stats format " << format << ", can only be json or prometheus";
+    return std::string();
+  }
   virtual void Init(const std::vector<int> &devices) {
     CHECK_EQ(init_end, 0) << "LocalServer.Init can only call Init once";
     CHECK_NE(devices.size(), 0) << "LocalServer.Init: must at least contain 1 devices";
@@ -172,7 +210,20 @@ class LocalModel : public ISharedModel<xpu, DType> {
     }
     // allocate space
     pull_stream.resize(devices.size());
+    inflight.resize(devices.size());
     push_stream.resize(devices.size());
+    stats.Init(devices);
+    // the reduction and the copy-out of all the keys share one set of workers,
+    // the calling thread of a job is one of the nthread_reduction threads
+    // tuning is opt-in, autotune=1 enables it in the process
+    if (use_autotune > 0) autotune::SetEnabled(true);
+    const bool tune = use_autotune != 0 && autotune::Enabled();
+    int npool = nthread_reduction;
+    if (tune && tune_reduce_thread != 0) {
+      npool = std::max(npool, NumProc());
+    }
+    worker_pool.Init(npool - 1);
+    if (tune) this->TuneReduce();
     // initialize all the thread related things
     if (perdev_push_thread != 0) {
       push_queues.resize(devices.size());
@@ -184,6 +235,7 @@ class LocalModel : public ISharedModel<xpu, DType> {
     }
     push_map.Init();
     push_lock.Init();
+    staging.Init(use_pin_memory != 0);
     pull_map.Init();
     request_lock.Init();
     wait_lock.Init();
@@ -288,12 +340,17 @@ class LocalModel : public ISharedModel<xpu, DType> {
   virtual void Push_(Tensor<xpu, 2, DType> data,
                      int key, int devid, int priority) {
     PullEntry &e = pull_map.GetRef(key);
-    e.req[GetWorkIndex(devid)].ready = false;
+    const int wid = GetWorkIndex(devid);
+    e.req[wid].ready = false;
+    PullTask tsk(data, key, devid);
+    if (use_telemetry != 0) {
+      tsk.tenqueue = this->Now();
+      stats.Device(wid)->push_queue_depth.Add(1);
+    }
     if (perdev_push_thread != 0) {
-      int wid = GetWorkIndex(devid);
-      push_queues[wid].Push(PullTask(data, key, devid), priority);
+      push_queues[wid].Push(tsk, priority);
     } else {
-      push_queues[0].Push(PullTask(data, key, devid), priority);
+      push_queues[0].Push(tsk, priority);
     }
   }
   virtual void PullReq_(Tensor<xpu, 2, DType> data,
@@ -318,6 +375,7 @@ class LocalModel : public ISharedModel<xpu, DType> {
     CHECK_EQ(!r.pending, true) << "key = " << key
       << "cannot send duplicate pull request before it finishes";
     if (e.req[wid].ready) {
+      this->MarkPullEnqueue(&r, wid);
       if (perdev_pull_thread != 0) {
         pull_queues[wid].Push(std::make_pair(key, devid));
       } else {
@@ -337,10 +395,15 @@ class LocalModel : public ISharedModel<xpu, DType> {
     PullEntry &e = pull_map.GetRef(key);
     CHECK_EQ(e.req.size(), devices.size()) << "PullReady: must initialize the key, req";
     request_lock.Lock();
+    // the pull source keeps a reference to the staging buffer,
+    // the buffer of the previous version goes back to the pool
+    staging.Retain(data.dptr_);
+    if (e.src.dptr_ != NULL) staging.Release(e.src.dptr_);
     e.src = data;
     for (index_t i = 0; i < e.req.size(); ++i) {
       e.req[i].ready = true;
       if (e.req[i].pending) {
+        this->MarkPullEnqueue(&e.req[i], static_cast<int>(i));
         if (perdev_pull_thread != 0) {
           pull_queues[i].Push(std::make_pair(key, devices[i]));
         } else {
@@ -363,6 +426,9 @@ class LocalModel : public ISharedModel<xpu, DType> {
   /*!
    * \brief event handler for push finish
    *  called when all the data with same key comes int
+   *  data is leased from the staging pool, and only lives until the
+   *  handler returns, unless a reference is kept by RetainStaging,
+   *  or the data is passed to PullReady
    * \param data the buffer holds the data in all devices
    * \param key the key of the data
    */
@@ -438,22 +504,30 @@ class LocalModel : public ISharedModel<xpu, DType> {
   IModelUpdater<DType> *custom_server;
   // whether use fifo push queue
   int use_fifo_push_queue;
+  /*!
+   * \brief keep a reference to the staging buffer that contains dptr,
+   *  used by the handlers that keep the pushed data after HandlePushFinish returns
+   */
+  inline void RetainStaging(const DType *dptr) {
+    staging.Retain(dptr);
+  }
+  /*! \brief release the reference obtained by RetainStaging */
+  inline void ReleaseStaging(const DType *dptr) {
+    staging.Release(dptr);
+  }
 
-  // perform sum reduction
+  // perform sum reduction, big arrays are split over the shared worker pool
   inline void ReduceSum(Tensor<cpu, 3, DType> data) {
-    #if defined(_OPENMP)
-    if (data[0].MSize() >= bigarray_bound &&
-        nthread_reduction != 0) {
-      ms_omp_uint ntask = static_cast<ms_omp_uint>(data.size(1));
-      #pragma omp parallel for schedule(static) num_threads(nthread_reduction)
-      for (ms_omp_uint j = 0; j < ntask; ++j) {
-        for (index_t i = 1; i < data.size(0); ++i) {
-          data[0][j] += data[i][j];
-        }
-      }
-    } else  //NOLINT(*)
-      #endif
-    {
+    if (data[0].MSize() >= bigarray_bound && nthread_reduction > 1) {
+      ReduceJob job;
+      job.data = data;
+      // split the flat array, so that arrays with few rows are also parallel
+      job.flat = data.CheckContiguous();
+      const size_t size = job.flat ? data[0].MSize() : data.size(1);
+      job.step = (size + nthread_reduction - 1) / nthread_reduction;
+      job.size = size;
+      worker_pool.Run(&job, nthread_reduction);
+    } else {
       for (index_t i = 1; i < data.size(0); ++i) {
         data[0] += data[i];
       }
@@ -472,41 +546,44 @@ class LocalModel : public ISharedModel<xpu, DType> {
      * uniquely identifies a mem location
      */
     int devid;
+    /*! \brief time when the task is put into queue */
+    uint64_t tenqueue;
     PullTask(void) {}
     PullTask(Tensor<xpu, 2, DType> data, int key, int devid)
-        : data(data), key(key), devid(devid) {}
+        : data(data), key(key), devid(devid), tenqueue(0) {}
   };
   /*! \brief data structure to hold temporal push result */
   struct PushEntry {
-    // temporal space to hold input data
-    Tensor<cpu, 4, DType> data;
+    // staging space of the version being copied in, leased from staging pool
+    // dptr_ is NULL when no version is in progress
+    Tensor<cpu, 3, DType> data;
     // temporal space to hold weight, if needed
     Tensor<cpu, 2, DType> weight;
+    // shape of the tensor pushed by each device
+    Shape<2> shape;
     // indicator whether the certain devices is already copied in
     std::vector<bool> copied;
     // number of data copied in
     int num_copied;
-    // version number of data used to hold incomming data in push
-    int copyin_version;
     // use pinned memory
     bool pin_memory;
+    // statistics of the key
+    telemetry::KeyStats *stats;
+    // serializes leasing of the staging buffer of this key,
+    // so that a key waiting in StagingPool::Alloc does not block other keys
+    utils::Mutex lease_lock;
     // constructor
-    PushEntry(void)
-        : copyin_version(0) {
+    PushEntry(void) {
+      data.dptr_ = NULL;
       weight.dptr_ = NULL;
     }
     ~PushEntry(void) {
-      if (data.dptr_ != NULL) {
+      if (copied.size() != 0) lease_lock.Destroy();
+      if (weight.dptr_ != NULL) {
         if (pin_memory) {
-          mshadow::FreeHost<xpu>(&data);
-          if (weight.dptr_ != NULL) {
-            mshadow::FreeHost<xpu>(&weight);
-          }
+          mshadow::FreeHost<xpu>(&weight);
         } else {
-          mshadow::FreeSpace(&data);
-          if (weight.dptr_ != NULL) {
-            mshadow::FreeSpace(&weight);
-          }
+          mshadow::FreeSpace(&weight);
         }
       }
     }
@@ -514,19 +591,19 @@ class LocalModel : public ISharedModel<xpu, DType> {
     inline void Init(int ndevice, Shape<2> shape,
                      bool pin_memory, bool need_weight) {
       this->pin_memory = pin_memory;
-      data.shape_ = Shape4(2, ndevice, shape[0], shape[1]);
+      this->shape = shape;
+      data.shape_ = Shape3(ndevice, shape[0], shape[1]);
+      data.stride_ = shape[1];
       weight.shape_ = shape;
       if (pin_memory) {
-        mshadow::AllocHost<xpu>(&data);
         if (need_weight) mshadow::AllocHost<xpu>(&weight);
       } else {
-        mshadow::AllocSpace(&data, false);
         if (need_weight) mshadow::AllocSpace(&weight);
       }
-      CHECK_EQ(data.CheckContiguous(), true) << "Data must be contiguous";
       CHECK(!need_weight || weight.CheckContiguous()) << "Weight must be contiguous";
       num_copied = 0;
       copied.resize(ndevice, false);
+      lease_lock.Init();
     }
   };
   // a record to remember things related to pull request
@@ -544,7 +621,9 @@ class LocalModel : public ISharedModel<xpu, DType> {
     CallbackFunction *callback;
     // argument for callback
     void *callback_arg;
-    PullReqRecord(void) : ready(false), pending(false) {
+    // time when the request is put into pull queue
+    uint64_t tenqueue;
+    PullReqRecord(void) : ready(false), pending(false), tenqueue(0) {
     }
   };
   // a record to help handle pullwait
@@ -566,7 +645,55 @@ class LocalModel : public ISharedModel<xpu, DType> {
     std::vector<PullReqRecord> req;
     // whether there is thread waiting on this event
     std::vector<PullWaitRecord> wait;
+    // statistics of the key
+    telemetry::KeyStats *stats;
     PullEntry(void) {
+      src.dptr_ = NULL;
+    }
+  };
+  // sum of a range of the flat array, or of a range of rows if not contiguous
+  struct ReduceJob : public utils::ThreadPool::Job {
+    Tensor<cpu, 3, DType> data;
+    bool flat;
+    size_t size, step;
+    virtual void Run(int part) {
+      const size_t begin = std::min(size, static_cast<size_t>(part) * step);
+      const size_t end = std::min(size, begin + step);
+      if (flat) {
+        DType *dst = data.dptr_;
+        for (index_t i = 1; i < data.size(0); ++i) {
+          const DType *src = data.dptr_ + i * size;
+          for (size_t k = begin; k < end; ++k) {
+            dst[k] += src[k];
+          }
+        }
+      } else {
+        for (size_t j = begin; j < end; ++j) {
+          for (index_t i = 1; i < data.size(0); ++i) {
+            data[0][j] += data[i][j];
+          }
+        }
+      }
+    }
+  };
+  // copy of one pull request, Done is the completion of the copy
+  struct CopyOutJob : public utils::ThreadPool::Job {
+    LocalModel *self;
+    Tensor<xpu, 2, DType> dst;
+    Tensor<cpu, 2, DType> src;
+    int key, devid;
+    CallbackFunction *callback;
+    void *callback_arg;
+    // time when the copy is issued
+    uint64_t tissue;
+    // split of the copy over the worker pool
+    size_t step;
+    virtual void Run(int part) {
+      self->CopyOutPart(this, part);
+    }
+    virtual void Done(void) {
+      self->PullDone(this);
+      delete this;
     }
   };
   // signal to notify all the thread about class destruction
@@ -593,6 +720,8 @@ class LocalModel : public ISharedModel<xpu, DType> {
   std::vector<utils::ThreadPQueue<std::pair<int, int> > > pull_queues;
   // stream used by pull thread each device for memcpy
   std::vector<Stream<xpu>*> pull_stream;
+  // copies issued to the stream of each device, completed after the stream syncs
+  std::vector<std::vector<CopyOutJob*> > inflight;
   // the map to store pull status
   utils::ThreadSafeMap<PullEntry> pull_map;
   // thread to handle pull task
@@ -613,8 +742,25 @@ class LocalModel : public ISharedModel<xpu, DType> {
   int use_pin_memory;
   // number of reduction thread
   int nthread_reduction;
+  // maximum number of staging buffers a key can hold at the same time
+  int max_push_version;
+  // maximum number of pull requests handled per wakeup of pull thread
+  int max_pull_batch;
+  // workers shared by the reduction and the copy-out of all keys
+  utils::ThreadPool worker_pool;
+  // pool of staging buffers shared by all keys
+  StagingPool<xpu, DType> staging;
+  // whether to collect runtime statistics
+  int use_telemetry;
+  // runtime statistics
+  telemetry::Registry stats;
   // the threshold for big array
   size_t bigarray_bound;
+  // whether tune the parameters of reduction that are not set by user,
+  // -1 follows autotune::Enabled, 1 enables tuning, 0 disables it
+  int use_autotune;
+  int tune_reduce_thread;
+  int tune_bigarray_bound;
   // whether use pull thread per device
   int perdev_pull_thread;
   // whether use push thread per device
@@ -627,33 +773,76 @@ class LocalModel : public ISharedModel<xpu, DType> {
       PullTask tsk;
       if (queue->Pop(&tsk)) {
         const int wid = GetWorkIndex(tsk.devid);
+        const uint64_t tstart = this->Now();
         PushEntry &e = push_map.GetRef(tsk.key);
-        CHECK_EQ(e.data[0][0].shape_, tsk.data.shape_)
+        if (use_telemetry != 0) {
+          stats.Device(wid)->push_queue_depth.Add(-1);
+          e.stats->push_queue.Add(tstart - tsk.tenqueue);
+        }
+        CHECK_EQ(e.shape, tsk.data.shape_)
           << "Tensor with same key must share same shape "
-          << e.data[0][0].shape_
+          << e.shape
           << " vs "
           << tsk.data.shape_;
         CHECK_EQ(!e.copied[wid], true) << "data inconsistency";
-        // start copy
-        SetDevice<xpu>(tsk.devid);
-        Copy(e.data[e.copyin_version][wid], tsk.data, push_stream[wid]);
-        // wait till the copy finishes
-        push_stream[wid]->Wait();
+        // lease the staging buffer when the first device of a version comes in,
+        // Alloc can block until the key returns a lease, so it must not
+        // hold push_lock, which is shared by all keys
+        e.lease_lock.Lock();
+        push_lock.Lock();
+        const bool need_lease = e.data.dptr_ == NULL;
+        push_lock.Unlock();
+        DType *dptr = need_lease ?
+            staging.Alloc(e.data.MSize(), tsk.key, max_push_version) : NULL;
+        push_lock.Lock();
+        if (need_lease) e.data.dptr_ = dptr;
+        Tensor<cpu, 3, DType> buf = e.data;
+        push_lock.Unlock();
+        e.lease_lock.Unlock();
+        if (buf.dptr_ == NULL) {
+          CHECK_EQ(destroy_signal, true) << "abort but not destroy";
+          continue;
+        }
+        {
+          MSHADOW_TRACE_SCOPE("PushCopyIn", "ps", tsk.data.shape_, 0,
+                              sizeof(DType) * tsk.data.shape_.Size());
+          // start copy
+          SetDevice<xpu>(tsk.devid);
+          Copy(buf[wid], tsk.data, push_stream[wid]);
+          // wait till the copy finishes
+          push_stream[wid]->Wait();
+        }
+        if (use_telemetry != 0) {
+          const uint64_t dt = this->Now() - tstart;
+          const int64_t nbyte = tsk.data.shape_.Size() * sizeof(DType);
+          e.stats->copy_in.Add(dt);
+          e.stats->bytes_push.Add(nbyte);
+          stats.Device(wid)->copy_in.Add(dt);
+          stats.Device(wid)->bytes_push.Add(nbyte);
+        }
         // mark copied
         e.copied[wid] = true;
         push_lock.Lock();
         e.num_copied += 1;
-        int cp_version = e.copyin_version;
         bool push_finish = e.num_copied >= static_cast<int>(devices.size());
         if (push_finish) {
-          // switch version
-          e.copyin_version = (e.copyin_version + 1) % e.data.size(0);
+          // switch version, next push leases a new buffer
+          e.data.dptr_ = NULL;
           std::fill(e.copied.begin(), e.copied.end(), false);
           e.num_copied = 0;
         }
         push_lock.Unlock();
         if (push_finish) {
-          this->HandlePushFinish(e.data[cp_version], tsk.key);
+          const uint64_t treduce = this->Now();
+          MSHADOW_TRACE_SCOPE("PushFinish", "ps", buf.shape_,
+                              buf.shape_.Size(), sizeof(DType) * buf.shape_.Size());
+          this->HandlePushFinish(buf, tsk.key);
+          if (use_telemetry != 0) {
+            e.stats->reduce.Add(this->Now() - treduce);
+          }
+          // drop the reference hold by the push,
+          // the buffer stays alive if it is referenced by the pull source
+          staging.Release(buf.dptr_);
         }
       } else {
         CHECK_EQ(destroy_signal, true) << "abort but not destroy";
@@ -696,38 +885,177 @@ class LocalModel : public ISharedModel<xpu, DType> {
     delete p;
     return NULL;
   }
-  // push handler procedure
+  // runs the reduction of synthetic data with a candidate parameter
+  struct ReduceBench {
+    LocalModel *self;
+    Tensor<cpu, 3, DType> data;
+    // whether the candidate is bigarray_bound, otherwise nthread_reduction
+    bool bound;
+    inline void operator()(int value) {
+      if (!bound) {
+        self->nthread_reduction = value;
+        self->ReduceSum(data);
+        return;
+      }
+      self->bigarray_bound = static_cast<size_t>(value);
+      // same amount of work for each size, so that all of them matter
+      const index_t total = data.size(2);
+      for (index_t size = 1 << 12; size <= total; size <<= 2) {
+        Tensor<cpu, 3, DType> part(data.dptr_, Shape3(data.size(0), 1, size));
+        for (index_t i = 0; i < total / size; ++i) {
+          self->ReduceSum(part);
+        }
+      }
+    }
+  };
+  // number of hardware threads, the largest candidate of nthread_reduction
+  inline static int NumProc(void) {
+    return std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  }
+  // tune the number of reduction threads and the threshold of big array,
+  // the tuned values are cached by autotune for this kind of machine
+  inline void TuneReduce(void) {
+    if (tune_reduce_thread == 0 && tune_bigarray_bound == 0) return;
+    const index_t ndev = static_cast<index_t>(devices.size());
+    if (ndev < 2) return;
+    Tensor<cpu, 3, DType> data(Shape3(ndev, 1, 1 << 19));
+    AllocSpace(&data, false);
+    data = static_cast<DType>(1);
+    ReduceBench bench;
+    bench.self = this; bench.data = data;
+    std::ostringstream cls;
+    cls << "ndev=" << ndev;
+    const int nthread_default = nthread_reduction;
+    const size_t bound_default = bigarray_bound;
+    if (tune_reduce_thread != 0) {
+      std::vector<int> cand;
+      const int nproc = NumProc();
+      for (int n = 1; n < nproc; n *= 2) cand.push_back(n);
+      cand.push_back(nproc);
+      bigarray_bound = 0;
+      bench.bound = false;
+      nthread_reduction = autotune::Tune("ps_reduce_thread", cls.str(), cand,
+                                         nthread_default, bench);
+    } else {
+      nthread_reduction = nthread_default;
+    }
+    if (tune_bigarray_bound != 0) {
+      std::vector<int> cand;
+      for (int b = 1 << 12; b <= (1 << 20); b <<= 2) cand.push_back(b);
+      cls << ",nthread=" << nthread_reduction;
+      bench.bound = true;
+      bigarray_bound = static_cast<size_t>(
+          autotune::Tune("ps_bigarray_bound", cls.str(), cand,
+                         static_cast<int>(bound_default), bench));
+    } else {
+      bigarray_bound = bound_default;
+    }
+    FreeSpace(&data);
+  }
+  // copy part of a pulled host array, big arrays are split over the worker pool
+  inline void CopyOutPart(CopyOutJob *job, int part) {
+    const size_t size = job->src.MSize();
+    const size_t begin = std::min(size, static_cast<size_t>(part) * job->step);
+    const size_t end = std::min(size, begin + job->step);
+    if (begin != end) {
+      memcpy(job->dst.dptr_ + begin, job->src.dptr_ + begin,
+             sizeof(DType) * (end - begin));
+    }
+  }
+  // copy pulled data back to host memory, the job completes in the worker pool
+  inline void CopyOut(Tensor<cpu, 2, DType> dst, CopyOutJob *job, int wid) {
+    if (job->src.MSize() >= bigarray_bound && nthread_reduction > 1 &&
+        dst.CheckContiguous() && job->src.CheckContiguous()) {
+      CHECK_EQ(dst.shape_, job->src.shape_) << "CopyOut: shape mismatch";
+      job->step = (job->src.MSize() + nthread_reduction - 1) / nthread_reduction;
+      worker_pool.Submit(job, nthread_reduction);
+    } else {
+      Copy(dst, job->src, pull_stream[wid]);
+      job->Done();
+    }
+  }
+  // copy pulled data back to device, asynchronize in the stream,
+  // the job completes after the stream is synchronized
+  inline void CopyOut(Tensor<gpu, 2, DType> dst, CopyOutJob *job, int wid) {
+    Copy(dst, job->src, pull_stream[wid]);
+    if (job->callback != NULL) {
+      (*job->callback)(pull_stream[wid], job->callback_arg);
+      job->callback = NULL;
+    }
+    inflight[wid].push_back(job);
+  }
+  // completion of one pull copy: run the callback, drop the reference to
+  // the source, and wake up the waiters of the request, called by the worker
+  // pool for big arrays on cpu, so it can run concurrently for several requests
+  inline void PullDone(CopyOutJob *job) {
+    const int wid = GetWorkIndex(job->devid);
+    if (job->callback != NULL) {
+      SetDevice<xpu>(job->devid);
+      (*job->callback)(pull_stream[wid], job->callback_arg);
+    }
+    staging.Release(job->src.dptr_);
+    PullEntry &e = pull_map.GetRef(job->key);
+    if (use_telemetry != 0) {
+      const uint64_t dt = this->Now() - job->tissue;
+      const int64_t nbyte = job->src.shape_.Size() * sizeof(DType);
+      e.stats->copy_out.Add(dt);
+      e.stats->bytes_pull.Add(nbyte);
+      stats.Device(wid)->copy_out.Add(dt);
+      stats.Device(wid)->bytes_pull.Add(nbyte);
+    }
+    wait_lock.Lock();
+    CHECK_EQ(e.wait.size(), devices.size()) << "PullHandler, must initialize the key, req";
+    PullWaitRecord &w = e.wait[wid];
+    w.finished = true;
+    if (w.nwait != 0) wait_cond.Broadcast();
+    wait_lock.Unlock();
+  }
+  // pull handler procedure
   inline void PullProc(utils::ThreadPQueue<std::pair<int, int> > *queue) {
+    // the batch of requests being handled
+    std::vector<std::pair<int, int> > tasks;
     while (!destroy_signal) {
-      std::pair<int, int> tsk;
-      if (queue->Pop(&tsk)) {
-        const int key = tsk.first;
-        const int devid = tsk.second;
-        const int wid = GetWorkIndex(devid);
-        PullEntry &e = pull_map.GetRef(key);
-        {
-          // handle request
+      if (queue->PopBatch(&tasks, static_cast<size_t>(max_pull_batch))) {
+        MSHADOW_TRACE_SCOPE("PullBatch", "ps", Shape1(tasks.size()), 0, 0);
+        // issue all the copies, each one completes on its own
+        for (size_t i = 0; i < tasks.size(); ++i) {
+          const int key = tasks[i].first;
+          const int devid = tasks[i].second;
+          const int wid = GetWorkIndex(devid);
+          PullEntry &e = pull_map.GetRef(key);
           CHECK_EQ(e.req.size(), devices.size()) << "PullHandler: must initialize the key, req";
           PullReqRecord &r = e.req[wid];
-          SetDevice<xpu>(devid);
-          Copy(r.dest, e.src, pull_stream[wid]);
-          // callback, if any
-          if (r.callback != NULL) {
-            (*r.callback)(pull_stream[wid], r.callback_arg);
+          CopyOutJob *job = new CopyOutJob();
+          job->self = this;
+          job->key = key;
+          job->devid = devid;
+          // hold the source, in case a new version is ready during copy
+          request_lock.Lock();
+          job->dst = r.dest;
+          job->src = e.src;
+          job->callback = r.callback;
+          job->callback_arg = r.callback_arg;
+          staging.Retain(job->src.dptr_);
+          const uint64_t tenqueue = r.tenqueue;
+          request_lock.Unlock();
+          job->tissue = this->Now();
+          if (use_telemetry != 0) {
+            stats.Device(wid)->pull_queue_depth.Add(-1);
+            e.stats->pull_queue.Add(job->tissue - tenqueue);
           }
-          // wait till the operation finishes
-          pull_stream[wid]->Wait();
+          SetDevice<xpu>(devid);
+          this->CopyOut(job->dst, job, wid);
         }
-        {
-          // wake up waiters if any
-          CHECK_EQ(e.wait.size(), devices.size()) << "PullHandler, must initialize the key, req";
-          PullWaitRecord &w = e.wait[wid];
-          wait_lock.Lock();
-          w.finished = true;
-          if (w.nwait != 0) {
-            wait_cond.Broadcast();
+        // copies to device complete when their stream is synchronized
+        for (size_t wid = 0; wid < inflight.size(); ++wid) {
+          if (inflight[wid].size() != 0) {
+            SetDevice<xpu>(devices[wid]);
+            pull_stream[wid]->Wait();
+            for (size_t i = 0; i < inflight[wid].size(); ++i) {
+              inflight[wid][i]->Done();
+            }
+            inflight[wid].clear();
           }
-          wait_lock.Unlock();
         }
       } else {
         CHECK_EQ(destroy_signal, true) << "abort but not destroy";
@@ -770,6 +1098,18 @@ class LocalModel : public ISharedModel<xpu, DType> {
     delete p;
     return NULL;
   }
+  // current time for telemetry, 0 if telemetry is disabled
+  inline uint64_t Now(void) const {
+    return use_telemetry != 0 ? telemetry::NowNanoSec() : 0;
+  }
+  // record the time and queue depth when a pull request is put into queue
+  // must be called with request_lock held
+  inline void MarkPullEnqueue(PullReqRecord *r, int wid) {
+    if (use_telemetry != 0) {
+      r->tenqueue = this->Now();
+      stats.Device(wid)->pull_queue_depth.Add(1);
+    }
+  }
   // get internal index of device
   inline int GetWorkIndex(int devid) const {
     CHECK(devid >= 0 &&
@@ -785,6 +1125,7 @@ class LocalModel : public ISharedModel<xpu, DType> {
     // must recheck after lock
     if (e.req.size() == 0) {
       e.req.resize(devices.size(), PullReqRecord());
+      e.stats = stats.Key(key);
     }
     request_lock.Unlock();
     // check wait map
@@ -804,6 +1145,7 @@ class LocalModel : public ISharedModel<xpu, DType> {
       e.Init(devices.size(), shape,
              use_pin_memory != 0,
              update_on_server != 0 || test_on_server != 0);
+      e.stats = stats.Key(key);
     }
     this->ServerInitKey(e.weight, key);
     push_lock.Unlock();
@@ -63,6 +63,8 @@ class RabitModel : public LocalModel<xpu, DType> {
     CHECK_EQ(data[0].CheckContiguous(), true) << "data must be contiguous";
     ReduceTask tsk;
     tsk.data = data[0]; tsk.key = key;
+    // keep the staging buffer until the reduction finishes
+    this->RetainStaging(tsk.data.dptr_);
     reduce_queue_.Push(tsk, 0);
   }
 
@@ -96,6 +98,7 @@ class RabitModel : public LocalModel<xpu, DType> {
         tsk.data *= 1.0f / rabit::GetWorldSize();
         CHECK_EQ(disable_allreduce_, 0) << "Allreduce disabled error";
         this->HandleReduceFinish(tsk.data, tsk.key);
+        this->ReleaseStaging(tsk.data.dptr_);
       } else {
         CHECK_EQ(destroy_reduce_thread_, true) << "abort but not destroy";
       }
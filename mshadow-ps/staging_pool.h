@@ -0,0 +1,216 @@
+/*!
+ * Copyright by Contributors
+ * \file staging_pool.h
+ * \brief size-classed pool of host staging buffers shared by all keys
+ *   of the parameter server, buffers are leased per in-flight version
+ *   and returned to the pool once nobody references them
+ * \author Tianqi Chen
+ */
+#ifndef MSHADOW_PS_STAGING_POOL_H_  // NOLINT(*)
+#define MSHADOW_PS_STAGING_POOL_H_  // NOLINT(*)
+#include <map>
+#include <vector>
+#include "../mshadow/tensor.h"
+#include "./thread.h"
+
+namespace mshadow {
+namespace ps {
+/*!
+ * \brief pool of (optionally pinned) host memory used to stage pushed data
+ *
+ *  Each lease is reference counted, the holder of a lease calls Retain
+ *  when it keeps the buffer beyond the current call and Release when done.
+ *  Released buffers go back to a free list of their size class, so that
+ *  the host memory held is bounded by the number of versions actually in
+ *  flight instead of the number of keys times the ring length.
+ *
+ * \tparam xpu the device that pushes data, decides how pinned memory is allocated
+ * \tparam DType the data type of the buffer
+ */
+template<typename xpu, typename DType>
+class StagingPool {
+ public:
+  StagingPool(void) : pin_memory_(false), abort_(false), nbyte_alloc_(0) {}
+  /*!
+   * \brief initialize the pool, must call this before use
+   * \param pin_memory whether allocate pinned memory
+   */
+  inline void Init(bool pin_memory) {
+    pin_memory_ = pin_memory;
+    abort_ = false;
+    lock_.Init();
+    cond_.Init();
+  }
+  /*! \brief free all the memory held by the pool */
+  inline void Destroy(void) {
+    for (typename std::map<DType*, Block>::iterator
+             it = blocks_.begin(); it != blocks_.end(); ++it) {
+      this->FreeBlock(it->first, it->second.size);
+    }
+    blocks_.clear();
+    free_.clear();
+    live_.clear();
+    nbyte_alloc_ = 0;
+    cond_.Destroy();
+    lock_.Destroy();
+  }
+  /*!
+   * \brief wake up all the threads waiting in Alloc,
+   *   the pending Alloc calls return NULL, used in destructor
+   */
+  inline void Abort(void) {
+    lock_.Lock();
+    abort_ = true;
+    cond_.Broadcast();
+    lock_.Unlock();
+  }
+  /*!
+   * \brief lease a buffer of at least size elements, the returned lease
+   *   holds one reference. The call blocks while owner already holds
+   *   max_lease live buffers
+   * \param size number of elements needed
+   * \param owner the owner of the lease, usually the key
+   * \param max_lease maximum number of live buffers the owner can hold
+   * \return the leased buffer, NULL if the pool is aborted
+   */
+  inline DType *Alloc(size_t size, int owner, int max_lease) {
+    const size_t csize = SizeClass(size);
+    lock_.Lock();
+    while (!abort_ && live_[owner] >= max_lease) {
+      cond_.Wait(&lock_);
+    }
+    if (abort_) {
+      lock_.Unlock(); return NULL;
+    }
+    live_[owner] += 1;
+    DType *dptr;
+    typename std::map<size_t, std::vector<DType*> >::iterator
+        it = free_.find(csize);
+    if (it != free_.end() && it->second.size() != 0) {
+      dptr = it->second.back();
+      it->second.pop_back();
+    } else {
+      // allocation can be slow, do not hold the lock
+      lock_.Unlock();
+      dptr = this->AllocBlock(csize);
+      lock_.Lock();
+      nbyte_alloc_ += csize * sizeof(DType);
+    }
+    Block &b = blocks_[dptr];
+    b.size = csize;
+    b.owner = owner;
+    b.ref = 1;
+    lock_.Unlock();
+    return dptr;
+  }
+  /*!
+   * \brief add a reference to the lease that contains dptr,
+   *   do nothing if dptr is not allocated by the pool
+   * \param dptr pointer into a leased buffer
+   */
+  inline void Retain(const DType *dptr) {
+    lock_.Lock();
+    typename std::map<DType*, Block>::iterator it = this->Find(dptr);
+    if (it != blocks_.end()) {
+      it->second.ref += 1;
+    }
+    lock_.Unlock();
+  }
+  /*!
+   * \brief remove a reference to the lease that contains dptr,
+   *   the buffer goes back to the pool when no reference is left,
+   *   do nothing if dptr is not allocated by the pool
+   * \param dptr pointer into a leased buffer
+   */
+  inline void Release(const DType *dptr) {
+    lock_.Lock();
+    typename std::map<DType*, Block>::iterator it = this->Find(dptr);
+    if (it != blocks_.end()) {
+      Block &b = it->second;
+      if (--b.ref == 0) {
+        free_[b.size].push_back(it->first);
+        live_[b.owner] -= 1;
+        cond_.Broadcast();
+      }
+    }
+    lock_.Unlock();
+  }
+  /*! \return total number of bytes allocated from the system */
+  inline size_t BytesAllocated(void) {
+    lock_.Lock();
+    size_t ret = nbyte_alloc_;
+    lock_.Unlock();
+    return ret;
+  }
+  /*!
+   * \brief round the size up to a size class, each power of two is split
+   *   into four classes, so that at most 25 percent of space is wasted
+   * \param size the requested number of elements
+   */
+  inline static size_t SizeClass(size_t size) {
+    if (size <= 64) return 64;
+    size_t base = 64;
+    while ((base << 1) < size) base <<= 1;
+    const size_t step = base / 4;
+    return (size + step - 1) / step * step;
+  }
+
+ private:
+  /*! \brief a buffer allocated by the pool */
+  struct Block {
+    // number of elements in the block
+    size_t size;
+    // owner that holds the lease
+    int owner;
+    // number of references, zero means the block is in free list
+    int ref;
+  };
+  // whether use pinned memory
+  bool pin_memory_;
+  // whether the pool is aborted
+  bool abort_;
+  // number of bytes allocated
+  size_t nbyte_alloc_;
+  // all the blocks, indexed by start address
+  std::map<DType*, Block> blocks_;
+  // free list of each size class
+  std::map<size_t, std::vector<DType*> > free_;
+  // number of live leases of each owner
+  std::map<int, int> live_;
+  // lock to protect the pool
+  utils::Mutex lock_;
+  // signals that some lease was released
+  utils::ConditionVariable cond_;
+  // find the live block that contains dptr, caller must hold the lock
+  inline typename std::map<DType*, Block>::iterator Find(const DType *dptr) {
+    typename std::map<DType*, Block>::iterator
+        it = blocks_.upper_bound(const_cast<DType*>(dptr));
+    if (it == blocks_.begin()) return blocks_.end();
+    --it;
+    if (dptr >= it->first + it->second.size || it->second.ref == 0) {
+      return blocks_.end();
+    }
+    return it;
+  }
+  inline DType *AllocBlock(size_t size) {
+    Tensor<cpu, 1, DType> t(Shape1(static_cast<index_t>(size)));
+    if (pin_memory_) {
+      mshadow::AllocHost<xpu>(&t);
+    } else {
+      mshadow::AllocSpace(&t, false);
+    }
+    CHECK_NE(t.dptr_, NULL) << "StagingPool: out of memory";
+    return t.dptr_;
+  }
+  inline void FreeBlock(DType *dptr, size_t size) {
+    Tensor<cpu, 1, DType> t(dptr, Shape1(static_cast<index_t>(size)));
+    if (pin_memory_) {
+      mshadow::FreeHost<xpu>(&t);
+    } else {
+      mshadow::FreeSpace(&t);
+    }
+  }
+};
+}  // namespace ps
+}  // namespace mshadow
+#endif  // MSHADOW_PS_STAGING_POOL_H_  NOLINT(*)
@@ -0,0 +1,403 @@
+/*!
+ * Copyright by Contributors
+ * \file telemetry.h
+ * \brief low overhead counters and latency histograms used to
+ *   instrument the parameter server, all updates are lock free
+ * \author Tianqi Chen
+ */
+#ifndef MSHADOW_PS_TELEMETRY_H_  // NOLINT(*)
+#define MSHADOW_PS_TELEMETRY_H_  // NOLINT(*)
+#include <stdint.h>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+#ifdef _MSC_VER
+#include <windows.h>
+#else
+#include <time.h>
+#include <sys/time.h>
+#endif
+#include "./thread.h"
+
+namespace mshadow {
+namespace ps {
+/*! \brief namespace of the telemetry utilities */
+namespace telemetry {
+/*! \return current time in nanoseconds, from a monotonic clock */
+inline uint64_t NowNanoSec(void) {
+#ifdef _MSC_VER
+  LARGE_INTEGER freq, cnt;
+  QueryPerformanceFrequency(&freq);
+  QueryPerformanceCounter(&cnt);
+  return static_cast<uint64_t>(cnt.QuadPart * (1e9 / freq.QuadPart));
+#elif defined(CLOCK_MONOTONIC)
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+#else
+  timeval tv;
+  gettimeofday(&tv, NULL);
+  return static_cast<uint64_t>(tv.tv_sec) * 1000000000ULL + tv.tv_usec * 1000ULL;
+#endif
+}
+/*! \brief atomically add val to *ptr, return the new value */
+inline int64_t AtomicAdd(volatile int64_t *ptr, int64_t val) {
+#ifdef _MSC_VER
+  return InterlockedExchangeAdd64(ptr, val) + val;
+#else
+  return __sync_add_and_fetch(ptr, val);
+#endif
+}
+/*! \brief atomically read *ptr, without ordering other memory accesses */
+inline int64_t AtomicLoad(volatile int64_t *ptr) {
+#ifdef _MSC_VER
+  return InterlockedOr64(ptr, 0);
+#else
+  return __atomic_load_n(ptr, __ATOMIC_RELAXED);
+#endif
+}
+/*! \brief atomically set *ptr to max(*ptr, val) */
+inline void AtomicMax(volatile int64_t *ptr, int64_t val) {
+  int64_t old = AtomicLoad(ptr);
+  while (old < val) {
+#ifdef _MSC_VER
+    int64_t prev = InterlockedCompareExchange64(ptr, val, old);
+#else
+    int64_t prev = __sync_val_compare_and_swap(ptr, old, val);
+#endif
+    if (prev == old) return;
+    old = prev;
+  }
+}
+/*! \brief a counter that can be updated from any thread */
+struct Counter {
+  /*! \brief current value */
+  volatile int64_t value;
+  /*! \brief maximum value ever reached, used by gauges */
+  volatile int64_t max_value;
+  Counter(void) : value(0), max_value(0) {}
+  /*! \brief add val to the counter */
+  inline void Add(int64_t val) {
+    int64_t v = AtomicAdd(&value, val);
+    if (val > 0) AtomicMax(&max_value, v);
+  }
+};
+/*!
+ * \brief log-linear histogram in the style of HDR histogram,
+ *  each power of two is split into kSub buckets, so that the
+ *  relative error of a recorded value is bounded by 1 / kSub
+ */
+class Histogram {
+ public:
+  /*! \brief number of bits used for buckets inside a power of two */
+  static const int kSubBits = 3;
+  /*! \brief number of buckets inside a power of two */
+  static const int kSub = 1 << kSubBits;
+  /*! \brief total number of buckets, covers all the 64 bit values */
+  static const int kNumBucket = (64 - kSubBits + 1) * kSub;
+  Histogram(void) : count_(0), sum_(0), max_(0) {
+    for (int i = 0; i < kNumBucket; ++i) bucket_[i] = 0;
+  }
+  /*! \brief record a value */
+  inline void Add(uint64_t val) {
+    AtomicAdd(&bucket_[BucketIndex(val)], 1);
+    AtomicAdd(&count_, 1);
+    AtomicAdd(&sum_, static_cast<int64_t>(val));
+    AtomicMax(&max_, static_cast<int64_t>(val));
+  }
+  /*! \return number of values recorded */
+  inline int64_t count(void) const {
+    return count_;
+  }
+  /*! \return sum of values recorded */
+  inline int64_t sum(void) const {
+    return sum_;
+  }
+  /*! \return maximum value recorded */
+  inline int64_t max(void) const {
+    return max_;
+  }
+  /*!
+   * \brief get the approximate value at a quantile
+   * \param q the quantile, in [0, 1]
+   * \return the upper bound of the bucket that contains the quantile
+   */
+  inline uint64_t Quantile(double q) const {
+    int64_t total = 0;
+    for (int i = 0; i < kNumBucket; ++i) total += bucket_[i];
+    if (total == 0) return 0;
+    int64_t rank = static_cast<int64_t>(q * total + 0.5);
+    if (rank < 1) rank = 1;
+    int64_t cnt = 0;
+    for (int i = 0; i < kNumBucket; ++i) {
+      cnt += bucket_[i];
+      if (cnt >= rank) {
+        uint64_t upper = BucketLowerBound(i + 1) - 1;
+        return upper < static_cast<uint64_t>(max_) ? upper : max_;
+      }
+    }
+    return max_;
+  }
+  /*! \return the bucket index of val */
+  inline static int BucketIndex(uint64_t val) {
+    if (val < static_cast<uint64_t>(kSub)) return static_cast<int>(val);
+    int e = HighBit(val);
+    return (e - kSubBits + 1) * kSub +
+        static_cast<int>((val >> (e - kSubBits)) - kSub);
+  }
+  /*! \return the smallest value that falls into bucket idx */
+  inline static uint64_t BucketLowerBound(int idx) {
+    if (idx < kSub) return static_cast<uint64_t>(idx);
+    if (idx >= kNumBucket) return ~static_cast<uint64_t>(0);
+    int e = idx / kSub + kSubBits - 1;
+    return static_cast<uint64_t>(idx % kSub + kSub) << (e - kSubBits);
+  }
+
+ private:
+  // number of values in each bucket
+  volatile int64_t bucket_[kNumBucket];
+  // statistics
+  volatile int64_t count_, sum_, max_;
+  // index of highest bit that is set
+  inline static int HighBit(uint64_t val) {
+#ifdef __GNUC__
+    return 63 - __builtin_clzll(val);
+#else
+    int e = 0;
+    while (val >>= 1) ++e;
+    return e;
+#endif
+  }
+};
+/*! \brief statistics of one key */
+struct KeyStats {
+  /*! \brief time a push task waits in push queue */
+  Histogram push_queue;
+  /*! \brief time to copy the pushed data into staging buffer */
+  Histogram copy_in;
+  /*! \brief time to handle the push when all devices arrive, including reduction */
+  Histogram reduce;
+  /*! \brief time a pull task waits in pull queue */
+  Histogram pull_queue;
+  /*! \brief time to copy the data back to the device */
+  Histogram copy_out;
+  /*! \brief time blocked in PullWait */
+  Histogram pull_wait;
+  /*! \brief bytes pushed */
+  Counter bytes_push;
+  /*! \brief bytes pulled */
+  Counter bytes_pull;
+};
+/*! \brief statistics of one device */
+struct DeviceStats {
+  /*! \brief time to copy the pushed data into staging buffer */
+  Histogram copy_in;
+  /*! \brief time to copy the data back to the device */
+  Histogram copy_out;
+  /*! \brief time blocked in PullWait */
+  Histogram pull_wait;
+  /*! \brief number of tasks in the push queue of the device */
+  Counter push_queue_depth;
+  /*! \brief number of tasks in the pull queue of the device */
+  Counter pull_queue_depth;
+  /*! \brief bytes pushed */
+  Counter bytes_push;
+  /*! \brief bytes pulled */
+  Counter bytes_pull;
+};
+/*!
+ * \brief collection of statistics of a parameter server,
+ *  the statistics objects are created once, updates to them are lock free
+ */
+class Registry {
+ public:
+  Registry(void) {
+    lock_.Init();
+  }
+  ~Registry(void) {
+    for (std::map<int, KeyStats*>::iterator
+             it = keys_.begin(); it != keys_.end(); ++it) {
+      delete it->second;
+    }
+    for (size_t i = 0; i < devices_.size(); ++i) {
+      delete devices_[i];
+    }
+    lock_.Destroy();
+  }
+  /*!
+   * \brief initialize the device statistics
+   * \param devices the device ids
+   */
+  inline void Init(const std::vector<int> &devices) {
+    lock_.Lock();
+    devid_ = devices;
+    for (size_t i = devices_.size(); i < devices.size(); ++i) {
+      devices_.push_back(new DeviceStats());
+    }
+    lock_.Unlock();
+  }
+  /*!
+   * \brief get statistics of a key, create it if not exist,
+   *  the returned pointer stays valid until the registry is destroyed
+   */
+  inline KeyStats *Key(int key) {
+    lock_.Lock();
+    KeyStats *&ret = keys_[key];
+    if (ret == NULL) ret = new KeyStats();
+    lock_.Unlock();
+    return ret;
+  }
+  /*! \brief get statistics of a device by its local index */
+  inline DeviceStats *Device(int wid) {
+    return devices_[wid];
+  }
+  /*! \return statistics in JSON format */
+  inline std::string ExportJSON(void) {
+    std::string ret = "{\n  \"keys\": {";
+    lock_.Lock();
+    for (std::map<int, KeyStats*>::const_iterator
+             it = keys_.begin(); it != keys_.end(); ++it) {
+      const KeyStats &s = *it->second;
+      ret += it == keys_.begin() ? "\n" : ",\n";
+      ret += "    \"" + ToString(it->first) + "\": {";
+      ret += JSONHist("push_queue", s.push_queue) + ", ";
+      ret += JSONHist("copy_in", s.copy_in) + ", ";
+      ret += JSONHist("reduce", s.reduce) + ", ";
+      ret += JSONHist("pull_queue", s.pull_queue) + ", ";
+      ret += JSONHist("copy_out", s.copy_out) + ", ";
+      ret += JSONHist("pull_wait", s.pull_wait) + ", ";
+      ret += "\"bytes_push\": " + ToString(s.bytes_push.value) + ", ";
+      ret += "\"bytes_pull\": " + ToString(s.bytes_pull.value) + "}";
+    }
+    ret += "\n  },\n  \"devices\": {";
+    for (size_t i = 0; i < devices_.size(); ++i) {
+      const DeviceStats &s = *devices_[i];
+      ret += i == 0 ? "\n" : ",\n";
+      ret += "    \"" + ToString(devid_[i]) + "\": {";
+      ret += JSONHist("copy_in", s.copy_in) + ", ";
+      ret += JSONHist("copy_out", s.copy_out) + ", ";
+      ret += JSONHist("pull_wait", s.pull_wait) + ", ";
+      ret += "\"push_queue_depth\": " + ToString(s.push_queue_depth.value) + ", ";
+      ret += "\"push_queue_depth_max\": " + ToString(s.push_queue_depth.max_value) + ", ";
+      ret += "\"pull_queue_depth\": " + ToString(s.pull_queue_depth.value) + ", ";
+      ret += "\"pull_queue_depth_max\": " + ToString(s.pull_queue_depth.max_value) + ", ";
+      ret += "\"bytes_push\": " + ToString(s.bytes_push.value) + ", ";
+      ret += "\"bytes_pull\": " + ToString(s.bytes_pull.value) + "}";
+    }
+    lock_.Unlock();
+    ret += "\n  }\n}\n";
+    return ret;
+  }
+  /*! \return statistics in prometheus text exposition format */
+  inline std::string ExportPrometheus(void) {
+    static const char *khist[] = {
+      "push_queue", "copy_in", "reduce", "pull_queue", "copy_out", "pull_wait"
+    };
+    std::string ret;
+    lock_.Lock();
+    for (int k = 0; k < 6; ++k) {
+      std::string name = std::string("mshadow_ps_") + khist[k] + "_seconds";
+      ret += "# TYPE " + name + " summary\n";
+      for (std::map<int, KeyStats*>::const_iterator
+               it = keys_.begin(); it != keys_.end(); ++it) {
+        ret += PromHist(name, "key=\"" + ToString(it->first) + "\"",
+                        KeyHist(*it->second, k));
+      }
+    }
+    const char *kbytes[] = {"push", "pull"};
+    for (int k = 0; k < 2; ++k) {
+      std::string name = std::string("mshadow_ps_") + kbytes[k] + "_bytes_total";
+      ret += "# TYPE " + name + " counter\n";
+      for (std::map<int, KeyStats*>::const_iterator
+               it = keys_.begin(); it != keys_.end(); ++it) {
+        const Counter &c = k == 0 ? it->second->bytes_push : it->second->bytes_pull;
+        ret += name + "{key=\"" + ToString(it->first) + "\"} " + ToString(c.value) + "\n";
+      }
+    }
+    const char *kqueue[] = {"push", "pull"};
+    for (int k = 0; k < 2; ++k) {
+      std::string name = std::string("mshadow_ps_") + kqueue[k] + "_queue_depth";
+      ret += "# TYPE " + name + " gauge\n";
+      for (size_t i = 0; i < devices_.size(); ++i) {
+        const Counter &c = k == 0 ?
+            devices_[i]->push_queue_depth : devices_[i]->pull_queue_depth;
+        ret += name + "{device=\"" + ToString(devid_[i]) + "\"} " + ToString(c.value) + "\n";
+      }
+    }
+    const char *kdev[] = {"copy_in", "copy_out", "pull_wait"};
+    for (int k = 0; k < 3; ++k) {
+      std::string name = std::string("mshadow_ps_device_") + kdev[k] + "_seconds";
+      ret += "# TYPE " + name + " summary\n";
+      for (size_t i = 0; i < devices_.size(); ++i) {
+        const DeviceStats &s = *devices_[i];
+        const Histogram &h = k == 0 ? s.copy_in : (k == 1 ? s.copy_out : s.pull_wait);
+        ret += PromHist(name, "device=\"" + ToString(devid_[i]) + "\"", h);
+      }
+    }
+    lock_.Unlock();
+    return ret;
+  }
+
+ private:
+  // lock to protect creation of statistics
+  utils::Mutex lock_;
+  // statistics of keys
+  std::map<int, KeyStats*> keys_;
+  // statistics of devices
+  std::vector<DeviceStats*> devices_;
+  // device id of each device
+  std::vector<int> devid_;
+  inline static const Histogram &KeyHist(const KeyStats &s, int k) {
+    switch (k) {
+      case 0: return s.push_queue;
+      case 1: return s.copy_in;
+      case 2: return s.reduce;
+      case 3: return s.pull_queue;
+      case 4: return s.copy_out;
+      default: return s.pull_wait;
+    }
+  }
+  inline static std::string ToString(int64_t val) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%lld", static_cast<long long>(val));  // NOLINT(*)
+    return buf;
+  }
+  inline static std::string ToString(double val) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%g", val);
+    return buf;
+  }
+  inline static std::string ToString(int val) {
+    return ToString(static_cast<int64_t>(val));
+  }
+  // histogram in JSON, time in microseconds
+  inline static std::string JSONHist(const char *name, const Histogram &h) {
+    std::string ret = std::string("\"") + name + "_us\": {";
+    ret += "\"count\": " + ToString(h.count());
+    ret += ", \"mean\": " + ToString(h.count() == 0 ? 0.0 : h.sum() * 1e-3 / h.count());
+    ret += ", \"p50\": " + ToString(h.Quantile(0.5) * 1e-3);
+    ret += ", \"p90\": " + ToString(h.Quantile(0.9) * 1e-3);
+    ret += ", \"p99\": " + ToString(h.Quantile(0.99) * 1e-3);
+    ret += ", \"max\": " + ToString(h.max() * 1e-3) + "}";
+    return ret;
+  }
+  // histogram as prometheus summary, time in seconds
+  inline static std::string PromHist(const std::string &name,
+                                     const std::string &label,
+                                     const Histogram &h) {
+    static const double kq[] = {0.5, 0.9, 0.99};
+    std::string ret;
+    for (int i = 0; i < 3; ++i) {
+      ret += name + "{" + label + ",quantile=\"" + ToString(kq[i]) + "\"} ";
+      ret += ToString(h.Quantile(kq[i]) * 1e-9) + "\n";
+    }
+    ret += name + "_sum{" + label + "} " + ToString(h.sum() * 1e-9) + "\n";
+    ret += name + "_count{" + label + "} " + ToString(h.count()) + "\n";
+    return ret;
+  }
+};
+}  // namespace telemetry
+}  // namespace ps
+}  // namespace mshadow
+#endif  // MSHADOW_PS_TELEMETRY_H_  NOLINT(*)
@@ -31,6 +31,10 @@ class Semaphore {
   inline void Post(void) {
     CHECK_NE(ReleaseSemaphore(sem, 1, NULL), 0) << "ReleaseSemaphore error";
   }
+  /*! \brief decrease the semaphore without blocking, return false if it is zero */
+  inline bool TryWait(void) {
+    return WaitForSingleObject(sem, 0) == WAIT_OBJECT_0;
+  }
 
  private:
   HANDLE sem;
@@ -111,6 +115,8 @@ inline void ThreadExit(void *status) {
 #include <semaphore.h>
 #include <pthread.h>
 #include <errno.h>
+#include <cstring>
+#include "../mshadow/logging.h"
 namespace mshadow {
 namespace utils {
 /*!\brief semaphore class */
@@ -159,6 +165,9 @@ class Semaphore {
   inline void Post(void) {
     sem_post(semPtr);
   }
+  inline bool TryWait(void) {
+    return sem_trywait(semPtr) == 0;
+  }
   #else
 
  private:
@@ -185,6 +194,10 @@ class Semaphore {
       LOG(FATAL) << "Semaphore.Post: " << strerror(errno);
     }
   }
+  /*! \brief decrease the semaphore without blocking, return false if it is zero */
+  inline bool TryWait(void) {
+    return sem_trywait(&sem) == 0;
+  }
   #endif
 };
 
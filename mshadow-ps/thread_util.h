@@ -9,7 +9,9 @@
 
 #include <utility>
 #include <queue>
+#include <deque>
 #include <map>
+#include <vector>
 #include "./thread.h"
 namespace mshadow {
 namespace utils {
@@ -94,6 +96,35 @@ class ThreadPQueue {
     lock_.Unlock();
     return true;
   }
+  /*!
+   * \brief pop up to max_batch elements from the queue,
+   * this will block the thread until at least one element is available,
+   * then take the other elements that are already in the queue without blocking
+   * \param out the elements poped, in the order of priority
+   * \param max_batch maximum number of elements to pop
+   * \return true if at least one element is returned
+   *  false if abort is called and no element was left in queue
+   */
+  inline bool PopBatch(std::vector<DType> *out, size_t max_batch) {
+    out->clear();
+    DType data;
+    if (!this->Pop(&data)) return false;
+    out->push_back(data);
+    lock_.Lock();
+    while (out->size() < max_batch) {
+      if (use_fifo_) {
+        if (fqueue_.size() == 0 || !counter_.TryWait()) break;
+        out->push_back(fqueue_.front());
+        fqueue_.pop();
+      } else {
+        if (pqueue_.size() == 0 || !counter_.TryWait()) break;
+        out->push_back(pqueue_.top().data);
+        pqueue_.pop();
+      }
+    }
+    lock_.Unlock();
+    return true;
+  }
 
  private:
   // entry in the queue
@@ -118,6 +149,167 @@ class ThreadPQueue {
   utils::Semaphore counter_;
 };
 
+/*!
+ * \brief a fixed set of worker threads shared by all the users of a component,
+ *  a job is split into parts that are run by the workers, and by the thread
+ *  that runs the job, so that concurrent users never start more threads than
+ *  the pool has
+ */
+class ThreadPool {
+ public:
+  /*! \brief a job that can be split into parts */
+  class Job {
+   public:
+    virtual ~Job(void) {}
+    /*!
+     * \brief run one part of the job, parts can run concurrently
+     * \param i the index of the part
+     */
+    virtual void Run(int i) = 0;
+    /*! \brief called once after all the parts of a submitted job finished */
+    virtual void Done(void) {}
+  };
+  ThreadPool(void) : nworker_(0) {}
+  /*!
+   * \brief start the workers, must call this before use
+   * \param nworker number of worker threads, 0 means all jobs run in the caller
+   */
+  inline void Init(int nworker) {
+    nworker_ = nworker < 0 ? 0 : nworker;
+    abort_ = false;
+    lock_.Init();
+    cond_.Init();
+    workers_.resize(nworker_);
+    for (int i = 0; i < nworker_; ++i) {
+      workers_[i].Start(WorkerThread, this);
+    }
+  }
+  /*! \brief finish the submitted jobs, then stop the workers */
+  inline void Destroy(void) {
+    lock_.Lock();
+    abort_ = true;
+    cond_.Broadcast();
+    lock_.Unlock();
+    for (size_t i = 0; i < workers_.size(); ++i) {
+      workers_[i].Join();
+    }
+    workers_.clear();
+    cond_.Destroy();
+    lock_.Destroy();
+  }
+  /*! \return number of worker threads */
+  inline int NumWorker(void) const {
+    return nworker_;
+  }
+  /*!
+   * \brief run all parts of the job and wait till they finish,
+   *  the calling thread runs parts of the job as well, Done is not called
+   * \param job the job
+   * \param npart number of parts
+   */
+  inline void Run(Job *job, int npart) {
+    if (npart <= 0) return;
+    Record r(job, npart, true);
+    lock_.Lock();
+    if (nworker_ != 0 && npart > 1) {
+      queue_.push_back(&r);
+      cond_.Broadcast();
+    }
+    while (r.next < r.npart) {
+      const int i = r.next++;
+      if (r.next == r.npart && nworker_ != 0 && npart > 1) this->Remove(&r);
+      lock_.Unlock();
+      job->Run(i);
+      lock_.Lock();
+      r.nleft -= 1;
+    }
+    while (r.nleft != 0) {
+      cond_.Wait(&lock_);
+    }
+    lock_.Unlock();
+  }
+  /*!
+   * \brief submit the job and return without waiting, Done of the job is called
+   *  by the thread that finishes the last part. When there is no worker,
+   *  the job runs in the calling thread before Submit returns
+   * \param job the job, must stay alive until Done is called
+   * \param npart number of parts
+   */
+  inline void Submit(Job *job, int npart) {
+    if (nworker_ == 0 || npart <= 0) {
+      for (int i = 0; i < npart; ++i) job->Run(i);
+      job->Done();
+      return;
+    }
+    lock_.Lock();
+    queue_.push_back(new Record(job, npart, false));
+    cond_.Broadcast();
+    lock_.Unlock();
+  }
+
+ private:
+  // a job in flight
+  struct Record {
+    Job *job;
+    // number of parts, next part to run, parts not finished
+    int npart, next, nleft;
+    // whether a thread waits in Run for the job
+    bool sync;
+    Record(Job *job, int npart, bool sync)
+        : job(job), npart(npart), next(0), nleft(npart), sync(sync) {}
+  };
+  // number of workers
+  int nworker_;
+  // whether Destroy is called
+  bool abort_;
+  // jobs that still have parts to start
+  std::deque<Record*> queue_;
+  // the worker threads
+  std::vector<Thread> workers_;
+  // lock of the queue and the records
+  Mutex lock_;
+  // signals new jobs and finished parts
+  ConditionVariable cond_;
+  // remove a record from the queue, caller must hold the lock
+  inline void Remove(Record *r) {
+    for (std::deque<Record*>::iterator it = queue_.begin(); it != queue_.end(); ++it) {
+      if (*it == r) {
+        queue_.erase(it); return;
+      }
+    }
+  }
+  inline void WorkerLoop(void) {
+    lock_.Lock();
+    while (true) {
+      while (!abort_ && queue_.size() == 0) {
+        cond_.Wait(&lock_);
+      }
+      if (queue_.size() == 0) break;
+      Record *r = queue_.front();
+      const int i = r->next++;
+      if (r->next == r->npart) queue_.pop_front();
+      lock_.Unlock();
+      r->job->Run(i);
+      lock_.Lock();
+      if (--r->nleft == 0) {
+        if (r->sync) {
+          cond_.Broadcast();
+        } else {
+          lock_.Unlock();
+          r->job->Done();
+          delete r;
+          lock_.Lock();
+        }
+      }
+    }
+    lock_.Unlock();
+  }
+  inline static MSHADOW_THREAD_PREFIX WorkerThread(void *pool) {
+    static_cast<ThreadPool*>(pool)->WorkerLoop();
+    return NULL;
+  }
+};
+
 // naive implementation of threadsafe map
 template<typename TValue>
 class ThreadSafeMap {
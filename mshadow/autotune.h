@@ -0,0 +1,295 @@
+/*!
+ *  Copyright (c) 2014 by Contributors
+ * \file autotune.h
+ * \brief autotuner of kernel parameters, such as threshold, blocking
+ *  and number of threads. The candidates of a parameter are timed on
+ *  first use, the winner is kept in a cache file keyed by the cpu model,
+ *  so later runs on the same kind of machine look it up directly.
+ *
+ *  Tuning is opt-in, until it is enabled Tune returns the default value and
+ *  no file is read or written. Environment variables:
+ *  - MSHADOW_TUNE: set to 1 to enable tuning, SetEnabled does the same in code
+ *  - MSHADOW_TUNE_CACHE: path of the cache file, default ~/.mshadow_tune_cache,
+ *    set to none to keep the results only in memory
+ *
+ *  Only runtime parameters can be tuned. Compile time tiles of the kernels,
+ *  such as the panel width of PackedMatrix or the chunk of flat evaluation,
+ *  and the choice between the SSE and the scalar path are fixed.
+ *
+ *  The tuner is compiled in when MSHADOW_USE_AUTOTUNE is 1 and c++11 is enabled,
+ *  otherwise Tune always returns the default value.
+ * \author Tianqi Chen
+ */
+#ifndef MSHADOW_AUTOTUNE_H_
+#define MSHADOW_AUTOTUNE_H_
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "./base.h"
+#include "./logging.h"
+
+#if MSHADOW_USE_AUTOTUNE && MSHADOW_IN_CXX11
+#include <chrono>
+#include <mutex>
+#include <thread>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__i386__) || defined(__x86_64__)
+#include <cpuid.h>
+#endif
+#endif
+
+namespace mshadow {
+/*! \brief namespace of the autotuner */
+namespace autotune {
+/*!
+ * \brief get the size class of a problem size, the power of two
+ *  that is not smaller than size, used as part of the key of a tuned parameter
+ * \param size the problem size, e.g. number of elements
+ */
+inline std::string SizeClass(size_t size) {
+  int k = 0;
+  while ((static_cast<size_t>(1) << k) < size && k < 63) ++k;
+  std::ostringstream os;
+  os << "2^" << k;
+  return os.str();
+}
+
+#if MSHADOW_USE_AUTOTUNE && MSHADOW_IN_CXX11
+/*!
+ * \return the name of the cpu model and number of hardware threads,
+ *  the key of the cache, e.g. "Intel(R) Xeon(R) CPU E5-2680 v2 @ 2.80GHz x40"
+ */
+inline std::string CPUModel(void) {
+  std::string name;
+#if defined(_MSC_VER) || defined(__i386__) || defined(__x86_64__)
+  unsigned regs[12];
+  bool ok = true;
+  for (unsigned i = 0; i < 3 && ok; ++i) {
+#if defined(_MSC_VER)
+    int r[4];
+    __cpuid(r, static_cast<int>(0x80000002 + i));
+    for (int j = 0; j < 4; ++j) regs[i * 4 + j] = static_cast<unsigned>(r[j]);
+#else
+    ok = __get_cpuid(0x80000002 + i, &regs[i * 4], &regs[i * 4 + 1],
+                     &regs[i * 4 + 2], &regs[i * 4 + 3]) != 0;
+#endif
+  }
+  if (ok) name.assign(reinterpret_cast<const char*>(regs), sizeof(regs));
+#endif
+  if (name.find_first_not_of(std::string(" \t\0", 3)) == std::string::npos) {
+    name.clear();
+    FILE *fi = fopen("/proc/cpuinfo", "r");
+    if (fi != NULL) {
+      char line[512];
+      while (fgets(line, sizeof(line), fi) != NULL) {
+        if (!strncmp(line, "model name", 10) || !strncmp(line, "Processor", 9) ||
+            !strncmp(line, "CPU part", 8)) {
+          const char *p = strchr(line, ':');
+          if (p != NULL) name = p + 1;
+          break;
+        }
+      }
+      fclose(fi);
+    }
+  }
+  // trim and remove the characters used as separator of the cache
+  std::string ret;
+  for (size_t i = 0; i < name.length(); ++i) {
+    char c = name[i];
+    if (c == '\0' || c == '\n' || c == '\r' || c == '\t') c = ' ';
+    if (c == ' ' && (ret.length() == 0 || ret[ret.length() - 1] == ' ')) continue;
+    ret += c;
+  }
+  while (ret.length() != 0 && ret[ret.length() - 1] == ' ') ret.resize(ret.length() - 1);
+  if (ret.length() == 0) ret = "unknown";
+  std::ostringstream os;
+  os << ret << " x" << std::thread::hardware_concurrency();
+  return os.str();
+}
+/*!
+ * \brief the cache of tuned parameters, one entry per line of the cache file:
+ *  cpu model, op, shape class and value separated by tab
+ */
+class Cache {
+ public:
+  /*! \return the global cache */
+  inline static Cache *Get(void) {
+    static Cache inst;
+    return &inst;
+  }
+  /*! \brief whether tuning is enabled */
+  inline bool enabled(void) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return enabled_;
+  }
+  /*!
+   * \brief enable or disable tuning, the cache file is loaded
+   *  the first time tuning is enabled
+   */
+  inline void set_enabled(bool enabled) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    enabled_ = enabled;
+    if (enabled_ && !loaded_) this->Load();
+  }
+  /*!
+   * \brief look up a tuned parameter of the current cpu
+   * \param key the key of the parameter, op and shape class
+   * \param out the output value
+   * \return whether the parameter is found
+   */
+  inline bool Lookup(const std::string &key, int *out) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::map<std::string, int>::const_iterator it = entry_.find(model_ + '\t' + key);
+    if (it == entry_.end()) return false;
+    *out = it->second;
+    return true;
+  }
+  /*!
+   * \brief store a tuned parameter of the current cpu and write the cache file
+   * \param key the key of the parameter, op and shape class
+   * \param value the value to store
+   */
+  inline void Store(const std::string &key, int value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entry_[model_ + '\t' + key] = value;
+    if (fname_.length() == 0) return;
+    // write to temp file then rename, so that the file is never half written
+    const std::string tmp = fname_ + ".tmp";
+    FILE *fo = fopen(tmp.c_str(), "w");
+    if (fo == NULL) {
+      LOG(INFO) << "autotune: cannot write cache " << tmp;
+      return;
+    }
+    for (std::map<std::string, int>::const_iterator
+             it = entry_.begin(); it != entry_.end(); ++it) {
+      fprintf(fo, "%s\t%d\n", it->first.c_str(), it->second);
+    }
+    fclose(fo);
+    if (rename(tmp.c_str(), fname_.c_str()) != 0) {
+      remove(tmp.c_str());
+    }
+  }
+  /*! \brief the lock that serializes tuning, so that the timing is not disturbed */
+  std::mutex tune_mutex;
+
+ private:
+  Cache(void) : enabled_(false), loaded_(false) {
+    const char *flag = getenv("MSHADOW_TUNE");
+    if (flag != NULL && atoi(flag) != 0) {
+      enabled_ = true;
+      this->Load();
+    }
+  }
+  // read the cache file, caller must hold the lock or be the constructor
+  inline void Load(void) {
+    loaded_ = true;
+    model_ = CPUModel();
+    const char *path = getenv("MSHADOW_TUNE_CACHE");
+    if (path != NULL) {
+      if (strcmp(path, "none") != 0) fname_ = path;
+    } else if (getenv("HOME") != NULL) {
+      fname_ = std::string(getenv("HOME")) + "/.mshadow_tune_cache";
+    }
+    if (fname_.length() == 0) return;
+    FILE *fi = fopen(fname_.c_str(), "r");
+    if (fi == NULL) return;
+    char line[1024];
+    while (fgets(line, sizeof(line), fi) != NULL) {
+      char *p = strrchr(line, '\t');
+      if (p == NULL) continue;
+      *p = '\0';
+      entry_[line] = atoi(p + 1);
+    }
+    fclose(fi);
+  }
+  // whether tuning is enabled
+  bool enabled_;
+  // whether the cache file is loaded
+  bool loaded_;
+  // the cpu model
+  std::string model_;
+  // name of cache file, empty for in memory cache
+  std::string fname_;
+  // all entries, including those of other cpu models
+  std::map<std::string, int> entry_;
+  // lock to protect the entries
+  std::mutex mutex_;
+};
+/*! \return whether tuning is enabled */
+inline bool Enabled(void) {
+  return Cache::Get()->enabled();
+}
+/*!
+ * \brief enable or disable tuning in this process,
+ *  overrides the environment variable MSHADOW_TUNE
+ */
+inline void SetEnabled(bool enabled) {
+  Cache::Get()->set_enabled(enabled);
+}
+/*!
+ * \brief get the tuned value of a parameter, the candidates are timed
+ *  on first use on this kind of cpu, and the fastest one is cached
+ * \param op name of the operation and parameter, e.g. ps_reduce_thread
+ * \param shape_class class of the problem, e.g. SizeClass(size)
+ * \param candidates the candidate values
+ * \param def default value, returned when tuning is disabled
+ * \param fbench function that runs the operation once with a candidate value,
+ *    fbench(value) is called several times for each candidate
+ * \param nrepeat number of timed runs of each candidate, the minimum time is used
+ * \return the tuned value
+ * \tparam FBench type of the benchmark function
+ */
+template<typename FBench>
+inline int Tune(const char *op, const std::string &shape_class,
+                const std::vector<int> &candidates, int def,
+                FBench fbench, int nrepeat = 3) {
+  Cache *cache = Cache::Get();
+  if (!cache->enabled() || candidates.size() == 0) return def;
+  const std::string key = std::string(op) + '\t' + shape_class;
+  int ret;
+  if (cache->Lookup(key, &ret)) return ret;
+  std::lock_guard<std::mutex> lock(cache->tune_mutex);
+  // another thread may have tuned it while waiting for the lock
+  if (cache->Lookup(key, &ret)) return ret;
+  double best = 0.0;
+  ret = def;
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    // warm up
+    fbench(candidates[i]);
+    double tmin = 0.0;
+    for (int r = 0; r < nrepeat; ++r) {
+      std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+      fbench(candidates[i]);
+      double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+      if (r == 0 || t < tmin) tmin = t;
+    }
+    if (i == 0 || tmin < best) {
+      best = tmin; ret = candidates[i];
+    }
+  }
+  cache->Store(key, ret);
+  return ret;
+}
+#else
+inline std::string CPUModel(void) {
+  return "unknown";
+}
+inline bool Enabled(void) {
+  return false;
+}
+inline void SetEnabled(bool enabled) {}
+template<typename FBench>
+inline int Tune(const char *op, const std::string &shape_class,
+                const std::vector<int> &candidates, int def,
+                FBench fbench, int nrepeat = 3) {
+  return def;
+}
+#endif  // MSHADOW_USE_AUTOTUNE && MSHADOW_IN_CXX11
+}  // namespace autotune
+}  // namespace mshadow
+#endif  // MSHADOW_AUTOTUNE_H_
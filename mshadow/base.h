@@ -108,11 +108,87 @@
 #ifndef MSHADOW_USE_NVML
   #define MSHADOW_USE_NVML 0
 #endif
+/*!
+ * \brief whether compile in the timeline tracer in trace.h,
+ *  the tracer records only after trace::Start is called, requires c++11
+ */
+#ifndef MSHADOW_USE_TRACE
+  #define MSHADOW_USE_TRACE 0
+#endif
+/*!
+ * \brief whether compile in the autotuner in autotune.h,
+ *  tuned parameters are cached per cpu model, requires c++11.
+ *  Tuning still has to be enabled at runtime, see autotune.h
+ */
+#ifndef MSHADOW_USE_AUTOTUNE
+  #define MSHADOW_USE_AUTOTUNE 1
+#endif
+/*!
+ * \brief whether dot with at most 8 rows of lhs uses the skinny kernels of
+ *  dot_skinny-inl.h instead of BLAS. On one thread they beat the BLAS gemm,
+ *  but they only use more threads with OpenMP, while the BLAS may be
+ *  multithreaded, so by default they are used without BLAS or with OpenMP
+ */
+#ifndef MSHADOW_USE_SKINNY_DOT
+  #if defined(_OPENMP) || !(MSHADOW_USE_CBLAS || MSHADOW_USE_MKL)
+    #define MSHADOW_USE_SKINNY_DOT 1
+  #else
+    #define MSHADOW_USE_SKINNY_DOT 0
+  #endif
+#endif
 // SSE is conflict with cudacc
 #ifdef __CUDACC__
   #undef MSHADOW_USE_SSE
   #define MSHADOW_USE_SSE 0
 #endif
+/*!
+ * \brief whether evaluate a * b + c, a * b - c and c - a * b with fused
+ *  multiply-add, needs a compiler that targets FMA3 (e.g. -mfma).
+ *  It selects other specializations of the plans and cpu engines, so it must
+ *  be set the same way in every translation unit of a program, which is why
+ *  it is off by default instead of following -mfma of each file
+ */
+#ifndef MSHADOW_USE_FMA
+  #define MSHADOW_USE_FMA 0
+#endif
+#ifdef __CUDACC__
+  #undef MSHADOW_USE_FMA
+  #define MSHADOW_USE_FMA 0
+#endif
+#if MSHADOW_USE_FMA && !defined(__FMA__)
+  #error "MSHADOW_USE_FMA needs a compiler that targets FMA3, e.g. -mfma"
+#endif
+/*!
+ * \brief number of elements from which the cpu kernels split their loops
+ *  over OpenMP threads, smaller loops cost less than starting the threads
+ */
+#ifndef MSHADOW_OMP_MIN_SIZE
+  #define MSHADOW_OMP_MIN_SIZE (1 << 16)
+#endif
+/*!
+ * \brief number of multiply-adds from which the dot kernels split their
+ *  loops over OpenMP threads, e.g. m * n * k of a gemm
+ */
+#ifndef MSHADOW_OMP_MIN_WORK
+  #define MSHADOW_OMP_MIN_WORK (1 << 18)
+#endif
+/*!
+ * \brief put before a for loop to run it over OpenMP threads with a static
+ *  schedule when cond holds, it expands to nothing without OpenMP
+ */
+#if defined(_OPENMP) && defined(_MSC_VER)
+  #define MSHADOW_OMP_PARALLEL_FOR_IF(cond) \
+    __pragma(omp parallel for schedule(static) if (cond))
+#elif defined(_OPENMP)
+  #define MSHADOW_PRAGMA_(x) _Pragma(#x)
+  #define MSHADOW_OMP_PARALLEL_FOR_IF(cond) \
+    MSHADOW_PRAGMA_(omp parallel for schedule(static) if (cond))
+#else
+  #define MSHADOW_OMP_PARALLEL_FOR_IF(cond)
+#endif
+/*! \brief parallel for loop over more than MSHADOW_OMP_MIN_SIZE elements */
+#define MSHADOW_OMP_PARALLEL_FOR(size) \
+  MSHADOW_OMP_PARALLEL_FOR_IF((size) > MSHADOW_OMP_MIN_SIZE)
 
 #if MSHADOW_USE_CBLAS
 extern "C" {
@@ -219,6 +295,15 @@ const unsigned kRandBufferSize = 1000000;
 const float kPi = 3.1415926f;
 /*! \brief type that will be used for index */
 typedef unsigned index_t;
+/*!
+ * \brief type of the index of loops parallelized by openmp,
+ *  msvc only accepts signed int there
+ */
+#ifdef _MSC_VER
+typedef int ms_omp_uint;
+#else
+typedef unsigned ms_omp_uint;
+#endif
 /*! \brief float point type that will be used in default by mshadow */
 typedef float default_real_t;
 
@@ -265,6 +350,87 @@ struct right {
     return b;
   }
 };
+/*! \brief larger one of a and b, b if any of them is NaN */
+struct maximum {
+  /*! \brief map a, b to result using defined operation */
+  template<typename DType>
+  MSHADOW_XINLINE static DType Map(DType a, DType b) {
+    return a > b ? a : b;
+  }
+};
+/*! \brief smaller one of a and b, b if any of them is NaN */
+struct minimum {
+  /*! \brief map a, b to result using defined operation */
+  template<typename DType>
+  MSHADOW_XINLINE static DType Map(DType a, DType b) {
+    return a < b ? a : b;
+  }
+};
+/*! \brief 1 if a is greater than b, else 0 */
+struct gt {
+  /*! \brief map a, b to result using defined operation */
+  template<typename DType>
+  MSHADOW_XINLINE static DType Map(DType a, DType b) {
+    return a > b ? DType(1) : DType(0);
+  }
+};
+/*! \brief 1 if a is greater than or equal to b, else 0 */
+struct ge {
+  /*! \brief map a, b to result using defined operation */
+  template<typename DType>
+  MSHADOW_XINLINE static DType Map(DType a, DType b) {
+    return a >= b ? DType(1) : DType(0);
+  }
+};
+/*! \brief 1 if a is less than b, else 0 */
+struct lt {
+  /*! \brief map a, b to result using defined operation */
+  template<typename DType>
+  MSHADOW_XINLINE static DType Map(DType a, DType b) {
+    return a < b ? DType(1) : DType(0);
+  }
+};
+/*! \brief 1 if a is less than or equal to b, else 0 */
+struct le {
+  /*! \brief map a, b to result using defined operation */
+  template<typename DType>
+  MSHADOW_XINLINE static DType Map(DType a, DType b) {
+    return a <= b ? DType(1) : DType(0);
+  }
+};
+/*! \brief 1 if a is equal to b, else 0 */
+struct eq {
+  /*! \brief map a, b to result using defined operation */
+  template<typename DType>
+  MSHADOW_XINLINE static DType Map(DType a, DType b) {
+    return a == b ? DType(1) : DType(0);
+  }
+};
+/*! \brief 1 if a is not equal to b, else 0 */
+struct ne {
+  /*! \brief map a, b to result using defined operation */
+  template<typename DType>
+  MSHADOW_XINLINE static DType Map(DType a, DType b) {
+    return a != b ? DType(1) : DType(0);
+  }
+};
+// ternary operator
+/*! \brief a if cond is not 0, else b */
+struct where {
+  /*! \brief map cond, a, b to result using defined operation */
+  template<typename DType>
+  MSHADOW_XINLINE static DType Map(DType cond, DType a, DType b) {
+    return cond != DType(0) ? a : b;
+  }
+};
+/*! \brief minimum(maximum(a, lo), hi), lo if a is NaN */
+struct clip {
+  /*! \brief map a, lo, hi to result using defined operation */
+  template<typename DType>
+  MSHADOW_XINLINE static DType Map(DType a, DType lo, DType hi) {
+    return minimum::Map(maximum::Map(a, lo), hi);
+  }
+};
 // unary operator/ function: example
 // these operators can be defined by user,
 // in the same style as binary and unary operator
@@ -277,6 +443,16 @@ struct identity{
     return a;
   }
 };
+/*! \brief sign of a, 1, -1 or 0, 0 if a is NaN */
+struct sign {
+  /*! \brief map a to result using defined operation */
+  template<typename DType>
+  MSHADOW_XINLINE static DType Map(DType a) {
+    if (a > DType(0)) return DType(1);
+    if (a < DType(0)) return DType(-1);
+    return DType(0);
+  }
+};
 }  // namespace op
 /*! \brief namespace for savers */
 namespace sv {
@@ -367,6 +543,27 @@ template<>
 MSHADOW_XINLINE int MinValue<int>(void) {
   return INT_MIN;
 }
+/*!
+ * \brief maximum value of certain types
+ * \tparam DType data type
+ */
+template<typename DType>
+MSHADOW_XINLINE DType MaxValue(void);
+/*! \brief maximum value of float */
+template<>
+MSHADOW_XINLINE float MaxValue<float>(void) {
+  return FLT_MAX;
+}
+/*! \brief maximum value of double */
+template<>
+MSHADOW_XINLINE double MaxValue<double>(void) {
+  return DBL_MAX;
+}
+/*! \brief maximum value of int */
+template<>
+MSHADOW_XINLINE int MaxValue<int>(void) {
+  return INT_MAX;
+}
 }  // namespace limits
 
 /*! \brief sum reducer */
@@ -416,6 +613,30 @@ struct maximum {
     initv = limits::MinValue<DType>();
   }
 };
+/*! \brief minimum reducer */
+struct minimum {
+  /*! \brief do reduction into dst */
+  template<typename DType>
+  MSHADOW_XINLINE static void Reduce(volatile DType& dst,  volatile DType src) { // NOLINT(*)
+    using namespace std;
+    dst = min(dst, src);
+  }
+  /*!
+   * \brief calculate gradient of redres with respect to redsrc,
+   * redres: reduced result, redsrc: one of reduction element
+   */
+  template<typename DType>
+  MSHADOW_XINLINE static DType PartialGrad(DType redres, DType redsrc) {
+    return redres == redsrc ? 1: 0;
+  }
+  /*!
+   *\brief set the initial value during reduction
+   */
+  template<typename DType>
+  MSHADOW_XINLINE static void SetInitValue(DType &initv) { // NOLINT(*)
+    initv = limits::MaxValue<DType>();
+  }
+};
 }  // namespace red
 }  // namespace mshadow
 #endif  // MSHADOW_BASE_H_
@@ -6,6 +6,7 @@
  */
 #ifndef MSHADOW_DOT_ENGINE_INL_H_
 #define MSHADOW_DOT_ENGINE_INL_H_
+#include "./dot_skinny-inl.h"
 namespace mshadow {
 namespace expr {
 //---------------------------------------------------------------------
@@ -216,6 +217,11 @@ struct DotEngine<SV, xpu, 2, 2, 2, transpose_left, transpose_right, DType> {
     Shape<2> sright = GetShape(rhs.shape_, transpose_right);
     CHECK(dst.size(0) == sleft[0] && dst.size(1) == sright[1] && sleft[1] == sright[0])
       << "dot-gemm: matrix shape mismatch";
+    if (SkinnyDot<SV, xpu, DType>::Eval(&dst, lhs, transpose_left,
+                                        rhs, transpose_right, scale)) return;
+    MSHADOW_TRACE_SCOPE("gemm", "blas", Shape3(sleft[0], sleft[1], sright[1]),
+                        2.0 * sleft[0] * sleft[1] * sright[1],
+                        sizeof(DType) * (lhs.MSize() + rhs.MSize() + dst.MSize()));
     // use column major argument to compatible with most BLAS
     BLASEngine<xpu>::gemm
         (dst.stream_,
@@ -240,12 +246,17 @@ struct DotEngine<SV, xpu, 1, 1, 2, false, transpose_right, DType> {
     // set kernel stream
     // if there is no stream, crush
     BLASEngine<xpu>::SetStream(dst.stream_);
-    Shape<2> sright = GetShape(rhs.shape, transpose_right);
+    Shape<2> sright = GetShape(rhs.shape_, transpose_right);
     CHECK(dst.size(0) == sright[1] && lhs.size(0) == sright[0])
       << "dot-gemv: matrix shape mismatch"
       << "dst: " << dst.shape_ << "\n"
       << "lhs: " << lhs.shape_ << "\n"
       << "rhs: " << sright << "\n";
+    Tensor<xpu, 2, DType> dst2(dst.dptr_, Shape2(1, dst.size(0)), dst.size(0), dst.stream_);
+    if (SkinnyDot<SV, xpu, DType>::Eval(&dst2, lhs.FlatTo2D(), false,
+                                        rhs, transpose_right, scale)) return;
+    MSHADOW_TRACE_SCOPE("gemv", "blas", sright, 2.0 * rhs.MSize(),
+                        sizeof(DType) * (lhs.MSize() + rhs.MSize() + dst.MSize()));
     BLASEngine<xpu>::gemv
         (dst.stream_,
          transpose_right,
@@ -270,6 +281,8 @@ struct DotEngine<SV, xpu, 2, 1, 1, true, false, DType> {
       << "dst: " << dst.shape_ << "\n"
       << "lhs: " << lhs.shape_ << "\n"
       << "rhs: " << rhs.shape_;
+    MSHADOW_TRACE_SCOPE("ger", "blas", dst.shape_, 2.0 * dst.MSize(),
+                        sizeof(DType) * (lhs.MSize() + rhs.MSize() + dst.MSize()));
     if (SV::BetaBLAS() == 0.0f) {
       BLASEngine<xpu>::ger
           (dst.stream_, rhs.size(0), lhs.size(0), scale * SV::AlphaBLAS(),
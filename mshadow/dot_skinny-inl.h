@@ -0,0 +1,247 @@
+/*!
+ *  Copyright (c) 2014 by Contributors
+ * \file dot_skinny-inl.h
+ * \brief kernels of skinny matrix products, where the lhs has only a few rows,
+ *  e.g. batch 1 to 8 in online inference. GEMM of BLAS is tuned for large
+ *  blocks and spends most of the time in packing for such shapes, while the
+ *  product is bounded by reading rhs once. The kernels here keep the rows of
+ *  lhs in registers and stream rhs, threads split the large dimension.
+ *  They are used when MSHADOW_USE_SKINNY_DOT is set, or when there is no BLAS.
+ * \author Tianqi Chen
+ */
+#ifndef MSHADOW_DOT_SKINNY_INL_H_
+#define MSHADOW_DOT_SKINNY_INL_H_
+#include <algorithm>
+#include <vector>
+#include "./sse-inl.h"
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+namespace mshadow {
+namespace expr {
+namespace skinny {
+/*!
+ * \brief number of accumulators of one block of the nn kernel, a block of
+ *  M rows covers kAccSize / M columns of rhs. Wide blocks read long runs of
+ *  each row of rhs, which keeps the hardware prefetcher and TLB efficient
+ */
+const index_t kAccSize = 2048;
+/*!
+ * \brief kernels over M rows of lhs, each row of lhs is contiguous
+ * \tparam M number of rows of lhs
+ * \tparam DType data type
+ */
+template<int M, typename DType>
+struct Kernel {
+  /*!
+   * \brief acc[i][j] += sum_k a[i][k] * b[k][j] for j < nc,
+   *  acc has ldc elements per row
+   */
+  inline static void NN(const DType *a, index_t lda, index_t k,
+                        const DType *b, index_t ldb, index_t nc, DType *acc, index_t ldc) {
+    for (index_t kk = 0; kk < k; ++kk) {
+      const DType *pb = b + kk * ldb;
+      for (int i = 0; i < M; ++i) {
+        const DType v = a[i * lda + kk];
+        DType *pacc = acc + i * ldc;
+        for (index_t j = 0; j < nc; ++j) pacc[j] += v * pb[j];
+      }
+    }
+  }
+  /*! \brief out[i] = sum_k a[i][k] * b[k] */
+  inline static void NT(const DType *a, index_t lda, index_t k,
+                        const DType *b, DType *out) {
+    for (int i = 0; i < M; ++i) out[i] = DType(0);
+    for (index_t kk = 0; kk < k; ++kk) {
+      for (int i = 0; i < M; ++i) out[i] += a[i * lda + kk] * b[kk];
+    }
+  }
+};
+#if MSHADOW_USE_SSE
+template<int M>
+struct Kernel<M, float> {
+  inline static void NN(const float *a, index_t lda, index_t k,
+                        const float *b, index_t ldb, index_t nc, float *acc, index_t ldc) {
+    const index_t nv = (nc >> 2) << 2;
+    index_t kk = 0;
+    // four rows of rhs per pass cut the traffic of the accumulators
+    for (; kk + 4 <= k; kk += 4) {
+      const float *pb = b + kk * ldb;
+      __m128 v[M][4];
+      for (int i = 0; i < M; ++i) {
+        for (int t = 0; t < 4; ++t) v[i][t] = _mm_set1_ps(a[i * lda + kk + t]);
+      }
+      // one load of rhs is shared by all the rows
+      for (index_t j = 0; j < nv; j += 4) {
+        const __m128 b0 = _mm_loadu_ps(pb + j), b1 = _mm_loadu_ps(pb + ldb + j);
+        const __m128 b2 = _mm_loadu_ps(pb + 2 * ldb + j), b3 = _mm_loadu_ps(pb + 3 * ldb + j);
+        for (int i = 0; i < M; ++i) {
+          float *pacc = acc + i * ldc + j;
+          const __m128 s01 = _mm_add_ps(_mm_mul_ps(v[i][0], b0), _mm_mul_ps(v[i][1], b1));
+          const __m128 s23 = _mm_add_ps(_mm_mul_ps(v[i][2], b2), _mm_mul_ps(v[i][3], b3));
+          _mm_storeu_ps(pacc, _mm_add_ps(_mm_loadu_ps(pacc), _mm_add_ps(s01, s23)));
+        }
+      }
+      for (index_t j = nv; j < nc; ++j) {
+        for (int i = 0; i < M; ++i) {
+          for (int t = 0; t < 4; ++t) acc[i * ldc + j] += a[i * lda + kk + t] * pb[t * ldb + j];
+        }
+      }
+    }
+    for (; kk < k; ++kk) {
+      const float *pb = b + kk * ldb;
+      for (int i = 0; i < M; ++i) {
+        const float v = a[i * lda + kk];
+        for (index_t j = 0; j < nc; ++j) acc[i * ldc + j] += v * pb[j];
+      }
+    }
+  }
+  inline static void NT(const float *a, index_t lda, index_t k,
+                        const float *b, float *out) {
+    // few rows give few independent chains, so two accumulators
+    // per row are used to hide the latency of add
+    const index_t kv = (k >> 3) << 3;
+    __m128 acc0[M], acc1[M];
+    for (int i = 0; i < M; ++i) {
+      acc0[i] = _mm_setzero_ps(); acc1[i] = _mm_setzero_ps();
+    }
+    for (index_t kk = 0; kk < kv; kk += 8) {
+      const __m128 b0 = _mm_loadu_ps(b + kk), b1 = _mm_loadu_ps(b + kk + 4);
+      for (int i = 0; i < M; ++i) {
+        acc0[i] = _mm_add_ps(acc0[i], _mm_mul_ps(_mm_loadu_ps(a + i * lda + kk), b0));
+        acc1[i] = _mm_add_ps(acc1[i], _mm_mul_ps(_mm_loadu_ps(a + i * lda + kk + 4), b1));
+      }
+    }
+    for (int i = 0; i < M; ++i) {
+      out[i] = sse2::FVec<float>(_mm_add_ps(acc0[i], acc1[i])).Sum();
+      for (index_t kk = kv; kk < k; ++kk) out[i] += a[i * lda + kk] * b[kk];
+    }
+  }
+};
+#endif  // MSHADOW_USE_SSE
+/*! \brief dst[:, j0:j0+nc] = SV(dst, scale * a * b[:, j0:j0+nc]), b is k x n */
+template<int M, typename SV, typename DType>
+inline void BlockNN(Tensor<cpu, 2, DType> dst, const DType *a, index_t lda,
+                    const Tensor<cpu, 2, DType> &b, index_t j0, index_t nc,
+                    DType scale) {
+  DType acc[kAccSize];
+  std::fill(acc, acc + M * nc, DType(0));
+  Kernel<M, DType>::NN(a, lda, b.size(0), b.dptr_ + j0, b.stride_, nc, acc, nc);
+  for (int i = 0; i < M; ++i) {
+    for (index_t j = 0; j < nc; ++j) {
+      SV::Save(dst[i][j0 + j], scale * acc[i * nc + j]);
+    }
+  }
+}
+/*! \brief dst[:, j] = SV(dst, scale * a * b[j]), b is n x k */
+template<int M, typename SV, typename DType>
+inline void ColumnNT(Tensor<cpu, 2, DType> dst, const DType *a, index_t lda,
+                     const Tensor<cpu, 2, DType> &b, index_t j, DType scale) {
+  DType out[M];
+  Kernel<M, DType>::NT(a, lda, b.size(1), b[j].dptr_, out);
+  for (int i = 0; i < M; ++i) SV::Save(dst[i][j], scale * out[i]);
+}
+/*!
+ * \brief dst = SV(dst, scale * a * op(b)), M rows of a
+ * \param a lhs, M x k with contiguous rows
+ * \param rtrans whether b is stored as n x k
+ */
+template<int M, typename SV, typename DType>
+inline void Run(Tensor<cpu, 2, DType> dst, const DType *a, index_t lda,
+                const Tensor<cpu, 2, DType> &b, bool rtrans, DType scale) {
+  const index_t n = dst.size(1);
+  #if defined(_OPENMP)
+  const double work = static_cast<double>(M) * b.shape_.Size();
+  #endif
+  if (rtrans) {
+    MSHADOW_OMP_PARALLEL_FOR_IF(work > MSHADOW_OMP_MIN_WORK)
+    for (ms_omp_uint j = 0; j < static_cast<ms_omp_uint>(n); ++j) {
+      ColumnNT<M, SV>(dst, a, lda, b, static_cast<index_t>(j), scale);
+    }
+  } else {
+    // the block is narrowed when there are not enough blocks for all threads
+    index_t width = kAccSize / M;
+    #if defined(_OPENMP)
+    if (work > MSHADOW_OMP_MIN_WORK) {
+      const index_t nthread = static_cast<index_t>(omp_get_max_threads());
+      width = std::min(width, std::max(static_cast<index_t>(64),
+                                       (n + nthread - 1) / nthread));
+    }
+    #endif
+    width = (width >> 2) << 2;
+    const index_t nblock = (n + width - 1) / width;
+    MSHADOW_OMP_PARALLEL_FOR_IF(work > MSHADOW_OMP_MIN_WORK)
+    for (ms_omp_uint bi = 0; bi < static_cast<ms_omp_uint>(nblock); ++bi) {
+      const index_t t = static_cast<index_t>(bi);
+      BlockNN<M, SV>(dst, a, lda, b, t * width,
+                     std::min(width, n - t * width), scale);
+    }
+  }
+}
+}  // namespace skinny
+/*!
+ * \brief dispatcher of the skinny products, the generic device has none
+ * \tparam SV saver type
+ * \tparam xpu device type
+ * \tparam DType data type
+ */
+template<typename SV, typename xpu, typename DType>
+struct SkinnyDot {
+  /*! \brief maximum number of rows of lhs that take the skinny kernels */
+  static const index_t kMaxRows = 8;
+  /*!
+   * \brief try to evaluate dst = SV(dst, scale * op(lhs) * op(rhs))
+   * \return whether the shape is skinny and the product is done
+   */
+  inline static bool Eval(Tensor<xpu, 2, DType> *p_dst,
+                          const Tensor<xpu, 2, DType> &lhs, bool ltrans,
+                          const Tensor<xpu, 2, DType> &rhs, bool rtrans,
+                          DType scale) {
+    return false;
+  }
+};
+template<typename SV, typename DType>
+struct SkinnyDot<SV, cpu, DType> {
+  static const index_t kMaxRows = 8;
+  inline static bool Eval(Tensor<cpu, 2, DType> *p_dst,
+                          const Tensor<cpu, 2, DType> &lhs, bool ltrans,
+                          const Tensor<cpu, 2, DType> &rhs, bool rtrans,
+                          DType scale) {
+    Tensor<cpu, 2, DType> &dst = *p_dst;
+    const index_t m = dst.size(0), n = dst.size(1);
+    const index_t k = ltrans ? lhs.size(0) : lhs.size(1);
+#if !MSHADOW_USE_SKINNY_DOT && (MSHADOW_USE_CBLAS || MSHADOW_USE_MKL)
+    return false;
+#endif
+    if (m == 0 || m > kMaxRows || n < m * 4) return false;
+    MSHADOW_TRACE_SCOPE("gemm_skinny", "blas", Shape3(m, k, n), 2.0 * m * k * n,
+                        sizeof(DType) * (lhs.MSize() + rhs.MSize() + dst.MSize()));
+    // the kernels need contiguous rows of lhs, transposed lhs is small to copy
+    std::vector<DType> buf;
+    const DType *a = lhs.dptr_;
+    index_t lda = lhs.stride_;
+    if (ltrans) {
+      buf.resize(m * k);
+      for (index_t i = 0; i < m; ++i) {
+        for (index_t j = 0; j < k; ++j) buf[i * k + j] = lhs[j][i];
+      }
+      a = k != 0 ? &buf[0] : NULL;
+      lda = k;
+    }
+    switch (m) {
+      case 1: skinny::Run<1, SV>(dst, a, lda, rhs, rtrans, scale); break;
+      case 2: skinny::Run<2, SV>(dst, a, lda, rhs, rtrans, scale); break;
+      case 3: skinny::Run<3, SV>(dst, a, lda, rhs, rtrans, scale); break;
+      case 4: skinny::Run<4, SV>(dst, a, lda, rhs, rtrans, scale); break;
+      case 5: skinny::Run<5, SV>(dst, a, lda, rhs, rtrans, scale); break;
+      case 6: skinny::Run<6, SV>(dst, a, lda, rhs, rtrans, scale); break;
+      case 7: skinny::Run<7, SV>(dst, a, lda, rhs, rtrans, scale); break;
+      default: skinny::Run<8, SV>(dst, a, lda, rhs, rtrans, scale); break;
+    }
+    return true;
+  }
+};
+}  // namespace expr
+}  // namespace mshadow
+#endif  // MSHADOW_DOT_SKINNY_INL_H_
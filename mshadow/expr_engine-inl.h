@@ -118,6 +118,22 @@ class Plan<BinaryMapExp<OP, TA, TB, DType, etype>, DType> {
   Plan<TA, DType> lhs_;
   Plan<TB, DType> rhs_;
 };
+// ternary expression
+template<typename OP, typename TA, typename TB, typename TC, int etype, typename DType>
+class Plan<TernaryMapExp<OP, TA, TB, TC, DType, etype>, DType> {
+ public:
+  explicit Plan(const Plan<TA, DType> &first, const Plan<TB, DType> &second,
+                const Plan<TC, DType> &third)
+      : first_(first), second_(second), third_(third) {}
+  MSHADOW_XINLINE DType Eval(index_t y, index_t x) const {
+    return OP::Map(first_.Eval(y, x), second_.Eval(y, x), third_.Eval(y, x));
+  }
+
+ private:
+  Plan<TA, DType> first_;
+  Plan<TB, DType> second_;
+  Plan<TC, DType> third_;
+};
 // unary expression
 template<typename OP, typename TA, int etype, typename DType>
 class Plan<UnaryMapExp<OP, TA, DType, etype>, DType> {
@@ -201,6 +217,159 @@ MakePlan(const BinaryMapExp<OP, TA, TB, DType, etype> &e) {
   return Plan<BinaryMapExp<OP, TA, TB, DType, etype>,
               DType>(MakePlan(e.lhs_), MakePlan(e.rhs_));
 }
+
+template<typename OP, typename TA, typename TB, typename TC, typename DType, int etype>
+inline Plan<TernaryMapExp<OP, TA, TB, TC, DType, etype>, DType>
+MakePlan(const TernaryMapExp<OP, TA, TB, TC, DType, etype> &e) {
+  return Plan<TernaryMapExp<OP, TA, TB, TC, DType, etype>,
+              DType>(MakePlan(e.first_), MakePlan(e.second_), MakePlan(e.third_));
+}
+#if MSHADOW_USE_FMA
+//----------------------------------------------------------------
+// Fused multiply-add: the plans of OP(a * b, c), OP(c, a * b) and
+// OP(a * b, c * d) keep the factors apart, so that plus and minus of
+// float and double round the product and the sum only once
+//----------------------------------------------------------------
+/*!
+ * \brief Map(a, b, c) = OP(a * b, c), RMap(c, a, b) = OP(c, a * b),
+ *  other operators and types are evaluated as they are written
+ */
+template<typename OP>
+struct FusedMulAdd {
+  template<typename DType>
+  MSHADOW_XINLINE static DType Map(DType a, DType b, DType c) {
+    return OP::Map(op::mul::Map(a, b), c);
+  }
+  template<typename DType>
+  MSHADOW_XINLINE static DType RMap(DType c, DType a, DType b) {
+    return OP::Map(c, op::mul::Map(a, b));
+  }
+};
+template<>
+struct FusedMulAdd<op::plus> {
+  template<typename DType>
+  MSHADOW_XINLINE static DType Map(DType a, DType b, DType c) {
+    return op::plus::Map(op::mul::Map(a, b), c);
+  }
+  MSHADOW_XINLINE static float Map(float a, float b, float c) {
+    return std::fma(a, b, c);
+  }
+  MSHADOW_XINLINE static double Map(double a, double b, double c) {
+    return std::fma(a, b, c);
+  }
+  template<typename DType>
+  MSHADOW_XINLINE static DType RMap(DType c, DType a, DType b) {
+    return Map(a, b, c);
+  }
+};
+template<>
+struct FusedMulAdd<op::minus> {
+  template<typename DType>
+  MSHADOW_XINLINE static DType Map(DType a, DType b, DType c) {
+    return op::minus::Map(op::mul::Map(a, b), c);
+  }
+  MSHADOW_XINLINE static float Map(float a, float b, float c) {
+    return std::fma(a, b, -c);
+  }
+  MSHADOW_XINLINE static double Map(double a, double b, double c) {
+    return std::fma(a, b, -c);
+  }
+  template<typename DType>
+  MSHADOW_XINLINE static DType RMap(DType c, DType a, DType b) {
+    return op::minus::Map(c, op::mul::Map(a, b));
+  }
+  MSHADOW_XINLINE static float RMap(float c, float a, float b) {
+    return std::fma(-a, b, c);
+  }
+  MSHADOW_XINLINE static double RMap(double c, double a, double b) {
+    return std::fma(-a, b, c);
+  }
+};
+// OP(a * b, c)
+template<typename OP, typename TA, typename TB, typename TC,
+         typename DType, int ea, int etype>
+class Plan<BinaryMapExp<OP, BinaryMapExp<op::mul, TA, TB, DType, ea>,
+                        TC, DType, etype>, DType> {
+ public:
+  Plan(const Plan<TA, DType> &a, const Plan<TB, DType> &b,
+       const Plan<TC, DType> &c)
+      : a_(a), b_(b), c_(c) {}
+  MSHADOW_XINLINE DType Eval(index_t y, index_t x) const {
+    return FusedMulAdd<OP>::Map(a_.Eval(y, x), b_.Eval(y, x), c_.Eval(y, x));
+  }
+
+ private:
+  Plan<TA, DType> a_;
+  Plan<TB, DType> b_;
+  Plan<TC, DType> c_;
+};
+// OP(c, a * b)
+template<typename OP, typename TA, typename TB, typename TC,
+         typename DType, int ea, int etype>
+class Plan<BinaryMapExp<OP, TC, BinaryMapExp<op::mul, TA, TB, DType, ea>,
+                        DType, etype>, DType> {
+ public:
+  Plan(const Plan<TC, DType> &c, const Plan<TA, DType> &a,
+       const Plan<TB, DType> &b)
+      : c_(c), a_(a), b_(b) {}
+  MSHADOW_XINLINE DType Eval(index_t y, index_t x) const {
+    return FusedMulAdd<OP>::RMap(c_.Eval(y, x), a_.Eval(y, x), b_.Eval(y, x));
+  }
+
+ private:
+  Plan<TC, DType> c_;
+  Plan<TA, DType> a_;
+  Plan<TB, DType> b_;
+};
+// OP(a * b, c * d), only the left product is fused
+template<typename OP, typename TA, typename TB, typename TC, typename TD,
+         typename DType, int ea, int ec, int etype>
+class Plan<BinaryMapExp<OP, BinaryMapExp<op::mul, TA, TB, DType, ea>,
+                        BinaryMapExp<op::mul, TC, TD, DType, ec>, DType, etype>, DType> {
+ public:
+  Plan(const Plan<TA, DType> &a, const Plan<TB, DType> &b,
+       const Plan<BinaryMapExp<op::mul, TC, TD, DType, ec>, DType> &cd)
+      : a_(a), b_(b), cd_(cd) {}
+  MSHADOW_XINLINE DType Eval(index_t y, index_t x) const {
+    return FusedMulAdd<OP>::Map(a_.Eval(y, x), b_.Eval(y, x), cd_.Eval(y, x));
+  }
+
+ private:
+  Plan<TA, DType> a_;
+  Plan<TB, DType> b_;
+  Plan<BinaryMapExp<op::mul, TC, TD, DType, ec>, DType> cd_;
+};
+template<typename OP, typename TA, typename TB, typename TC,
+         typename DType, int ea, int etype>
+inline Plan<BinaryMapExp<OP, BinaryMapExp<op::mul, TA, TB, DType, ea>,
+                         TC, DType, etype>, DType>
+MakePlan(const BinaryMapExp<OP, BinaryMapExp<op::mul, TA, TB, DType, ea>,
+                            TC, DType, etype> &e) {
+  return Plan<BinaryMapExp<OP, BinaryMapExp<op::mul, TA, TB, DType, ea>,
+                           TC, DType, etype>, DType>
+      (MakePlan(e.lhs_.lhs_), MakePlan(e.lhs_.rhs_), MakePlan(e.rhs_));
+}
+template<typename OP, typename TA, typename TB, typename TC,
+         typename DType, int ea, int etype>
+inline Plan<BinaryMapExp<OP, TC, BinaryMapExp<op::mul, TA, TB, DType, ea>,
+                         DType, etype>, DType>
+MakePlan(const BinaryMapExp<OP, TC, BinaryMapExp<op::mul, TA, TB, DType, ea>,
+                            DType, etype> &e) {
+  return Plan<BinaryMapExp<OP, TC, BinaryMapExp<op::mul, TA, TB, DType, ea>,
+                           DType, etype>, DType>
+      (MakePlan(e.lhs_), MakePlan(e.rhs_.lhs_), MakePlan(e.rhs_.rhs_));
+}
+template<typename OP, typename TA, typename TB, typename TC, typename TD,
+         typename DType, int ea, int ec, int etype>
+inline Plan<BinaryMapExp<OP, BinaryMapExp<op::mul, TA, TB, DType, ea>,
+                         BinaryMapExp<op::mul, TC, TD, DType, ec>, DType, etype>, DType>
+MakePlan(const BinaryMapExp<OP, BinaryMapExp<op::mul, TA, TB, DType, ea>,
+                            BinaryMapExp<op::mul, TC, TD, DType, ec>, DType, etype> &e) {
+  return Plan<BinaryMapExp<OP, BinaryMapExp<op::mul, TA, TB, DType, ea>,
+                           BinaryMapExp<op::mul, TC, TD, DType, ec>, DType, etype>, DType>
+      (MakePlan(e.lhs_.lhs_), MakePlan(e.lhs_.rhs_), MakePlan(e.rhs_));
+}
+#endif  // MSHADOW_USE_FMA
 //----------------------------------------------------------------
 // Static Type inference and Type Checking
 //----------------------------------------------------------------
@@ -257,6 +426,19 @@ struct ExpInfo<BinaryMapExp<OP, TA, TB, DType, etype> > {
        ((kDimRhs == 0 || kDimLhs == kDimRhs) ? kDimLhs : -1)) : -1;
   static const int kDevMask = ExpInfo<TA>::kDevMask & ExpInfo<TB>::kDevMask;
 };
+template<typename OP, typename TA, typename TB, typename TC, typename DType, int etype>
+struct ExpInfo<TernaryMapExp<OP, TA, TB, TC, DType, etype> > {
+  static const int kDimA = ExpInfo<TA>::kDim;
+  static const int kDimB = ExpInfo<TB>::kDim;
+  static const int kDimC = ExpInfo<TC>::kDim;
+  // dimension of the operands that are not scalar, -1 if they mismatch
+  static const int kDimAB = (kDimA >= 0 && kDimB >= 0) ?\
+      (kDimA == 0 ? kDimB : ((kDimB == 0 || kDimA == kDimB) ? kDimA : -1)) : -1;
+  static const int kDim = (kDimAB >= 0 && kDimC >= 0) ?\
+      (kDimAB == 0 ? kDimC : ((kDimC == 0 || kDimAB == kDimC) ? kDimAB : -1)) : -1;
+  static const int kDevMask = ExpInfo<TA>::kDevMask & ExpInfo<TB>::kDevMask &
+      ExpInfo<TC>::kDevMask;
+};
 /*! \brief template to do type check */
 template<typename Device, int dim, typename DType, typename E>
 struct TypeCheck {
@@ -365,6 +547,23 @@ struct ShapeCheck<dim, BinaryMapExp<OP, TA, TB, DType, etype> > {
     return shape1;
   }
 };
+template<int dim, typename OP, typename TA, typename TB, typename TC,
+         typename DType, int etype>
+struct ShapeCheck<dim, TernaryMapExp<OP, TA, TB, TC, DType, etype> > {
+  inline static Shape<dim>
+  Check(const TernaryMapExp<OP, TA, TB, TC, DType, etype> &t) {
+    Shape<dim> shape = ShapeCheck<dim, TA>::Check(t.first_);
+    Shape<dim> shape2 = ShapeCheck<dim, TB>::Check(t.second_);
+    Shape<dim> shape3 = ShapeCheck<dim, TC>::Check(t.third_);
+    if (shape[0] == 0) shape = shape2;
+    if (shape[0] == 0) shape = shape3;
+    CHECK(shape2[0] == 0 || shape2 == shape)
+      << "TernaryMapExp: Shapes of operands are not the same";
+    CHECK(shape3[0] == 0 || shape3 == shape)
+      << "TernaryMapExp: Shapes of operands are not the same";
+    return shape;
+  }
+};
 }  // namespace expr
 }  // namespace mshadow
 // include definition of dot engine
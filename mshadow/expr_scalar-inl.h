@@ -125,6 +125,31 @@ inline BinaryMapExp<op::div, ScalarExp<MSHADOW_SCALAR_>, TB,
 operator/(const ScalarExp<MSHADOW_SCALAR_> &lhs, const Exp<TB, MSHADOW_SCALAR_, tb> &rhs) {
   return MakeExp<op::div>(lhs, rhs);
 }
+// ternary operators with constants
+/*! \brief select with a constant where cond is 0 */
+template<typename TC, typename TA, int tc, int ta>
+inline TernaryMapExp<op::where, TC, TA, ScalarExp<MSHADOW_SCALAR_>,
+                     MSHADOW_SCALAR_, (tc|ta|type::kMapper)>
+where(const Exp<TC, MSHADOW_SCALAR_, tc> &cond, const Exp<TA, MSHADOW_SCALAR_, ta> &a,
+      const ScalarExp<MSHADOW_SCALAR_> &b) {
+  return MakeExp<op::where>(cond, a, b);
+}
+/*! \brief select with a constant where cond is not 0 */
+template<typename TC, typename TB, int tc, int tb>
+inline TernaryMapExp<op::where, TC, ScalarExp<MSHADOW_SCALAR_>, TB,
+                     MSHADOW_SCALAR_, (tc|tb|type::kMapper)>
+where(const Exp<TC, MSHADOW_SCALAR_, tc> &cond, const ScalarExp<MSHADOW_SCALAR_> &a,
+      const Exp<TB, MSHADOW_SCALAR_, tb> &b) {
+  return MakeExp<op::where>(cond, a, b);
+}
+/*! \brief clip into constant bounds */
+template<typename TA, int ta>
+inline TernaryMapExp<op::clip, TA, ScalarExp<MSHADOW_SCALAR_>, ScalarExp<MSHADOW_SCALAR_>,
+                     MSHADOW_SCALAR_, (ta|type::kMapper)>
+clip(const Exp<TA, MSHADOW_SCALAR_, ta> &src, const ScalarExp<MSHADOW_SCALAR_> &lo,
+     const ScalarExp<MSHADOW_SCALAR_> &hi) {
+  return MakeExp<op::clip>(src, lo, hi);
+}
 }  // namespace expr
 }  // namespace mshadow
 #endif  // MSHADOW_EXPR_SCALAR_INL_H_
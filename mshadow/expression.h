@@ -350,6 +350,81 @@ inline UnaryMapExp<OP, TA, DType, (ta|type::kMapper)>
 F(const Exp<TA, DType, ta> &src) {
   return MakeExp<OP>(src);
 }
+//---------------
+// TernaryMapExp
+// --------------
+/*!
+ * \brief ternary map expression op(first, second, third)
+ * \tparam OP operator
+ * \tparam TA type of first operand
+ * \tparam TB type of second operand
+ * \tparam TC type of third operand
+ * \tparam etype expression type, sa namespace::type
+ */
+template<typename OP, typename TA, typename TB, typename TC, typename DType, int etype>
+struct TernaryMapExp: public Exp<TernaryMapExp<OP, TA, TB, TC, DType, etype>,
+                                 DType, etype> {
+  /*! \brief first operand */
+  const TA &first_;
+  /*! \brief second operand */
+  const TB &second_;
+  /*! \brief third operand */
+  const TC &third_;
+  /*! \brief constructor */
+  explicit TernaryMapExp(const TA &first, const TB &second, const TC &third)
+      : first_(first), second_(second), third_(third) {}
+};
+
+/*! \brief make expression */
+template<typename OP, typename TA, typename TB, typename TC, typename DType,
+         int ta, int tb, int tc>
+inline TernaryMapExp<OP, TA, TB, TC, DType, (ta|tb|tc|type::kMapper)>
+MakeExp(const Exp<TA, DType, ta> &first, const Exp<TB, DType, tb> &second,
+        const Exp<TC, DType, tc> &third) {
+  return TernaryMapExp<OP, TA, TB, TC, DType,
+                       (ta|tb|tc|type::kMapper)>(first.self(), second.self(), third.self());
+}
+/*!
+ * \brief short hand for MakeExp, usage F<op>(first, second, third),
+ *  create a ternary operation expression
+ * \param first first operand
+ * \param second second operand
+ * \param third third operand
+ * \return the result expression
+ * \tparam ternary operator
+ * \sa mshadow::op
+ */
+template<typename OP, typename TA, typename TB, typename TC, typename DType,
+         int ta, int tb, int tc>
+inline TernaryMapExp<OP, TA, TB, TC, DType, (ta|tb|tc|type::kMapper)>
+F(const Exp<TA, DType, ta> &first, const Exp<TB, DType, tb> &second,
+  const Exp<TC, DType, tc> &third) {
+  return MakeExp<OP>(first, second, third);
+}
+/*!
+ * \brief elementwise select, a where cond is not 0, else b
+ * \param cond condition, e.g. F<op::gt>(x, scalar(0.0f))
+ * \param a value where cond is not 0
+ * \param b value where cond is 0
+ */
+template<typename TC, typename TA, typename TB, typename DType, int tc, int ta, int tb>
+inline TernaryMapExp<op::where, TC, TA, TB, DType, (tc|ta|tb|type::kMapper)>
+where(const Exp<TC, DType, tc> &cond, const Exp<TA, DType, ta> &a,
+      const Exp<TB, DType, tb> &b) {
+  return MakeExp<op::where>(cond, a, b);
+}
+/*!
+ * \brief clip src elementwise into [lo, hi]
+ * \param src source expression
+ * \param lo lower bound
+ * \param hi upper bound
+ */
+template<typename TA, typename TB, typename TC, typename DType, int ta, int tb, int tc>
+inline TernaryMapExp<op::clip, TA, TB, TC, DType, (ta|tb|tc|type::kMapper)>
+clip(const Exp<TA, DType, ta> &src, const Exp<TB, DType, tb> &lo,
+     const Exp<TC, DType, tc> &hi) {
+  return MakeExp<op::clip>(src, lo, hi);
+}
 }  // namespace expr
 }  // namespace mshadow
 #endif  // MSHADOW_EXPRESSION_H_
@@ -22,4 +22,12 @@
 #include "./extension/crop.h"
 #include "./extension/mirror.h"
 #include "./extension/concat.h"
+#include "./extension/resize.h"
+#include "./extension/batch_norm.h"
+#include "./extension/layer_norm.h"
+#include "./extension/take.h"
+#include "./extension/arg_reduce.h"
+#include "./extension/group_conv.h"
+#include "./extension/rnn_cell.h"
+#include "./extension/optimizer.h"
 #endif  // MSHADOW_EXTENSION_H_
@@ -0,0 +1,286 @@
+/*!
+ *  Copyright (c) 2014 by Contributors
+ * \file arg_reduce.h
+ * \brief argmax/argmin along an axis and top-k of rows
+ * \author Tianqi Chen
+ */
+#ifndef MSHADOW_EXTENSION_ARG_REDUCE_H_
+#define MSHADOW_EXTENSION_ARG_REDUCE_H_
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include "../extension.h"
+#include "../sse-inl.h"
+
+namespace mshadow {
+namespace argreduce {
+/*!
+ * \brief comparison of a reducer that has an arg version,
+ *  only red::maximum and red::minimum are defined
+ */
+template<typename Reducer>
+struct Compare;
+template<>
+struct Compare<red::maximum> {
+  /*! \brief whether a is strictly better than b */
+  template<typename DType>
+  MSHADOW_XINLINE static bool Better(DType a, DType b) {
+    return a > b;
+  }
+};
+template<>
+struct Compare<red::minimum> {
+  template<typename DType>
+  MSHADOW_XINLINE static bool Better(DType a, DType b) {
+    return a < b;
+  }
+};
+/*!
+ * \brief index of the first best element of a contiguous row, in the order
+ *  of the plan: an element only replaces the best when it compares better,
+ *  so NaN is only chosen as the first element
+ */
+template<typename Reducer, typename DType>
+inline index_t RowScalar(const DType *x, index_t n) {
+  index_t best = 0;
+  for (index_t i = 1; i < n; ++i) {
+    if (Compare<Reducer>::Better(x[i], x[best])) best = i;
+  }
+  return best;
+}
+/*! \brief index of the first best element of a contiguous row, generic version */
+template<typename Reducer, typename DType>
+struct Kernel {
+  inline static index_t Row(const DType *x, index_t n) {
+    return RowScalar<Reducer>(x, n);
+  }
+};
+/*! \brief order of (value, index) in top-k, larger value then smaller index first */
+template<typename DType>
+struct EntryBetter {
+  inline bool operator()(const std::pair<DType, index_t> &a,
+                         const std::pair<DType, index_t> &b) const {
+    return a.first > b.first || (a.first == b.first && a.second < b.second);
+  }
+};
+#if MSHADOW_USE_SSE
+/*! \brief lane-wise strict comparison of SSE */
+template<typename Reducer>
+struct SSECompare;
+template<>
+struct SSECompare<red::maximum> {
+  inline static __m128 Better(__m128 a, __m128 b) {
+    return _mm_cmpgt_ps(a, b);
+  }
+};
+template<>
+struct SSECompare<red::minimum> {
+  inline static __m128 Better(__m128 a, __m128 b) {
+    return _mm_cmplt_ps(a, b);
+  }
+};
+template<typename Reducer>
+struct Kernel<Reducer, float> {
+  inline static index_t Row(const float *x, index_t n) {
+    if (n < 8) return RowScalar<Reducer>(x, n);
+    // each lane keeps its first best value and index, blended by the compare
+    // mask, two sets of lanes break the dependency on the best values.
+    // A lane that starts with NaN would keep it, unlike the scalar order,
+    // so rows with NaN are done again by the scalar loop
+    const index_t nv = (n >> 3) << 3;
+    __m128 vbest[2] = {_mm_loadu_ps(x), _mm_loadu_ps(x + 4)};
+    __m128 vnan[2] = {_mm_cmpunord_ps(vbest[0], vbest[0]),
+                      _mm_cmpunord_ps(vbest[1], vbest[1])};
+    __m128i ibest[2] = {_mm_set_epi32(3, 2, 1, 0), _mm_set_epi32(7, 6, 5, 4)};
+    __m128i icur[2] = {ibest[0], ibest[1]};
+    const __m128i istep = _mm_set1_epi32(8);
+    for (index_t i = 8; i < nv; i += 8) {
+      for (int t = 0; t < 2; ++t) {
+        const __m128 v = _mm_loadu_ps(x + i + t * 4);
+        vnan[t] = _mm_or_ps(vnan[t], _mm_cmpunord_ps(v, v));
+        icur[t] = _mm_add_epi32(icur[t], istep);
+        const __m128 mask = SSECompare<Reducer>::Better(v, vbest[t]);
+        const __m128i imask = _mm_castps_si128(mask);
+        vbest[t] = _mm_or_ps(_mm_and_ps(mask, v), _mm_andnot_ps(mask, vbest[t]));
+        ibest[t] = _mm_or_si128(_mm_and_si128(imask, icur[t]),
+                                _mm_andnot_si128(imask, ibest[t]));
+      }
+    }
+    if (_mm_movemask_ps(_mm_or_ps(vnan[0], vnan[1])) != 0) {
+      return RowScalar<Reducer>(x, n);
+    }
+    float lval[8];
+    int lidx[8];
+    for (int t = 0; t < 2; ++t) {
+      _mm_storeu_ps(lval + t * 4, vbest[t]);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(lidx + t * 4), ibest[t]);
+    }
+    index_t best = static_cast<index_t>(lidx[0]);
+    for (int k = 1; k < 8; ++k) {
+      const index_t idx = static_cast<index_t>(lidx[k]);
+      if (Compare<Reducer>::Better(lval[k], x[best]) ||
+          (lval[k] == x[best] && idx < best)) {
+        best = idx;
+      }
+    }
+    for (index_t i = nv; i < n; ++i) {
+      if (Compare<Reducer>::Better(x[i], x[best])) best = i;
+    }
+    return best;
+  }
+};
+#endif  // MSHADOW_USE_SSE
+}  // namespace argreduce
+
+namespace expr {
+/*!
+ * \brief index of the best element along an axis, e.g. argmax
+ * \tparam Reducer red::maximum or red::minimum
+ * \tparam SrcExp type of source expression
+ * \tparam DType the type of elements, the index is stored as DType
+ * \tparam srcdim dimension of source
+ * \tparam axis the axis to reduce
+ */
+template<typename Reducer, typename SrcExp, typename DType, int srcdim, int axis>
+struct ArgReduceExp:
+      public MakeTensorExp<ArgReduceExp<Reducer, SrcExp, DType, srcdim, axis>,
+                           SrcExp, srcdim - 1, DType> {
+  /*! \brief source operand */
+  const SrcExp &src_;
+  /*! \brief length of the reduced axis */
+  index_t len_;
+  /*! \brief product of the dimensions after axis */
+  index_t inner_;
+  /*! \brief size of the last dimension of source */
+  index_t src_last_;
+  /*! \brief constructor */
+  explicit ArgReduceExp(const SrcExp &src) : src_(src) {
+    Shape<srcdim> sshape = ShapeCheck<srcdim, SrcExp>::Check(src_);
+    CHECK_NE(sshape[axis], 0U) << "arg reduction over empty axis";
+    len_ = sshape[axis];
+    inner_ = sshape.ProdShape(axis + 1, srcdim);
+    src_last_ = sshape[srcdim - 1];
+    for (int i = 0, j = 0; i < srcdim; ++i) {
+      if (i != axis) this->shape_[j++] = sshape[i];
+    }
+  }
+};
+/*!
+ * \brief index of the maximum along an axis, the first one when tied
+ * \param src source expression
+ * \return expression of one dimension less, index stored as DType
+ * \tparam axis the axis to reduce
+ * \tparam SrcExp type of source expression
+ * \tparam DType the type of elements
+ * \tparam etype type of expression
+ */
+template<int axis, typename SrcExp, typename DType, int etype>
+inline ArgReduceExp<red::maximum, SrcExp, DType, ExpInfo<SrcExp>::kDim, axis>
+argmax(const Exp<SrcExp, DType, etype> &src) {
+  TypeCheckPass<ExpInfo<SrcExp>::kDim >= 2 && axis < ExpInfo<SrcExp>::kDim>
+      ::Error_Expression_Does_Not_Meet_Dimension_Req();
+  return ArgReduceExp<red::maximum, SrcExp, DType,
+                      ExpInfo<SrcExp>::kDim, axis>(src.self());
+}
+/*!
+ * \brief index of the minimum along an axis, the first one when tied
+ * \param src source expression
+ * \return expression of one dimension less, index stored as DType
+ * \tparam axis the axis to reduce
+ * \tparam SrcExp type of source expression
+ * \tparam DType the type of elements
+ * \tparam etype type of expression
+ */
+template<int axis, typename SrcExp, typename DType, int etype>
+inline ArgReduceExp<red::minimum, SrcExp, DType, ExpInfo<SrcExp>::kDim, axis>
+argmin(const Exp<SrcExp, DType, etype> &src) {
+  TypeCheckPass<ExpInfo<SrcExp>::kDim >= 2 && axis < ExpInfo<SrcExp>::kDim>
+      ::Error_Expression_Does_Not_Meet_Dimension_Req();
+  return ArgReduceExp<red::minimum, SrcExp, DType,
+                      ExpInfo<SrcExp>::kDim, axis>(src.self());
+}
+//----------------------
+// Execution plan
+//----------------------
+template<typename Reducer, typename SrcExp, typename DType, int srcdim, int axis>
+struct Plan<ArgReduceExp<Reducer, SrcExp, DType, srcdim, axis>, DType> {
+ public:
+  explicit Plan(const ArgReduceExp<Reducer, SrcExp, DType, srcdim, axis> &e)
+      : src_(MakePlan(e.src_)), len_(e.len_), inner_(e.inner_),
+        src_last_(e.src_last_), last_(e.shape_[srcdim - 2]) {}
+  MSHADOW_XINLINE DType Eval(index_t i, index_t j) const {
+    const index_t o = i * last_ + j;
+    const index_t base = (o / inner_) * len_ * inner_ + o % inner_;
+    index_t best = 0;
+    DType vbest = src_.Eval(base / src_last_, base % src_last_);
+    for (index_t k = 1; k < len_; ++k) {
+      const index_t s = base + k * inner_;
+      const DType v = src_.Eval(s / src_last_, s % src_last_);
+      if (argreduce::Compare<Reducer>::Better(v, vbest)) {
+        vbest = v; best = k;
+      }
+    }
+    return static_cast<DType>(best);
+  }
+
+ private:
+  Plan<SrcExp, DType> src_;
+  const index_t len_, inner_, src_last_, last_;
+};
+}  // namespace expr
+/*!
+ * \brief the k largest elements of each row, k is values.size(1)
+ *  values[i] is sorted in descending order, ties keep the earlier element
+ * \param values output values of shape (nrow, k)
+ * \param indices output column index of values, can be of a different type, e.g. int
+ * \param src source of shape (nrow, ncol)
+ * \tparam DType the type of elements
+ * \tparam IType the type of index
+ */
+template<typename DType, typename IType>
+inline void TopK(Tensor<cpu, 2, DType> values,
+                 Tensor<cpu, 2, IType> indices,
+                 const Tensor<cpu, 2, DType> &src) {
+  const index_t nrow = src.size(0), ncol = src.size(1), k = values.size(1);
+  CHECK(values.size(0) == nrow && indices.shape_ == values.shape_)
+    << "TopK: shape mismatch";
+  CHECK(k != 0 && k <= ncol) << "TopK: k must be in [1, ncol]";
+  MSHADOW_TRACE_SCOPE("TopK", "op", src.shape_, src.shape_.Size(),
+                      sizeof(DType) * src.shape_.Size());
+  typedef std::pair<DType, index_t> Entry;
+  #if defined(_OPENMP)
+  #pragma omp parallel if (src.shape_.Size() > MSHADOW_OMP_MIN_SIZE)
+  #endif
+  {
+    // min heap of the current k best, the top is the worst of them
+    std::vector<Entry> heap(k);
+    const argreduce::EntryBetter<DType> better;
+    #if defined(_OPENMP)
+    #pragma omp for schedule(static)
+    #endif
+    for (index_t r = 0; r < nrow; ++r) {
+      const DType *x = src[r].dptr_;
+      if (k == 1) {
+        const index_t best = argreduce::Kernel<red::maximum, DType>::Row(x, ncol);
+        values[r][0] = x[best];
+        indices[r][0] = static_cast<IType>(best);
+        continue;
+      }
+      for (index_t i = 0; i < k; ++i) heap[i] = Entry(x[i], i);
+      std::make_heap(heap.begin(), heap.end(), better);
+      for (index_t i = k; i < ncol; ++i) {
+        if (!(x[i] > heap[0].first)) continue;
+        std::pop_heap(heap.begin(), heap.end(), better);
+        heap[k - 1] = Entry(x[i], i);
+        std::push_heap(heap.begin(), heap.end(), better);
+      }
+      std::sort_heap(heap.begin(), heap.end(), better);
+      for (index_t i = 0; i < k; ++i) {
+        values[r][i] = heap[i].first;
+        indices[r][i] = static_cast<IType>(heap[i].second);
+      }
+    }
+  }
+}
+}  // namespace mshadow
+#endif  // MSHADOW_EXTENSION_ARG_REDUCE_H_
@@ -0,0 +1,305 @@
+/*!
+ *  Copyright (c) 2014 by Contributors
+ * \file batch_norm.h
+ * \brief batch normalization over dimension 1 of a 4D tensor (batch, channel, y, x).
+ *  Composing batch norm from sumall_except_dim, broadcast and elementwise
+ *  expressions takes five or more passes over the data. Here the forward
+ *  computes the statistics in one pass and normalizes in a second, the
+ *  backward takes two passes, and inference is one multiply-add.
+ *  Channels are processed in parallel when OpenMP is enabled.
+ * \author Tianqi Chen
+ */
+#ifndef MSHADOW_EXTENSION_BATCH_NORM_H_
+#define MSHADOW_EXTENSION_BATCH_NORM_H_
+#include <algorithm>
+#include <cmath>
+#include "../extension.h"
+#include "../sse-inl.h"
+
+namespace mshadow {
+namespace batchnorm {
+/*! \brief number of elements whose statistics are computed at once */
+const index_t kChunk = 4096;
+/*! \brief kernels on contiguous data, generic version */
+template<typename DType>
+struct Kernel {
+  /*! \return sum of x[0:n] */
+  inline static DType Sum(const DType *x, index_t n) {
+    DType s = 0;
+    for (index_t i = 0; i < n; ++i) s += x[i];
+    return s;
+  }
+  /*! \return sum of (x[i] - mean)^2 */
+  inline static DType SumSqDev(const DType *x, index_t n, DType mean) {
+    DType s = 0;
+    for (index_t i = 0; i < n; ++i) s += (x[i] - mean) * (x[i] - mean);
+    return s;
+  }
+  /*! \brief dst = x * a + b */
+  inline static void ScaleShift(DType *dst, const DType *x, index_t n, DType a, DType b) {
+    for (index_t i = 0; i < n; ++i) dst[i] = x[i] * a + b;
+  }
+  /*! \brief sum_dy += sum of dy, sum_dyx += sum of dy * (x - mean) */
+  inline static void GradSum(const DType *dy, const DType *x, index_t n, DType mean,
+                             DType *sum_dy, DType *sum_dyx) {
+    DType s0 = 0, s1 = 0;
+    for (index_t i = 0; i < n; ++i) {
+      s0 += dy[i]; s1 += dy[i] * (x[i] - mean);
+    }
+    *sum_dy += s0; *sum_dyx += s1;
+  }
+  /*! \brief dst = dy * a + x * b + c */
+  inline static void Combine(DType *dst, const DType *dy, const DType *x, index_t n,
+                             DType a, DType b, DType c) {
+    for (index_t i = 0; i < n; ++i) dst[i] = dy[i] * a + x[i] * b + c;
+  }
+};
+#if MSHADOW_USE_SSE
+// the data of a channel is rarely 16 byte aligned, unaligned load is used
+template<>
+struct Kernel<float> {
+  inline static float Sum(const float *x, index_t n) {
+    const index_t nv = (n >> 2) << 2;
+    __m128 s = _mm_setzero_ps();
+    for (index_t i = 0; i < nv; i += 4) s = _mm_add_ps(s, _mm_loadu_ps(x + i));
+    float ret = sse2::FVec<float>(s).Sum();
+    for (index_t i = nv; i < n; ++i) ret += x[i];
+    return ret;
+  }
+  inline static float SumSqDev(const float *x, index_t n, float mean) {
+    const index_t nv = (n >> 2) << 2;
+    const __m128 vm = _mm_set1_ps(mean);
+    __m128 s = _mm_setzero_ps();
+    for (index_t i = 0; i < nv; i += 4) {
+      const __m128 d = _mm_sub_ps(_mm_loadu_ps(x + i), vm);
+      s = _mm_add_ps(s, _mm_mul_ps(d, d));
+    }
+    float ret = sse2::FVec<float>(s).Sum();
+    for (index_t i = nv; i < n; ++i) ret += (x[i] - mean) * (x[i] - mean);
+    return ret;
+  }
+  inline static void ScaleShift(float *dst, const float *x, index_t n, float a, float b) {
+    const index_t nv = (n >> 2) << 2;
+    const __m128 va = _mm_set1_ps(a), vb = _mm_set1_ps(b);
+    for (index_t i = 0; i < nv; i += 4) {
+      _mm_storeu_ps(dst + i, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(x + i), va), vb));
+    }
+    for (index_t i = nv; i < n; ++i) dst[i] = x[i] * a + b;
+  }
+  inline static void GradSum(const float *dy, const float *x, index_t n, float mean,
+                             float *sum_dy, float *sum_dyx) {
+    const index_t nv = (n >> 2) << 2;
+    const __m128 vm = _mm_set1_ps(mean);
+    __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps();
+    for (index_t i = 0; i < nv; i += 4) {
+      const __m128 g = _mm_loadu_ps(dy + i);
+      s0 = _mm_add_ps(s0, g);
+      s1 = _mm_add_ps(s1, _mm_mul_ps(g, _mm_sub_ps(_mm_loadu_ps(x + i), vm)));
+    }
+    float r0 = sse2::FVec<float>(s0).Sum(), r1 = sse2::FVec<float>(s1).Sum();
+    for (index_t i = nv; i < n; ++i) {
+      r0 += dy[i]; r1 += dy[i] * (x[i] - mean);
+    }
+    *sum_dy += r0; *sum_dyx += r1;
+  }
+  inline static void Combine(float *dst, const float *dy, const float *x, index_t n,
+                             float a, float b, float c) {
+    const index_t nv = (n >> 2) << 2;
+    const __m128 va = _mm_set1_ps(a), vb = _mm_set1_ps(b), vc = _mm_set1_ps(c);
+    for (index_t i = 0; i < nv; i += 4) {
+      const __m128 r = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(dy + i), va),
+                                  _mm_mul_ps(_mm_loadu_ps(x + i), vb));
+      _mm_storeu_ps(dst + i, _mm_add_ps(r, vc));
+    }
+    for (index_t i = nv; i < n; ++i) dst[i] = dy[i] * a + x[i] * b + c;
+  }
+};
+#endif  // MSHADOW_USE_SSE
+/*!
+ * \brief the contiguous segments of one channel of one image, a whole
+ *  HxW plane when the tensors have no padding, otherwise one row
+ */
+struct Segments {
+  /*! \brief number of segments and length of each segment */
+  index_t nseg, len;
+  Segments(const Shape<4> &shape, bool flat)
+      : nseg(flat ? 1 : shape[2]), len(flat ? shape[2] * shape[3] : shape[3]) {}
+  /*! \return pointer to segment s of plane (n, c) */
+  template<typename DType>
+  inline DType *Get(const Tensor<cpu, 4, DType> &t, index_t n, index_t c, index_t s) const {
+    return t.dptr_ + ((n * t.size(1) + c) * t.size(2) + s) * t.stride_;
+  }
+};
+/*!
+ * \brief running statistics of a channel, merged chunk by chunk with
+ *  the parallel form of the Welford update, which does not lose
+ *  precision as the naive sum of squares does
+ */
+struct Stats {
+  double count, mean, m2;
+  Stats(void) : count(0), mean(0), m2(0) {}
+  /*! \brief add a chunk with its own count, mean and sum of squared deviations */
+  inline void Merge(double n, double cmean, double cm2) {
+    if (n == 0) return;
+    const double total = count + n, delta = cmean - mean;
+    mean += delta * n / total;
+    m2 += cm2 + delta * delta * count * n / total;
+    count = total;
+  }
+};
+}  // namespace batchnorm
+
+/*!
+ * \brief forward of batch normalization in training,
+ *  out = gamma * (data - mean) / sqrt(var + eps) + beta
+ * \param out output, can be the same as data
+ * \param mean output mean of each channel
+ * \param var output biased variance of each channel
+ * \param data input data, of shape (batch, channel, y, x)
+ * \param gamma scale of each channel
+ * \param beta shift of each channel
+ * \param eps small constant added to the variance
+ * \tparam DType type of element
+ */
+template<typename DType>
+inline void BatchNormForward(Tensor<cpu, 4, DType> out,
+                             Tensor<cpu, 1, DType> mean,
+                             Tensor<cpu, 1, DType> var,
+                             const Tensor<cpu, 4, DType> &data,
+                             const Tensor<cpu, 1, DType> &gamma,
+                             const Tensor<cpu, 1, DType> &beta,
+                             DType eps) {
+  const index_t nchannel = data.size(1);
+  CHECK(out.shape_ == data.shape_ && mean.size(0) == nchannel &&
+        var.size(0) == nchannel && gamma.size(0) == nchannel &&
+        beta.size(0) == nchannel) << "BatchNormForward: shape mismatch";
+  MSHADOW_TRACE_SCOPE("BatchNormForward", "op", data.shape_, 5.0 * data.shape_.Size(),
+                      3.0 * sizeof(DType) * data.shape_.Size());
+  const batchnorm::Segments seg(data.shape_, data.stride_ == data.size(3) &&
+                                out.stride_ == data.size(3));
+  MSHADOW_OMP_PARALLEL_FOR(data.shape_.Size())
+  for (index_t c = 0; c < nchannel; ++c) {
+    batchnorm::Stats st;
+    for (index_t n = 0; n < data.size(0); ++n) {
+      for (index_t s = 0; s < seg.nseg; ++s) {
+        const DType *x = seg.Get(data, n, c, s);
+        for (index_t i = 0; i < seg.len; i += batchnorm::kChunk) {
+          // the chunk is read again from cache for the deviations
+          const index_t len = std::min(batchnorm::kChunk, seg.len - i);
+          const DType cmean = batchnorm::Kernel<DType>::Sum(x + i, len) / len;
+          st.Merge(len, cmean, batchnorm::Kernel<DType>::SumSqDev(x + i, len, cmean));
+        }
+      }
+    }
+    mean[c] = static_cast<DType>(st.mean);
+    var[c] = static_cast<DType>(st.count != 0 ? st.m2 / st.count : 0.0);
+    const DType scale = gamma[c] / std::sqrt(var[c] + eps);
+    const DType shift = beta[c] - mean[c] * scale;
+    for (index_t n = 0; n < data.size(0); ++n) {
+      for (index_t s = 0; s < seg.nseg; ++s) {
+        batchnorm::Kernel<DType>::ScaleShift(seg.Get(out, n, c, s), seg.Get(data, n, c, s),
+                                             seg.len, scale, shift);
+      }
+    }
+  }
+}
+/*!
+ * \brief backward of batch normalization, with the mean and var of the forward
+ * \param grad_in output gradient of data, can be the same as grad_out
+ * \param grad_gamma output gradient of gamma
+ * \param grad_beta output gradient of beta
+ * \param grad_out gradient of the output of forward
+ * \param data input data of forward
+ * \param mean mean computed by forward
+ * \param var variance computed by forward
+ * \param gamma scale of each channel
+ * \param eps small constant added to the variance
+ * \tparam DType type of element
+ */
+template<typename DType>
+inline void BatchNormBackward(Tensor<cpu, 4, DType> grad_in,
+                              Tensor<cpu, 1, DType> grad_gamma,
+                              Tensor<cpu, 1, DType> grad_beta,
+                              const Tensor<cpu, 4, DType> &grad_out,
+                              const Tensor<cpu, 4, DType> &data,
+                              const Tensor<cpu, 1, DType> &mean,
+                              const Tensor<cpu, 1, DType> &var,
+                              const Tensor<cpu, 1, DType> &gamma,
+                              DType eps) {
+  const index_t nchannel = data.size(1);
+  CHECK(grad_in.shape_ == data.shape_ && grad_out.shape_ == data.shape_ &&
+        grad_gamma.size(0) == nchannel && grad_beta.size(0) == nchannel &&
+        mean.size(0) == nchannel && var.size(0) == nchannel &&
+        gamma.size(0) == nchannel) << "BatchNormBackward: shape mismatch";
+  MSHADOW_TRACE_SCOPE("BatchNormBackward", "op", data.shape_, 8.0 * data.shape_.Size(),
+                      5.0 * sizeof(DType) * data.shape_.Size());
+  const index_t w = data.size(3);
+  const batchnorm::Segments seg(data.shape_, data.stride_ == w &&
+                                grad_in.stride_ == w && grad_out.stride_ == w);
+  const DType m = static_cast<DType>(data.size(0) * data.size(2) * data.size(3));
+  MSHADOW_OMP_PARALLEL_FOR(data.shape_.Size())
+  for (index_t c = 0; c < nchannel; ++c) {
+    DType sum_dy = 0, sum_dyx = 0;
+    for (index_t n = 0; n < data.size(0); ++n) {
+      for (index_t s = 0; s < seg.nseg; ++s) {
+        batchnorm::Kernel<DType>::GradSum(seg.Get(grad_out, n, c, s), seg.Get(data, n, c, s),
+                                          seg.len, mean[c], &sum_dy, &sum_dyx);
+      }
+    }
+    const DType inv_std = DType(1) / std::sqrt(var[c] + eps);
+    grad_beta[c] = sum_dy;
+    grad_gamma[c] = sum_dyx * inv_std;
+    // grad_in = gamma * inv_std * (dy - sum_dy / m - (x - mean) * inv_std^2 * sum_dyx / m)
+    const DType a = gamma[c] * inv_std;
+    const DType b = -a * inv_std * inv_std * sum_dyx / m;
+    const DType d = -a * sum_dy / m - b * mean[c];
+    for (index_t n = 0; n < data.size(0); ++n) {
+      for (index_t s = 0; s < seg.nseg; ++s) {
+        batchnorm::Kernel<DType>::Combine(seg.Get(grad_in, n, c, s), seg.Get(grad_out, n, c, s),
+                                          seg.Get(data, n, c, s), seg.len, a, b, d);
+      }
+    }
+  }
+}
+/*!
+ * \brief batch normalization in inference, with the moving statistics
+ *  folded into one multiply-add per element
+ * \param out output, can be the same as data
+ * \param data input data, of shape (batch, channel, y, x)
+ * \param moving_mean mean used in inference
+ * \param moving_var variance used in inference
+ * \param gamma scale of each channel
+ * \param beta shift of each channel
+ * \param eps small constant added to the variance
+ * \tparam DType type of element
+ */
+template<typename DType>
+inline void BatchNormInference(Tensor<cpu, 4, DType> out,
+                               const Tensor<cpu, 4, DType> &data,
+                               const Tensor<cpu, 1, DType> &moving_mean,
+                               const Tensor<cpu, 1, DType> &moving_var,
+                               const Tensor<cpu, 1, DType> &gamma,
+                               const Tensor<cpu, 1, DType> &beta,
+                               DType eps) {
+  const index_t nchannel = data.size(1);
+  CHECK(out.shape_ == data.shape_ && moving_mean.size(0) == nchannel &&
+        moving_var.size(0) == nchannel && gamma.size(0) == nchannel &&
+        beta.size(0) == nchannel) << "BatchNormInference: shape mismatch";
+  MSHADOW_TRACE_SCOPE("BatchNormInference", "op", data.shape_, 2.0 * data.shape_.Size(),
+                      2.0 * sizeof(DType) * data.shape_.Size());
+  const batchnorm::Segments seg(data.shape_, data.stride_ == data.size(3) &&
+                                out.stride_ == data.size(3));
+  const index_t nplane = data.size(0) * nchannel;
+  MSHADOW_OMP_PARALLEL_FOR(data.shape_.Size())
+  for (index_t p = 0; p < nplane; ++p) {
+    const index_t n = p / nchannel, c = p % nchannel;
+    const DType scale = gamma[c] / std::sqrt(moving_var[c] + eps);
+    const DType shift = beta[c] - moving_mean[c] * scale;
+    for (index_t s = 0; s < seg.nseg; ++s) {
+      batchnorm::Kernel<DType>::ScaleShift(seg.Get(out, n, c, s), seg.Get(data, n, c, s),
+                                           seg.len, scale, shift);
+    }
+  }
+}
+}  // namespace mshadow
+#endif  // MSHADOW_EXTENSION_BATCH_NORM_H_
@@ -92,7 +92,7 @@ inline ChannelUnpoolingExp<Reducer, SrcExp, DType, ExpInfo<SrcExp>::kDim>
 ch_unpool(const Exp<SrcExp, DType, etype> &data_src,
        const Exp<SrcExp, DType, etype> &data_pooled,
        const Exp<SrcExp, DType, etype> &grad_pooled, index_t nsize) {
-  return ch_unpool(data_src, data_pooled, grad_pooled, nsize, 1, nsize / 2);
+  return ch_unpool<Reducer>(data_src, data_pooled, grad_pooled, nsize, 1, nsize / 2);
 }
 
 
@@ -117,7 +117,7 @@ struct Plan<ChannelUnpoolingExp<Reducer, SrcExp, DType, srcdim>, DType> {
     const index_t x = j;
     const index_t cstart = c < hnsize_ - pad_ ? 0
                         : (c - (hnsize_ - pad_) + stride_) / stride_;
-    const index_t cend = min((c + pad_ + stride_) / stride_, channel_);
+    const index_t cend = min((c + pad_ + stride_) / stride_, pchannel_);
     DType val = static_cast<DType>(0);
     for (index_t cc = cstart; cc < cend; ++cc) {
       val += Reducer::PartialGrad(vsrc,
@@ -0,0 +1,416 @@
+/*!
+ *  Copyright (c) 2014 by Contributors
+ * \file group_conv.h
+ * \brief depthwise and grouped convolution of 4D tensors on cpu.
+ *  Depthwise convolution slides the kernel directly over each (image, channel)
+ *  plane, one output row is accumulated from a shifted input row per kernel
+ *  element. Grouped convolution unpacks the patches of an image with padding
+ *  once and runs one dot per group on row blocks of the column buffer.
+ *  The output size is (in + 2 * pad - ksize) / stride + 1.
+ * \author Tianqi Chen
+ */
+#ifndef MSHADOW_EXTENSION_GROUP_CONV_H_
+#define MSHADOW_EXTENSION_GROUP_CONV_H_
+#include <algorithm>
+#include "../extension.h"
+#include "../sse-inl.h"
+
+namespace mshadow {
+namespace conv {
+/*!
+ * \brief range [lo, hi) of output positions o where the input position
+ *  o * stride + k - pad is inside [0, isize)
+ */
+inline void Range(index_t k, index_t pad, index_t stride, index_t isize, index_t osize,
+                  index_t *lo, index_t *hi) {
+  *lo = k >= pad ? 0 : (pad - k + stride - 1) / stride;
+  *hi = isize + pad <= k ? 0 : std::min(osize, (isize + pad - k - 1) / stride + 1);
+  if (*lo > *hi) *lo = *hi;
+}
+/*! \brief kernels on a row, generic version */
+template<typename DType>
+struct Kernel {
+  /*! \brief y[i] += a * x[i * xstride] */
+  inline static void Axpy(DType *y, const DType *x, index_t xstride, DType a, index_t n) {
+    for (index_t i = 0; i < n; ++i) y[i] += a * x[i * xstride];
+  }
+  /*! \brief y[i * ystride] += a * x[i] */
+  inline static void AxpyTo(DType *y, index_t ystride, const DType *x, DType a, index_t n) {
+    for (index_t i = 0; i < n; ++i) y[i * ystride] += a * x[i];
+  }
+  /*! \brief sum of x[i * xstride] * y[i] */
+  inline static DType Dot(const DType *x, index_t xstride, const DType *y, index_t n) {
+    DType s = 0;
+    for (index_t i = 0; i < n; ++i) s += x[i * xstride] * y[i];
+    return s;
+  }
+};
+#if MSHADOW_USE_SSE
+template<>
+struct Kernel<float> {
+  inline static void Axpy(float *y, const float *x, index_t xstride, float a, index_t n) {
+    if (xstride != 1) {
+      for (index_t i = 0; i < n; ++i) y[i] += a * x[i * xstride];
+      return;
+    }
+    const index_t nv = (n >> 2) << 2;
+    const __m128 va = _mm_set1_ps(a);
+    for (index_t i = 0; i < nv; i += 4) {
+      _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i),
+                                      _mm_mul_ps(va, _mm_loadu_ps(x + i))));
+    }
+    for (index_t i = nv; i < n; ++i) y[i] += a * x[i];
+  }
+  inline static void AxpyTo(float *y, index_t ystride, const float *x, float a, index_t n) {
+    if (ystride == 1) {
+      Axpy(y, x, 1, a, n);
+    } else {
+      for (index_t i = 0; i < n; ++i) y[i * ystride] += a * x[i];
+    }
+  }
+  inline static float Dot(const float *x, index_t xstride, const float *y, index_t n) {
+    float s = 0;
+    if (xstride != 1) {
+      for (index_t i = 0; i < n; ++i) s += x[i * xstride] * y[i];
+      return s;
+    }
+    const index_t nv = (n >> 3) << 3;
+    __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps();
+    for (index_t i = 0; i < nv; i += 8) {
+      s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(y + i)));
+      s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_loadu_ps(x + i + 4), _mm_loadu_ps(y + i + 4)));
+    }
+    s = sse2::FVec<float>(_mm_add_ps(s0, s1)).Sum();
+    for (index_t i = nv; i < n; ++i) s += x[i] * y[i];
+    return s;
+  }
+};
+#endif  // MSHADOW_USE_SSE
+/*! \brief checks the output size of a convolution */
+inline void CheckOutSize(index_t isize, index_t osize, index_t ksize,
+                         index_t stride, index_t pad, const char *name) {
+  CHECK(stride != 0 && isize + 2 * pad >= ksize &&
+        osize == (isize + 2 * pad - ksize) / stride + 1)
+    << name << ": output size must be (in + 2 * pad - ksize) / stride + 1";
+}
+/*!
+ * \brief out = sum of w[ky][kx] * shifted in, one plane, each output row
+ *  gets one axpy of an input row per kernel element while it stays in cache
+ */
+template<typename DType>
+inline void DepthwisePlane(Tensor<cpu, 2, DType> out, const Tensor<cpu, 2, DType> &in,
+                           const Tensor<cpu, 2, DType> &w, index_t stride, index_t pad) {
+  for (index_t oy = 0; oy < out.size(0); ++oy) {
+    DType *pout = out[oy].dptr_;
+    std::fill(pout, pout + out.size(1), DType(0));
+    for (index_t ky = 0; ky < w.size(0); ++ky) {
+      const index_t iy = oy * stride + ky;
+      if (iy < pad || iy >= in.size(0) + pad) continue;
+      const DType *pin = in[iy - pad].dptr_;
+      for (index_t kx = 0; kx < w.size(1); ++kx) {
+        index_t lo, hi;
+        Range(kx, pad, stride, in.size(1), out.size(1), &lo, &hi);
+        Kernel<DType>::Axpy(pout + lo, pin + lo * stride + kx - pad, stride,
+                            w[ky][kx], hi - lo);
+      }
+    }
+  }
+}
+/*!
+ * \brief unpacks the patches of an image (C, H, W) with zero padding into
+ *  col of shape (C * ky * kx, oh * ow), rows are processed in parallel
+ */
+template<typename DType>
+inline void Im2Col(Tensor<cpu, 2, DType> col, const Tensor<cpu, 3, DType> &img,
+                   index_t ksize_y, index_t ksize_x, index_t stride, index_t pad,
+                   index_t oheight, index_t owidth) {
+  const index_t nrow = col.size(0);
+  MSHADOW_OMP_PARALLEL_FOR(col.shape_.Size())
+  for (index_t r = 0; r < nrow; ++r) {
+    const index_t kx = r % ksize_x, ky = (r / ksize_x) % ksize_y, c = r / (ksize_x * ksize_y);
+    index_t lo, hi;
+    Range(kx, pad, stride, img.size(2), owidth, &lo, &hi);
+    for (index_t oy = 0; oy < oheight; ++oy) {
+      DType *pcol = col[r].dptr_ + oy * owidth;
+      const index_t iy = oy * stride + ky;
+      if (iy < pad || iy >= img.size(1) + pad) {
+        std::fill(pcol, pcol + owidth, DType(0));
+        continue;
+      }
+      const DType *pin = img[c][iy - pad].dptr_ + kx - pad;
+      std::fill(pcol, pcol + lo, DType(0));
+      for (index_t ox = lo; ox < hi; ++ox) pcol[ox] = pin[ox * stride];
+      std::fill(pcol + hi, pcol + owidth, DType(0));
+    }
+  }
+}
+/*! \brief img = sum of the patches in col, reverse of Im2Col, channels are processed in parallel */
+template<typename DType>
+inline void Col2Im(Tensor<cpu, 3, DType> img, const Tensor<cpu, 2, DType> &col,
+                   index_t ksize_y, index_t ksize_x, index_t stride, index_t pad,
+                   index_t oheight, index_t owidth) {
+  MSHADOW_OMP_PARALLEL_FOR(col.shape_.Size())
+  for (index_t c = 0; c < img.size(0); ++c) {
+    for (index_t y = 0; y < img.size(1); ++y) {
+      std::fill(img[c][y].dptr_, img[c][y].dptr_ + img.size(2), DType(0));
+    }
+    for (index_t ky = 0; ky < ksize_y; ++ky) {
+      for (index_t kx = 0; kx < ksize_x; ++kx) {
+        const DType *pcol = col[(c * ksize_y + ky) * ksize_x + kx].dptr_;
+        index_t lo, hi;
+        Range(kx, pad, stride, img.size(2), owidth, &lo, &hi);
+        for (index_t oy = 0; oy < oheight; ++oy) {
+          const index_t iy = oy * stride + ky;
+          if (iy < pad || iy >= img.size(1) + pad) continue;
+          Kernel<DType>::AxpyTo(img[c][iy - pad].dptr_ + lo * stride + kx - pad, stride,
+                                pcol + oy * owidth + lo, DType(1), hi - lo);
+        }
+      }
+    }
+  }
+}
+/*!
+ * \brief an image (C, H, W) as a (C, H * W) matrix, buf is allocated and
+ *  returned instead when the rows of the image are padded
+ */
+template<typename DType>
+inline Tensor<cpu, 2, DType> Mat(const Tensor<cpu, 3, DType> &img, Tensor<cpu, 2, DType> *buf) {
+  const Shape<2> shape = Shape2(img.size(0), img.size(1) * img.size(2));
+  if (img.CheckContiguous()) return Tensor<cpu, 2, DType>(img.dptr_, shape);
+  if (buf->dptr_ == NULL) {
+    buf->shape_ = shape;
+    AllocSpace(buf);
+  }
+  return *buf;
+}
+/*! \brief copies between an image and its matrix when they are not the same memory */
+template<typename DType>
+inline void CopyMat(Tensor<cpu, 3, DType> img, Tensor<cpu, 2, DType> mat, bool to_img) {
+  if (mat.dptr_ == img.dptr_) return;
+  const index_t width = img.size(2);
+  for (index_t c = 0; c < img.size(0); ++c) {
+    for (index_t y = 0; y < img.size(1); ++y) {
+      DType *pimg = img[c][y].dptr_, *pmat = mat[c].dptr_ + y * width;
+      if (to_img) {
+        std::copy(pmat, pmat + width, pimg);
+      } else {
+        std::copy(pimg, pimg + width, pmat);
+      }
+    }
+  }
+}
+}  // namespace conv
+
+/*!
+ * \brief depthwise convolution, out[n][c] = conv(data[n][c], weight[c]),
+ *  (image, channel) planes are processed in parallel
+ * \param out output of shape (batch, channel, oheight, owidth)
+ * \param data input of shape (batch, channel, height, width)
+ * \param weight kernel of each channel, of shape (channel, ksize_y, ksize_x)
+ * \param stride stride of the kernel
+ * \param pad zero padding of each side
+ * \tparam DType type of element
+ */
+template<typename DType>
+inline void DepthwiseConvForward(Tensor<cpu, 4, DType> out,
+                                 const Tensor<cpu, 4, DType> &data,
+                                 const Tensor<cpu, 3, DType> &weight,
+                                 index_t stride, index_t pad) {
+  CHECK(out.size(0) == data.size(0) && out.size(1) == data.size(1) &&
+        weight.size(0) == data.size(1)) << "DepthwiseConvForward: shape mismatch";
+  conv::CheckOutSize(data.size(2), out.size(2), weight.size(1), stride, pad,
+                     "DepthwiseConvForward");
+  conv::CheckOutSize(data.size(3), out.size(3), weight.size(2), stride, pad,
+                     "DepthwiseConvForward");
+  MSHADOW_TRACE_SCOPE("DepthwiseConvForward", "op", data.shape_,
+                      2.0 * out.shape_.Size() * weight.size(1) * weight.size(2),
+                      sizeof(DType) * (data.shape_.Size() + out.shape_.Size()));
+  const index_t nchannel = data.size(1), nplane = data.size(0) * nchannel;
+  MSHADOW_OMP_PARALLEL_FOR_IF(out.shape_.Size() > (1 << 14))
+  for (index_t p = 0; p < nplane; ++p) {
+    const index_t n = p / nchannel, c = p % nchannel;
+    conv::DepthwisePlane(out[n][c], data[n][c], weight[c], stride, pad);
+  }
+}
+/*!
+ * \brief backward of depthwise convolution
+ * \param grad_data gradient of data, overwritten
+ * \param grad_weight gradient of weight, overwritten
+ * \param grad_out gradient of output
+ * \param data input data of forward
+ * \param weight kernel of forward
+ * \param stride stride of the kernel
+ * \param pad zero padding of each side
+ * \tparam DType type of element
+ */
+template<typename DType>
+inline void DepthwiseConvBackward(Tensor<cpu, 4, DType> grad_data,
+                                  Tensor<cpu, 3, DType> grad_weight,
+                                  const Tensor<cpu, 4, DType> &grad_out,
+                                  const Tensor<cpu, 4, DType> &data,
+                                  const Tensor<cpu, 3, DType> &weight,
+                                  index_t stride, index_t pad) {
+  CHECK(grad_data.shape_ == data.shape_ && grad_weight.shape_ == weight.shape_ &&
+        grad_out.size(0) == data.size(0) && grad_out.size(1) == data.size(1) &&
+        weight.size(0) == data.size(1)) << "DepthwiseConvBackward: shape mismatch";
+  conv::CheckOutSize(data.size(2), grad_out.size(2), weight.size(1), stride, pad,
+                     "DepthwiseConvBackward");
+  conv::CheckOutSize(data.size(3), grad_out.size(3), weight.size(2), stride, pad,
+                     "DepthwiseConvBackward");
+  MSHADOW_TRACE_SCOPE("DepthwiseConvBackward", "op", data.shape_,
+                      4.0 * grad_out.shape_.Size() * weight.size(1) * weight.size(2),
+                      sizeof(DType) * (2.0 * data.shape_.Size() + 2.0 * grad_out.shape_.Size()));
+  const index_t nbatch = data.size(0), nchannel = data.size(1);
+  const index_t ksize_y = weight.size(1), ksize_x = weight.size(2);
+  const index_t oheight = grad_out.size(2), owidth = grad_out.size(3);
+  // gradient of weight, each thread owns the channels it sums
+  MSHADOW_OMP_PARALLEL_FOR_IF(grad_out.shape_.Size() > (1 << 14))
+  for (index_t c = 0; c < nchannel; ++c) {
+    for (index_t ky = 0; ky < ksize_y; ++ky) {
+      for (index_t kx = 0; kx < ksize_x; ++kx) {
+        index_t lo, hi;
+        conv::Range(kx, pad, stride, data.size(3), owidth, &lo, &hi);
+        DType sum = 0;
+        for (index_t n = 0; n < nbatch; ++n) {
+          for (index_t oy = 0; oy < oheight; ++oy) {
+            const index_t iy = oy * stride + ky;
+            if (iy < pad || iy >= data.size(2) + pad) continue;
+            sum += conv::Kernel<DType>::Dot(data[n][c][iy - pad].dptr_ + lo * stride + kx - pad,
+                                            stride, grad_out[n][c][oy].dptr_ + lo, hi - lo);
+          }
+        }
+        grad_weight[c][ky][kx] = sum;
+      }
+    }
+  }
+  // gradient of data, the output rows are spread back to the shifted input rows
+  MSHADOW_OMP_PARALLEL_FOR_IF(grad_out.shape_.Size() > (1 << 14))
+  for (index_t p = 0; p < nbatch * nchannel; ++p) {
+    const index_t n = p / nchannel, c = p % nchannel;
+    Tensor<cpu, 2, DType> gin = grad_data[n][c];
+    for (index_t y = 0; y < gin.size(0); ++y) {
+      std::fill(gin[y].dptr_, gin[y].dptr_ + gin.size(1), DType(0));
+    }
+    for (index_t oy = 0; oy < oheight; ++oy) {
+      const DType *pout = grad_out[n][c][oy].dptr_;
+      for (index_t ky = 0; ky < ksize_y; ++ky) {
+        const index_t iy = oy * stride + ky;
+        if (iy < pad || iy >= gin.size(0) + pad) continue;
+        for (index_t kx = 0; kx < ksize_x; ++kx) {
+          index_t lo, hi;
+          conv::Range(kx, pad, stride, gin.size(1), owidth, &lo, &hi);
+          conv::Kernel<DType>::AxpyTo(gin[iy - pad].dptr_ + lo * stride + kx - pad, stride,
+                                      pout + lo, weight[c][ky][kx], hi - lo);
+        }
+      }
+    }
+  }
+}
+/*!
+ * \brief grouped convolution, the channels of data and out are split into
+ *  num_group groups and group g of out only sees group g of data
+ * \param out output of shape (batch, nout, oheight, owidth)
+ * \param data input of shape (batch, nin, height, width)
+ * \param weight kernel of shape (nout, nin / num_group * ksize_y * ksize_x),
+ *  the same layout as the weight of dot(weight, unpack_patch2col(...))
+ * \param num_group number of groups, must divide nin and nout
+ * \param ksize_y height of kernel
+ * \param ksize_x width of kernel
+ * \param stride stride of the kernel
+ * \param pad zero padding of each side
+ * \tparam DType type of element
+ */
+template<typename DType>
+inline void GroupConvForward(Tensor<cpu, 4, DType> out,
+                             const Tensor<cpu, 4, DType> &data,
+                             const Tensor<cpu, 2, DType> &weight,
+                             index_t num_group, index_t ksize_y, index_t ksize_x,
+                             index_t stride, index_t pad) {
+  const index_t nin = data.size(1), nout = out.size(1);
+  CHECK(num_group != 0 && nin % num_group == 0 && nout % num_group == 0)
+    << "GroupConvForward: num_group must divide the channels";
+  const index_t kin = nin / num_group * ksize_y * ksize_x, kout = nout / num_group;
+  CHECK(out.size(0) == data.size(0) && weight.size(0) == nout && weight.size(1) == kin)
+    << "GroupConvForward: shape mismatch";
+  conv::CheckOutSize(data.size(2), out.size(2), ksize_y, stride, pad, "GroupConvForward");
+  conv::CheckOutSize(data.size(3), out.size(3), ksize_x, stride, pad, "GroupConvForward");
+  MSHADOW_TRACE_SCOPE("GroupConvForward", "op", data.shape_,
+                      2.0 * out.shape_.Size() * kin,
+                      sizeof(DType) * (data.shape_.Size() + out.shape_.Size()));
+  const index_t oheight = out.size(2), owidth = out.size(3);
+  Tensor<cpu, 2, DType> col(Shape2(kin * num_group, oheight * owidth));
+  Tensor<cpu, 2, DType> buf(NULL, Shape2(0, 0));
+  AllocSpace(&col);
+  for (index_t n = 0; n < data.size(0); ++n) {
+    conv::Im2Col(col, data[n], ksize_y, ksize_x, stride, pad, oheight, owidth);
+    Tensor<cpu, 2, DType> omat = conv::Mat(out[n], &buf);
+    for (index_t g = 0; g < num_group; ++g) {
+      Tensor<cpu, 2, DType> og = omat.Slice(g * kout, (g + 1) * kout);
+      og = expr::dot(weight.Slice(g * kout, (g + 1) * kout),
+                     col.Slice(g * kin, (g + 1) * kin));
+    }
+    conv::CopyMat(out[n], omat, true);
+  }
+  FreeSpace(&col);
+  if (buf.dptr_ != NULL) FreeSpace(&buf);
+}
+/*!
+ * \brief backward of grouped convolution
+ * \param grad_data gradient of data, overwritten
+ * \param grad_weight gradient of weight, overwritten
+ * \param grad_out gradient of output
+ * \param data input data of forward
+ * \param weight kernel of forward
+ * \param num_group number of groups
+ * \param ksize_y height of kernel
+ * \param ksize_x width of kernel
+ * \param stride stride of the kernel
+ * \param pad zero padding of each side
+ * \tparam DType type of element
+ */
+template<typename DType>
+inline void GroupConvBackward(Tensor<cpu, 4, DType> grad_data,
+                              Tensor<cpu, 2, DType> grad_weight,
+                              const Tensor<cpu, 4, DType> &grad_out,
+                              const Tensor<cpu, 4, DType> &data,
+                              const Tensor<cpu, 2, DType> &weight,
+                              index_t num_group, index_t ksize_y, index_t ksize_x,
+                              index_t stride, index_t pad) {
+  const index_t nin = data.size(1), nout = grad_out.size(1);
+  CHECK(num_group != 0 && nin % num_group == 0 && nout % num_group == 0)
+    << "GroupConvBackward: num_group must divide the channels";
+  const index_t kin = nin / num_group * ksize_y * ksize_x, kout = nout / num_group;
+  CHECK(grad_data.shape_ == data.shape_ && grad_weight.shape_ == weight.shape_ &&
+        grad_out.size(0) == data.size(0) && weight.size(0) == nout && weight.size(1) == kin)
+    << "GroupConvBackward: shape mismatch";
+  conv::CheckOutSize(data.size(2), grad_out.size(2), ksize_y, stride, pad, "GroupConvBackward");
+  conv::CheckOutSize(data.size(3), grad_out.size(3), ksize_x, stride, pad, "GroupConvBackward");
+  MSHADOW_TRACE_SCOPE("GroupConvBackward", "op", data.shape_,
+                      4.0 * grad_out.shape_.Size() * kin,
+                      sizeof(DType) * (2.0 * data.shape_.Size() + grad_out.shape_.Size()));
+  const index_t oheight = grad_out.size(2), owidth = grad_out.size(3);
+  Tensor<cpu, 2, DType> col(Shape2(kin * num_group, oheight * owidth));
+  Tensor<cpu, 2, DType> buf(NULL, Shape2(0, 0));
+  AllocSpace(&col);
+  grad_weight = DType(0);
+  for (index_t n = 0; n < data.size(0); ++n) {
+    Tensor<cpu, 2, DType> gmat = conv::Mat(grad_out[n], &buf);
+    conv::CopyMat(grad_out[n], gmat, false);
+    conv::Im2Col(col, data[n], ksize_y, ksize_x, stride, pad, oheight, owidth);
+    for (index_t g = 0; g < num_group; ++g) {
+      Tensor<cpu, 2, DType> gw = grad_weight.Slice(g * kout, (g + 1) * kout);
+      gw += expr::dot(gmat.Slice(g * kout, (g + 1) * kout),
+                      col.Slice(g * kin, (g + 1) * kin).T());
+    }
+    for (index_t g = 0; g < num_group; ++g) {
+      Tensor<cpu, 2, DType> cg = col.Slice(g * kin, (g + 1) * kin);
+      cg = expr::dot(weight.Slice(g * kout, (g + 1) * kout).T(),
+                     gmat.Slice(g * kout, (g + 1) * kout));
+    }
+    conv::Col2Im(grad_data[n], col, ksize_y, ksize_x, stride, pad, oheight, owidth);
+  }
+  FreeSpace(&col);
+  if (buf.dptr_ != NULL) FreeSpace(&buf);
+}
+}  // namespace mshadow
+#endif  // MSHADOW_EXTENSION_GROUP_CONV_H_
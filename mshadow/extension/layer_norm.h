@@ -0,0 +1,307 @@
+/*!
+ *  Copyright (c) 2014 by Contributors
+ * \file layer_norm.h
+ * \brief layer normalization and RMS normalization over the rows of a 2D tensor.
+ *  The statistics of a row are computed in one pass, with the chunked Welford
+ *  update of batch_norm.h, the row is then normalized while it is still in
+ *  cache. Rows are processed in parallel when OpenMP is enabled.
+ * \author Tianqi Chen
+ */
+#ifndef MSHADOW_EXTENSION_LAYER_NORM_H_
+#define MSHADOW_EXTENSION_LAYER_NORM_H_
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "../extension.h"
+#include "../sse-inl.h"
+#include "./batch_norm.h"
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+namespace mshadow {
+namespace layernorm {
+/*! \brief kernels on a row, generic version */
+template<typename DType>
+struct Kernel {
+  /*! \brief dst = (x - mean) * rstd * gamma + beta, beta can be NULL */
+  inline static void Normalize(DType *dst, const DType *x, index_t n, DType mean, DType rstd,
+                               const DType *gamma, const DType *beta) {
+    for (index_t i = 0; i < n; ++i) {
+      dst[i] = (x[i] - mean) * rstd * gamma[i] + (beta != NULL ? beta[i] : DType(0));
+    }
+  }
+  /*!
+   * \brief with xhat = (x - mean) * rstd, adds sum of dy * gamma to s1 and
+   *  sum of dy * gamma * xhat to s2, adds dy * xhat to grad_gamma and dy to
+   *  grad_beta, grad_beta can be NULL
+   */
+  inline static void GradSum(const DType *dy, const DType *x, const DType *gamma, index_t n,
+                             DType mean, DType rstd, DType *grad_gamma, DType *grad_beta,
+                             DType *s1, DType *s2) {
+    DType r1 = 0, r2 = 0;
+    for (index_t i = 0; i < n; ++i) {
+      const DType xhat = (x[i] - mean) * rstd, g = dy[i] * gamma[i];
+      r1 += g; r2 += g * xhat;
+      grad_gamma[i] += dy[i] * xhat;
+      if (grad_beta != NULL) grad_beta[i] += dy[i];
+    }
+    *s1 += r1; *s2 += r2;
+  }
+  /*! \brief dx = rstd * (dy * gamma - a - xhat * b) */
+  inline static void GradIn(DType *dx, const DType *dy, const DType *x, const DType *gamma,
+                            index_t n, DType mean, DType rstd, DType a, DType b) {
+    for (index_t i = 0; i < n; ++i) {
+      dx[i] = rstd * (dy[i] * gamma[i] - a - (x[i] - mean) * rstd * b);
+    }
+  }
+};
+#if MSHADOW_USE_SSE
+template<>
+struct Kernel<float> {
+  inline static void Normalize(float *dst, const float *x, index_t n, float mean, float rstd,
+                               const float *gamma, const float *beta) {
+    const index_t nv = (n >> 2) << 2;
+    const __m128 vm = _mm_set1_ps(mean), vr = _mm_set1_ps(rstd);
+    for (index_t i = 0; i < nv; i += 4) {
+      __m128 r = _mm_mul_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(x + i), vm), vr),
+                            _mm_loadu_ps(gamma + i));
+      if (beta != NULL) r = _mm_add_ps(r, _mm_loadu_ps(beta + i));
+      _mm_storeu_ps(dst + i, r);
+    }
+    for (index_t i = nv; i < n; ++i) {
+      dst[i] = (x[i] - mean) * rstd * gamma[i] + (beta != NULL ? beta[i] : 0.0f);
+    }
+  }
+  inline static void GradSum(const float *dy, const float *x, const float *gamma, index_t n,
+                             float mean, float rstd, float *grad_gamma, float *grad_beta,
+                             float *s1, float *s2) {
+    const index_t nv = (n >> 2) << 2;
+    const __m128 vm = _mm_set1_ps(mean), vr = _mm_set1_ps(rstd);
+    __m128 v1 = _mm_setzero_ps(), v2 = _mm_setzero_ps();
+    for (index_t i = 0; i < nv; i += 4) {
+      const __m128 vdy = _mm_loadu_ps(dy + i);
+      const __m128 xhat = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(x + i), vm), vr);
+      const __m128 g = _mm_mul_ps(vdy, _mm_loadu_ps(gamma + i));
+      v1 = _mm_add_ps(v1, g);
+      v2 = _mm_add_ps(v2, _mm_mul_ps(g, xhat));
+      _mm_storeu_ps(grad_gamma + i, _mm_add_ps(_mm_loadu_ps(grad_gamma + i),
+                                               _mm_mul_ps(vdy, xhat)));
+      if (grad_beta != NULL) {
+        _mm_storeu_ps(grad_beta + i, _mm_add_ps(_mm_loadu_ps(grad_beta + i), vdy));
+      }
+    }
+    float r1 = sse2::FVec<float>(v1).Sum(), r2 = sse2::FVec<float>(v2).Sum();
+    for (index_t i = nv; i < n; ++i) {
+      const float xhat = (x[i] - mean) * rstd, g = dy[i] * gamma[i];
+      r1 += g; r2 += g * xhat;
+      grad_gamma[i] += dy[i] * xhat;
+      if (grad_beta != NULL) grad_beta[i] += dy[i];
+    }
+    *s1 += r1; *s2 += r2;
+  }
+  inline static void GradIn(float *dx, const float *dy, const float *x, const float *gamma,
+                            index_t n, float mean, float rstd, float a, float b) {
+    const index_t nv = (n >> 2) << 2;
+    const __m128 vm = _mm_set1_ps(mean), vr = _mm_set1_ps(rstd);
+    const __m128 va = _mm_set1_ps(a), vb = _mm_set1_ps(b);
+    for (index_t i = 0; i < nv; i += 4) {
+      const __m128 xhat = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(x + i), vm), vr);
+      const __m128 g = _mm_mul_ps(_mm_loadu_ps(dy + i), _mm_loadu_ps(gamma + i));
+      const __m128 r = _mm_sub_ps(_mm_sub_ps(g, va), _mm_mul_ps(xhat, vb));
+      _mm_storeu_ps(dx + i, _mm_mul_ps(vr, r));
+    }
+    for (index_t i = nv; i < n; ++i) {
+      dx[i] = rstd * (dy[i] * gamma[i] - a - (x[i] - mean) * rstd * b);
+    }
+  }
+};
+#endif  // MSHADOW_USE_SSE
+/*!
+ * \brief mean and sum of squared deviations of a row
+ * \param centered whether to compute deviations around the mean,
+ *   otherwise around 0 and the mean is 0, as needed by RMSNorm
+ */
+template<typename DType>
+inline void RowStats(const DType *x, index_t n, bool centered, double *mean, double *m2) {
+  batchnorm::Stats st;
+  for (index_t i = 0; i < n; i += batchnorm::kChunk) {
+    const index_t len = std::min(batchnorm::kChunk, n - i);
+    const DType cmean = centered ? batchnorm::Kernel<DType>::Sum(x + i, len) / len : DType(0);
+    st.Merge(len, cmean, batchnorm::Kernel<DType>::SumSqDev(x + i, len, cmean));
+  }
+  *mean = st.mean; *m2 = st.m2;
+}
+/*!
+ * \brief backward shared by LayerNorm and RMSNorm, RMSNorm has zero mean
+ *  and no beta. grad_gamma and grad_beta are summed over the rows, each
+ *  thread keeps its own partial sums.
+ */
+template<typename DType>
+inline void Backward(Tensor<cpu, 2, DType> grad_in, DType *grad_gamma, DType *grad_beta,
+                     const Tensor<cpu, 2, DType> &grad_out, const Tensor<cpu, 2, DType> &data,
+                     const DType *mean, const DType *rstd, const DType *gamma, bool rms) {
+  const index_t nrow = data.size(0), ncol = data.size(1);
+  const DType inv_n = DType(1) / ncol;
+  int nthread = 1;
+  #if defined(_OPENMP)
+  if (data.shape_.Size() > MSHADOW_OMP_MIN_SIZE) nthread = omp_get_max_threads();
+  #endif
+  std::vector<DType> partial(static_cast<size_t>(nthread) * 2 * ncol, DType(0));
+  #if defined(_OPENMP)
+  #pragma omp parallel num_threads(nthread)
+  #endif
+  {
+    int tid = 0;
+    #if defined(_OPENMP)
+    tid = omp_get_thread_num();
+    #endif
+    DType *pgamma = ncol != 0 ? &partial[static_cast<size_t>(tid) * 2 * ncol] : NULL;
+    DType *pbeta = rms ? NULL : pgamma + ncol;
+    #if defined(_OPENMP)
+    #pragma omp for schedule(static)
+    #endif
+    for (index_t r = 0; r < nrow; ++r) {
+      const DType m = rms ? DType(0) : mean[r];
+      DType s1 = 0, s2 = 0;
+      Kernel<DType>::GradSum(grad_out[r].dptr_, data[r].dptr_, gamma, ncol, m, rstd[r],
+                             pgamma, pbeta, &s1, &s2);
+      Kernel<DType>::GradIn(grad_in[r].dptr_, grad_out[r].dptr_, data[r].dptr_, gamma,
+                            ncol, m, rstd[r], rms ? DType(0) : s1 * inv_n, s2 * inv_n);
+    }
+  }
+  for (index_t j = 0; j < ncol; ++j) {
+    DType sg = 0, sb = 0;
+    for (int t = 0; t < nthread; ++t) {
+      sg += partial[static_cast<size_t>(t) * 2 * ncol + j];
+      sb += partial[static_cast<size_t>(t) * 2 * ncol + ncol + j];
+    }
+    grad_gamma[j] = sg;
+    if (grad_beta != NULL) grad_beta[j] = sb;
+  }
+}
+}  // namespace layernorm
+
+/*!
+ * \brief forward of layer normalization over each row,
+ *  out = gamma * (data - mean) / sqrt(var + eps) + beta
+ * \param out output, can be the same as data
+ * \param mean output mean of each row
+ * \param rstd output 1 / sqrt(var + eps) of each row
+ * \param data input data, of shape (nrow, ncol)
+ * \param gamma scale of each column
+ * \param beta shift of each column
+ * \param eps small constant added to the variance
+ * \tparam DType type of element
+ */
+template<typename DType>
+inline void LayerNormForward(Tensor<cpu, 2, DType> out,
+                             Tensor<cpu, 1, DType> mean,
+                             Tensor<cpu, 1, DType> rstd,
+                             const Tensor<cpu, 2, DType> &data,
+                             const Tensor<cpu, 1, DType> &gamma,
+                             const Tensor<cpu, 1, DType> &beta,
+                             DType eps) {
+  const index_t nrow = data.size(0), ncol = data.size(1);
+  CHECK(out.shape_ == data.shape_ && mean.size(0) == nrow && rstd.size(0) == nrow &&
+        gamma.size(0) == ncol && beta.size(0) == ncol) << "LayerNormForward: shape mismatch";
+  MSHADOW_TRACE_SCOPE("LayerNormForward", "op", data.shape_, 6.0 * data.shape_.Size(),
+                      2.0 * sizeof(DType) * data.shape_.Size());
+  MSHADOW_OMP_PARALLEL_FOR(data.shape_.Size())
+  for (index_t r = 0; r < nrow; ++r) {
+    double m, m2;
+    layernorm::RowStats(data[r].dptr_, ncol, true, &m, &m2);
+    mean[r] = static_cast<DType>(m);
+    rstd[r] = static_cast<DType>(1.0 / std::sqrt(m2 / ncol + eps));
+    layernorm::Kernel<DType>::Normalize(out[r].dptr_, data[r].dptr_, ncol, mean[r], rstd[r],
+                                        gamma.dptr_, beta.dptr_);
+  }
+}
+/*!
+ * \brief backward of layer normalization
+ * \param grad_in output gradient of data, can be the same as grad_out
+ * \param grad_gamma output gradient of gamma
+ * \param grad_beta output gradient of beta
+ * \param grad_out gradient of the output of forward
+ * \param data input data of forward
+ * \param mean mean computed by forward
+ * \param rstd rstd computed by forward
+ * \param gamma scale of each column
+ * \tparam DType type of element
+ */
+template<typename DType>
+inline void LayerNormBackward(Tensor<cpu, 2, DType> grad_in,
+                              Tensor<cpu, 1, DType> grad_gamma,
+                              Tensor<cpu, 1, DType> grad_beta,
+                              const Tensor<cpu, 2, DType> &grad_out,
+                              const Tensor<cpu, 2, DType> &data,
+                              const Tensor<cpu, 1, DType> &mean,
+                              const Tensor<cpu, 1, DType> &rstd,
+                              const Tensor<cpu, 1, DType> &gamma) {
+  const index_t nrow = data.size(0), ncol = data.size(1);
+  CHECK(grad_in.shape_ == data.shape_ && grad_out.shape_ == data.shape_ &&
+        grad_gamma.size(0) == ncol && grad_beta.size(0) == ncol && gamma.size(0) == ncol &&
+        mean.size(0) == nrow && rstd.size(0) == nrow) << "LayerNormBackward: shape mismatch";
+  MSHADOW_TRACE_SCOPE("LayerNormBackward", "op", data.shape_, 12.0 * data.shape_.Size(),
+                      3.0 * sizeof(DType) * data.shape_.Size());
+  layernorm::Backward(grad_in, grad_gamma.dptr_, grad_beta.dptr_, grad_out, data,
+                      mean.dptr_, rstd.dptr_, gamma.dptr_, false);
+}
+/*!
+ * \brief forward of RMS normalization over each row,
+ *  out = gamma * data / sqrt(mean(data^2) + eps)
+ * \param out output, can be the same as data
+ * \param rstd output 1 / sqrt(mean(data^2) + eps) of each row
+ * \param data input data, of shape (nrow, ncol)
+ * \param gamma scale of each column
+ * \param eps small constant added to the mean square
+ * \tparam DType type of element
+ */
+template<typename DType>
+inline void RMSNormForward(Tensor<cpu, 2, DType> out,
+                           Tensor<cpu, 1, DType> rstd,
+                           const Tensor<cpu, 2, DType> &data,
+                           const Tensor<cpu, 1, DType> &gamma,
+                           DType eps) {
+  const index_t nrow = data.size(0), ncol = data.size(1);
+  CHECK(out.shape_ == data.shape_ && rstd.size(0) == nrow && gamma.size(0) == ncol)
+    << "RMSNormForward: shape mismatch";
+  MSHADOW_TRACE_SCOPE("RMSNormForward", "op", data.shape_, 4.0 * data.shape_.Size(),
+                      2.0 * sizeof(DType) * data.shape_.Size());
+  MSHADOW_OMP_PARALLEL_FOR(data.shape_.Size())
+  for (index_t r = 0; r < nrow; ++r) {
+    double m, m2;
+    layernorm::RowStats(data[r].dptr_, ncol, false, &m, &m2);
+    rstd[r] = static_cast<DType>(1.0 / std::sqrt(m2 / ncol + eps));
+    layernorm::Kernel<DType>::Normalize(out[r].dptr_, data[r].dptr_, ncol, DType(0), rstd[r],
+                                        gamma.dptr_, static_cast<const DType*>(NULL));
+  }
+}
+/*!
+ * \brief backward of RMS normalization
+ * \param grad_in output gradient of data, can be the same as grad_out
+ * \param grad_gamma output gradient of gamma
+ * \param grad_out gradient of the output of forward
+ * \param data input data of forward
+ * \param rstd rstd computed by forward
+ * \param gamma scale of each column
+ * \tparam DType type of element
+ */
+template<typename DType>
+inline void RMSNormBackward(Tensor<cpu, 2, DType> grad_in,
+                            Tensor<cpu, 1, DType> grad_gamma,
+                            const Tensor<cpu, 2, DType> &grad_out,
+                            const Tensor<cpu, 2, DType> &data,
+                            const Tensor<cpu, 1, DType> &rstd,
+                            const Tensor<cpu, 1, DType> &gamma) {
+  const index_t nrow = data.size(0), ncol = data.size(1);
+  CHECK(grad_in.shape_ == data.shape_ && grad_out.shape_ == data.shape_ &&
+        grad_gamma.size(0) == ncol && gamma.size(0) == ncol && rstd.size(0) == nrow)
+    << "RMSNormBackward: shape mismatch";
+  MSHADOW_TRACE_SCOPE("RMSNormBackward", "op", data.shape_, 9.0 * data.shape_.Size(),
+                      3.0 * sizeof(DType) * data.shape_.Size());
+  layernorm::Backward(grad_in, grad_gamma.dptr_, static_cast<DType*>(NULL), grad_out, data,
+                      static_cast<const DType*>(NULL), rstd.dptr_, gamma.dptr_, true);
+}
+}  // namespace mshadow
+#endif  // MSHADOW_EXTENSION_LAYER_NORM_H_
@@ -0,0 +1,426 @@
+/*!
+ *  Copyright (c) 2014 by Contributors
+ * \file optimizer.h
+ * \brief fused multi-tensor optimizer updates on cpu. One call updates a
+ *  list of parameters, the tensors are cut into chunks of similar size,
+ *  consecutive small tensors are grouped into one task, and the tasks run
+ *  in parallel. Each element is read and written once per step.
+ *
+ *    std::vector<Tensor<cpu, 2> > w, g, m;
+ *    w.push_back(wmat.FlatTo2D()); g.push_back(gwmat.FlatTo2D()); ...
+ *    MultiSGDMomUpdate(w, g, m, param);
+ * \author Tianqi Chen
+ */
+#ifndef MSHADOW_EXTENSION_OPTIMIZER_H_
+#define MSHADOW_EXTENSION_OPTIMIZER_H_
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "../extension.h"
+#include "../sse-inl.h"
+
+namespace mshadow {
+/*! \brief parameters of SGD, with momentum for MultiSGDMomUpdate */
+struct SGDParam {
+  /*! \brief learning rate */
+  float lr;
+  /*! \brief weight decay */
+  float wd;
+  /*! \brief momentum */
+  float momentum;
+  /*! \brief scale of the gradient, e.g. 1 / batch_size */
+  float rescale_grad;
+  SGDParam(void) : lr(0.01f), wd(0.0f), momentum(0.9f), rescale_grad(1.0f) {}
+};
+/*! \brief parameters of Adam and LAMB */
+struct AdamParam {
+  /*! \brief learning rate */
+  float lr;
+  /*! \brief weight decay, added to the gradient by Adam and to the update by LAMB */
+  float wd;
+  float beta1, beta2, epsilon;
+  /*! \brief scale of the gradient, e.g. 1 / batch_size */
+  float rescale_grad;
+  /*! \brief number of the step, starting from 1, for bias correction */
+  int t;
+  AdamParam(void)
+      : lr(0.001f), wd(0.0f), beta1(0.9f), beta2(0.999f), epsilon(1e-8f),
+        rescale_grad(1.0f), t(1) {}
+};
+namespace optim {
+/*! \brief number of elements of one task */
+const index_t kChunk = 1 << 15;
+/*! \brief a contiguous piece of a parameter */
+struct Segment {
+  index_t tensor, row, col, len;
+};
+/*!
+ * \brief parameters and their states as lists of 2D tensors, a tensor whose
+ *  roles are all contiguous is viewed as one row, so it can be cut anywhere
+ */
+template<typename DType, int nrole>
+struct TensorLists {
+  std::vector<Tensor<cpu, 2, DType> > view[nrole];
+  std::vector<Segment> seg;
+  /*! \brief tasks are seg[task[i]] to seg[task[i + 1] - 1] */
+  std::vector<size_t> task;
+  explicit TensorLists(const std::vector<Tensor<cpu, 2, DType> > *const *roles) {
+    const index_t ntensor = static_cast<index_t>(roles[0]->size());
+    for (int k = 1; k < nrole; ++k) {
+      CHECK_EQ(roles[k]->size(), ntensor) << "optimizer: number of tensors mismatch";
+    }
+    for (index_t t = 0; t < ntensor; ++t) {
+      bool contiguous = true;
+      for (int k = 0; k < nrole; ++k) {
+        const Tensor<cpu, 2, DType> &x = (*roles[k])[t];
+        CHECK_EQ(x.shape_, (*roles[0])[t].shape_) << "optimizer: shape mismatch";
+        contiguous = contiguous && x.CheckContiguous();
+      }
+      for (int k = 0; k < nrole; ++k) {
+        const Tensor<cpu, 2, DType> &x = (*roles[k])[t];
+        const index_t size = x.shape_.Size();
+        view[k].push_back(contiguous ?
+                          Tensor<cpu, 2, DType>(x.dptr_, Shape2(1, size), size, x.stream_) : x);
+      }
+      const Tensor<cpu, 2, DType> &x = view[0][t];
+      for (index_t r = 0; r < x.size(0); ++r) {
+        for (index_t c = 0; c < x.size(1); c += kChunk) {
+          Segment s;
+          s.tensor = t; s.row = r; s.col = c;
+          s.len = std::min(kChunk, x.size(1) - c);
+          seg.push_back(s);
+        }
+      }
+    }
+    // group consecutive segments into tasks of about kChunk elements
+    index_t acc = kChunk;
+    for (size_t i = 0; i < seg.size(); ++i) {
+      if (acc >= kChunk) {
+        task.push_back(i); acc = 0;
+      }
+      acc += seg[i].len;
+    }
+    task.push_back(seg.size());
+  }
+  /*! \brief pointer of role k of a segment */
+  inline DType *Ptr(int k, const Segment &s) const {
+    return view[k][s.tensor][s.row].dptr_ + s.col;
+  }
+  /*! \brief total number of elements */
+  inline double Size(void) const {
+    double size = 0;
+    for (size_t i = 0; i < seg.size(); ++i) size += seg[i].len;
+    return size;
+  }
+  /*! \brief run op(p, len, segment id) on all segments, tasks in parallel */
+  template<typename Op>
+  inline void Run(const Op &op) const {
+    const index_t ntask = static_cast<index_t>(task.size()) - 1;
+    #if defined(_OPENMP)
+    #pragma omp parallel for schedule(dynamic, 1) if (ntask > 1)
+    #endif
+    for (index_t i = 0; i < ntask; ++i) {
+      for (size_t j = task[i]; j < task[i + 1]; ++j) {
+        DType *p[nrole];
+        for (int k = 0; k < nrole; ++k) p[k] = this->Ptr(k, seg[j]);
+        op(p, seg[j].len, j);
+      }
+    }
+  }
+};
+/*! \brief w -= lr * (rescale * g + wd * w) */
+struct SGD {
+  float lr, wd, rescale;
+  explicit SGD(const SGDParam &param)
+      : lr(param.lr), wd(param.wd), rescale(param.rescale_grad) {}
+  template<typename DType>
+  inline void Elem(DType *const *p, index_t j) const {
+    p[0][j] -= lr * (rescale * p[1][j] + wd * p[0][j]);
+  }
+  template<typename DType>
+  inline void operator()(DType *const *p, index_t n, size_t) const {
+    for (index_t j = 0; j < n; ++j) this->Elem(p, j);
+  }
+#if MSHADOW_USE_SSE
+  inline void operator()(float *const *p, index_t n, size_t) const {
+    const index_t nv = (n >> 2) << 2;
+    const __m128 vlr = _mm_set1_ps(lr), vwd = _mm_set1_ps(wd), vrs = _mm_set1_ps(rescale);
+    for (index_t j = 0; j < nv; j += 4) {
+      const __m128 w = _mm_loadu_ps(p[0] + j), g = _mm_loadu_ps(p[1] + j);
+      const __m128 d = _mm_add_ps(_mm_mul_ps(vrs, g), _mm_mul_ps(vwd, w));
+      _mm_storeu_ps(p[0] + j, _mm_sub_ps(w, _mm_mul_ps(vlr, d)));
+    }
+    for (index_t j = nv; j < n; ++j) this->Elem(p, j);
+  }
+#endif  // MSHADOW_USE_SSE
+};
+/*! \brief m = momentum * m - lr * (rescale * g + wd * w), w += m */
+struct SGDMom {
+  float lr, wd, momentum, rescale;
+  explicit SGDMom(const SGDParam &param)
+      : lr(param.lr), wd(param.wd), momentum(param.momentum),
+        rescale(param.rescale_grad) {}
+  template<typename DType>
+  inline void Elem(DType *const *p, index_t j) const {
+    p[2][j] = momentum * p[2][j] - lr * (rescale * p[1][j] + wd * p[0][j]);
+    p[0][j] += p[2][j];
+  }
+  template<typename DType>
+  inline void operator()(DType *const *p, index_t n, size_t) const {
+    for (index_t j = 0; j < n; ++j) this->Elem(p, j);
+  }
+#if MSHADOW_USE_SSE
+  inline void operator()(float *const *p, index_t n, size_t) const {
+    const index_t nv = (n >> 2) << 2;
+    const __m128 vlr = _mm_set1_ps(lr), vwd = _mm_set1_ps(wd);
+    const __m128 vmom = _mm_set1_ps(momentum), vrs = _mm_set1_ps(rescale);
+    for (index_t j = 0; j < nv; j += 4) {
+      const __m128 w = _mm_loadu_ps(p[0] + j), g = _mm_loadu_ps(p[1] + j);
+      const __m128 d = _mm_add_ps(_mm_mul_ps(vrs, g), _mm_mul_ps(vwd, w));
+      const __m128 m = _mm_sub_ps(_mm_mul_ps(vmom, _mm_loadu_ps(p[2] + j)),
+                                  _mm_mul_ps(vlr, d));
+      _mm_storeu_ps(p[2] + j, m);
+      _mm_storeu_ps(p[0] + j, _mm_add_ps(w, m));
+    }
+    for (index_t j = nv; j < n; ++j) this->Elem(p, j);
+  }
+#endif  // MSHADOW_USE_SSE
+};
+/*!
+ * \brief moments of Adam and LAMB, g' = rescale * g + wd_grad * w,
+ *  m = beta1 * m + (1 - beta1) * g', v = beta2 * v + (1 - beta2) * g'^2,
+ *  the update direction is r = m * c1 / (sqrt(v * c2) + eps) + wd_update * w,
+ *  where c1, c2 are the bias corrections
+ */
+struct AdamDir {
+  float wd_grad, wd_update, beta1, beta2, eps, rescale, c1, c2;
+  AdamDir(const AdamParam &param, bool lamb) {
+    CHECK_GE(param.t, 1) << "Adam: step t starts from 1";
+    wd_grad = lamb ? 0.0f : param.wd;
+    wd_update = lamb ? param.wd : 0.0f;
+    beta1 = param.beta1; beta2 = param.beta2;
+    eps = param.epsilon; rescale = param.rescale_grad;
+    c1 = 1.0f / (1.0f - std::pow(param.beta1, static_cast<float>(param.t)));
+    c2 = 1.0f / (1.0f - std::pow(param.beta2, static_cast<float>(param.t)));
+  }
+  /*! \brief update the moments and return r */
+  template<typename DType>
+  inline DType Moment(DType *const *p, index_t j) const {
+    const DType g = rescale * p[1][j] + wd_grad * p[0][j];
+    const DType m = beta1 * p[2][j] + (1.0f - beta1) * g;
+    const DType v = beta2 * p[3][j] + (1.0f - beta2) * g * g;
+    p[2][j] = m; p[3][j] = v;
+    return this->Dir(m, v, p[0][j]);
+  }
+  /*! \brief r from the updated moments */
+  template<typename DType>
+  inline DType Dir(DType m, DType v, DType w) const {
+    return m * c1 / (std::sqrt(v * c2) + eps) + wd_update * w;
+  }
+#if MSHADOW_USE_SSE
+  /*! \brief SSE version of Moment, four elements at j */
+  inline __m128 MomentSSE(float *const *p, index_t j) const {
+    const __m128 w = _mm_loadu_ps(p[0] + j);
+    const __m128 g = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(rescale), _mm_loadu_ps(p[1] + j)),
+                                _mm_mul_ps(_mm_set1_ps(wd_grad), w));
+    const __m128 m = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(beta1), _mm_loadu_ps(p[2] + j)),
+                                _mm_mul_ps(_mm_set1_ps(1.0f - beta1), g));
+    const __m128 v = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(beta2), _mm_loadu_ps(p[3] + j)),
+                                _mm_mul_ps(_mm_set1_ps(1.0f - beta2), _mm_mul_ps(g, g)));
+    _mm_storeu_ps(p[2] + j, m);
+    _mm_storeu_ps(p[3] + j, v);
+    return this->DirSSE(m, v, w);
+  }
+  inline __m128 DirSSE(__m128 m, __m128 v, __m128 w) const {
+    const __m128 den = _mm_add_ps(_mm_sqrt_ps(_mm_mul_ps(v, _mm_set1_ps(c2))),
+                                  _mm_set1_ps(eps));
+    return _mm_add_ps(_mm_div_ps(_mm_mul_ps(m, _mm_set1_ps(c1)), den),
+                      _mm_mul_ps(_mm_set1_ps(wd_update), w));
+  }
+#endif  // MSHADOW_USE_SSE
+};
+/*! \brief w -= lr * r of Adam */
+struct Adam {
+  AdamDir dir;
+  float lr;
+  explicit Adam(const AdamParam &param) : dir(param, false), lr(param.lr) {}
+  template<typename DType>
+  inline void operator()(DType *const *p, index_t n, size_t) const {
+    for (index_t j = 0; j < n; ++j) p[0][j] -= lr * dir.Moment(p, j);
+  }
+#if MSHADOW_USE_SSE
+  inline void operator()(float *const *p, index_t n, size_t) const {
+    const index_t nv = (n >> 2) << 2;
+    const __m128 vlr = _mm_set1_ps(lr);
+    for (index_t j = 0; j < nv; j += 4) {
+      const __m128 r = dir.MomentSSE(p, j);
+      _mm_storeu_ps(p[0] + j, _mm_sub_ps(_mm_loadu_ps(p[0] + j), _mm_mul_ps(vlr, r)));
+    }
+    for (index_t j = nv; j < n; ++j) p[0][j] -= lr * dir.Moment(p, j);
+  }
+#endif  // MSHADOW_USE_SSE
+};
+/*! \brief first pass of LAMB, updates the moments and sums w^2 and r^2 of each segment */
+struct LAMBNorm {
+  AdamDir dir;
+  /*! \brief two sums of each segment */
+  double *sum;
+  LAMBNorm(const AdamParam &param, double *sum) : dir(param, true), sum(sum) {}
+  template<typename DType>
+  inline void operator()(DType *const *p, index_t n, size_t seg) const {
+    double sw = 0, sr = 0;
+    for (index_t j = 0; j < n; ++j) {
+      const DType r = dir.Moment(p, j);
+      sw += static_cast<double>(p[0][j]) * p[0][j];
+      sr += static_cast<double>(r) * r;
+    }
+    sum[seg * 2] = sw; sum[seg * 2 + 1] = sr;
+  }
+#if MSHADOW_USE_SSE
+  inline void operator()(float *const *p, index_t n, size_t seg) const {
+    const index_t nv = (n >> 2) << 2;
+    __m128 vw = _mm_setzero_ps(), vr = _mm_setzero_ps();
+    for (index_t j = 0; j < nv; j += 4) {
+      const __m128 r = dir.MomentSSE(p, j), w = _mm_loadu_ps(p[0] + j);
+      vw = _mm_add_ps(vw, _mm_mul_ps(w, w));
+      vr = _mm_add_ps(vr, _mm_mul_ps(r, r));
+    }
+    double sw = sse2::FVec<float>(vw).Sum(), sr = sse2::FVec<float>(vr).Sum();
+    for (index_t j = nv; j < n; ++j) {
+      const float r = dir.Moment(p, j);
+      sw += static_cast<double>(p[0][j]) * p[0][j];
+      sr += static_cast<double>(r) * r;
+    }
+    sum[seg * 2] = sw; sum[seg * 2 + 1] = sr;
+  }
+#endif  // MSHADOW_USE_SSE
+};
+/*! \brief second pass of LAMB, w -= lr * trust * r with the trust ratio of each segment */
+struct LAMBApply {
+  AdamDir dir;
+  /*! \brief lr * trust of each segment */
+  const float *scale;
+  LAMBApply(const AdamParam &param, const float *scale)
+      : dir(param, true), scale(scale) {}
+  template<typename DType>
+  inline void operator()(DType *const *p, index_t n, size_t seg) const {
+    const DType s = scale[seg];
+    for (index_t j = 0; j < n; ++j) {
+      p[0][j] -= s * dir.Dir(p[2][j], p[3][j], p[0][j]);
+    }
+  }
+#if MSHADOW_USE_SSE
+  inline void operator()(float *const *p, index_t n, size_t seg) const {
+    const index_t nv = (n >> 2) << 2;
+    const __m128 vs = _mm_set1_ps(scale[seg]);
+    for (index_t j = 0; j < nv; j += 4) {
+      const __m128 w = _mm_loadu_ps(p[0] + j);
+      const __m128 r = dir.DirSSE(_mm_loadu_ps(p[2] + j), _mm_loadu_ps(p[3] + j), w);
+      _mm_storeu_ps(p[0] + j, _mm_sub_ps(w, _mm_mul_ps(vs, r)));
+    }
+    for (index_t j = nv; j < n; ++j) {
+      p[0][j] -= scale[seg] * dir.Dir(p[2][j], p[3][j], p[0][j]);
+    }
+  }
+#endif  // MSHADOW_USE_SSE
+};
+}  // namespace optim
+/*!
+ * \brief SGD update of a list of parameters, w -= lr * (rescale_grad * g + wd * w)
+ * \param weight parameters, e.g. w.FlatTo2D()
+ * \param grad gradients of the same shapes as weight
+ * \param param parameters of SGD, momentum is not used
+ * \tparam DType the type of elements
+ */
+template<typename DType>
+inline void MultiSGDUpdate(const std::vector<Tensor<cpu, 2, DType> > &weight,
+                           const std::vector<Tensor<cpu, 2, DType> > &grad,
+                           const SGDParam &param) {
+  const std::vector<Tensor<cpu, 2, DType> > *roles[2] = {&weight, &grad};
+  const optim::TensorLists<DType, 2> lists(roles);
+  MSHADOW_TRACE_SCOPE("MultiSGDUpdate", "op", Shape1(weight.size()), 4.0 * lists.Size(),
+                      3.0 * sizeof(DType) * lists.Size());
+  lists.Run(optim::SGD(param));
+}
+/*!
+ * \brief SGD with momentum of a list of parameters,
+ *  mom = momentum * mom - lr * (rescale_grad * g + wd * w), w += mom
+ * \param weight parameters, e.g. w.FlatTo2D()
+ * \param grad gradients of the same shapes as weight
+ * \param mom momentum states of the same shapes as weight
+ * \param param parameters of SGD
+ * \tparam DType the type of elements
+ */
+template<typename DType>
+inline void MultiSGDMomUpdate(const std::vector<Tensor<cpu, 2, DType> > &weight,
+                              const std::vector<Tensor<cpu, 2, DType> > &grad,
+                              const std::vector<Tensor<cpu, 2, DType> > &mom,
+                              const SGDParam &param) {
+  const std::vector<Tensor<cpu, 2, DType> > *roles[3] = {&weight, &grad, &mom};
+  const optim::TensorLists<DType, 3> lists(roles);
+  MSHADOW_TRACE_SCOPE("MultiSGDMomUpdate", "op", Shape1(weight.size()), 6.0 * lists.Size(),
+                      5.0 * sizeof(DType) * lists.Size());
+  lists.Run(optim::SGDMom(param));
+}
+/*!
+ * \brief Adam update of a list of parameters, the weight decay is added to the gradient
+ * \param weight parameters, e.g. w.FlatTo2D()
+ * \param grad gradients of the same shapes as weight
+ * \param mean first moments of the same shapes as weight
+ * \param var second moments of the same shapes as weight
+ * \param param parameters of Adam, param.t is the step starting from 1
+ * \tparam DType the type of elements
+ */
+template<typename DType>
+inline void MultiAdamUpdate(const std::vector<Tensor<cpu, 2, DType> > &weight,
+                            const std::vector<Tensor<cpu, 2, DType> > &grad,
+                            const std::vector<Tensor<cpu, 2, DType> > &mean,
+                            const std::vector<Tensor<cpu, 2, DType> > &var,
+                            const AdamParam &param) {
+  const std::vector<Tensor<cpu, 2, DType> > *roles[4] = {&weight, &grad, &mean, &var};
+  const optim::TensorLists<DType, 4> lists(roles);
+  MSHADOW_TRACE_SCOPE("MultiAdamUpdate", "op", Shape1(weight.size()), 14.0 * lists.Size(),
+                      7.0 * sizeof(DType) * lists.Size());
+  lists.Run(optim::Adam(param));
+}
+/*!
+ * \brief LAMB update of a list of parameters, r is the Adam direction plus
+ *  wd * w, and each tensor is updated by w -= lr * |w| / |r| * r. The norms
+ *  are reduced per tensor between two passes over the data.
+ * \param weight parameters, e.g. w.FlatTo2D()
+ * \param grad gradients of the same shapes as weight
+ * \param mean first moments of the same shapes as weight
+ * \param var second moments of the same shapes as weight
+ * \param param parameters of LAMB, param.t is the step starting from 1
+ * \tparam DType the type of elements
+ */
+template<typename DType>
+inline void MultiLAMBUpdate(const std::vector<Tensor<cpu, 2, DType> > &weight,
+                            const std::vector<Tensor<cpu, 2, DType> > &grad,
+                            const std::vector<Tensor<cpu, 2, DType> > &mean,
+                            const std::vector<Tensor<cpu, 2, DType> > &var,
+                            const AdamParam &param) {
+  const std::vector<Tensor<cpu, 2, DType> > *roles[4] = {&weight, &grad, &mean, &var};
+  const optim::TensorLists<DType, 4> lists(roles);
+  MSHADOW_TRACE_SCOPE("MultiLAMBUpdate", "op", Shape1(weight.size()), 24.0 * lists.Size(),
+                      10.0 * sizeof(DType) * lists.Size());
+  const size_t nseg = lists.seg.size();
+  if (nseg == 0) return;
+  std::vector<double> sum(nseg * 2);
+  lists.Run(optim::LAMBNorm(param, &sum[0]));
+  // reduce the norms of each tensor, segments of a tensor are consecutive
+  std::vector<float> scale(nseg);
+  for (size_t i = 0; i < nseg;) {
+    size_t j = i;
+    double sw = 0, sr = 0;
+    for (; j < nseg && lists.seg[j].tensor == lists.seg[i].tensor; ++j) {
+      sw += sum[j * 2]; sr += sum[j * 2 + 1];
+    }
+    const double trust = (sw > 0 && sr > 0) ? std::sqrt(sw / sr) : 1.0;
+    std::fill(scale.begin() + i, scale.begin() + j, static_cast<float>(param.lr * trust));
+    i = j;
+  }
+  lists.Run(optim::LAMBApply(param, &scale[0]));
+}
+}  // namespace mshadow
+#endif  // MSHADOW_EXTENSION_OPTIMIZER_H_
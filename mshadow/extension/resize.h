@@ -0,0 +1,324 @@
+/*!
+ *  Copyright (c) 2014 by Contributors
+ * \file resize.h
+ * \brief nearest neighbor upsampling and bilinear resizing of the last two
+ *  dimensions, and their gradients. Bilinear uses the pixel center convention,
+ *  source coordinate = (dst + 0.5) * isize / osize - 0.5, clamped to the border.
+ * \author Tianqi Chen
+ */
+#ifndef MSHADOW_EXTENSION_RESIZE_H_
+#define MSHADOW_EXTENSION_RESIZE_H_
+#include <algorithm>
+#include <vector>
+#include "../extension.h"
+#include "../sse-inl.h"
+
+namespace mshadow {
+namespace resize {
+/*!
+ * \brief source positions of a dst coordinate, dst is interpolated as
+ *  src[i0] * (1 - l) + src[i1] * l
+ * \param o dst coordinate
+ * \param scale isize / osize
+ * \param isize size of source
+ */
+template<typename DType>
+MSHADOW_XINLINE void Coord(index_t o, float scale, index_t isize,
+                           index_t *i0, index_t *i1, DType *l) {
+  float s = (static_cast<float>(o) + 0.5f) * scale - 0.5f;
+  if (s < 0.0f) s = 0.0f;
+  index_t i = static_cast<index_t>(s);
+  if (i > isize - 1) i = isize - 1;
+  *i0 = i;
+  *i1 = i + 1 < isize ? i + 1 : i;
+  *l = static_cast<DType>(s - static_cast<float>(i));
+}
+/*! \brief precomputed source positions and weights of each dst coordinate */
+template<typename DType>
+struct Table {
+  std::vector<index_t> i0, i1;
+  std::vector<DType> l;
+  Table(index_t isize, index_t osize)
+      : i0(osize), i1(osize), l(osize) {
+    const float scale = static_cast<float>(isize) / static_cast<float>(osize);
+    for (index_t o = 0; o < osize; ++o) {
+      Coord(o, scale, isize, &i0[o], &i1[o], &l[o]);
+    }
+  }
+};
+/*! \brief kernels on a row, generic version */
+template<typename DType>
+struct Kernel {
+  /*! \brief dst = a + l * (b - a) */
+  inline static void Lerp(DType *dst, const DType *a, const DType *b, DType l, index_t n) {
+    for (index_t i = 0; i < n; ++i) dst[i] = a[i] + l * (b[i] - a[i]);
+  }
+  /*! \brief dst += l * src */
+  inline static void Axpy(DType *dst, const DType *src, DType l, index_t n) {
+    for (index_t i = 0; i < n; ++i) dst[i] += l * src[i];
+  }
+};
+#if MSHADOW_USE_SSE
+template<>
+struct Kernel<float> {
+  inline static void Lerp(float *dst, const float *a, const float *b, float l, index_t n) {
+    const index_t nv = (n >> 2) << 2;
+    const __m128 vl = _mm_set1_ps(l);
+    for (index_t i = 0; i < nv; i += 4) {
+      const __m128 va = _mm_loadu_ps(a + i);
+      const __m128 vb = _mm_loadu_ps(b + i);
+      _mm_storeu_ps(dst + i, _mm_add_ps(va, _mm_mul_ps(vl, _mm_sub_ps(vb, va))));
+    }
+    for (index_t i = nv; i < n; ++i) dst[i] = a[i] + l * (b[i] - a[i]);
+  }
+  inline static void Axpy(float *dst, const float *src, float l, index_t n) {
+    const index_t nv = (n >> 2) << 2;
+    const __m128 vl = _mm_set1_ps(l);
+    for (index_t i = 0; i < nv; i += 4) {
+      _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i),
+                                        _mm_mul_ps(vl, _mm_loadu_ps(src + i))));
+    }
+    for (index_t i = nv; i < n; ++i) dst[i] += l * src[i];
+  }
+};
+#endif  // MSHADOW_USE_SSE
+/*! \brief horizontal interpolation of a source row, dst[x] = src[i0[x]] * (1 - l[x]) + src[i1[x]] * l[x] */
+template<typename DType>
+inline void RowInterp(DType *dst, const DType *src, const Table<DType> &tx) {
+  const index_t n = static_cast<index_t>(tx.l.size());
+  for (index_t x = 0; x < n; ++x) {
+    const DType a = src[tx.i0[x]];
+    dst[x] = a + tx.l[x] * (src[tx.i1[x]] - a);
+  }
+}
+/*! \brief view of a tensor as (planes, height, width) */
+template<int dim, typename DType>
+inline Tensor<cpu, 3, DType> Planes(const Tensor<cpu, dim, DType> &t) {
+  const index_t height = t.size(dim - 2), width = t.size(dim - 1);
+  const index_t nplane = height == 0 ? 0 : t.shape_.FlatTo2D()[0] / height;
+  return Tensor<cpu, 3, DType>(t.dptr_, Shape3(nplane, height, width), t.stride_, t.stream_);
+}
+}  // namespace resize
+
+namespace expr {
+/*!
+ * \brief nearest neighbor upsampling of the last two dimensions by an integer scale
+ * \tparam SrcExp source expression
+ * \tparam DType the type of elements
+ * \tparam srcdim dimension of src
+ */
+template<typename SrcExp, typename DType, int srcdim>
+struct UpSamplingNearestExp:
+      public MakeTensorExp<UpSamplingNearestExp<SrcExp, DType, srcdim>,
+                           SrcExp, srcdim, DType> {
+  /*! \brief source operand */
+  const SrcExp &src_;
+  /*! \brief upsampling scale */
+  index_t scale_;
+  /*! \brief source height */
+  index_t src_height_;
+  /*! \brief constructor */
+  UpSamplingNearestExp(const SrcExp &src, index_t scale)
+      : src_(src), scale_(scale) {
+    CHECK_NE(scale, 0U) << "upsample_nearest: scale must be positive";
+    this->shape_ = ShapeCheck<srcdim, SrcExp>::Check(src_);
+    src_height_ = this->shape_[srcdim - 2];
+    this->shape_[srcdim - 2] *= scale;
+    this->shape_[srcdim - 1] *= scale;
+  }
+};
+/*!
+ * \brief nearest neighbor upsampling, out[y][x] = src[y / scale][x / scale]
+ * \param src source image batches
+ * \param scale integer scale of height and width
+ * \return expression with height and width multiplied by scale
+ * \tparam SrcExp source expression
+ * \tparam DType the type of elements
+ * \tparam etype type of expression
+ */
+template<typename SrcExp, typename DType, int etype>
+inline UpSamplingNearestExp<SrcExp, DType, ExpInfo<SrcExp>::kDim>
+upsample_nearest(const Exp<SrcExp, DType, etype> &src, index_t scale) {
+  TypeCheckPass<ExpInfo<SrcExp>::kDim >= 2>
+      ::Error_Expression_Does_Not_Meet_Dimension_Req();
+  return UpSamplingNearestExp<SrcExp, DType, ExpInfo<SrcExp>::kDim>(src.self(), scale);
+}
+/*!
+ * \brief bilinear resizing of the last two dimensions
+ * \tparam SrcExp source expression
+ * \tparam DType the type of elements
+ * \tparam srcdim dimension of src
+ */
+template<typename SrcExp, typename DType, int srcdim>
+struct ResizeBilinearExp:
+      public MakeTensorExp<ResizeBilinearExp<SrcExp, DType, srcdim>,
+                           SrcExp, srcdim, DType> {
+  /*! \brief source operand */
+  const SrcExp &src_;
+  /*! \brief source height */
+  index_t src_height_;
+  /*! \brief source width */
+  index_t src_width_;
+  /*! \brief constructor */
+  ResizeBilinearExp(const SrcExp &src, index_t oheight, index_t owidth)
+      : src_(src) {
+    this->shape_ = ShapeCheck<srcdim, SrcExp>::Check(src_);
+    src_height_ = this->shape_[srcdim - 2];
+    src_width_ = this->shape_[srcdim - 1];
+    CHECK(src_height_ != 0 && src_width_ != 0) << "resize_bilinear: empty source";
+    this->shape_[srcdim - 2] = oheight;
+    this->shape_[srcdim - 1] = owidth;
+  }
+};
+/*!
+ * \brief bilinear resizing of image batches to (oheight, owidth)
+ * \param src source image batches
+ * \param oheight output height
+ * \param owidth output width
+ * \return expression of the resized images
+ * \tparam SrcExp source expression
+ * \tparam DType the type of elements
+ * \tparam etype type of expression
+ */
+template<typename SrcExp, typename DType, int etype>
+inline ResizeBilinearExp<SrcExp, DType, ExpInfo<SrcExp>::kDim>
+resize_bilinear(const Exp<SrcExp, DType, etype> &src, index_t oheight, index_t owidth) {
+  TypeCheckPass<ExpInfo<SrcExp>::kDim >= 2>
+      ::Error_Expression_Does_Not_Meet_Dimension_Req();
+  return ResizeBilinearExp<SrcExp, DType, ExpInfo<SrcExp>::kDim>(src.self(), oheight, owidth);
+}
+//----------------------
+// Execution plan
+//----------------------
+template<typename SrcExp, typename DType, int srcdim>
+struct Plan<UpSamplingNearestExp<SrcExp, DType, srcdim>, DType> {
+ public:
+  explicit Plan(const UpSamplingNearestExp<SrcExp, DType, srcdim> &e)
+      : src_(MakePlan(e.src_)), scale_(e.scale_),
+        src_height_(e.src_height_), new_height_(e.shape_[srcdim - 2]) {}
+  MSHADOW_XINLINE DType Eval(index_t i, index_t j) const {
+    const index_t y = i % new_height_;
+    const index_t c = i / new_height_;
+    return src_.Eval(c * src_height_ + y / scale_, j / scale_);
+  }
+
+ private:
+  Plan<SrcExp, DType> src_;
+  const index_t scale_, src_height_, new_height_;
+};
+template<typename SrcExp, typename DType, int srcdim>
+struct Plan<ResizeBilinearExp<SrcExp, DType, srcdim>, DType> {
+ public:
+  explicit Plan(const ResizeBilinearExp<SrcExp, DType, srcdim> &e)
+      : src_(MakePlan(e.src_)), src_height_(e.src_height_), src_width_(e.src_width_),
+        new_height_(e.shape_[srcdim - 2]),
+        scale_y_(static_cast<float>(e.src_height_) / static_cast<float>(e.shape_[srcdim - 2])),
+        scale_x_(static_cast<float>(e.src_width_) / static_cast<float>(e.shape_[srcdim - 1])) {}
+  MSHADOW_XINLINE DType Eval(index_t i, index_t j) const {
+    const index_t y = i % new_height_;
+    const index_t row = (i / new_height_) * src_height_;
+    index_t y0, y1, x0, x1;
+    DType ly, lx;
+    resize::Coord(y, scale_y_, src_height_, &y0, &y1, &ly);
+    resize::Coord(j, scale_x_, src_width_, &x0, &x1, &lx);
+    const DType a = src_.Eval(row + y0, x0), b = src_.Eval(row + y0, x1);
+    const DType c = src_.Eval(row + y1, x0), d = src_.Eval(row + y1, x1);
+    const DType top = a + lx * (b - a), bottom = c + lx * (d - c);
+    return top + ly * (bottom - top);
+  }
+
+ private:
+  Plan<SrcExp, DType> src_;
+  const index_t src_height_, src_width_, new_height_;
+  const float scale_y_, scale_x_;
+};
+}  // namespace expr
+/*!
+ * \brief gradient of upsample_nearest, grad_in[y][x] is the sum of
+ *  grad_out over its scale x scale block, planes are processed in parallel
+ * \param grad_in gradient of source, overwritten
+ * \param grad_out gradient of the upsampled output
+ * \param scale upsampling scale
+ * \tparam dim dimension of tensors
+ * \tparam DType the type of elements
+ */
+template<int dim, typename DType>
+inline void UpSampleNearestBackward(Tensor<cpu, dim, DType> grad_in,
+                                    const Tensor<cpu, dim, DType> &grad_out,
+                                    index_t scale) {
+  Shape<dim> oshape = grad_in.shape_;
+  oshape[dim - 2] *= scale; oshape[dim - 1] *= scale;
+  CHECK_EQ(oshape, grad_out.shape_) << "UpSampleNearestBackward: shape mismatch";
+  MSHADOW_TRACE_SCOPE("UpSampleNearestBackward", "op", grad_out.shape_,
+                      grad_out.shape_.Size(),
+                      sizeof(DType) * (grad_in.shape_.Size() + grad_out.shape_.Size()));
+  const Tensor<cpu, 3, DType> din = resize::Planes(grad_in);
+  const Tensor<cpu, 3, DType> dout = resize::Planes(grad_out);
+  const index_t nplane = din.size(0), height = din.size(1), width = din.size(2);
+  MSHADOW_OMP_PARALLEL_FOR(grad_out.shape_.Size())
+  for (index_t p = 0; p < nplane; ++p) {
+    for (index_t y = 0; y < height; ++y) {
+      DType *pin = din[p][y].dptr_;
+      std::fill(pin, pin + width, DType(0));
+      for (index_t k = 0; k < scale; ++k) {
+        const DType *pout = dout[p][y * scale + k].dptr_;
+        for (index_t x = 0; x < width; ++x) {
+          DType s = 0;
+          for (index_t t = 0; t < scale; ++t) s += pout[x * scale + t];
+          pin[x] += s;
+        }
+      }
+    }
+  }
+}
+/*!
+ * \brief gradient of resize_bilinear, each row of grad_out is spread back
+ *  along width, then added to the two source rows with their weights.
+ *  Planes are processed in parallel.
+ * \param grad_in gradient of source, overwritten
+ * \param grad_out gradient of the resized output
+ * \tparam dim dimension of tensors
+ * \tparam DType the type of elements
+ */
+template<int dim, typename DType>
+inline void ResizeBilinearBackward(Tensor<cpu, dim, DType> grad_in,
+                                   const Tensor<cpu, dim, DType> &grad_out) {
+  for (int k = 0; k < dim - 2; ++k) {
+    CHECK_EQ(grad_in.size(k), grad_out.size(k)) << "ResizeBilinearBackward: shape mismatch";
+  }
+  MSHADOW_TRACE_SCOPE("ResizeBilinearBackward", "op", grad_out.shape_,
+                      4.0 * grad_out.shape_.Size(),
+                      sizeof(DType) * (2.0 * grad_in.shape_.Size() + grad_out.shape_.Size()));
+  const Tensor<cpu, 3, DType> din = resize::Planes(grad_in);
+  const Tensor<cpu, 3, DType> dout = resize::Planes(grad_out);
+  const index_t nplane = din.size(0), iheight = din.size(1), iwidth = din.size(2);
+  const index_t oheight = dout.size(1), owidth = dout.size(2);
+  if (iheight == 0 || iwidth == 0) return;
+  const resize::Table<DType> ty(iheight, oheight), tx(iwidth, owidth);
+  #if defined(_OPENMP)
+  #pragma omp parallel if (grad_out.shape_.Size() > MSHADOW_OMP_MIN_SIZE)
+  #endif
+  {
+    std::vector<DType> row(iwidth);
+    #if defined(_OPENMP)
+    #pragma omp for schedule(static)
+    #endif
+    for (index_t p = 0; p < nplane; ++p) {
+      for (index_t y = 0; y < iheight; ++y) {
+        std::fill(din[p][y].dptr_, din[p][y].dptr_ + iwidth, DType(0));
+      }
+      for (index_t y = 0; y < oheight; ++y) {
+        const DType *pout = dout[p][y].dptr_;
+        std::fill(row.begin(), row.end(), DType(0));
+        for (index_t x = 0; x < owidth; ++x) {
+          row[tx.i0[x]] += pout[x] - tx.l[x] * pout[x];
+          row[tx.i1[x]] += tx.l[x] * pout[x];
+        }
+        resize::Kernel<DType>::Axpy(din[p][ty.i0[y]].dptr_, &row[0], DType(1) - ty.l[y], iwidth);
+        resize::Kernel<DType>::Axpy(din[p][ty.i1[y]].dptr_, &row[0], ty.l[y], iwidth);
+      }
+    }
+  }
+}
+}  // namespace mshadow
+#endif  // MSHADOW_EXTENSION_RESIZE_H_
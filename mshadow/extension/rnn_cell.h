@@ -0,0 +1,354 @@
+/*!
+ *  Copyright (c) 2014 by Contributors
+ * \file rnn_cell.h
+ * \brief fused LSTM and GRU cells on cpu. The gates come from the gemm of
+ *  input and hidden state, the cell applies bias, activations and the state
+ *  update in one pass, instead of a dozen expression passes over the gates.
+ *  Each row of the gates holds the blocks of all gates of one sample:
+ *    LSTM: (batch, 4 * hidden), in the order of input, forget, cell, output
+ *    GRU:  (batch, 3 * hidden), in the order of reset, update, new
+ * \author Tianqi Chen
+ */
+#ifndef MSHADOW_EXTENSION_RNN_CELL_H_
+#define MSHADOW_EXTENSION_RNN_CELL_H_
+#include <cmath>
+#include "../extension.h"
+#include "../sse-inl.h"
+
+namespace mshadow {
+namespace rnn {
+template<typename DType>
+inline DType Sigmoid(DType x) {
+  return DType(1) / (DType(1) + std::exp(-x));
+}
+template<typename DType>
+inline DType Tanh(DType x) {
+  return std::tanh(x);
+}
+/*! \brief pointers to the gate blocks of one row */
+template<typename DType, int ngate>
+struct Gates {
+  DType *g[ngate];
+  Gates(DType *row, index_t nhidden) {
+    for (int k = 0; k < ngate; ++k) g[k] = row + k * nhidden;
+  }
+};
+/*!
+ * \brief scalar kernels of a row, each function works on columns
+ *  [begin, end) so that the SSE version can use it for the tail
+ */
+template<typename DType>
+struct Scalar {
+  /*!
+   * \brief gates = act(gates + bias), c = f * c_prev + i * g, h = o * tanh(c)
+   *  the activated gates are kept for backward
+   */
+  inline static void LSTMForward(Gates<DType, 4> a, Gates<const DType, 4> b,
+                                 const DType *c_prev, DType *c, DType *h,
+                                 index_t begin, index_t end) {
+    for (index_t j = begin; j < end; ++j) {
+      const DType i = Sigmoid(a.g[0][j] + b.g[0][j]), f = Sigmoid(a.g[1][j] + b.g[1][j]);
+      const DType g = Tanh(a.g[2][j] + b.g[2][j]), o = Sigmoid(a.g[3][j] + b.g[3][j]);
+      const DType cj = f * c_prev[j] + i * g;
+      a.g[0][j] = i; a.g[1][j] = f; a.g[2][j] = g; a.g[3][j] = o;
+      c[j] = cj;
+      h[j] = o * Tanh(cj);
+    }
+  }
+  /*! \brief gradient of LSTMForward, grad_c is the gradient of c from the next step */
+  inline static void LSTMBackward(Gates<DType, 4> d, Gates<const DType, 4> a,
+                                  const DType *c_prev, const DType *c,
+                                  const DType *grad_h, const DType *grad_c, DType *grad_c_prev,
+                                  index_t begin, index_t end) {
+    for (index_t j = begin; j < end; ++j) {
+      const DType i = a.g[0][j], f = a.g[1][j], g = a.g[2][j], o = a.g[3][j];
+      const DType tc = Tanh(c[j]);
+      const DType dc = grad_c[j] + grad_h[j] * o * (DType(1) - tc * tc);
+      const DType cp = c_prev[j];
+      d.g[0][j] = dc * g * i * (DType(1) - i);
+      d.g[1][j] = dc * cp * f * (DType(1) - f);
+      d.g[2][j] = dc * i * (DType(1) - g * g);
+      d.g[3][j] = grad_h[j] * tc * o * (DType(1) - o);
+      grad_c_prev[j] = dc * f;
+    }
+  }
+  /*!
+   * \brief r = sig(x_r + h_r), z = sig(x_z + h_z), n = tanh(x_n + r * h_n),
+   *  h = (1 - z) * n + z * h_prev, the biases are added to x and h,
+   *  r, z and n are kept in the gates of x for backward
+   */
+  inline static void GRUForward(Gates<DType, 3> x, Gates<const DType, 3> bx,
+                                Gates<const DType, 3> hg, Gates<const DType, 3> bh,
+                                const DType *h_prev, DType *h, index_t begin, index_t end) {
+    for (index_t j = begin; j < end; ++j) {
+      const DType r = Sigmoid(x.g[0][j] + bx.g[0][j] + hg.g[0][j] + bh.g[0][j]);
+      const DType z = Sigmoid(x.g[1][j] + bx.g[1][j] + hg.g[1][j] + bh.g[1][j]);
+      const DType n = Tanh(x.g[2][j] + bx.g[2][j] + r * (hg.g[2][j] + bh.g[2][j]));
+      x.g[0][j] = r; x.g[1][j] = z; x.g[2][j] = n;
+      h[j] = (DType(1) - z) * n + z * h_prev[j];
+    }
+  }
+  /*! \brief gradient of GRUForward */
+  inline static void GRUBackward(Gates<DType, 3> dx, Gates<DType, 3> dh,
+                                 Gates<const DType, 3> x, Gates<const DType, 3> hg,
+                                 Gates<const DType, 3> bh, const DType *h_prev,
+                                 const DType *grad_h, DType *grad_h_prev,
+                                 index_t begin, index_t end) {
+    for (index_t j = begin; j < end; ++j) {
+      const DType r = x.g[0][j], z = x.g[1][j], n = x.g[2][j], gh = grad_h[j];
+      const DType hn = hg.g[2][j] + bh.g[2][j];
+      const DType dn = gh * (DType(1) - z) * (DType(1) - n * n);
+      const DType dz = gh * (h_prev[j] - n) * z * (DType(1) - z);
+      const DType dr = dn * hn * r * (DType(1) - r);
+      grad_h_prev[j] = gh * z;
+      dx.g[0][j] = dr; dx.g[1][j] = dz; dx.g[2][j] = dn;
+      dh.g[0][j] = dr; dh.g[1][j] = dz; dh.g[2][j] = dn * r;
+    }
+  }
+};
+/*! \brief kernels of a row, generic version */
+template<typename DType>
+struct Kernel : public Scalar<DType> {};
+#if MSHADOW_USE_SSE
+template<>
+struct Kernel<float> {
+  typedef sse2::FVec<float> V;
+  inline static __m128 Ld(const float *p) {
+    return _mm_loadu_ps(p);
+  }
+  inline static __m128 Sig(__m128 x) {
+    return sse2::Sigmoid(V(x)).data_;
+  }
+  inline static __m128 Th(__m128 x) {
+    return sse2::Tanh(V(x)).data_;
+  }
+  inline static void LSTMForward(Gates<float, 4> a, Gates<const float, 4> b,
+                                 const float *c_prev, float *c, float *h,
+                                 index_t begin, index_t end) {
+    const index_t nv = begin + (((end - begin) >> 2) << 2);
+    for (index_t j = begin; j < nv; j += 4) {
+      const __m128 i = Sig(_mm_add_ps(Ld(a.g[0] + j), Ld(b.g[0] + j)));
+      const __m128 f = Sig(_mm_add_ps(Ld(a.g[1] + j), Ld(b.g[1] + j)));
+      const __m128 g = Th(_mm_add_ps(Ld(a.g[2] + j), Ld(b.g[2] + j)));
+      const __m128 o = Sig(_mm_add_ps(Ld(a.g[3] + j), Ld(b.g[3] + j)));
+      const __m128 cj = _mm_add_ps(_mm_mul_ps(f, Ld(c_prev + j)), _mm_mul_ps(i, g));
+      _mm_storeu_ps(a.g[0] + j, i); _mm_storeu_ps(a.g[1] + j, f);
+      _mm_storeu_ps(a.g[2] + j, g); _mm_storeu_ps(a.g[3] + j, o);
+      _mm_storeu_ps(c + j, cj);
+      _mm_storeu_ps(h + j, _mm_mul_ps(o, Th(cj)));
+    }
+    Scalar<float>::LSTMForward(a, b, c_prev, c, h, nv, end);
+  }
+  inline static void LSTMBackward(Gates<float, 4> d, Gates<const float, 4> a,
+                                  const float *c_prev, const float *c,
+                                  const float *grad_h, const float *grad_c, float *grad_c_prev,
+                                  index_t begin, index_t end) {
+    const index_t nv = begin + (((end - begin) >> 2) << 2);
+    const __m128 one = _mm_set1_ps(1.0f);
+    for (index_t j = begin; j < nv; j += 4) {
+      const __m128 i = Ld(a.g[0] + j), f = Ld(a.g[1] + j);
+      const __m128 g = Ld(a.g[2] + j), o = Ld(a.g[3] + j);
+      const __m128 tc = Th(Ld(c + j)), gh = Ld(grad_h + j);
+      const __m128 dc = _mm_add_ps(Ld(grad_c + j),
+                                   _mm_mul_ps(_mm_mul_ps(gh, o),
+                                              _mm_sub_ps(one, _mm_mul_ps(tc, tc))));
+      const __m128 cp = Ld(c_prev + j);
+      _mm_storeu_ps(d.g[0] + j, _mm_mul_ps(_mm_mul_ps(dc, g),
+                                           _mm_mul_ps(i, _mm_sub_ps(one, i))));
+      _mm_storeu_ps(d.g[1] + j, _mm_mul_ps(_mm_mul_ps(dc, cp),
+                                           _mm_mul_ps(f, _mm_sub_ps(one, f))));
+      _mm_storeu_ps(d.g[2] + j, _mm_mul_ps(_mm_mul_ps(dc, i),
+                                           _mm_sub_ps(one, _mm_mul_ps(g, g))));
+      _mm_storeu_ps(d.g[3] + j, _mm_mul_ps(_mm_mul_ps(gh, tc),
+                                           _mm_mul_ps(o, _mm_sub_ps(one, o))));
+      _mm_storeu_ps(grad_c_prev + j, _mm_mul_ps(dc, f));
+    }
+    Scalar<float>::LSTMBackward(d, a, c_prev, c, grad_h, grad_c, grad_c_prev, nv, end);
+  }
+  inline static void GRUForward(Gates<float, 3> x, Gates<const float, 3> bx,
+                                Gates<const float, 3> hg, Gates<const float, 3> bh,
+                                const float *h_prev, float *h, index_t begin, index_t end) {
+    const index_t nv = begin + (((end - begin) >> 2) << 2);
+    const __m128 one = _mm_set1_ps(1.0f);
+    for (index_t j = begin; j < nv; j += 4) {
+      const __m128 r = Sig(_mm_add_ps(_mm_add_ps(Ld(x.g[0] + j), Ld(bx.g[0] + j)),
+                                      _mm_add_ps(Ld(hg.g[0] + j), Ld(bh.g[0] + j))));
+      const __m128 z = Sig(_mm_add_ps(_mm_add_ps(Ld(x.g[1] + j), Ld(bx.g[1] + j)),
+                                      _mm_add_ps(Ld(hg.g[1] + j), Ld(bh.g[1] + j))));
+      const __m128 hn = _mm_add_ps(Ld(hg.g[2] + j), Ld(bh.g[2] + j));
+      const __m128 n = Th(_mm_add_ps(_mm_add_ps(Ld(x.g[2] + j), Ld(bx.g[2] + j)),
+                                     _mm_mul_ps(r, hn)));
+      _mm_storeu_ps(x.g[0] + j, r); _mm_storeu_ps(x.g[1] + j, z); _mm_storeu_ps(x.g[2] + j, n);
+      _mm_storeu_ps(h + j, _mm_add_ps(_mm_mul_ps(_mm_sub_ps(one, z), n),
+                                      _mm_mul_ps(z, Ld(h_prev + j))));
+    }
+    Scalar<float>::GRUForward(x, bx, hg, bh, h_prev, h, nv, end);
+  }
+  inline static void GRUBackward(Gates<float, 3> dx, Gates<float, 3> dh,
+                                 Gates<const float, 3> x, Gates<const float, 3> hg,
+                                 Gates<const float, 3> bh, const float *h_prev,
+                                 const float *grad_h, float *grad_h_prev,
+                                 index_t begin, index_t end) {
+    const index_t nv = begin + (((end - begin) >> 2) << 2);
+    const __m128 one = _mm_set1_ps(1.0f);
+    for (index_t j = begin; j < nv; j += 4) {
+      const __m128 r = Ld(x.g[0] + j), z = Ld(x.g[1] + j), n = Ld(x.g[2] + j);
+      const __m128 gh = Ld(grad_h + j);
+      const __m128 hn = _mm_add_ps(Ld(hg.g[2] + j), Ld(bh.g[2] + j));
+      const __m128 dn = _mm_mul_ps(_mm_mul_ps(gh, _mm_sub_ps(one, z)),
+                                   _mm_sub_ps(one, _mm_mul_ps(n, n)));
+      const __m128 dz = _mm_mul_ps(_mm_mul_ps(gh, _mm_sub_ps(Ld(h_prev + j), n)),
+                                   _mm_mul_ps(z, _mm_sub_ps(one, z)));
+      const __m128 dr = _mm_mul_ps(_mm_mul_ps(dn, hn), _mm_mul_ps(r, _mm_sub_ps(one, r)));
+      _mm_storeu_ps(grad_h_prev + j, _mm_mul_ps(gh, z));
+      _mm_storeu_ps(dx.g[0] + j, dr); _mm_storeu_ps(dx.g[1] + j, dz);
+      _mm_storeu_ps(dx.g[2] + j, dn);
+      _mm_storeu_ps(dh.g[0] + j, dr); _mm_storeu_ps(dh.g[1] + j, dz);
+      _mm_storeu_ps(dh.g[2] + j, _mm_mul_ps(dn, r));
+    }
+    Scalar<float>::GRUBackward(dx, dh, x, hg, bh, h_prev, grad_h, grad_h_prev, nv, end);
+  }
+};
+#endif  // MSHADOW_USE_SSE
+}  // namespace rnn
+
+/*!
+ * \brief forward of a LSTM cell
+ * \param c output cell state, (batch, hidden)
+ * \param h output hidden state, (batch, hidden)
+ * \param gates input the gemm output of the gates without bias, (batch, 4 * hidden),
+ *   output the activated gates that are needed by backward
+ * \param c_prev cell state of the previous step
+ * \param bias bias of the gates, (4 * hidden)
+ * \tparam DType type of element
+ */
+template<typename DType>
+inline void LSTMCellForward(Tensor<cpu, 2, DType> c,
+                            Tensor<cpu, 2, DType> h,
+                            Tensor<cpu, 2, DType> gates,
+                            const Tensor<cpu, 2, DType> &c_prev,
+                            const Tensor<cpu, 1, DType> &bias) {
+  const index_t batch = c.size(0), nhidden = c.size(1);
+  CHECK(h.shape_ == c.shape_ && c_prev.shape_ == c.shape_ &&
+        gates.shape_ == Shape2(batch, 4 * nhidden) && bias.size(0) == 4 * nhidden)
+    << "LSTMCellForward: shape mismatch";
+  MSHADOW_TRACE_SCOPE("LSTMCellForward", "op", gates.shape_, 30.0 * gates.shape_.Size(),
+                      sizeof(DType) * (2.0 * gates.shape_.Size() + 3.0 * c.shape_.Size()));
+  MSHADOW_OMP_PARALLEL_FOR_IF(gates.shape_.Size() > (1 << 14))
+  for (index_t r = 0; r < batch; ++r) {
+    rnn::Kernel<DType>::LSTMForward(rnn::Gates<DType, 4>(gates[r].dptr_, nhidden),
+                                    rnn::Gates<const DType, 4>(bias.dptr_, nhidden),
+                                    c_prev[r].dptr_, c[r].dptr_, h[r].dptr_, 0, nhidden);
+  }
+}
+/*!
+ * \brief backward of a LSTM cell, the gradient of the gemm inputs and
+ *  bias are then computed from grad_gates by dot and sum_rows
+ * \param grad_gates output gradient of the gates before activation, can be the same as gates
+ * \param grad_c_prev output gradient of c_prev, can be the same as grad_c
+ * \param grad_h gradient of h
+ * \param grad_c gradient of c from the next step
+ * \param gates activated gates given by forward
+ * \param c_prev cell state of the previous step
+ * \param c cell state given by forward
+ * \tparam DType type of element
+ */
+template<typename DType>
+inline void LSTMCellBackward(Tensor<cpu, 2, DType> grad_gates,
+                             Tensor<cpu, 2, DType> grad_c_prev,
+                             const Tensor<cpu, 2, DType> &grad_h,
+                             const Tensor<cpu, 2, DType> &grad_c,
+                             const Tensor<cpu, 2, DType> &gates,
+                             const Tensor<cpu, 2, DType> &c_prev,
+                             const Tensor<cpu, 2, DType> &c) {
+  const index_t batch = c.size(0), nhidden = c.size(1);
+  CHECK(grad_c_prev.shape_ == c.shape_ && grad_h.shape_ == c.shape_ &&
+        grad_c.shape_ == c.shape_ && c_prev.shape_ == c.shape_ &&
+        gates.shape_ == Shape2(batch, 4 * nhidden) && grad_gates.shape_ == gates.shape_)
+    << "LSTMCellBackward: shape mismatch";
+  MSHADOW_TRACE_SCOPE("LSTMCellBackward", "op", gates.shape_, 25.0 * gates.shape_.Size(),
+                      sizeof(DType) * (2.0 * gates.shape_.Size() + 5.0 * c.shape_.Size()));
+  MSHADOW_OMP_PARALLEL_FOR_IF(gates.shape_.Size() > (1 << 14))
+  for (index_t r = 0; r < batch; ++r) {
+    rnn::Kernel<DType>::LSTMBackward(rnn::Gates<DType, 4>(grad_gates[r].dptr_, nhidden),
+                                     rnn::Gates<const DType, 4>(gates[r].dptr_, nhidden),
+                                     c_prev[r].dptr_, c[r].dptr_, grad_h[r].dptr_,
+                                     grad_c[r].dptr_, grad_c_prev[r].dptr_, 0, nhidden);
+  }
+}
+/*!
+ * \brief forward of a GRU cell
+ * \param h output hidden state, (batch, hidden)
+ * \param gates_x input the gemm output of input without bias, (batch, 3 * hidden),
+ *   output the activated gates that are needed by backward
+ * \param gates_h gemm output of the previous hidden state without bias, (batch, 3 * hidden)
+ * \param h_prev hidden state of the previous step
+ * \param bias_x bias of gates_x, (3 * hidden)
+ * \param bias_h bias of gates_h, (3 * hidden)
+ * \tparam DType type of element
+ */
+template<typename DType>
+inline void GRUCellForward(Tensor<cpu, 2, DType> h,
+                           Tensor<cpu, 2, DType> gates_x,
+                           const Tensor<cpu, 2, DType> &gates_h,
+                           const Tensor<cpu, 2, DType> &h_prev,
+                           const Tensor<cpu, 1, DType> &bias_x,
+                           const Tensor<cpu, 1, DType> &bias_h) {
+  const index_t batch = h.size(0), nhidden = h.size(1);
+  CHECK(h_prev.shape_ == h.shape_ && gates_x.shape_ == Shape2(batch, 3 * nhidden) &&
+        gates_h.shape_ == gates_x.shape_ && bias_x.size(0) == 3 * nhidden &&
+        bias_h.size(0) == 3 * nhidden) << "GRUCellForward: shape mismatch";
+  MSHADOW_TRACE_SCOPE("GRUCellForward", "op", gates_x.shape_, 30.0 * gates_x.shape_.Size(),
+                      sizeof(DType) * (3.0 * gates_x.shape_.Size() + 2.0 * h.shape_.Size()));
+  MSHADOW_OMP_PARALLEL_FOR_IF(gates_x.shape_.Size() > (1 << 14))
+  for (index_t r = 0; r < batch; ++r) {
+    rnn::Kernel<DType>::GRUForward(rnn::Gates<DType, 3>(gates_x[r].dptr_, nhidden),
+                                   rnn::Gates<const DType, 3>(bias_x.dptr_, nhidden),
+                                   rnn::Gates<const DType, 3>(gates_h[r].dptr_, nhidden),
+                                   rnn::Gates<const DType, 3>(bias_h.dptr_, nhidden),
+                                   h_prev[r].dptr_, h[r].dptr_, 0, nhidden);
+  }
+}
+/*!
+ * \brief backward of a GRU cell, the gradient of the gemm inputs and
+ *  biases are then computed from grad_gates_x and grad_gates_h
+ * \param grad_gates_x output gradient of gates_x
+ * \param grad_gates_h output gradient of gates_h
+ * \param grad_h_prev output gradient of h_prev through the update gate,
+ *   the part through gates_h is added by the dot of grad_gates_h
+ * \param grad_h gradient of h
+ * \param gates_x activated gates given by forward
+ * \param gates_h gemm output of the previous hidden state without bias
+ * \param bias_h bias of gates_h
+ * \param h_prev hidden state of the previous step
+ * \tparam DType type of element
+ */
+template<typename DType>
+inline void GRUCellBackward(Tensor<cpu, 2, DType> grad_gates_x,
+                            Tensor<cpu, 2, DType> grad_gates_h,
+                            Tensor<cpu, 2, DType> grad_h_prev,
+                            const Tensor<cpu, 2, DType> &grad_h,
+                            const Tensor<cpu, 2, DType> &gates_x,
+                            const Tensor<cpu, 2, DType> &gates_h,
+                            const Tensor<cpu, 1, DType> &bias_h,
+                            const Tensor<cpu, 2, DType> &h_prev) {
+  const index_t batch = h_prev.size(0), nhidden = h_prev.size(1);
+  CHECK(grad_h_prev.shape_ == h_prev.shape_ && grad_h.shape_ == h_prev.shape_ &&
+        gates_x.shape_ == Shape2(batch, 3 * nhidden) && gates_h.shape_ == gates_x.shape_ &&
+        grad_gates_x.shape_ == gates_x.shape_ && grad_gates_h.shape_ == gates_x.shape_ &&
+        bias_h.size(0) == 3 * nhidden) << "GRUCellBackward: shape mismatch";
+  MSHADOW_TRACE_SCOPE("GRUCellBackward", "op", gates_x.shape_, 15.0 * gates_x.shape_.Size(),
+                      sizeof(DType) * (4.0 * gates_x.shape_.Size() + 3.0 * h_prev.shape_.Size()));
+  MSHADOW_OMP_PARALLEL_FOR_IF(gates_x.shape_.Size() > (1 << 14))
+  for (index_t r = 0; r < batch; ++r) {
+    rnn::Kernel<DType>::GRUBackward(rnn::Gates<DType, 3>(grad_gates_x[r].dptr_, nhidden),
+                                    rnn::Gates<DType, 3>(grad_gates_h[r].dptr_, nhidden),
+                                    rnn::Gates<const DType, 3>(gates_x[r].dptr_, nhidden),
+                                    rnn::Gates<const DType, 3>(gates_h[r].dptr_, nhidden),
+                                    rnn::Gates<const DType, 3>(bias_h.dptr_, nhidden),
+                                    h_prev[r].dptr_, grad_h[r].dptr_, grad_h_prev[r].dptr_,
+                                    0, nhidden);
+  }
+}
+}  // namespace mshadow
+#endif  // MSHADOW_EXTENSION_RNN_CELL_H_
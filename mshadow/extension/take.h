@@ -0,0 +1,207 @@
+/*!
+ *  Copyright (c) 2014 by Contributors
+ * \file take.h
+ * \brief row gather and scatter, e.g. embedding lookup and its gradient
+ * \author Tianqi Chen
+ */
+#ifndef MSHADOW_EXTENSION_TAKE_H_
+#define MSHADOW_EXTENSION_TAKE_H_
+#include <algorithm>
+#include <vector>
+#include "../extension.h"
+#include "../sse-inl.h"
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+namespace mshadow {
+namespace expr {
+/*!
+ * \brief take expression, out[i] = table[index[i]]
+ * \tparam SrcExp type of table expression
+ * \tparam IndexExp type of index expression
+ * \tparam DType the type of elements
+ * \tparam IType the type of index
+ */
+template<typename SrcExp, typename IndexExp, typename DType, typename IType>
+struct TakeExp:
+      public MakeTensorExp<TakeExp<SrcExp, IndexExp, DType, IType>,
+                           SrcExp, 2, DType> {
+  /*! \brief table to take rows from */
+  const SrcExp &src_;
+  /*! \brief index of rows */
+  const IndexExp &index_;
+  /*! \brief number of rows of table */
+  index_t nrow_;
+  /*! \brief constructor */
+  TakeExp(const SrcExp &src, const IndexExp &index)
+      : src_(src), index_(index) {
+    Shape<2> sshape = ShapeCheck<2, SrcExp>::Check(src_);
+    Shape<1> ishape = ShapeCheck<1, IndexExp>::Check(index_);
+    nrow_ = sshape[0];
+    CHECK(ishape[0] == 0 || nrow_ != 0) << "take: empty table";
+    this->shape_ = Shape2(ishape[0], sshape[1]);
+  }
+};
+/*!
+ * \brief take rows of a table, out[i] = table[index[i]]. An index out of
+ *  [0, nrow) is an error when the index is a cpu tensor, it is checked before
+ *  the rows are taken. Other index expressions can not be checked, their out
+ *  of range index is clipped to the rows of the table
+ * \param src table of shape (nrow, ncol)
+ * \param index 1D index of rows, can be of a different type, e.g. int
+ * \return expression of shape (index.size(0), ncol)
+ * \tparam SrcExp type of table expression
+ * \tparam IndexExp type of index expression
+ * \tparam DType the type of elements
+ * \tparam IType the type of index
+ * \tparam etype type of expression
+ * \tparam itype type of index expression
+ */
+template<typename SrcExp, typename IndexExp, typename DType, typename IType,
+         int etype, int itype>
+inline TakeExp<SrcExp, IndexExp, DType, IType>
+take(const Exp<SrcExp, DType, etype> &src, const Exp<IndexExp, IType, itype> &index) {
+  TypeCheckPass<ExpInfo<SrcExp>::kDim == 2 && ExpInfo<IndexExp>::kDim == 1>
+      ::Error_Expression_Does_Not_Meet_Dimension_Req();
+  return TakeExp<SrcExp, IndexExp, DType, IType>(src.self(), index.self());
+}
+/*! \brief clip an index into [0, nrow), nrow must not be 0 */
+template<typename IType>
+MSHADOW_XINLINE index_t ClipIndex(IType idx, index_t nrow) {
+  if (!(idx > IType(0))) return 0;
+  const index_t i = static_cast<index_t>(idx);
+  return i < nrow ? i : nrow - 1;
+}
+/*!
+ * \brief CHECK that all the index are in [0, nrow), only an index in a cpu
+ *  tensor can be read here, other index expressions pass
+ * \tparam IndexExp type of index expression
+ */
+template<typename IndexExp>
+struct TakeIndexCheck {
+  inline static void Check(const IndexExp &index, index_t nrow, const char *name) {}
+};
+template<typename IType>
+struct TakeIndexCheck<Tensor<cpu, 1, IType> > {
+  inline static void Check(const Tensor<cpu, 1, IType> &index, index_t nrow,
+                           const char *name) {
+    for (index_t i = 0; i < index.size(0); ++i) {
+      const IType idx = index[i];
+      CHECK(idx >= IType(0) && static_cast<index_t>(idx) < nrow)
+        << name << ": index " << idx << " at " << i << " is out of [0, " << nrow << ")";
+    }
+  }
+};
+/*! \brief dst[0:n] += src[0:n] */
+template<typename DType>
+struct ScatterRow {
+  inline static void Add(DType *dst, const DType *src, index_t n) {
+    for (index_t j = 0; j < n; ++j) dst[j] += src[j];
+  }
+};
+#if MSHADOW_USE_SSE
+template<>
+struct ScatterRow<float> {
+  inline static void Add(float *dst, const float *src, index_t n) {
+    const index_t nv = (n >> 3) << 3;
+    for (index_t j = 0; j < nv; j += 8) {
+      _mm_storeu_ps(dst + j, _mm_add_ps(_mm_loadu_ps(dst + j), _mm_loadu_ps(src + j)));
+      _mm_storeu_ps(dst + j + 4, _mm_add_ps(_mm_loadu_ps(dst + j + 4),
+                                            _mm_loadu_ps(src + j + 4)));
+    }
+    for (index_t j = nv; j < n; ++j) dst[j] += src[j];
+  }
+};
+template<>
+struct ScatterRow<double> {
+  inline static void Add(double *dst, const double *src, index_t n) {
+    const index_t nv = (n >> 2) << 2;
+    for (index_t j = 0; j < nv; j += 4) {
+      _mm_storeu_pd(dst + j, _mm_add_pd(_mm_loadu_pd(dst + j), _mm_loadu_pd(src + j)));
+      _mm_storeu_pd(dst + j + 2, _mm_add_pd(_mm_loadu_pd(dst + j + 2),
+                                            _mm_loadu_pd(src + j + 2)));
+    }
+    for (index_t j = nv; j < n; ++j) dst[j] += src[j];
+  }
+};
+#endif  // MSHADOW_USE_SSE
+//----------------------
+// Execution plan
+//----------------------
+template<typename SrcExp, typename IndexExp, typename DType, typename IType>
+struct Plan<TakeExp<SrcExp, IndexExp, DType, IType>, DType> {
+ public:
+  explicit Plan(const TakeExp<SrcExp, IndexExp, DType, IType> &e)
+      : src_(MakePlan(e.src_)), index_(MakePlan(e.index_)), nrow_(e.nrow_) {
+    TakeIndexCheck<IndexExp>::Check(e.index_, nrow_, "take");
+  }
+  MSHADOW_XINLINE DType Eval(index_t i, index_t j) const {
+    return src_.Eval(ClipIndex(index_.Eval(0, i), nrow_), j);
+  }
+
+ private:
+  Plan<SrcExp, DType> src_;
+  Plan<IndexExp, IType> index_;
+  const index_t nrow_;
+};
+}  // namespace expr
+/*!
+ * \brief dst[index[i]] += src[i], the gradient of take. Rows of dst are
+ *  split among threads, the rows of src are first grouped by the thread that
+ *  owns their destination, keeping their order, so there are no conflicts and
+ *  the result is the same as the serial order. An index out of [0, nrow) is
+ *  an error, as in take.
+ * \param dst destination table of shape (nrow, ncol)
+ * \param index 1D index of rows
+ * \param src rows to add, of shape (index.size(0), ncol)
+ * \tparam DType the type of elements
+ * \tparam IType the type of index
+ */
+template<typename DType, typename IType>
+inline void ScatterAdd(Tensor<cpu, 2, DType> dst,
+                       const Tensor<cpu, 1, IType> &index,
+                       const Tensor<cpu, 2, DType> &src) {
+  CHECK(index.size(0) == src.size(0) && dst.size(1) == src.size(1))
+    << "ScatterAdd: shape mismatch";
+  expr::TakeIndexCheck<Tensor<cpu, 1, IType> >::Check(index, dst.size(0), "ScatterAdd");
+  MSHADOW_TRACE_SCOPE("ScatterAdd", "op", src.shape_, src.shape_.Size(),
+                      3.0 * sizeof(DType) * src.shape_.Size());
+  const index_t n = src.size(0), ncol = dst.size(1);
+  int nthread = 1;
+  #if defined(_OPENMP)
+  if (src.shape_.Size() > MSHADOW_OMP_MIN_SIZE) {
+    nthread = std::min(omp_get_max_threads(), static_cast<int>(dst.size(0)));
+  }
+  #endif
+  if (nthread <= 1) {
+    for (index_t i = 0; i < n; ++i) {
+      expr::ScatterRow<DType>::Add(dst[static_cast<index_t>(index[i])].dptr_,
+                                   src[i].dptr_, ncol);
+    }
+    return;
+  }
+  #if defined(_OPENMP)
+  // counting sort of the rows of src by owner, stable in i
+  const index_t step = (dst.size(0) + nthread - 1) / nthread;
+  std::vector<index_t> offset(nthread + 1, 0), order(n);
+  for (index_t i = 0; i < n; ++i) {
+    ++offset[static_cast<index_t>(index[i]) / step + 1];
+  }
+  for (int t = 0; t < nthread; ++t) offset[t + 1] += offset[t];
+  std::vector<index_t> pos(offset.begin(), offset.end() - 1);
+  for (index_t i = 0; i < n; ++i) {
+    order[pos[static_cast<index_t>(index[i]) / step]++] = i;
+  }
+  #pragma omp parallel for schedule(static, 1) num_threads(nthread)
+  for (int t = 0; t < nthread; ++t) {
+    for (index_t p = offset[t]; p < offset[t + 1]; ++p) {
+      const index_t i = order[p];
+      expr::ScatterRow<DType>::Add(dst[static_cast<index_t>(index[i])].dptr_,
+                                   src[i].dptr_, ncol);
+    }
+  }
+  #endif
+}
+}  // namespace mshadow
+#endif  // MSHADOW_EXTENSION_TAKE_H_
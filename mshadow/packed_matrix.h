@@ -0,0 +1,408 @@
+/*!
+ *  Copyright (c) 2014 by Contributors
+ * \file packed_matrix.h
+ * \brief weight matrix prepacked into the panel layout used by gemm.
+ *  BLAS re-packs the rhs of every gemm call, for small batch inference
+ *  the packing is a large part of the runtime. A PackedMatrix is packed
+ *  once and can be used as rhs of dot many times:
+ *
+ *    PackedMatrix<float> pw(wmat);
+ *    out = dot(data, pw);
+ *
+ *  With MKL the packed format of cblas_?gemm_pack is used. With other BLAS
+ *  there is no packed interface, and the builtin kernel is slower than their
+ *  gemm, so the matrix is kept as a plain copy and multiplied by the BLAS.
+ *  Without BLAS the matrix is kept in panels of kPanel columns and multiplied
+ *  by the builtin kernel.
+ * \author Tianqi Chen
+ */
+#ifndef MSHADOW_PACKED_MATRIX_H_
+#define MSHADOW_PACKED_MATRIX_H_
+#include <algorithm>
+#include "./tensor.h"
+
+#if MSHADOW_USE_MKL && defined(INTEL_MKL_VERSION) && INTEL_MKL_VERSION >= 20170000
+#define MSHADOW_USE_MKL_PACK 1
+#else
+#define MSHADOW_USE_MKL_PACK 0
+#endif
+
+namespace mshadow {
+namespace packed {
+/*!
+ * \brief wrapper of the packed gemm of MKL
+ * \tparam DType data type, only float and double are supported by MKL
+ */
+template<typename DType>
+struct MKLPack {
+  static const bool kEnabled = false;
+  inline static size_t Size(index_t k, index_t n) { return 0; }
+  inline static void Pack(bool trans, index_t k, index_t n,
+                          const DType *src, index_t ld, DType *dst) {}
+  inline static void Compute(bool ltrans, index_t m, index_t n, index_t k,
+                             const DType *a, index_t lda, const DType *b,
+                             DType beta, DType *c, index_t ldc) {}
+};
+#if MSHADOW_USE_MKL_PACK
+// the packed format of B only depends on n and k, so one packed matrix
+// serves lhs of any number of rows, m=1 is passed when packing
+template<>
+struct MKLPack<float> {
+  static const bool kEnabled = true;
+  inline static size_t Size(index_t k, index_t n) {
+    return cblas_sgemm_pack_get_size(CblasBMatrix, 1, n, k);
+  }
+  inline static void Pack(bool trans, index_t k, index_t n,
+                          const float *src, index_t ld, float *dst) {
+    cblas_sgemm_pack(CblasRowMajor, CblasBMatrix, trans ? CblasTrans : CblasNoTrans,
+                     1, n, k, 1.0f, src, ld, dst);
+  }
+  inline static void Compute(bool ltrans, index_t m, index_t n, index_t k,
+                             const float *a, index_t lda, const float *b,
+                             float beta, float *c, index_t ldc) {
+    cblas_sgemm_compute(CblasRowMajor, ltrans ? CblasTrans : CblasNoTrans, CblasPacked,
+                        m, n, k, a, lda, b, n, beta, c, ldc);
+  }
+};
+template<>
+struct MKLPack<double> {
+  static const bool kEnabled = true;
+  inline static size_t Size(index_t k, index_t n) {
+    return cblas_dgemm_pack_get_size(CblasBMatrix, 1, n, k);
+  }
+  inline static void Pack(bool trans, index_t k, index_t n,
+                          const double *src, index_t ld, double *dst) {
+    cblas_dgemm_pack(CblasRowMajor, CblasBMatrix, trans ? CblasTrans : CblasNoTrans,
+                     1, n, k, 1.0, src, ld, dst);
+  }
+  inline static void Compute(bool ltrans, index_t m, index_t n, index_t k,
+                             const double *a, index_t lda, const double *b,
+                             double beta, double *c, index_t ldc) {
+    cblas_dgemm_compute(CblasRowMajor, ltrans ? CblasTrans : CblasNoTrans, CblasPacked,
+                        m, n, k, a, lda, b, n, beta, c, ldc);
+  }
+};
+#endif  // MSHADOW_USE_MKL_PACK
+/*!
+ * \brief gemm of the BLAS on a plain copy of the matrix,
+ *  used when the BLAS has no packed interface
+ * \tparam DType data type, only float and double are supported by BLAS
+ */
+template<typename DType>
+struct BLASDot {
+  static const bool kEnabled = false;
+  template<typename SV>
+  inline static void Eval(Tensor<cpu, 2, DType> dst, Tensor<cpu, 2, DType> lhs,
+                          bool ltrans, Tensor<cpu, 2, DType> rhs, DType scale) {}
+};
+#if (MSHADOW_USE_CBLAS || MSHADOW_USE_MKL) && !MSHADOW_USE_MKL_PACK
+template<typename DType>
+struct BLASDotImpl {
+  static const bool kEnabled = true;
+  template<typename SV>
+  inline static void Eval(Tensor<cpu, 2, DType> dst, Tensor<cpu, 2, DType> lhs,
+                          bool ltrans, Tensor<cpu, 2, DType> rhs, DType scale) {
+    if (ltrans) {
+      expr::DotEngine<SV, cpu, 2, 2, 2, true, false, DType>::Eval(&dst, lhs, rhs, scale);
+    } else {
+      expr::DotEngine<SV, cpu, 2, 2, 2, false, false, DType>::Eval(&dst, lhs, rhs, scale);
+    }
+  }
+};
+template<>
+struct BLASDot<float> : public BLASDotImpl<float> {};
+template<>
+struct BLASDot<double> : public BLASDotImpl<double> {};
+#endif
+}  // namespace packed
+
+/*!
+ * \brief matrix of shape (k, n) packed for the rhs of dot,
+ *  the lhs can be a matrix of shape (m, k), its transpose or a vector
+ *  of length k. The packed matrix is not copyable, and must be packed
+ *  again when the source matrix changes.
+ * \tparam DType data type
+ */
+template<typename DType>
+class PackedMatrix : public expr::RValueExp<PackedMatrix<DType>, DType> {
+ public:
+  /*! \brief number of columns in one panel of the builtin layout */
+  static const index_t kPanel = 8;
+  /*! \brief shape of the matrix, (k, n) */
+  Shape<2> shape_;
+  /*! \brief packed data */
+  DType *dptr_;
+  /*! \brief layout of the packed data */
+  enum Format {
+    /*! \brief panels of kPanel columns, used by the builtin kernel */
+    kPanelFormat,
+    /*! \brief packed format of MKL */
+    kMKLFormat,
+    /*! \brief plain row major copy, used by the BLAS */
+    kPlainFormat
+  };
+  /*! \brief layout of the data */
+  Format format;
+  /*! \brief constructor of empty matrix */
+  PackedMatrix(void) : shape_(Shape2(0, 0)), dptr_(NULL), format(kPanelFormat) {}
+  /*!
+   * \brief constructor that packs a matrix
+   * \param src the source matrix
+   * \param transpose whether to pack src.T() instead of src
+   */
+  explicit PackedMatrix(const Tensor<cpu, 2, DType> &src, bool transpose = false)
+      : shape_(Shape2(0, 0)), dptr_(NULL), format(kPanelFormat) {
+    this->Pack(src, transpose);
+  }
+  ~PackedMatrix(void) {
+    this->Release();
+  }
+  /*!
+   * \brief pack a matrix, the previous content is released
+   * \param src the source matrix
+   * \param transpose whether to pack src.T() instead of src
+   */
+  inline void Pack(const Tensor<cpu, 2, DType> &src, bool transpose = false) {
+    this->Release();
+    const index_t k = transpose ? src.size(1) : src.size(0);
+    const index_t n = transpose ? src.size(0) : src.size(1);
+    shape_ = Shape2(k, n);
+    if (src.shape_.Size() == 0) return;
+    MSHADOW_TRACE_SCOPE("pack", "blas", shape_, 0.0,
+                        2.0 * sizeof(DType) * shape_.Size());
+    if (packed::MKLPack<DType>::kEnabled) {
+      size_t pitch;
+      dptr_ = static_cast<DType*>(sse2::AlignedMallocPitch
+                                  (&pitch, packed::MKLPack<DType>::Size(k, n), 1));
+      format = kMKLFormat;
+      packed::MKLPack<DType>::Pack(transpose, k, n, src.dptr_, src.stride_, dptr_);
+      return;
+    }
+    if (packed::BLASDot<DType>::kEnabled) {
+      size_t pitch;
+      dptr_ = static_cast<DType*>(sse2::AlignedMallocPitch
+                                  (&pitch, k * n * sizeof(DType), 1));
+      format = kPlainFormat;
+      for (index_t i = 0; i < k; ++i) {
+        for (index_t j = 0; j < n; ++j) {
+          dptr_[i * n + j] = transpose ? src[j][i] : src[i][j];
+        }
+      }
+      return;
+    }
+    // panel p holds column p * kPanel to p * kPanel + kPanel - 1,
+    // stored row by row, the columns past n are filled by 0
+    const index_t npanel = (n + kPanel - 1) / kPanel;
+    size_t pitch;
+    dptr_ = static_cast<DType*>(sse2::AlignedMallocPitch
+                                (&pitch, npanel * k * kPanel * sizeof(DType), 1));
+    for (index_t p = 0; p < npanel; ++p) {
+      DType *panel = dptr_ + p * k * kPanel;
+      const index_t c0 = p * kPanel, ncol = std::min(kPanel, n - c0);
+      for (index_t i = 0; i < k; ++i) {
+        for (index_t j = 0; j < kPanel; ++j) {
+          if (j >= ncol) {
+            panel[i * kPanel + j] = DType(0);
+          } else if (transpose) {
+            panel[i * kPanel + j] = src[c0 + j][i];
+          } else {
+            panel[i * kPanel + j] = src[i][c0 + j];
+          }
+        }
+      }
+    }
+  }
+  /*! \brief free the packed data */
+  inline void Release(void) {
+    if (dptr_ != NULL) sse2::AlignedFree(dptr_);
+    dptr_ = NULL;
+    shape_ = Shape2(0, 0);
+    format = kPanelFormat;
+  }
+  /*! \return size of i-th dimension, k for 0 and n for 1 */
+  MSHADOW_XINLINE index_t size(index_t i) const {
+    return shape_[i];
+  }
+
+ private:
+  // not copyable
+  PackedMatrix(const PackedMatrix<DType> &other);
+  PackedMatrix<DType> &operator=(const PackedMatrix<DType> &other);
+};
+
+namespace packed {
+/*!
+ * \brief micro kernel of the builtin packed gemm, accumulates the
+ *  product of MR rows of lhs and one panel into acc
+ * \param a lhs, element (r, i) is a[r * rs + i * cs]
+ * \param panel the panel, kPanel elements per row
+ * \param acc the accumulator, MR x kPanel
+ */
+template<int MR, typename DType>
+struct Kernel {
+  inline static void Run(const DType *a, index_t rs, index_t cs, index_t k,
+                         const DType *panel, DType *acc) {
+    const index_t np = PackedMatrix<DType>::kPanel;
+    for (index_t i = 0; i < MR * np; ++i) acc[i] = DType(0);
+    for (index_t i = 0; i < k; ++i) {
+      const DType *b = panel + i * np;
+      for (int r = 0; r < MR; ++r) {
+        const DType v = a[r * rs + i * cs];
+        for (index_t j = 0; j < np; ++j) acc[r * np + j] += v * b[j];
+      }
+    }
+  }
+};
+#if MSHADOW_USE_SSE
+// each row of the panel is two sse vectors, the accumulators of four rows
+// fill eight registers, leaving the rest for the panel and the broadcast
+template<int MR>
+struct Kernel<MR, float> {
+  inline static void Run(const float *a, index_t rs, index_t cs, index_t k,
+                         const float *panel, float *acc) {
+    __m128 c[MR][2];
+    for (int r = 0; r < MR; ++r) {
+      c[r][0] = _mm_setzero_ps(); c[r][1] = _mm_setzero_ps();
+    }
+    for (index_t i = 0; i < k; ++i) {
+      const __m128 b0 = _mm_load_ps(panel + i * 8);
+      const __m128 b1 = _mm_load_ps(panel + i * 8 + 4);
+      for (int r = 0; r < MR; ++r) {
+        const __m128 v = _mm_set1_ps(a[r * rs + i * cs]);
+        c[r][0] = _mm_add_ps(c[r][0], _mm_mul_ps(v, b0));
+        c[r][1] = _mm_add_ps(c[r][1], _mm_mul_ps(v, b1));
+      }
+    }
+    for (int r = 0; r < MR; ++r) {
+      _mm_storeu_ps(acc + r * 8, c[r][0]);
+      _mm_storeu_ps(acc + r * 8 + 4, c[r][1]);
+    }
+  }
+};
+#endif  // MSHADOW_USE_SSE
+/*!
+ * \brief builtin gemm of lhs and packed matrix, dst = SV(dst, scale * lhs * rhs)
+ * \param dst output, m x n, row stride ldc
+ * \param a lhs, element (r, i) is a[r * rs + i * cs]
+ */
+template<typename SV, typename DType>
+inline void Gemm(DType *dst, index_t ldc, index_t m,
+                 const DType *a, index_t rs, index_t cs,
+                 const PackedMatrix<DType> &rhs, DType scale) {
+  const index_t np = PackedMatrix<DType>::kPanel;
+  const index_t k = rhs.size(0), n = rhs.size(1);
+  const index_t npanel = (n + np - 1) / np;
+  // the panels are independent, one panel of a large k stays in the
+  // cache while all the rows of lhs pass through it
+  MSHADOW_OMP_PARALLEL_FOR_IF(static_cast<double>(m) * n * k > MSHADOW_OMP_MIN_WORK)
+  for (ms_omp_uint pi = 0; pi < static_cast<ms_omp_uint>(npanel); ++pi) {
+    const index_t p = static_cast<index_t>(pi);
+    const DType *panel = rhs.dptr_ + p * k * np;
+    const index_t c0 = p * np, ncol = std::min(np, n - c0);
+    DType acc[4 * PackedMatrix<DType>::kPanel];
+    for (index_t r0 = 0; r0 < m; r0 += 4) {
+      const index_t mr = std::min(static_cast<index_t>(4), m - r0);
+      const DType *pa = a + r0 * rs;
+      switch (mr) {
+        case 4: Kernel<4, DType>::Run(pa, rs, cs, k, panel, acc); break;
+        case 3: Kernel<3, DType>::Run(pa, rs, cs, k, panel, acc); break;
+        case 2: Kernel<2, DType>::Run(pa, rs, cs, k, panel, acc); break;
+        default: Kernel<1, DType>::Run(pa, rs, cs, k, panel, acc); break;
+      }
+      for (index_t r = 0; r < mr; ++r) {
+        DType *out = dst + (r0 + r) * ldc + c0;
+        for (index_t j = 0; j < ncol; ++j) {
+          SV::Save(out[j], scale * acc[r * np + j]);
+        }
+      }
+    }
+  }
+}
+/*!
+ * \brief gemm of lhs and packed matrix, dispatched to MKL, the BLAS or the builtin kernel
+ * \param dst output, m x n, row stride ldc
+ * \param a lhs data
+ * \param lda row stride of lhs
+ * \param ltrans whether lhs is stored transposed, as k x m
+ */
+template<typename SV, typename DType>
+inline void Eval(DType *dst, index_t ldc, index_t m, const DType *a, index_t lda,
+                 bool ltrans, const PackedMatrix<DType> &rhs, DType scale) {
+  const index_t k = rhs.size(0), n = rhs.size(1);
+  MSHADOW_TRACE_SCOPE("gemm_packed", "blas", Shape3(m, k, n), 2.0 * m * k * n,
+                      sizeof(DType) * (static_cast<double>(m) * k + k * n + m * n));
+  if (m == 0 || n == 0) return;
+  if (rhs.format == PackedMatrix<DType>::kPlainFormat) {
+    BLASDot<DType>::template Eval<SV>(
+        Tensor<cpu, 2, DType>(dst, Shape2(m, n), ldc, NULL),
+        Tensor<cpu, 2, DType>(const_cast<DType*>(a),
+                              ltrans ? Shape2(k, m) : Shape2(m, k), lda, NULL),
+        ltrans, Tensor<cpu, 2, DType>(rhs.dptr_, Shape2(k, n), n, NULL), scale);
+    return;
+  }
+  if (rhs.format == PackedMatrix<DType>::kPanelFormat) {
+    Gemm<SV>(dst, ldc, m, a, ltrans ? 1 : lda, ltrans ? lda : 1, rhs, scale);
+    return;
+  }
+  // the packed matrix of MKL carries alpha=1, other scales go through a buffer
+  const DType alpha = scale * SV::AlphaBLAS();
+  if (alpha == DType(1)) {
+    MKLPack<DType>::Compute(ltrans, m, n, k, a, lda, rhs.dptr_,
+                            SV::BetaBLAS(), dst, ldc);
+  } else {
+    TensorContainer<cpu, 2, DType> tmp(Shape2(m, n));
+    MKLPack<DType>::Compute(ltrans, m, n, k, a, lda, rhs.dptr_,
+                            DType(0), tmp.dptr_, tmp.stride_);
+    for (index_t i = 0; i < m; ++i) {
+      for (index_t j = 0; j < n; ++j) {
+        SV::Save(dst[i * ldc + j], scale * tmp[i][j]);
+      }
+    }
+  }
+}
+}  // namespace packed
+
+namespace expr {
+template<typename SV, bool ltrans, typename DType>
+struct ExpComplexEngine<SV, Tensor<cpu, 2, DType>,
+                        DotExp<Tensor<cpu, 2, DType>, PackedMatrix<DType>,
+                               ltrans, false, DType>,
+                        DType> {
+  inline static void Eval(Tensor<cpu, 2, DType> *dst,
+                          const DotExp<Tensor<cpu, 2, DType>, PackedMatrix<DType>,
+                                       ltrans, false, DType> &exp) {
+    const Tensor<cpu, 2, DType> &lhs = exp.lhs_;
+    const PackedMatrix<DType> &rhs = exp.rhs_;
+    const index_t m = ltrans ? lhs.size(1) : lhs.size(0);
+    const index_t k = ltrans ? lhs.size(0) : lhs.size(1);
+    CHECK(dst->size(0) == m && dst->size(1) == rhs.size(1) && k == rhs.size(0))
+      << "dot-packed: matrix shape mismatch"
+      << "dst: " << dst->shape_ << "\n"
+      << "lhs: " << lhs.shape_ << "\n"
+      << "rhs: " << rhs.shape_ << "\n";
+    packed::Eval<SV>(dst->dptr_, dst->stride_, m, lhs.dptr_, lhs.stride_,
+                     ltrans, rhs, exp.scale_);
+  }
+};
+template<typename SV, typename DType>
+struct ExpComplexEngine<SV, Tensor<cpu, 1, DType>,
+                        DotExp<Tensor<cpu, 1, DType>, PackedMatrix<DType>,
+                               false, false, DType>,
+                        DType> {
+  inline static void Eval(Tensor<cpu, 1, DType> *dst,
+                          const DotExp<Tensor<cpu, 1, DType>, PackedMatrix<DType>,
+                                       false, false, DType> &exp) {
+    const Tensor<cpu, 1, DType> &lhs = exp.lhs_;
+    const PackedMatrix<DType> &rhs = exp.rhs_;
+    CHECK(dst->size(0) == rhs.size(1) && lhs.size(0) == rhs.size(0))
+      << "dot-packed: matrix shape mismatch"
+      << "dst: " << dst->shape_ << "\n"
+      << "lhs: " << lhs.shape_ << "\n"
+      << "rhs: " << rhs.shape_ << "\n";
+    packed::Eval<SV>(dst->dptr_, rhs.size(1), 1, lhs.dptr_, lhs.size(0),
+                     false, rhs, exp.scale_);
+  }
+};
+}  // namespace expr
+}  // namespace mshadow
+#endif  // MSHADOW_PACKED_MATRIX_H_
@@ -6,11 +6,13 @@
  */
 #ifndef MSHADOW_SSE_INL_H_
 #define MSHADOW_SSE_INL_H_
-#ifdef __APPLE__
 #include <stdlib.h>
-#else
+#ifndef __APPLE__
 #include <malloc.h>
 #endif
+#if defined(__linux__)
+#include <unistd.h>
+#endif
 #include "./expression.h"
 #include "./tensor.h"
 
@@ -41,6 +43,29 @@ inline void* AlignedMallocPitch(size_t *out_pitch,
   }
   return res;
 }
+/*!
+ * \brief same as AlignedMallocPitch, but the space is zeroed. Large blocks are
+ *  mapped from zero pages of the system and are not touched here.
+ * \return NULL when the zeroed space can not be given with the alignment,
+ *  the caller should then allocate with AlignedMallocPitch and fill the space
+ */
+inline void* AlignedCallocPitch(size_t *out_pitch,
+                                size_t lspace, size_t num_line) {
+  size_t pitch = ((lspace+15) >> 4) << 4;
+  *out_pitch = pitch;
+#ifdef _MSC_VER
+  // _aligned_malloc has no zeroed version that _aligned_free can release
+  return NULL;
+#else
+  void *res = calloc(pitch * num_line, 1);
+  // calloc aligns to 16 bytes on common 64 bit systems, but not everywhere
+  if (res != NULL && (reinterpret_cast<size_t>(res) & 15) != 0) {
+    free(res);
+    return NULL;
+  }
+  return res;
+#endif
+}
 /*!
  * \brief free aligned space
  * \param ptr pointer to space to be freed
@@ -81,6 +106,9 @@ inline index_t LowerAlign(index_t size, size_t fsize) {
 #if MSHADOW_USE_SSE
 // sse types are not compatible with nvcc, only use them in cpu mode
 #include <emmintrin.h>
+#if MSHADOW_USE_FMA
+#include <immintrin.h>
+#endif
 
 namespace mshadow {
 namespace sse2 {
@@ -120,6 +148,10 @@ struct FVec<float> {
   inline void Store(float *dst) const {
     return _mm_store_ps(dst, data_);
   }
+  /*! \brief store data into dst space with a non-temporal store, bypassing the cache */
+  inline void Stream(float *dst) const {
+    _mm_stream_ps(dst, data_);
+  }
   /*! \brief sum of all content */
   inline float Sum(void) const {
     DType ans  = _mm_add_ps(data_, _mm_movehl_ps(data_, data_));
@@ -158,6 +190,10 @@ struct FVec<double> {
   inline void Store(double *dst) const {
     return _mm_store_pd(dst, data_);
   }
+  /*! \brief store data into dst space with a non-temporal store, bypassing the cache */
+  inline void Stream(double *dst) const {
+    _mm_stream_pd(dst, data_);
+  }
   /*! \brief sum of all content */
   inline double Sum(void) const {
     DType tmp =  _mm_add_sd(data_, _mm_unpackhi_pd(data_, data_));
@@ -232,6 +268,197 @@ struct SSEOp<op::identity> {
     return src;
   }
 };
+template<>
+struct SSEOp<op::maximum> {
+  static const bool kEnabled = true;
+  MSHADOW_CINLINE static FVec<float>
+  Map(const FVec<float> &lhs, const FVec<float> &rhs) {
+    return FVec<float>(_mm_max_ps(lhs.data_, rhs.data_));
+  }
+  MSHADOW_CINLINE static FVec<double>
+  Map(const FVec<double> &lhs, const FVec<double> &rhs) {
+    return FVec<double>(_mm_max_pd(lhs.data_, rhs.data_));
+  }
+};
+template<>
+struct SSEOp<op::minimum> {
+  static const bool kEnabled = true;
+  MSHADOW_CINLINE static FVec<float>
+  Map(const FVec<float> &lhs, const FVec<float> &rhs) {
+    return FVec<float>(_mm_min_ps(lhs.data_, rhs.data_));
+  }
+  MSHADOW_CINLINE static FVec<double>
+  Map(const FVec<double> &lhs, const FVec<double> &rhs) {
+    return FVec<double>(_mm_min_pd(lhs.data_, rhs.data_));
+  }
+};
+// comparisons turn the all-ones mask of the compare into 1
+template<>
+struct SSEOp<op::gt> {
+  static const bool kEnabled = true;
+  MSHADOW_CINLINE static FVec<float>
+  Map(const FVec<float> &lhs, const FVec<float> &rhs) {
+    return FVec<float>(_mm_and_ps(_mm_cmpgt_ps(lhs.data_, rhs.data_), _mm_set1_ps(1.0f)));
+  }
+  MSHADOW_CINLINE static FVec<double>
+  Map(const FVec<double> &lhs, const FVec<double> &rhs) {
+    return FVec<double>(_mm_and_pd(_mm_cmpgt_pd(lhs.data_, rhs.data_), _mm_set1_pd(1.0)));
+  }
+};
+template<>
+struct SSEOp<op::ge> {
+  static const bool kEnabled = true;
+  MSHADOW_CINLINE static FVec<float>
+  Map(const FVec<float> &lhs, const FVec<float> &rhs) {
+    return FVec<float>(_mm_and_ps(_mm_cmpge_ps(lhs.data_, rhs.data_), _mm_set1_ps(1.0f)));
+  }
+  MSHADOW_CINLINE static FVec<double>
+  Map(const FVec<double> &lhs, const FVec<double> &rhs) {
+    return FVec<double>(_mm_and_pd(_mm_cmpge_pd(lhs.data_, rhs.data_), _mm_set1_pd(1.0)));
+  }
+};
+template<>
+struct SSEOp<op::lt> {
+  static const bool kEnabled = true;
+  MSHADOW_CINLINE static FVec<float>
+  Map(const FVec<float> &lhs, const FVec<float> &rhs) {
+    return FVec<float>(_mm_and_ps(_mm_cmplt_ps(lhs.data_, rhs.data_), _mm_set1_ps(1.0f)));
+  }
+  MSHADOW_CINLINE static FVec<double>
+  Map(const FVec<double> &lhs, const FVec<double> &rhs) {
+    return FVec<double>(_mm_and_pd(_mm_cmplt_pd(lhs.data_, rhs.data_), _mm_set1_pd(1.0)));
+  }
+};
+template<>
+struct SSEOp<op::le> {
+  static const bool kEnabled = true;
+  MSHADOW_CINLINE static FVec<float>
+  Map(const FVec<float> &lhs, const FVec<float> &rhs) {
+    return FVec<float>(_mm_and_ps(_mm_cmple_ps(lhs.data_, rhs.data_), _mm_set1_ps(1.0f)));
+  }
+  MSHADOW_CINLINE static FVec<double>
+  Map(const FVec<double> &lhs, const FVec<double> &rhs) {
+    return FVec<double>(_mm_and_pd(_mm_cmple_pd(lhs.data_, rhs.data_), _mm_set1_pd(1.0)));
+  }
+};
+template<>
+struct SSEOp<op::eq> {
+  static const bool kEnabled = true;
+  MSHADOW_CINLINE static FVec<float>
+  Map(const FVec<float> &lhs, const FVec<float> &rhs) {
+    return FVec<float>(_mm_and_ps(_mm_cmpeq_ps(lhs.data_, rhs.data_), _mm_set1_ps(1.0f)));
+  }
+  MSHADOW_CINLINE static FVec<double>
+  Map(const FVec<double> &lhs, const FVec<double> &rhs) {
+    return FVec<double>(_mm_and_pd(_mm_cmpeq_pd(lhs.data_, rhs.data_), _mm_set1_pd(1.0)));
+  }
+};
+template<>
+struct SSEOp<op::ne> {
+  static const bool kEnabled = true;
+  MSHADOW_CINLINE static FVec<float>
+  Map(const FVec<float> &lhs, const FVec<float> &rhs) {
+    return FVec<float>(_mm_and_ps(_mm_cmpneq_ps(lhs.data_, rhs.data_), _mm_set1_ps(1.0f)));
+  }
+  MSHADOW_CINLINE static FVec<double>
+  Map(const FVec<double> &lhs, const FVec<double> &rhs) {
+    return FVec<double>(_mm_and_pd(_mm_cmpneq_pd(lhs.data_, rhs.data_), _mm_set1_pd(1.0)));
+  }
+};
+template<>
+struct SSEOp<op::sign> {
+  static const bool kEnabled = true;
+  MSHADOW_CINLINE static FVec<float> Map(const FVec<float> &src) {
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+    return FVec<float>(_mm_sub_ps(_mm_and_ps(_mm_cmpgt_ps(src.data_, zero), one),
+                                  _mm_and_ps(_mm_cmplt_ps(src.data_, zero), one)));
+  }
+  MSHADOW_CINLINE static FVec<double> Map(const FVec<double> &src) {
+    const __m128d zero = _mm_setzero_pd(), one = _mm_set1_pd(1.0);
+    return FVec<double>(_mm_sub_pd(_mm_and_pd(_mm_cmpgt_pd(src.data_, zero), one),
+                                   _mm_and_pd(_mm_cmplt_pd(src.data_, zero), one)));
+  }
+};
+template<>
+struct SSEOp<op::where> {
+  static const bool kEnabled = true;
+  MSHADOW_CINLINE static FVec<float>
+  Map(const FVec<float> &cond, const FVec<float> &a, const FVec<float> &b) {
+    const __m128 mask = _mm_cmpneq_ps(cond.data_, _mm_setzero_ps());
+    return FVec<float>(_mm_or_ps(_mm_and_ps(mask, a.data_), _mm_andnot_ps(mask, b.data_)));
+  }
+  MSHADOW_CINLINE static FVec<double>
+  Map(const FVec<double> &cond, const FVec<double> &a, const FVec<double> &b) {
+    const __m128d mask = _mm_cmpneq_pd(cond.data_, _mm_setzero_pd());
+    return FVec<double>(_mm_or_pd(_mm_and_pd(mask, a.data_), _mm_andnot_pd(mask, b.data_)));
+  }
+};
+template<>
+struct SSEOp<op::clip> {
+  static const bool kEnabled = true;
+  MSHADOW_CINLINE static FVec<float>
+  Map(const FVec<float> &src, const FVec<float> &lo, const FVec<float> &hi) {
+    return FVec<float>(_mm_min_ps(_mm_max_ps(src.data_, lo.data_), hi.data_));
+  }
+  MSHADOW_CINLINE static FVec<double>
+  Map(const FVec<double> &src, const FVec<double> &lo, const FVec<double> &hi) {
+    return FVec<double>(_mm_min_pd(_mm_max_pd(src.data_, lo.data_), hi.data_));
+  }
+};
+#if MSHADOW_USE_FMA
+/*!
+ * \brief vector version of expr::FusedMulAdd, Map(a, b, c) = OP(a * b, c),
+ *  RMap(c, a, b) = OP(c, a * b), plus and minus use fma3 instructions
+ */
+template<typename OP>
+struct SSEFusedMulAdd {
+  template<typename TFloat>
+  MSHADOW_CINLINE static FVec<TFloat>
+  Map(const FVec<TFloat> &a, const FVec<TFloat> &b, const FVec<TFloat> &c) {
+    return SSEOp<OP>::Map(SSEOp<op::mul>::Map(a, b), c);
+  }
+  template<typename TFloat>
+  MSHADOW_CINLINE static FVec<TFloat>
+  RMap(const FVec<TFloat> &c, const FVec<TFloat> &a, const FVec<TFloat> &b) {
+    return SSEOp<OP>::Map(c, SSEOp<op::mul>::Map(a, b));
+  }
+};
+template<>
+struct SSEFusedMulAdd<op::plus> {
+  MSHADOW_CINLINE static FVec<float>
+  Map(const FVec<float> &a, const FVec<float> &b, const FVec<float> &c) {
+    return FVec<float>(_mm_fmadd_ps(a.data_, b.data_, c.data_));
+  }
+  MSHADOW_CINLINE static FVec<double>
+  Map(const FVec<double> &a, const FVec<double> &b, const FVec<double> &c) {
+    return FVec<double>(_mm_fmadd_pd(a.data_, b.data_, c.data_));
+  }
+  template<typename TFloat>
+  MSHADOW_CINLINE static FVec<TFloat>
+  RMap(const FVec<TFloat> &c, const FVec<TFloat> &a, const FVec<TFloat> &b) {
+    return Map(a, b, c);
+  }
+};
+template<>
+struct SSEFusedMulAdd<op::minus> {
+  MSHADOW_CINLINE static FVec<float>
+  Map(const FVec<float> &a, const FVec<float> &b, const FVec<float> &c) {
+    return FVec<float>(_mm_fmsub_ps(a.data_, b.data_, c.data_));
+  }
+  MSHADOW_CINLINE static FVec<double>
+  Map(const FVec<double> &a, const FVec<double> &b, const FVec<double> &c) {
+    return FVec<double>(_mm_fmsub_pd(a.data_, b.data_, c.data_));
+  }
+  MSHADOW_CINLINE static FVec<float>
+  RMap(const FVec<float> &c, const FVec<float> &a, const FVec<float> &b) {
+    return FVec<float>(_mm_fnmadd_ps(a.data_, b.data_, c.data_));
+  }
+  MSHADOW_CINLINE static FVec<double>
+  RMap(const FVec<double> &c, const FVec<double> &a, const FVec<double> &b) {
+    return FVec<double>(_mm_fnmadd_pd(a.data_, b.data_, c.data_));
+  }
+};
+#endif  // MSHADOW_USE_FMA
 // savers to do storage
 template<typename SV, typename TFloat>
 struct Saver{
@@ -247,6 +474,109 @@ struct Saver<sv::saveto, TFloat> {
     src.Store(dst);
   }
 };
+/*!
+ * \brief savers with non-temporal stores, only saveto does not read the
+ *  destination, the other savers fall back to Saver
+ */
+template<typename SV, typename TFloat>
+struct StreamSaver {
+  static const bool kEnabled = false;
+  MSHADOW_CINLINE static void Save(TFloat *dst, const FVec<TFloat> &src) {
+    Saver<SV, TFloat>::Save(dst, src);
+  }
+};
+template<typename TFloat>
+struct StreamSaver<sv::saveto, TFloat> {
+  static const bool kEnabled = true;
+  MSHADOW_CINLINE static void Save(TFloat *dst, const FVec<TFloat> &src) {
+    src.Stream(dst);
+  }
+};
+/*! \brief distance in bytes of the software prefetch of sources in streaming loops */
+const index_t kPrefetchBytes = 1024;
+/*! \brief default of StreamThreshold */
+inline size_t DefaultStreamThreshold(void) {
+  const char *env = getenv("MSHADOW_STREAM_THRESHOLD");
+  if (env != NULL) return static_cast<size_t>(strtoull(env, NULL, 10));
+#if defined(__linux__) && defined(_SC_LEVEL3_CACHE_SIZE)
+  const long llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+  if (llc > 0) return static_cast<size_t>(llc);
+#endif
+  return 8UL << 20;
+}
+/*!
+ * \brief size in bytes of the destination of a saveto assignment above
+ *  which non-temporal stores are used, the value can be assigned to tune it.
+ *  The default is the size of the last level cache, the environment
+ *  variable MSHADOW_STREAM_THRESHOLD in bytes overrides it.
+ */
+inline size_t &StreamThreshold(void) {
+  static size_t threshold = DefaultStreamThreshold();
+  return threshold;
+}
+/*!
+ * \brief exp of float vector, polynomial approximation of cephes, relative
+ *  error about 2e-7. As std::exp, it is Inf above log(FLT_MAX), flushes to 0
+ *  below about -104 and keeps NaN
+ */
+inline FVec<float> Exp(const FVec<float> &src) {
+  // the clamp only keeps 2^n in range of int, it is wide enough to overflow
+  __m128 x = _mm_min_ps(_mm_max_ps(src.data_, _mm_set1_ps(-104.0f)),
+                        _mm_set1_ps(88.8f));
+  // exp(x) = 2^n * exp(r), n = round(x / log(2)), |r| <= log(2) / 2
+  __m128 fx = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(1.44269504088896341f)),
+                         _mm_set1_ps(0.5f));
+  __m128 tmp = _mm_cvtepi32_ps(_mm_cvttps_epi32(fx));
+  fx = _mm_sub_ps(tmp, _mm_and_ps(_mm_cmpgt_ps(tmp, fx), _mm_set1_ps(1.0f)));
+  x = _mm_sub_ps(x, _mm_mul_ps(fx, _mm_set1_ps(0.693359375f)));
+  x = _mm_sub_ps(x, _mm_mul_ps(fx, _mm_set1_ps(-2.12194440e-4f)));
+  const __m128 z = _mm_mul_ps(x, x);
+  __m128 y = _mm_set1_ps(1.9875691500e-4f);
+  y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.3981999507e-3f));
+  y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(8.3334519073e-3f));
+  y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(4.1665795894e-2f));
+  y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.6666665459e-1f));
+  y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(5.0000001201e-1f));
+  y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(y, z), x), _mm_set1_ps(1.0f));
+  // 2^n is applied as 2^(n/2) * 2^(n - n/2), both halves are normal floats,
+  // so the result overflows or becomes denormal only by the multiplications
+  const __m128i n = _mm_cvttps_epi32(fx);
+  const __m128i n1 = _mm_srai_epi32(n, 1), n2 = _mm_sub_epi32(n, n1);
+  const __m128i bias = _mm_set1_epi32(0x7f);
+  y = _mm_mul_ps(y, _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(n1, bias), 23)));
+  y = _mm_mul_ps(y, _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(n2, bias), 23)));
+  // max and min of SSE return the bound for NaN, it is put back here
+  const __m128 nan = _mm_cmpunord_ps(src.data_, src.data_);
+  return FVec<float>(_mm_or_ps(_mm_and_ps(nan, src.data_), _mm_andnot_ps(nan, y)));
+}
+/*! \brief 1 / (1 + exp(-x)) of float vector */
+inline FVec<float> Sigmoid(const FVec<float> &src) {
+  const __m128 one = _mm_set1_ps(1.0f);
+  const FVec<float> e = Exp(FVec<float>(_mm_sub_ps(_mm_setzero_ps(), src.data_)));
+  return FVec<float>(_mm_div_ps(one, _mm_add_ps(one, e.data_)));
+}
+/*!
+ * \brief tanh of float vector as in cephes, an odd polynomial for |x| < 0.625,
+ *  which keeps the relative accuracy of small x, else sign(x) * (1 - 2 / (exp(2|x|) + 1))
+ */
+inline FVec<float> Tanh(const FVec<float> &src) {
+  const __m128 x = src.data_, one = _mm_set1_ps(1.0f);
+  const __m128 sign = _mm_and_ps(x, _mm_set1_ps(-0.0f));
+  const __m128 ax = _mm_xor_ps(x, sign);
+  const __m128 e = Exp(FVec<float>(_mm_add_ps(ax, ax))).data_;
+  __m128 large = _mm_sub_ps(one, _mm_div_ps(_mm_set1_ps(2.0f), _mm_add_ps(e, one)));
+  large = _mm_or_ps(large, sign);
+  const __m128 z = _mm_mul_ps(x, x);
+  __m128 p = _mm_set1_ps(-5.70498872745e-3f);
+  p = _mm_add_ps(_mm_mul_ps(p, z), _mm_set1_ps(2.06390887954e-2f));
+  p = _mm_add_ps(_mm_mul_ps(p, z), _mm_set1_ps(-5.37397155531e-2f));
+  p = _mm_add_ps(_mm_mul_ps(p, z), _mm_set1_ps(1.33314422036e-1f));
+  p = _mm_add_ps(_mm_mul_ps(p, z), _mm_set1_ps(-3.33332819422e-1f));
+  const __m128 small = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(p, z), x), x);
+  // NaN fails the compare and takes the large branch, where it is kept
+  const __m128 mask = _mm_cmplt_ps(ax, _mm_set1_ps(0.625f));
+  return FVec<float>(_mm_or_ps(_mm_and_ps(mask, small), _mm_andnot_ps(mask, large)));
+}
 }  // namespace sse2
 namespace expr {
 // same as plan, but use sse2
@@ -271,6 +601,9 @@ class SSEPlan<Tensor<Device, dim, DType>, DType> {
   MSHADOW_CINLINE DType Eval(index_t y, index_t x) const {
     return dptr_[y * stride_ + x];
   }
+  MSHADOW_CINLINE void Prefetch(index_t y, index_t x) const {
+    _mm_prefetch(reinterpret_cast<const char*>(&dptr_[y * stride_ + x]), _MM_HINT_T0);
+  }
 
  private:
   const DType  *dptr_;
@@ -286,6 +619,7 @@ class SSEPlan<ScalarExp<DType>, DType> {
   MSHADOW_CINLINE DType Eval(index_t y, index_t x) const {
     return scalar_;
   }
+  MSHADOW_CINLINE void Prefetch(index_t y, index_t x) const {}
 
  private:
   DType scalar_;
@@ -301,12 +635,38 @@ class SSEPlan<BinaryMapExp<OP, TA, TB, DType, etype>, DType> {
   MSHADOW_CINLINE DType Eval(index_t y, index_t x) const {
     return OP::Map(lhs_.Eval(y, x), rhs_.Eval(y, x));
   }
+  MSHADOW_CINLINE void Prefetch(index_t y, index_t x) const {
+    lhs_.Prefetch(y, x); rhs_.Prefetch(y, x);
+  }
 
  private:
   SSEPlan<TA, DType> lhs_;
   SSEPlan<TB, DType> rhs_;
 };
 
+template<typename OP, typename TA, typename TB, typename TC, int etype, typename DType>
+class SSEPlan<TernaryMapExp<OP, TA, TB, TC, DType, etype>, DType> {
+ public:
+  SSEPlan(const SSEPlan<TA, DType> &first, const SSEPlan<TB, DType> &second,
+          const SSEPlan<TC, DType> &third)
+      : first_(first), second_(second), third_(third) {}
+  MSHADOW_CINLINE sse2::FVec<DType> EvalSSE(index_t y, index_t x) const {
+    return sse2::SSEOp<OP>::Map(first_.EvalSSE(y, x), second_.EvalSSE(y, x),
+                                third_.EvalSSE(y, x));
+  }
+  MSHADOW_CINLINE DType Eval(index_t y, index_t x) const {
+    return OP::Map(first_.Eval(y, x), second_.Eval(y, x), third_.Eval(y, x));
+  }
+  MSHADOW_CINLINE void Prefetch(index_t y, index_t x) const {
+    first_.Prefetch(y, x); second_.Prefetch(y, x); third_.Prefetch(y, x);
+  }
+
+ private:
+  SSEPlan<TA, DType> first_;
+  SSEPlan<TB, DType> second_;
+  SSEPlan<TC, DType> third_;
+};
+
 template<typename OP, typename TA, int etype, typename DType>
 class SSEPlan<UnaryMapExp<OP, TA, DType, etype>, DType> {
  public:
@@ -317,6 +677,9 @@ class SSEPlan<UnaryMapExp<OP, TA, DType, etype>, DType> {
   MSHADOW_CINLINE DType Eval(index_t y, index_t x) const {
     return OP::Map(src_.Eval(y, x));
   }
+  MSHADOW_CINLINE void Prefetch(index_t y, index_t x) const {
+    src_.Prefetch(y, x);
+  }
 
  private:
   SSEPlan<TA, DType> src_;
@@ -350,6 +713,117 @@ MakeSSEPlan(const BinaryMapExp<OP, TA, TB, DType, etype> &e) {
   return SSEPlan<BinaryMapExp<OP, TA, TB, DType, etype>,
                  DType>(MakeSSEPlan(e.lhs_), MakeSSEPlan(e.rhs_));
 }
+template<typename OP, typename TA, typename TB, typename TC, typename DType, int etype>
+inline SSEPlan<TernaryMapExp<OP, TA, TB, TC, DType, etype>, DType>
+MakeSSEPlan(const TernaryMapExp<OP, TA, TB, TC, DType, etype> &e) {
+  return SSEPlan<TernaryMapExp<OP, TA, TB, TC, DType, etype>, DType>
+      (MakeSSEPlan(e.first_), MakeSSEPlan(e.second_), MakeSSEPlan(e.third_));
+}
+#if MSHADOW_USE_FMA
+// fused multiply-add plans, see the plans of the same expressions in expr_engine-inl.h
+template<typename OP, typename TA, typename TB, typename TC,
+         typename DType, int ea, int etype>
+class SSEPlan<BinaryMapExp<OP, BinaryMapExp<op::mul, TA, TB, DType, ea>,
+                           TC, DType, etype>, DType> {
+ public:
+  SSEPlan(const SSEPlan<TA, DType> &a, const SSEPlan<TB, DType> &b,
+          const SSEPlan<TC, DType> &c)
+      : a_(a), b_(b), c_(c) {}
+  MSHADOW_CINLINE sse2::FVec<DType> EvalSSE(index_t y, index_t x) const {
+    return sse2::SSEFusedMulAdd<OP>::Map(a_.EvalSSE(y, x), b_.EvalSSE(y, x),
+                                         c_.EvalSSE(y, x));
+  }
+  MSHADOW_CINLINE DType Eval(index_t y, index_t x) const {
+    return FusedMulAdd<OP>::Map(a_.Eval(y, x), b_.Eval(y, x), c_.Eval(y, x));
+  }
+  MSHADOW_CINLINE void Prefetch(index_t y, index_t x) const {
+    a_.Prefetch(y, x); b_.Prefetch(y, x); c_.Prefetch(y, x);
+  }
+
+ private:
+  SSEPlan<TA, DType> a_;
+  SSEPlan<TB, DType> b_;
+  SSEPlan<TC, DType> c_;
+};
+template<typename OP, typename TA, typename TB, typename TC,
+         typename DType, int ea, int etype>
+class SSEPlan<BinaryMapExp<OP, TC, BinaryMapExp<op::mul, TA, TB, DType, ea>,
+                           DType, etype>, DType> {
+ public:
+  SSEPlan(const SSEPlan<TC, DType> &c, const SSEPlan<TA, DType> &a,
+          const SSEPlan<TB, DType> &b)
+      : c_(c), a_(a), b_(b) {}
+  MSHADOW_CINLINE sse2::FVec<DType> EvalSSE(index_t y, index_t x) const {
+    return sse2::SSEFusedMulAdd<OP>::RMap(c_.EvalSSE(y, x), a_.EvalSSE(y, x),
+                                          b_.EvalSSE(y, x));
+  }
+  MSHADOW_CINLINE DType Eval(index_t y, index_t x) const {
+    return FusedMulAdd<OP>::RMap(c_.Eval(y, x), a_.Eval(y, x), b_.Eval(y, x));
+  }
+  MSHADOW_CINLINE void Prefetch(index_t y, index_t x) const {
+    c_.Prefetch(y, x); a_.Prefetch(y, x); b_.Prefetch(y, x);
+  }
+
+ private:
+  SSEPlan<TC, DType> c_;
+  SSEPlan<TA, DType> a_;
+  SSEPlan<TB, DType> b_;
+};
+template<typename OP, typename TA, typename TB, typename TC, typename TD,
+         typename DType, int ea, int ec, int etype>
+class SSEPlan<BinaryMapExp<OP, BinaryMapExp<op::mul, TA, TB, DType, ea>,
+                           BinaryMapExp<op::mul, TC, TD, DType, ec>, DType, etype>, DType> {
+ public:
+  SSEPlan(const SSEPlan<TA, DType> &a, const SSEPlan<TB, DType> &b,
+          const SSEPlan<BinaryMapExp<op::mul, TC, TD, DType, ec>, DType> &cd)
+      : a_(a), b_(b), cd_(cd) {}
+  MSHADOW_CINLINE sse2::FVec<DType> EvalSSE(index_t y, index_t x) const {
+    return sse2::SSEFusedMulAdd<OP>::Map(a_.EvalSSE(y, x), b_.EvalSSE(y, x),
+                                         cd_.EvalSSE(y, x));
+  }
+  MSHADOW_CINLINE DType Eval(index_t y, index_t x) const {
+    return FusedMulAdd<OP>::Map(a_.Eval(y, x), b_.Eval(y, x), cd_.Eval(y, x));
+  }
+  MSHADOW_CINLINE void Prefetch(index_t y, index_t x) const {
+    a_.Prefetch(y, x); b_.Prefetch(y, x); cd_.Prefetch(y, x);
+  }
+
+ private:
+  SSEPlan<TA, DType> a_;
+  SSEPlan<TB, DType> b_;
+  SSEPlan<BinaryMapExp<op::mul, TC, TD, DType, ec>, DType> cd_;
+};
+template<typename OP, typename TA, typename TB, typename TC,
+         typename DType, int ea, int etype>
+inline SSEPlan<BinaryMapExp<OP, BinaryMapExp<op::mul, TA, TB, DType, ea>,
+                            TC, DType, etype>, DType>
+MakeSSEPlan(const BinaryMapExp<OP, BinaryMapExp<op::mul, TA, TB, DType, ea>,
+                               TC, DType, etype> &e) {
+  return SSEPlan<BinaryMapExp<OP, BinaryMapExp<op::mul, TA, TB, DType, ea>,
+                              TC, DType, etype>, DType>
+      (MakeSSEPlan(e.lhs_.lhs_), MakeSSEPlan(e.lhs_.rhs_), MakeSSEPlan(e.rhs_));
+}
+template<typename OP, typename TA, typename TB, typename TC,
+         typename DType, int ea, int etype>
+inline SSEPlan<BinaryMapExp<OP, TC, BinaryMapExp<op::mul, TA, TB, DType, ea>,
+                            DType, etype>, DType>
+MakeSSEPlan(const BinaryMapExp<OP, TC, BinaryMapExp<op::mul, TA, TB, DType, ea>,
+                               DType, etype> &e) {
+  return SSEPlan<BinaryMapExp<OP, TC, BinaryMapExp<op::mul, TA, TB, DType, ea>,
+                              DType, etype>, DType>
+      (MakeSSEPlan(e.lhs_), MakeSSEPlan(e.rhs_.lhs_), MakeSSEPlan(e.rhs_.rhs_));
+}
+template<typename OP, typename TA, typename TB, typename TC, typename TD,
+         typename DType, int ea, int ec, int etype>
+inline SSEPlan<BinaryMapExp<OP, BinaryMapExp<op::mul, TA, TB, DType, ea>,
+                            BinaryMapExp<op::mul, TC, TD, DType, ec>, DType, etype>, DType>
+MakeSSEPlan(const BinaryMapExp<OP, BinaryMapExp<op::mul, TA, TB, DType, ea>,
+                               BinaryMapExp<op::mul, TC, TD, DType, ec>, DType, etype> &e) {
+  return SSEPlan<BinaryMapExp<OP, BinaryMapExp<op::mul, TA, TB, DType, ea>,
+                              BinaryMapExp<op::mul, TC, TD, DType, ec>, DType, etype>, DType>
+      (MakeSSEPlan(e.lhs_.lhs_), MakeSSEPlan(e.lhs_.rhs_), MakeSSEPlan(e.rhs_));
+}
+#endif  // MSHADOW_USE_FMA
 /*!
  * \brief static check sse enable
  *        if a expression E can not be evaluated using sse, then kPass = false
@@ -378,6 +852,11 @@ struct SSECheck< BinaryMapExp<OP, TA, TB, DType, etype> > {
   static const bool kPass = SSECheck<TA>::kPass &&
       SSECheck<TB>::kPass && sse2::SSEOp<OP>::kEnabled;
 };
+template<typename OP, typename TA, typename TB, typename TC, typename DType, int etype>
+struct SSECheck<TernaryMapExp<OP, TA, TB, TC, DType, etype> > {
+  static const bool kPass = SSECheck<TA>::kPass && SSECheck<TB>::kPass &&
+      SSECheck<TC>::kPass && sse2::SSEOp<OP>::kEnabled;
+};
 //-------------------------------------------------
 // Check if data is aligned and allow sse operation
 //-------------------------------------------------
@@ -414,6 +893,107 @@ struct SSEAlignCheck<dim, BinaryMapExp<OP, TA, TB, DType, etype> > {
         SSEAlignCheck<dim, TB>::Check(t.rhs_);
   }
 };
+template<int dim, typename OP, typename TA, typename TB, typename TC,
+         typename DType, int etype>
+struct SSEAlignCheck<dim, TernaryMapExp<OP, TA, TB, TC, DType, etype> > {
+  inline static bool Check(const TernaryMapExp<OP, TA, TB, TC, DType, etype> &t) {
+    return SSEAlignCheck<dim, TA>::Check(t.first_) &&
+        SSEAlignCheck<dim, TB>::Check(t.second_) &&
+        SSEAlignCheck<dim, TC>::Check(t.third_);
+  }
+};
+/*!
+ * \brief check if all tensors of an expression are contiguous and start at
+ *  aligned addresses, so that it can be evaluated as a flat aligned vector
+ */
+template<typename E>
+struct SSEFlatAlignCheck {
+  inline static bool Check(const E &exp) {
+    return false;
+  }
+};
+template<typename DType>
+struct SSEFlatAlignCheck<ScalarExp<DType> > {
+  inline static bool Check(const ScalarExp<DType> &exp) {
+    return true;
+  }
+};
+template<int dim, typename DType>
+struct SSEFlatAlignCheck<Tensor<cpu, dim, DType> > {
+  inline static bool Check(const Tensor<cpu, dim, DType> &t) {
+    return sse2::CheckAlign(t.dptr_) && t.CheckContiguous();
+  }
+};
+template<typename OP, typename TA, typename DType, int etype>
+struct SSEFlatAlignCheck<UnaryMapExp<OP, TA, DType, etype> > {
+  inline static bool Check(const UnaryMapExp<OP, TA, DType, etype> &t) {
+    return SSEFlatAlignCheck<TA>::Check(t.src_);
+  }
+};
+template<typename OP, typename TA, typename TB, typename DType, int etype>
+struct SSEFlatAlignCheck<BinaryMapExp<OP, TA, TB, DType, etype> > {
+  inline static bool Check(const BinaryMapExp<OP, TA, TB, DType, etype> &t) {
+    return SSEFlatAlignCheck<TA>::Check(t.lhs_) &&
+        SSEFlatAlignCheck<TB>::Check(t.rhs_);
+  }
+};
+template<typename OP, typename TA, typename TB, typename TC, typename DType, int etype>
+struct SSEFlatAlignCheck<TernaryMapExp<OP, TA, TB, TC, DType, etype> > {
+  inline static bool Check(const TernaryMapExp<OP, TA, TB, TC, DType, etype> &t) {
+    return SSEFlatAlignCheck<TA>::Check(t.first_) &&
+        SSEFlatAlignCheck<TB>::Check(t.second_) &&
+        SSEFlatAlignCheck<TC>::Check(t.third_);
+  }
+};
+/*!
+ * \brief check if an expression of SSEFlatAlignCheck reads memory in
+ *  [begin, end), a destination that is also read keeps cached stores
+ */
+template<typename E>
+struct SSEOverlapCheck {
+  inline static bool Check(const E &exp, const void *begin, const void *end) {
+    return true;
+  }
+};
+template<typename DType>
+struct SSEOverlapCheck<ScalarExp<DType> > {
+  inline static bool Check(const ScalarExp<DType> &exp, const void *begin, const void *end) {
+    return false;
+  }
+};
+template<int dim, typename DType>
+struct SSEOverlapCheck<Tensor<cpu, dim, DType> > {
+  inline static bool Check(const Tensor<cpu, dim, DType> &t,
+                           const void *begin, const void *end) {
+    const char *p = reinterpret_cast<const char*>(t.dptr_);
+    return p < static_cast<const char*>(end) &&
+        static_cast<const char*>(begin) < p + t.shape_.Size() * sizeof(DType);
+  }
+};
+template<typename OP, typename TA, typename DType, int etype>
+struct SSEOverlapCheck<UnaryMapExp<OP, TA, DType, etype> > {
+  inline static bool Check(const UnaryMapExp<OP, TA, DType, etype> &t,
+                           const void *begin, const void *end) {
+    return SSEOverlapCheck<TA>::Check(t.src_, begin, end);
+  }
+};
+template<typename OP, typename TA, typename TB, typename DType, int etype>
+struct SSEOverlapCheck<BinaryMapExp<OP, TA, TB, DType, etype> > {
+  inline static bool Check(const BinaryMapExp<OP, TA, TB, DType, etype> &t,
+                           const void *begin, const void *end) {
+    return SSEOverlapCheck<TA>::Check(t.lhs_, begin, end) ||
+        SSEOverlapCheck<TB>::Check(t.rhs_, begin, end);
+  }
+};
+template<typename OP, typename TA, typename TB, typename TC, typename DType, int etype>
+struct SSEOverlapCheck<TernaryMapExp<OP, TA, TB, TC, DType, etype> > {
+  inline static bool Check(const TernaryMapExp<OP, TA, TB, TC, DType, etype> &t,
+                           const void *begin, const void *end) {
+    return SSEOverlapCheck<TA>::Check(t.first_, begin, end) ||
+        SSEOverlapCheck<TB>::Check(t.second_, begin, end) ||
+        SSEOverlapCheck<TC>::Check(t.third_, begin, end);
+  }
+};
 /*!
  * \brief use SSEPlan to compute result
  */
@@ -15,6 +15,8 @@
 #include <iostream>
 #include "./base.h"
 #include "./expression.h"
+#include "./trace.h"
+#include "./autotune.h"
 
 namespace mshadow {
 /*! \brief device name CPU */
@@ -537,6 +539,33 @@ inline void AllocSpace(Tensor<cpu, dim, DType> *obj,
 template<int dim, typename DType>
 inline void AllocSpace(Tensor<gpu, dim, DType> *obj,
                        bool pad = MSHADOW_ALLOC_PAD);
+/*!
+ * \brief CPU/GPU: allocate space for CTensor like AllocSpace, and set all of it,
+ *        including the padding, to initv.
+ *        On cpu a zero initv takes zeroed pages from calloc, which are not touched
+ *        until they are used, other values are filled in parallel with the same
+ *        static schedule as the flat evaluation of expressions, so that on NUMA
+ *        machines the pages are first touched by the threads that use them.
+ *        The parallel fill needs OpenMP and MSHADOW_OMP_MIN_SIZE elements,
+ *        otherwise the calling thread fills and first touches all of the space
+ * \param obj the tensor object, with shape specified
+ * \param initv initialization value
+ * \param pad whether padding dimension 0, see AllocSpace
+ * \tparam dim specify the dim of tensor
+ * \tparam DType type of element in tensor
+ */
+template<int dim, typename DType>
+inline void AllocSpace(Tensor<cpu, dim, DType> *obj, DType initv, bool pad);
+/*!
+ * \brief CPU/GPU: allocate space for CTensor like AllocSpace, and set all of it to initv
+ * \param obj the tensor object, with shape specified
+ * \param initv initialization value
+ * \param pad whether padding dimension 0, see AllocSpace
+ * \tparam dim specify the dim of tensor
+ * \tparam DType type of element in tensor
+ */
+template<int dim, typename DType>
+inline void AllocSpace(Tensor<gpu, dim, DType> *obj, DType initv, bool pad);
 /*!
  * \brief CPU/GPU: free the space of tensor, will set obj.dptr to NULL
  * \param obj the tensor object
@@ -554,7 +583,8 @@ inline void FreeSpace(Tensor<cpu, dim, DType> *obj);
 template<int dim, typename DType>
 inline void FreeSpace(Tensor<gpu, dim, DType> *obj);
 /*!
- * \brief CPU/GPU: short cut to allocate and initialize a Tensor
+ * \brief CPU/GPU: short cut to allocate and initialize a Tensor, the space
+ *  is set by AllocSpace(obj, initv, pad), whose fill is parallel only with OpenMP
  * \param shape: shape of tensor
  * \param initv: initialization value
  * \param pad : padding option
@@ -771,6 +801,9 @@ inline void MapReduceKeepHighDim(TRValue<R, gpu, 1, DType> *dst,
 #include "./io.h"
 #include "./tensor_container.h"
 #include "./tensor_blob.h"
+#include "./tensor_fixed.h"
+#include "./packed_matrix.h"
+#include "./tensor_csr.h"
 #include "./random.h"
 // add definition of scalar related operators
 #ifdef MSAHDOW_SCALAR_
@@ -43,15 +43,15 @@ class TensorContainer: public Tensor<Device, dimension, DType> {
     this->AllocByShape(shape);
   }
   /*!
-   * \brief constructor
+   * \brief constructor, the space is set by AllocSpace(obj, initv, pad),
+   *  whose fill is parallel only with OpenMP
    * \param shape intial shape
    * \param initv intial value
    */
   explicit TensorContainer(const Shape<dimension> &shape, DType initv) {
     this->pad_ = MSHADOW_ALLOC_PAD;
     data_.dptr_ = NULL;
-    this->AllocByShape(shape);
-    (*this) = initv;
+    this->AllocByShape(shape, initv);
   }
   /*!
    * \brief copy constructor
@@ -92,13 +92,20 @@ class TensorContainer: public Tensor<Device, dimension, DType> {
     }
   }
   /*!
-   * \brief resize the container to given shape, and initialize, content is NOT preserved
+   * \brief resize the container to given shape, and initialize, content is NOT preserved.
+   *  New space is set by AllocSpace(obj, initv, pad), whose fill is parallel only
+   *  with OpenMP, space that is kept is assigned initv
    * \param shape target shape
    * \param initv initialization value
    */
   inline void Resize(const Shape<dimension> &shape, DType initv) {
-    this->Resize(shape);
-    (*this) = initv;
+    Shape<2> s2 = shape.FlatTo2D();
+    if (s2.shape_[1] > data_.stride_ || s2.shape_[0] > data_.size(0)) {
+      this->AllocByShape(shape, initv);
+    } else {
+      this->Resize(shape);
+      (*this) = initv;
+    }
   }
   /*! \brief set whether padding is allowed in tensor */
   inline void set_pad(bool pad) {
@@ -190,6 +197,17 @@ class TensorContainer: public Tensor<Device, dimension, DType> {
     if (data_.dptr_ != NULL) this->Release();
     data_.shape_ = shape.FlatTo2D();
     mshadow::AllocSpace(&data_, pad_);
+    this->SetView(shape);
+  }
+  // allocate and set the whole space to initv, see AllocSpace
+  inline void AllocByShape(const Shape<dimension>& shape, DType initv) {
+    if (data_.dptr_ != NULL) this->Release();
+    data_.shape_ = shape.FlatTo2D();
+    data_.stream_ = this->stream_;
+    mshadow::AllocSpace(&data_, initv, pad_);
+    this->SetView(shape);
+  }
+  inline void SetView(const Shape<dimension>& shape) {
     this->dptr_ = data_.dptr_;
     this->shape_ = shape;
     if (this->pad_) {
@@ -6,7 +6,9 @@
  */
 #ifndef MSHADOW_TENSOR_CPU_INL_H_
 #define MSHADOW_TENSOR_CPU_INL_H_
+#include <algorithm>
 #include <cstring>
+#include <vector>
 #include "./base.h"
 #include "./tensor.h"
 #include "./sse-inl.h"
@@ -102,13 +104,32 @@ inline void AllocSpace(Tensor<cpu, dim, DType> *obj, bool pad) {
   }
   obj->dptr_ = reinterpret_cast<DType*>(dptr);
 }
+template<int dim, typename DType>
+inline void AllocSpace(Tensor<cpu, dim, DType> *obj, DType initv, bool pad) {
+  // a zeroed allocation already holds initv when all its bytes are zero
+  const unsigned char *bytes = reinterpret_cast<const unsigned char*>(&initv);
+  bool zero = true;
+  for (size_t i = 0; i < sizeof(DType); ++i) zero = zero && bytes[i] == 0;
+  const index_t nrow = pad ? obj->shape_.FlatTo2D()[0] : 1;
+  const size_t lspace = (pad ? obj->size(dim - 1) : obj->shape_.Size()) * sizeof(DType);
+  size_t pitch;
+  void *dptr = zero ? sse2::AlignedCallocPitch(&pitch, lspace, nrow) : NULL;
+  if (dptr != NULL) {
+    obj->dptr_ = reinterpret_cast<DType*>(dptr);
+    obj->stride_ = pad ? static_cast<index_t>(pitch / sizeof(DType)) : obj->size(dim - 1);
+    return;
+  }
+  AllocSpace(obj, pad);
+  // fill the whole space as one contiguous vector, in parallel
+  Tensor<cpu, 1, DType> space(obj->dptr_, Shape1(obj->shape_.FlatTo2D()[0] * obj->stride_));
+  MapExp<sv::saveto>(&space, expr::ScalarExp<DType>(initv));
+}
 template<typename Device, typename DType, int dim>
 inline Tensor<Device, dim, DType>
 NewTensor(const Shape<dim> &shape, DType initv, bool pad, Stream<Device> *stream_) {
   Tensor<Device, dim, DType> obj(shape);
   obj.stream_ = stream_;
-  AllocSpace(&obj, pad);
-  MapExp<sv::saveto>(&obj, expr::ScalarExp<DType>(initv));
+  AllocSpace(&obj, initv, pad);
   return obj;
 }
 template<int dim, typename DType>
@@ -122,6 +143,8 @@ inline void Copy(Tensor<cpu, dim, DType> _dst,
                  Stream<cpu> *stream) {
   CHECK_EQ(_dst.shape_, _src.shape_)
       << "Copy:shape mismatch:" << _dst.shape_ << " vs " << _src.shape_;
+  MSHADOW_TRACE_SCOPE("Copy", "copy", _dst.shape_, 0,
+                      2 * sizeof(DType) * _dst.shape_.Size());
   if (_dst.CheckContiguous() && _src.CheckContiguous()) {
     memcpy(_dst.dptr_, _src.dptr_, sizeof(DType) * _dst.shape_.Size());
   } else {
@@ -146,6 +169,134 @@ inline void MapPlan(TRValue<R, cpu, dim, DType> *dst,
     }
   }
 }
+// elementwise expressions whose tensors are all contiguous are evaluated as
+// one flat vector, Eval(0, i) of the plan of a contiguous tensor is its i-th
+// element. The vector is cut into chunks that are evaluated in parallel.
+namespace expr {
+/*! \brief number of elements of a chunk of flat evaluation */
+const index_t kFlatChunk = 1 << 14;
+/*! \brief minimum size of flat evaluation to run in parallel */
+const index_t kFlatParallelSize = MSHADOW_OMP_MIN_SIZE;
+/*!
+ * \brief check if an expression only maps elements of contiguous tensors,
+ *  so that it can be evaluated as a flat vector
+ * \tparam E expression
+ */
+template<typename E>
+struct FlatCheck {
+  inline static bool Check(const E &exp) {
+    return false;
+  }
+};
+template<typename DType>
+struct FlatCheck<ScalarExp<DType> > {
+  inline static bool Check(const ScalarExp<DType> &exp) {
+    return true;
+  }
+};
+template<int dim, typename DType>
+struct FlatCheck<Tensor<cpu, dim, DType> > {
+  inline static bool Check(const Tensor<cpu, dim, DType> &t) {
+    return t.CheckContiguous();
+  }
+};
+template<typename DstDType, typename SrcDType, typename EType, int etype>
+struct FlatCheck<TypecastExp<DstDType, SrcDType, EType, etype> > {
+  inline static bool Check(const TypecastExp<DstDType, SrcDType, EType, etype> &t) {
+    return FlatCheck<EType>::Check(t.exp);
+  }
+};
+template<typename OP, typename TA, typename DType, int etype>
+struct FlatCheck<UnaryMapExp<OP, TA, DType, etype> > {
+  inline static bool Check(const UnaryMapExp<OP, TA, DType, etype> &t) {
+    return FlatCheck<TA>::Check(t.src_);
+  }
+};
+template<typename OP, typename TA, typename TB, typename DType, int etype>
+struct FlatCheck<BinaryMapExp<OP, TA, TB, DType, etype> > {
+  inline static bool Check(const BinaryMapExp<OP, TA, TB, DType, etype> &t) {
+    return FlatCheck<TA>::Check(t.lhs_) && FlatCheck<TB>::Check(t.rhs_);
+  }
+};
+template<typename OP, typename TA, typename TB, typename TC, typename DType, int etype>
+struct FlatCheck<TernaryMapExp<OP, TA, TB, TC, DType, etype> > {
+  inline static bool Check(const TernaryMapExp<OP, TA, TB, TC, DType, etype> &t) {
+    return FlatCheck<TA>::Check(t.first_) && FlatCheck<TB>::Check(t.second_) &&
+        FlatCheck<TC>::Check(t.third_);
+  }
+};
+}  // namespace expr
+/*! \brief evaluate plan into dst as a flat vector, chunks run in parallel */
+template<typename Saver, typename R, int dim,
+         typename DType, typename E>
+inline void MapFlatPlan(TRValue<R, cpu, dim, DType> *dst,
+                        const expr::Plan<E, DType> &plan) {
+  const index_t size = expr::ShapeCheck<dim, R>::Check(dst->self()).Size();
+  const index_t nchunk = (size + expr::kFlatChunk - 1) / expr::kFlatChunk;
+  expr::Plan<R, DType> dplan = expr::MakePlan(dst->self());
+  MSHADOW_OMP_PARALLEL_FOR_IF(size >= expr::kFlatParallelSize)
+  for (index_t c = 0; c < nchunk; ++c) {
+    const index_t end = std::min(size, (c + 1) * expr::kFlatChunk);
+    for (index_t i = c * expr::kFlatChunk; i < end; ++i) {
+      Saver::Save(dplan.REval(0, i), plan.Eval(0, i));
+    }
+  }
+}
+#if MSHADOW_USE_SSE
+namespace expr {
+/*!
+ * \brief evaluate one chunk of a flat assignment, with stream = true the
+ *  results are written with non-temporal stores and the sources are
+ *  prefetched once per cache line
+ */
+template<bool stream, typename SV, typename E, typename DType>
+MSHADOW_CINLINE void MapSSEFlatChunk(DType *pdst, const SSEPlan<E, DType> &plan,
+                                     index_t begin, index_t end, index_t size) {
+  const index_t xlen = begin + sse2::LowerAlign(end - begin, sizeof(DType));
+  if (stream) {
+    const index_t kLine = 64 / sizeof(DType);
+    const index_t kDist = sse2::kPrefetchBytes / sizeof(DType);
+    for (index_t x = begin; x < xlen; x += sse2::FVec<DType>::kSize) {
+      if (x % kLine == 0 && x + kDist < size) plan.Prefetch(0, x + kDist);
+      sse2::StreamSaver<SV, DType>::Save(pdst + x, plan.EvalSSE(0, x));
+    }
+    _mm_sfence();
+  } else {
+    for (index_t x = begin; x < xlen; x += sse2::FVec<DType>::kSize) {
+      sse2::Saver<SV, DType>::Save(pdst + x, plan.EvalSSE(0, x));
+    }
+  }
+  for (index_t x = xlen; x < end; ++x) {
+    SV::Save(pdst[x], plan.Eval(0, x));
+  }
+}
+/*!
+ * \brief use SSEPlan to compute result as a flat vector, only the last chunk has a tail.
+ *  saveto of a destination larger than sse2::StreamThreshold() bypasses the cache,
+ *  unless the destination is also read by the expression, as in x = x * 2,
+ *  where the lines are already cached by the loads
+ * \param overlap whether the expression reads the memory of dst
+ */
+template<typename SV, typename E, int dim, typename DType>
+inline void MapSSEFlatPlan(Tensor<cpu, dim, DType> dst,
+                           const SSEPlan<E, DType> &plan, bool overlap) {
+  const index_t size = dst.shape_.Size();
+  const index_t nchunk = (size + kFlatChunk - 1) / kFlatChunk;
+  DType *pdst = dst.dptr_;
+  const bool stream = sse2::StreamSaver<SV, DType>::kEnabled && !overlap &&
+      static_cast<size_t>(size) * sizeof(DType) >= sse2::StreamThreshold();
+  MSHADOW_OMP_PARALLEL_FOR_IF(size >= kFlatParallelSize)
+  for (index_t c = 0; c < nchunk; ++c) {
+    const index_t begin = c * kFlatChunk, end = std::min(size, begin + kFlatChunk);
+    if (stream) {
+      MapSSEFlatChunk<true, SV>(pdst, plan, begin, end, size);
+    } else {
+      MapSSEFlatChunk<false, SV>(pdst, plan, begin, end, size);
+    }
+  }
+}
+}  // namespace expr
+#endif  // MSHADOW_USE_SSE
 // code to handle SSE optimization
 template<bool pass_check, typename Saver,
          typename R, int dim,
@@ -153,7 +304,12 @@ template<bool pass_check, typename Saver,
 struct MapExpCPUEngine {
   inline static void Map(TRValue<R, cpu, dim, DType> *dst,
                          const expr::Exp<E, DType, etype> &exp) {
-    MapPlan<Saver>(dst, MakePlan(exp.self()));
+    if (expr::FlatCheck<E>::Check(exp.self()) &&
+        expr::FlatCheck<R>::Check(dst->self())) {
+      MapFlatPlan<Saver>(dst, MakePlan(exp.self()));
+    } else {
+      MapPlan<Saver>(dst, MakePlan(exp.self()));
+    }
   }
 };
 
@@ -163,15 +319,390 @@ struct MapExpCPUEngine<true, SV, Tensor<cpu, dim, DType>,
                        dim, DType, E, etype> {
   inline static void Map(Tensor<cpu, dim, DType> *dst,
                          const expr::Exp<E, DType, etype> &exp) {
-    if (expr::SSEAlignCheck<dim, E>::Check(exp.self()) &&
+    if (expr::SSEFlatAlignCheck<E>::Check(exp.self()) &&
+        expr::SSEFlatAlignCheck<Tensor<cpu, dim, DType> >::Check(*dst)) {
+      const index_t size = dst->shape_.Size();
+      expr::MapSSEFlatPlan<SV>(dst->self(), MakeSSEPlan(exp.self()),
+                               expr::SSEOverlapCheck<E>::Check(exp.self(), dst->dptr_,
+                                                               dst->dptr_ + size));
+    } else if (expr::SSEAlignCheck<dim, E>::Check(exp.self()) &&
         expr::SSEAlignCheck<dim, Tensor<cpu, dim, DType> >::Check(*dst)) {
       expr::MapSSEPlan<SV>(dst->self(), MakeSSEPlan(exp.self()));
+    } else if (expr::FlatCheck<E>::Check(exp.self()) && dst->CheckContiguous()) {
+      MapFlatPlan<SV>(dst, MakePlan(exp.self()));
     } else {
       MapPlan<SV>(dst, MakePlan(exp.self()));
     }
   }
 };
+#if MSHADOW_USE_FMA
+// dst += a * b and dst -= a * b with aligned tensors are evaluated as
+// dst = dst + a * b and dst = dst - a * b, whose plans use fused multiply-add.
+// The scalar plan of the rewritten form is slower than the saver, so other
+// tensors keep the saver.
+template<typename SV, int dim, typename DType, typename E, int etype>
+struct MapFusedUpdateEngine {
+  inline static void Map(Tensor<cpu, dim, DType> *dst,
+                         const expr::Exp<E, DType, etype> &exp) {
+    if ((expr::SSEFlatAlignCheck<E>::Check(exp.self()) &&
+         expr::SSEFlatAlignCheck<Tensor<cpu, dim, DType> >::Check(*dst)) ||
+        (expr::SSEAlignCheck<dim, E>::Check(exp.self()) &&
+         expr::SSEAlignCheck<dim, Tensor<cpu, dim, DType> >::Check(*dst))) {
+      MapUpdate(dst, expr::F<typename SV::OPType>(*dst, exp.self()));
+    } else {
+      MapExpCPUEngine<false, SV, Tensor<cpu, dim, DType>,
+                      dim, DType, E, etype>::Map(dst, exp);
+    }
+  }
+  template<typename EU, int eutype>
+  inline static void MapUpdate(Tensor<cpu, dim, DType> *dst,
+                               const expr::Exp<EU, DType, eutype> &exp) {
+    MapExpCPUEngine<true, sv::saveto, Tensor<cpu, dim, DType>,
+                    dim, DType, EU, eutype>::Map(dst, exp);
+  }
+};
+template<int dim, typename DType, typename TA, typename TB, int ea, int etype>
+struct MapExpCPUEngine<true, sv::plusto, Tensor<cpu, dim, DType>, dim, DType,
+                       expr::BinaryMapExp<op::mul, TA, TB, DType, ea>, etype>
+    : public MapFusedUpdateEngine<sv::plusto, dim, DType,
+                                  expr::BinaryMapExp<op::mul, TA, TB, DType, ea>, etype> {};
+template<int dim, typename DType, typename TA, typename TB, int ea, int etype>
+struct MapExpCPUEngine<true, sv::minusto, Tensor<cpu, dim, DType>, dim, DType,
+                       expr::BinaryMapExp<op::mul, TA, TB, DType, ea>, etype>
+    : public MapFusedUpdateEngine<sv::minusto, dim, DType,
+                                  expr::BinaryMapExp<op::mul, TA, TB, DType, ea>, etype> {};
+#endif  // MSHADOW_USE_FMA
+#endif  // MSHADOW_USE_SSE
+
+// sliding window evaluation of sum chpool and ch_unpool of 4D tensors.
+// The window of output channel c covers the source channels [start(c), end(c)),
+// both bounds never decrease with c, so a running sum of the window adds and
+// removes each HxW source plane once instead of nsize times. Removing a plane
+// leaves its rounding error in the sum, which is large when the removed planes
+// are large compared with the rest. The sum is kept in double, where that error
+// is far below the rounding of a float result. A sum of double planes has no
+// wider type, it is summed from scratch once as many planes were removed as
+// the window holds, which costs at most one more add per channel.
+namespace expr {
+/*! \brief adds or subtracts a source plane to the window sum */
+template<bool use_sse, typename SrcExp, typename DType>
+struct ChannelWindowPlane {
+  explicit ChannelWindowPlane(const SrcExp &src) : plan_(MakePlan(src)) {}
+  /*! \brief sum += sign * src plane starting at row */
+  inline void Update(Tensor<cpu, 2, double> sum, index_t row, bool add) const {
+    for (index_t y = 0; y < sum.size(0); ++y) {
+      double *psum = sum[y].dptr_;
+      for (index_t x = 0; x < sum.size(1); ++x) {
+        const double v = static_cast<double>(plan_.Eval(row + y, x));
+        psum[x] += add ? v : -v;
+      }
+    }
+  }
+
+ private:
+  Plan<SrcExp, DType> plan_;
+};
+#if MSHADOW_USE_SSE
+template<typename SrcExp, typename DType>
+struct ChannelWindowPlane<true, SrcExp, DType> {
+  explicit ChannelWindowPlane(const SrcExp &src)
+      : plan_(MakePlan(src)), sse_plan_(MakeSSEPlan(src)),
+        aligned_(SSEAlignCheck<4, SrcExp>::Check(src)) {}
+  inline void Update(Tensor<cpu, 2, double> sum, index_t row, bool add) const {
+    const index_t xlen = aligned_ ? sse2::LowerAlign(sum.size(1), sizeof(DType)) : 0;
+    for (index_t y = 0; y < sum.size(0); ++y) {
+      double *psum = sum[y].dptr_;
+      for (index_t x = 0; x < xlen; x += sse2::FVec<DType>::kSize) {
+        Add(psum + x, sse_plan_.EvalSSE(row + y, x), add);
+      }
+      for (index_t x = xlen; x < sum.size(1); ++x) {
+        const double v = static_cast<double>(plan_.Eval(row + y, x));
+        psum[x] += add ? v : -v;
+      }
+    }
+  }
+
+ private:
+  /*! \brief psum[0:4] += or -= v, widened to double */
+  inline static void Add(double *psum, const sse2::FVec<float> &v, bool add) {
+    const __m128d lo = _mm_cvtps_pd(v.data_);
+    const __m128d hi = _mm_cvtps_pd(_mm_movehl_ps(v.data_, v.data_));
+    if (add) {
+      _mm_storeu_pd(psum, _mm_add_pd(_mm_loadu_pd(psum), lo));
+      _mm_storeu_pd(psum + 2, _mm_add_pd(_mm_loadu_pd(psum + 2), hi));
+    } else {
+      _mm_storeu_pd(psum, _mm_sub_pd(_mm_loadu_pd(psum), lo));
+      _mm_storeu_pd(psum + 2, _mm_sub_pd(_mm_loadu_pd(psum + 2), hi));
+    }
+  }
+  /*! \brief psum[0:2] += or -= v */
+  inline static void Add(double *psum, const sse2::FVec<double> &v, bool add) {
+    _mm_storeu_pd(psum, add ? _mm_add_pd(_mm_loadu_pd(psum), v.data_)
+                            : _mm_sub_pd(_mm_loadu_pd(psum), v.data_));
+  }
+  Plan<SrcExp, DType> plan_;
+  SSEPlan<SrcExp, DType> sse_plan_;
+  bool aligned_;
+};
+#endif  // MSHADOW_USE_SSE
+/*! \brief window of chpool, same as Plan<ChannelPoolingExp> */
+struct ChannelPoolWindow {
+  index_t nsize, stride, pad, nchannel;
+  inline void Get(index_t c, index_t *start, index_t *end) const {
+    *start = c * stride < pad ? 0 : c * stride - pad;
+    *end = std::min(*start + nsize, nchannel);
+  }
+};
+/*! \brief window of sum ch_unpool, same as Plan<ChannelUnpoolingExp>, nchannel is the pooled channels */
+struct ChannelUnpoolWindow {
+  index_t nsize, stride, pad, nchannel;
+  inline void Get(index_t c, index_t *start, index_t *end) const {
+    *start = c < nsize - pad ? 0 : (c - (nsize - pad) + stride) / stride;
+    *end = std::min((c + pad + stride) / stride, nchannel);
+  }
+};
+/*!
+ * \brief dst[n][c] = SV(dst[n][c], sum of src planes in window(c)),
+ *  images are processed in parallel
+ * \param nsrc number of channels of src
+ */
+template<typename SV, typename SrcExp, typename DType, typename Window>
+inline void ChannelWindowSum(Tensor<cpu, 4, DType> dst, const SrcExp &src,
+                             index_t nsrc, const Window &window) {
+  const index_t nimg = dst.size(0), nchannel = dst.size(1);
+  const index_t height = dst.size(2), width = dst.size(3);
+  const bool resum = sizeof(DType) >= sizeof(double);
+#if MSHADOW_USE_SSE
+  const ChannelWindowPlane<SSECheck<SrcExp>::kPass, SrcExp, DType> plane(src);
+#else
+  const ChannelWindowPlane<false, SrcExp, DType> plane(src);
 #endif
+  MSHADOW_OMP_PARALLEL_FOR_IF(nimg > 1)
+  for (index_t n = 0; n < nimg; ++n) {
+    Tensor<cpu, 2, double> sum(Shape2(height, width));
+    AllocSpace(&sum);
+    index_t lo = 0, hi = 0, nremoved = 0;
+    for (index_t c = 0; c < nchannel; ++c) {
+      index_t start, end;
+      window.Get(c, &start, &end);
+      if (end < start) end = start;
+      const index_t nremove = (start > lo ? start - lo : 0) + (hi > end ? hi - end : 0);
+      if (start >= hi || (resum && nremoved + nremove > end - start)) {
+        sum = 0.0; lo = hi = start; nremoved = 0;
+      } else {
+        nremoved += nremove;
+      }
+      for (; hi < end; ++hi) plane.Update(sum, (n * nsrc + hi) * height, true);
+      for (; hi > end; --hi) plane.Update(sum, (n * nsrc + hi - 1) * height, false);
+      for (; lo < start; ++lo) plane.Update(sum, (n * nsrc + lo) * height, false);
+      for (index_t y = 0; y < height; ++y) {
+        DType *pdst = dst[n][c][y].dptr_;
+        const double *psum = sum[y].dptr_;
+        for (index_t x = 0; x < width; ++x) SV::Save(pdst[x], static_cast<DType>(psum[x]));
+      }
+    }
+    FreeSpace(&sum);
+  }
+}
+}  // namespace expr
+template<typename SV, typename SrcExp, typename DType>
+struct MapExpCPUEngine<false, SV, Tensor<cpu, 4, DType>, 4, DType,
+                       expr::MakeTensorExp<expr::ChannelPoolingExp<red::sum, SrcExp, DType, 4>,
+                                           SrcExp, 4, DType>,
+                       expr::type::kChainer> {
+  typedef expr::ChannelPoolingExp<red::sum, SrcExp, DType, 4> PoolExp;
+  inline static void Map(TRValue<Tensor<cpu, 4, DType>, cpu, 4, DType> *dst,
+                         const expr::Exp<expr::MakeTensorExp<PoolExp, SrcExp, 4, DType>,
+                                         DType, expr::type::kChainer> &exp) {
+    const PoolExp &e = exp.self().real_self();
+    expr::ChannelPoolWindow window;
+    window.nsize = e.nsize_; window.stride = e.stride_;
+    window.pad = e.pad_; window.nchannel = e.shape_[1];
+    expr::ChannelWindowSum<SV>(dst->self(), e.src_, e.src_channel_, window);
+  }
+};
+template<typename SV, typename SrcExp, typename DType>
+struct MapExpCPUEngine<false, SV, Tensor<cpu, 4, DType>, 4, DType,
+                       expr::MakeTensorExp<expr::ChannelUnpoolingExp<red::sum, SrcExp, DType, 4>,
+                                           SrcExp, 4, DType>,
+                       expr::type::kChainer> {
+  typedef expr::ChannelUnpoolingExp<red::sum, SrcExp, DType, 4> UnpoolExp;
+  inline static void Map(TRValue<Tensor<cpu, 4, DType>, cpu, 4, DType> *dst,
+                         const expr::Exp<expr::MakeTensorExp<UnpoolExp, SrcExp, 4, DType>,
+                                         DType, expr::type::kChainer> &exp) {
+    // the partial gradient of sum is 1, only the gradient of pooled data is needed
+    const UnpoolExp &e = exp.self().real_self();
+    expr::ChannelUnpoolWindow window;
+    window.nsize = e.nsize_; window.stride = e.kstride_;
+    window.pad = e.pad_; window.nchannel = e.pchannel_;
+    expr::ChannelWindowSum<SV>(dst->self(), e.grad_pooled_, e.pchannel_, window);
+  }
+};
+
+// take of a table tensor by an index tensor copies whole rows, the rows a few
+// steps ahead are prefetched since the lookup order is random.
+namespace expr {
+/*! \brief dst = SV(dst, src) over a row */
+template<typename SV, typename DType>
+struct TakeRow {
+  inline static void Copy(DType *dst, const DType *src, index_t n) {
+    for (index_t j = 0; j < n; ++j) SV::Save(dst[j], src[j]);
+  }
+};
+template<typename DType>
+struct TakeRow<sv::saveto, DType> {
+  inline static void Copy(DType *dst, const DType *src, index_t n) {
+    memcpy(dst, src, sizeof(DType) * n);
+  }
+};
+}  // namespace expr
+template<typename SV, typename DType, typename IType>
+struct MapExpCPUEngine<false, SV, Tensor<cpu, 2, DType>, 2, DType,
+                       expr::MakeTensorExp<expr::TakeExp<Tensor<cpu, 2, DType>,
+                                                         Tensor<cpu, 1, IType>, DType, IType>,
+                                           Tensor<cpu, 2, DType>, 2, DType>,
+                       expr::type::kChainer> {
+  typedef expr::TakeExp<Tensor<cpu, 2, DType>, Tensor<cpu, 1, IType>, DType, IType> TakeExp;
+  /*! \brief number of rows to prefetch ahead */
+  static const index_t kPrefetch = 4;
+  inline static void Map(TRValue<Tensor<cpu, 2, DType>, cpu, 2, DType> *dst,
+                         const expr::Exp<expr::MakeTensorExp<TakeExp, Tensor<cpu, 2, DType>,
+                                                             2, DType>,
+                                         DType, expr::type::kChainer> &exp) {
+    const TakeExp &e = exp.self().real_self();
+    Tensor<cpu, 2, DType> out = dst->self();
+    const Tensor<cpu, 2, DType> &table = e.src_;
+    const Tensor<cpu, 1, IType> &index = e.index_;
+    const index_t n = out.size(0), ncol = out.size(1), nrow = e.nrow_;
+    expr::TakeIndexCheck<Tensor<cpu, 1, IType> >::Check(index, nrow, "take");
+    MSHADOW_OMP_PARALLEL_FOR(out.shape_.Size())
+    for (index_t i = 0; i < n; ++i) {
+#if MSHADOW_USE_SSE
+      if (i + kPrefetch < n) {
+        const char *p = reinterpret_cast<const char*>(
+            table[static_cast<index_t>(index[i + kPrefetch])].dptr_);
+        for (size_t k = 0; k < sizeof(DType) * ncol; k += 64) {
+          _mm_prefetch(p + k, _MM_HINT_T0);
+        }
+      }
+#endif
+      expr::TakeRow<SV, DType>::Copy(out[i].dptr_,
+                                     table[static_cast<index_t>(index[i])].dptr_, ncol);
+    }
+  }
+};
+
+// nearest upsampling and bilinear resizing of a tensor work on whole planes in
+// parallel. Bilinear interpolates the needed source rows along width with the
+// precomputed column table, keeps the last two of them since neighbouring
+// output rows share source rows, and blends them along height.
+template<typename SV, int dim, typename DType>
+struct MapExpCPUEngine<false, SV, Tensor<cpu, dim, DType>, dim, DType,
+                       expr::MakeTensorExp<expr::UpSamplingNearestExp<Tensor<cpu, dim, DType>,
+                                                                      DType, dim>,
+                                           Tensor<cpu, dim, DType>, dim, DType>,
+                       expr::type::kChainer> {
+  typedef expr::UpSamplingNearestExp<Tensor<cpu, dim, DType>, DType, dim> UpExp;
+  inline static void Map(TRValue<Tensor<cpu, dim, DType>, cpu, dim, DType> *dst,
+                         const expr::Exp<expr::MakeTensorExp<UpExp, Tensor<cpu, dim, DType>,
+                                                             dim, DType>,
+                                         DType, expr::type::kChainer> &exp) {
+    const UpExp &e = exp.self().real_self();
+    const Tensor<cpu, 3, DType> src = resize::Planes(e.src_);
+    const Tensor<cpu, 3, DType> out = resize::Planes(dst->self());
+    const index_t nplane = out.size(0), height = out.size(1);
+    const index_t swidth = src.size(2), scale = e.scale_;
+    MSHADOW_OMP_PARALLEL_FOR(out.shape_.Size())
+    for (index_t p = 0; p < nplane; ++p) {
+      for (index_t y = 0; y < height; ++y) {
+        const DType *psrc = src[p][y / scale].dptr_;
+        DType *pout = out[p][y].dptr_;
+        for (index_t x = 0; x < swidth; ++x) {
+          const DType v = psrc[x];
+          for (index_t t = 0; t < scale; ++t) SV::Save(pout[x * scale + t], v);
+        }
+      }
+    }
+  }
+};
+template<typename SV, int dim, typename DType>
+struct MapExpCPUEngine<false, SV, Tensor<cpu, dim, DType>, dim, DType,
+                       expr::MakeTensorExp<expr::ResizeBilinearExp<Tensor<cpu, dim, DType>,
+                                                                   DType, dim>,
+                                           Tensor<cpu, dim, DType>, dim, DType>,
+                       expr::type::kChainer> {
+  typedef expr::ResizeBilinearExp<Tensor<cpu, dim, DType>, DType, dim> ResizeExp;
+  inline static void Map(TRValue<Tensor<cpu, dim, DType>, cpu, dim, DType> *dst,
+                         const expr::Exp<expr::MakeTensorExp<ResizeExp, Tensor<cpu, dim, DType>,
+                                                             dim, DType>,
+                                         DType, expr::type::kChainer> &exp) {
+    const ResizeExp &e = exp.self().real_self();
+    const Tensor<cpu, 3, DType> src = resize::Planes(e.src_);
+    const Tensor<cpu, 3, DType> out = resize::Planes(dst->self());
+    const index_t nplane = out.size(0), height = out.size(1), width = out.size(2);
+    if (width == 0) return;
+    const resize::Table<DType> ty(src.size(1), height), tx(src.size(2), width);
+    #if defined(_OPENMP)
+    #pragma omp parallel if (out.shape_.Size() > MSHADOW_OMP_MIN_SIZE)
+    #endif
+    {
+      std::vector<DType> buf(3 * width);
+      DType *hrow[2] = {&buf[0], &buf[width]};
+      DType *vrow = &buf[2 * width];
+      #if defined(_OPENMP)
+      #pragma omp for schedule(static)
+      #endif
+      for (index_t p = 0; p < nplane; ++p) {
+        // source rows held by hrow, the height of the plane means none
+        index_t cached[2] = {src.size(1), src.size(1)};
+        for (index_t y = 0; y < height; ++y) {
+          const index_t y0 = ty.i0[y], y1 = ty.i1[y];
+          int s[2];
+          for (int k = 0; k < 2; ++k) {
+            const index_t r = k == 0 ? y0 : y1, keep = k == 0 ? y1 : y0;
+            if (cached[0] == r || cached[1] == r) {
+              s[k] = cached[0] == r ? 0 : 1;
+              continue;
+            }
+            s[k] = cached[0] == keep ? 1 : 0;
+            resize::RowInterp(hrow[s[k]], src[p][r].dptr_, tx);
+            cached[s[k]] = r;
+          }
+          resize::Kernel<DType>::Lerp(vrow, hrow[s[0]], hrow[s[1]], ty.l[y], width);
+          expr::TakeRow<SV, DType>::Copy(out[p][y].dptr_, vrow, width);
+        }
+      }
+    }
+  }
+};
+
+// argmax/argmin of a tensor along the last axis scan contiguous rows.
+template<typename SV, int dim, typename Reducer, int srcdim, int axis, typename DType>
+struct MapExpCPUEngine<false, SV, Tensor<cpu, dim, DType>, dim, DType,
+                       expr::MakeTensorExp<expr::ArgReduceExp<Reducer, Tensor<cpu, srcdim, DType>,
+                                                              DType, srcdim, axis>,
+                                           Tensor<cpu, srcdim, DType>, dim, DType>,
+                       expr::type::kChainer> {
+  typedef expr::ArgReduceExp<Reducer, Tensor<cpu, srcdim, DType>, DType, srcdim, axis> ArgExp;
+  inline static void Map(TRValue<Tensor<cpu, dim, DType>, cpu, dim, DType> *dst,
+                         const expr::Exp<expr::MakeTensorExp<ArgExp, Tensor<cpu, srcdim, DType>,
+                                                             dim, DType>,
+                                         DType, expr::type::kChainer> &exp) {
+    const ArgExp &e = exp.self().real_self();
+    if (axis != srcdim - 1) {
+      MapPlan<SV>(dst, MakePlan(exp.self()));
+      return;
+    }
+    Tensor<cpu, 2, DType> src = e.src_.FlatTo2D();
+    Tensor<cpu, 2, DType> out = dst->self().FlatTo2D();
+    const index_t ncol = out.size(1);
+    MSHADOW_OMP_PARALLEL_FOR(src.shape_.Size())
+    for (index_t r = 0; r < src.size(0); ++r) {
+      const index_t best = argreduce::Kernel<Reducer, DType>::Row(src[r].dptr_, src.size(1));
+      SV::Save(out[r / ncol][r % ncol], static_cast<DType>(best));
+    }
+  }
+};
 
 template<typename Saver, typename R, int dim,
          typename DType, typename E, int etype>
@@ -183,6 +714,8 @@ inline void MapExp(TRValue<R, cpu, dim, DType> *dst,
   Shape<dim> dshape = expr::ShapeCheck<dim, R>::Check(dst->self());
   CHECK(eshape[0] == 0 || eshape == dshape)
     << "Assignment: Shape of Tensors are not consistent with target";
+  MSHADOW_TRACE_SCOPE("MapExp", "op", dshape, dshape.Size(),
+                      sizeof(DType) * dshape.Size());
 #if MSHADOW_USE_SSE
   MapExpCPUEngine<expr::SSECheck<E>::kPass, Saver, R, dim, DType, E, etype>
       ::Map(dst->ptrself(), exp);
@@ -203,6 +736,8 @@ inline void MapReduceKeepLowest(TRValue<R, cpu, 1, DType> *dst,
   Shape<1> dshape = expr::ShapeCheck<1, R>::Check(dst->self());
   CHECK_EQ(eshape[1], dshape[0]) << "MapReduceKeepLowest::reduction dimension do not match";
   CHECK_NE(eshape[0], 0) << "can not reduce over empty tensor";
+  MSHADOW_TRACE_SCOPE("MapReduceKeepLowest", "op", eshape, eshape.Size(),
+                      sizeof(DType) * eshape.Size());
   // execution
   expr::Plan<R, DType> dplan = MakePlan(dst->self());
   expr::Plan<E, DType> splan = MakePlan(exp.self());
@@ -228,6 +763,8 @@ inline void MapReduceKeepHighDim(TRValue<R, cpu, 1, DType> *dst,
   Shape<1> dshape = expr::ShapeCheck<1, R>::Check(dst->self());
   CHECK_EQ(eshape[dimkeep], dshape[0])
     << "MapReduceKeepHighDim::reduction dimension do not match";
+  MSHADOW_TRACE_SCOPE("MapReduceKeepHighDim", "op", eshape, eshape.Size(),
+                      sizeof(DType) * eshape.Size());
   // use equvalent form
   Shape<4> pshape = Shape4(eshape.ProdShape(0, dimkeep),
                            eshape[dimkeep],
@@ -273,6 +810,8 @@ template<typename DType>
 inline void SoftmaxGrad(Tensor<cpu, 2, DType> dst,
                         const Tensor<cpu, 2, DType> &src,
                         const Tensor<cpu, 1, DType> &label) {
+  MSHADOW_TRACE_SCOPE("SoftmaxGrad", "op", dst.shape_, dst.shape_.Size(),
+                      2 * sizeof(DType) * dst.shape_.Size());
   for (index_t y = 0; y < dst.size(0); ++y) {
     const index_t k = static_cast<int>(label[y]);
     for (index_t x = 0; x < dst.size(1); ++x) {
@@ -289,6 +828,8 @@ template<typename DType>
 inline void Softmax(Tensor<cpu, 2, DType> dst,
                     const Tensor<cpu, 2, DType> &energy) {
   CHECK_EQ(dst.shape_, energy.shape_) << "Softmax: shape mismatch";
+  MSHADOW_TRACE_SCOPE("Softmax", "op", dst.shape_, 4 * dst.shape_.Size(),
+                      2 * sizeof(DType) * dst.shape_.Size());
   for (index_t y = 0; y < dst.size(0); ++y) {
     Softmax(dst[y], energy[y]);
   }
@@ -0,0 +1,361 @@
+/*!
+ *  Copyright (c) 2014 by Contributors
+ * \file tensor_csr.h
+ * \brief sparse matrix in compressed sparse row format, e.g. bag of words
+ *  or one-hot features, that can be used as lhs of dot:
+ *
+ *    CSRTensor<cpu, float> x;
+ *    x.FromDense(dense_x);
+ *    out = dot(x, wmat);           // sparse x dense
+ *    gwmat = dot(x.T(), grad);     // gradient of wmat
+ *
+ *  Only the nonzeros are stored and multiplied, the rows of the dense
+ *  matrix are combined by SIMD axpy.
+ * \author Tianqi Chen
+ */
+#ifndef MSHADOW_TENSOR_CSR_H_
+#define MSHADOW_TENSOR_CSR_H_
+#include <algorithm>
+#include <vector>
+#include "./tensor.h"
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+namespace mshadow {
+/*!
+ * \brief sparse matrix in compressed sparse row format,
+ *  the nonzeros of row i are data_[indptr_[i]] to data_[indptr_[i + 1] - 1],
+ *  and their columns are in indices_, in increasing order
+ * \tparam Device which device the tensor is on, only cpu is supported
+ * \tparam DType the type of elements
+ */
+template<typename Device, typename DType MSHADOW_DEFAULT_DTYPE>
+class CSRTensor;
+template<typename DType>
+class CSRTensor<cpu, DType> : public expr::RValueExp<CSRTensor<cpu, DType>, DType> {
+ public:
+  /*! \brief shape of the matrix, (nrow, ncol) */
+  Shape<2> shape_;
+  /*! \brief values of the nonzeros */
+  std::vector<DType> data_;
+  /*! \brief column index of the nonzeros */
+  std::vector<index_t> indices_;
+  /*! \brief start of each row in data_, of size nrow + 1 */
+  std::vector<index_t> indptr_;
+  /*! \brief constructor of empty matrix */
+  CSRTensor(void) : shape_(Shape2(0, 0)), indptr_(1, 0) {}
+  /*! \brief constructor of all zero matrix of a shape */
+  explicit CSRTensor(Shape<2> shape) : shape_(shape), indptr_(shape[0] + 1, 0) {}
+  /*!
+   * \brief set the shape and number of nonzeros, the content is to be filled
+   * \param shape shape of the matrix
+   * \param nnz number of nonzeros
+   */
+  inline void Resize(Shape<2> shape, index_t nnz) {
+    shape_ = shape;
+    data_.resize(nnz);
+    indices_.resize(nnz);
+    indptr_.resize(shape[0] + 1);
+    indptr_[0] = 0;
+    indptr_[shape[0]] = nnz;
+  }
+  /*! \brief set from a dense matrix, the zeros are dropped */
+  inline void FromDense(const Tensor<cpu, 2, DType> &src) {
+    shape_ = src.shape_;
+    data_.clear(); indices_.clear();
+    indptr_.resize(src.size(0) + 1);
+    indptr_[0] = 0;
+    for (index_t i = 0; i < src.size(0); ++i) {
+      for (index_t j = 0; j < src.size(1); ++j) {
+        if (src[i][j] != DType(0)) {
+          data_.push_back(src[i][j]);
+          indices_.push_back(j);
+        }
+      }
+      indptr_[i + 1] = static_cast<index_t>(data_.size());
+    }
+  }
+  /*! \brief write the matrix into a dense matrix of the same shape */
+  inline void ToDense(Tensor<cpu, 2, DType> dst) const {
+    CHECK_EQ(dst.shape_, shape_) << "CSRTensor::ToDense: shape mismatch";
+    for (index_t i = 0; i < shape_[0]; ++i) {
+      std::fill(dst[i].dptr_, dst[i].dptr_ + shape_[1], DType(0));
+      for (index_t k = indptr_[i]; k < indptr_[i + 1]; ++k) {
+        dst[i][indices_[k]] = data_[k];
+      }
+    }
+  }
+  /*! \brief check the structure of the matrix */
+  inline void Check(void) const {
+    CHECK(indptr_.size() == shape_[0] + 1 && indptr_[0] == 0 &&
+          indptr_[shape_[0]] == data_.size() && indices_.size() == data_.size())
+      << "CSRTensor: inconsistent indptr";
+    for (index_t i = 0; i < shape_[0]; ++i) {
+      CHECK_LE(indptr_[i], indptr_[i + 1]) << "CSRTensor: indptr must not decrease";
+    }
+    for (size_t k = 0; k < indices_.size(); ++k) {
+      CHECK_LT(indices_[k], shape_[1]) << "CSRTensor: column index out of range";
+    }
+  }
+  /*! \return number of nonzeros */
+  inline index_t nnz(void) const {
+    return static_cast<index_t>(data_.size());
+  }
+  /*! \return size of i-th dimension */
+  MSHADOW_XINLINE index_t size(index_t i) const {
+    return shape_[i];
+  }
+};
+
+namespace csr {
+/*! \brief dense row kernels, generic version */
+template<typename DType>
+struct Kernel {
+  /*! \brief y += a * x */
+  inline static void Axpy(DType *y, const DType *x, DType a, index_t n) {
+    for (index_t j = 0; j < n; ++j) y[j] += a * x[j];
+  }
+  /*! \brief sum of val[p] * x[idx[p]] over the nnz nonzeros of a row */
+  inline static DType SparseDot(const DType *val, const index_t *idx,
+                                const DType *x, index_t nnz) {
+    DType sum = 0;
+    for (index_t p = 0; p < nnz; ++p) sum += val[p] * x[idx[p]];
+    return sum;
+  }
+};
+#if MSHADOW_USE_SSE
+template<>
+struct Kernel<float> {
+  inline static void Axpy(float *y, const float *x, float a, index_t n) {
+    const index_t nv = (n >> 2) << 2;
+    const __m128 va = _mm_set1_ps(a);
+    for (index_t j = 0; j < nv; j += 4) {
+      _mm_storeu_ps(y + j, _mm_add_ps(_mm_loadu_ps(y + j),
+                                      _mm_mul_ps(va, _mm_loadu_ps(x + j))));
+    }
+    for (index_t j = nv; j < n; ++j) y[j] += a * x[j];
+  }
+  inline static float SparseDot(const float *val, const index_t *idx,
+                                const float *x, index_t nnz) {
+    // the values are loaded as vectors, x is gathered by scalar loads,
+    // two accumulators hide the latency of add
+    const index_t nv = (nnz >> 3) << 3;
+    __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps();
+    for (index_t p = 0; p < nv; p += 8) {
+      const __m128 x0 = _mm_set_ps(x[idx[p + 3]], x[idx[p + 2]], x[idx[p + 1]], x[idx[p]]);
+      const __m128 x1 = _mm_set_ps(x[idx[p + 7]], x[idx[p + 6]], x[idx[p + 5]], x[idx[p + 4]]);
+      s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(val + p), x0));
+      s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_loadu_ps(val + p + 4), x1));
+    }
+    float sum = sse2::FVec<float>(_mm_add_ps(s0, s1)).Sum();
+    for (index_t p = nv; p < nnz; ++p) sum += val[p] * x[idx[p]];
+    return sum;
+  }
+};
+#endif  // MSHADOW_USE_SSE
+/*! \brief y *= b, y is set to 0 when b is 0 */
+template<typename DType>
+inline void Scale(DType *y, DType b, index_t n) {
+  if (b == DType(0)) {
+    std::fill(y, y + n, DType(0));
+  } else if (b != DType(1)) {
+    for (index_t j = 0; j < n; ++j) y[j] *= b;
+  }
+}
+/*!
+ * \brief dst = beta * dst + alpha * lhs * rhs, rows of dst in parallel
+ * \param lhs sparse matrix, m x k
+ * \param rhs dense matrix, k x n
+ * \param dst dense matrix, m x n
+ */
+template<typename DType>
+inline void SpMM(Tensor<cpu, 2, DType> dst, const CSRTensor<cpu, DType> &lhs,
+                 const Tensor<cpu, 2, DType> &rhs, DType alpha, DType beta) {
+  const index_t m = dst.size(0), n = dst.size(1);
+  #if defined(_OPENMP)
+  #pragma omp parallel for schedule(dynamic, 16) if (lhs.nnz() * n > MSHADOW_OMP_MIN_SIZE)
+  #endif
+  for (index_t i = 0; i < m; ++i) {
+    DType *y = dst[i].dptr_;
+    Scale(y, beta, n);
+    for (index_t k = lhs.indptr_[i]; k < lhs.indptr_[i + 1]; ++k) {
+      Kernel<DType>::Axpy(y, rhs[lhs.indices_[k]].dptr_, alpha * lhs.data_[k], n);
+    }
+  }
+}
+/*!
+ * \brief dst = beta * dst + alpha * lhs.T() * rhs. On one thread the
+ *  nonzeros are scattered into the rows of dst. With more threads the matrix
+ *  is first transposed to compressed columns, keeping the order of rows, so
+ *  each row of dst is a gather of its own nonzeros, without conflicts and in
+ *  the serial order
+ * \param lhs sparse matrix, k x m
+ * \param rhs dense matrix, k x n
+ * \param dst dense matrix, m x n
+ */
+template<typename DType>
+inline void SpMMTrans(Tensor<cpu, 2, DType> dst, const CSRTensor<cpu, DType> &lhs,
+                      const Tensor<cpu, 2, DType> &rhs, DType alpha, DType beta) {
+  const index_t m = dst.size(0), n = dst.size(1), k = lhs.size(0);
+  int nthread = 1;
+  #if defined(_OPENMP)
+  if (lhs.nnz() * n > MSHADOW_OMP_MIN_SIZE) {
+    nthread = std::min(omp_get_max_threads(), static_cast<int>(m));
+  }
+  #endif
+  if (nthread <= 1) {
+    for (index_t j = 0; j < m; ++j) Scale(dst[j].dptr_, beta, n);
+    for (index_t i = 0; i < k; ++i) {
+      for (index_t p = lhs.indptr_[i]; p < lhs.indptr_[i + 1]; ++p) {
+        Kernel<DType>::Axpy(dst[lhs.indices_[p]].dptr_, rhs[i].dptr_,
+                            alpha * lhs.data_[p], n);
+      }
+    }
+    return;
+  }
+  #if defined(_OPENMP)
+  // counting sort of the nonzeros by column
+  std::vector<index_t> colptr(m + 1, 0), row(lhs.nnz());
+  std::vector<DType> val(lhs.nnz());
+  for (index_t p = 0; p < lhs.nnz(); ++p) ++colptr[lhs.indices_[p] + 1];
+  for (index_t j = 0; j < m; ++j) colptr[j + 1] += colptr[j];
+  std::vector<index_t> pos(colptr.begin(), colptr.end() - 1);
+  for (index_t i = 0; i < k; ++i) {
+    for (index_t p = lhs.indptr_[i]; p < lhs.indptr_[i + 1]; ++p) {
+      const index_t q = pos[lhs.indices_[p]]++;
+      row[q] = i; val[q] = lhs.data_[p];
+    }
+  }
+  #pragma omp parallel for schedule(dynamic, 16) num_threads(nthread)
+  for (ms_omp_uint j = 0; j < static_cast<ms_omp_uint>(m); ++j) {
+    DType *y = dst[j].dptr_;
+    Scale(y, beta, n);
+    for (index_t q = colptr[j]; q < colptr[j + 1]; ++q) {
+      Kernel<DType>::Axpy(y, rhs[row[q]].dptr_, alpha * val[q], n);
+    }
+  }
+  #endif
+}
+/*! \brief dst = beta * dst + alpha * lhs * rhs, rhs is a vector */
+template<typename DType>
+inline void SpMV(Tensor<cpu, 1, DType> dst, const CSRTensor<cpu, DType> &lhs,
+                 const Tensor<cpu, 1, DType> &rhs, DType alpha, DType beta) {
+  const index_t m = dst.size(0);
+  if (lhs.nnz() == 0) {
+    Scale(dst.dptr_, beta, m);
+    return;
+  }
+  const DType *val = &lhs.data_[0];
+  const index_t *idx = &lhs.indices_[0];
+  MSHADOW_OMP_PARALLEL_FOR(lhs.nnz())
+  for (index_t i = 0; i < m; ++i) {
+    const index_t begin = lhs.indptr_[i];
+    const DType sum = Kernel<DType>::SparseDot(val + begin, idx + begin, rhs.dptr_,
+                                               lhs.indptr_[i + 1] - begin);
+    dst[i] = (beta == DType(0) ? DType(0) : beta * dst[i]) + alpha * sum;
+  }
+}
+}  // namespace csr
+
+namespace expr {
+template<typename SV, bool ltrans, typename DType>
+struct ExpComplexEngine<SV, Tensor<cpu, 2, DType>,
+                        DotExp<CSRTensor<cpu, DType>, Tensor<cpu, 2, DType>,
+                               ltrans, false, DType>,
+                        DType> {
+  inline static void Eval(Tensor<cpu, 2, DType> *dst,
+                          const DotExp<CSRTensor<cpu, DType>, Tensor<cpu, 2, DType>,
+                                       ltrans, false, DType> &exp) {
+    const CSRTensor<cpu, DType> &lhs = exp.lhs_;
+    const Tensor<cpu, 2, DType> &rhs = exp.rhs_;
+    const index_t m = ltrans ? lhs.size(1) : lhs.size(0);
+    const index_t k = ltrans ? lhs.size(0) : lhs.size(1);
+    CHECK(dst->size(0) == m && dst->size(1) == rhs.size(1) && k == rhs.size(0))
+      << "dot-csr: matrix shape mismatch"
+      << "dst: " << dst->shape_ << "\n"
+      << "lhs: " << lhs.shape_ << "\n"
+      << "rhs: " << rhs.shape_ << "\n";
+    MSHADOW_TRACE_SCOPE("spmm", "blas", Shape3(m, k, rhs.size(1)),
+                        2.0 * lhs.nnz() * rhs.size(1),
+                        sizeof(DType) * (2.0 * lhs.nnz() * rhs.size(1) + dst->MSize()));
+    const DType alpha = exp.scale_ * SV::AlphaBLAS(), beta = SV::BetaBLAS();
+    if (ltrans) {
+      csr::SpMMTrans(*dst, lhs, rhs, alpha, beta);
+    } else {
+      csr::SpMM(*dst, lhs, rhs, alpha, beta);
+    }
+  }
+};
+template<typename SV, bool ltrans, typename DType>
+struct ExpComplexEngine<SV, Tensor<cpu, 1, DType>,
+                        DotExp<CSRTensor<cpu, DType>, Tensor<cpu, 1, DType>,
+                               ltrans, false, DType>,
+                        DType> {
+  inline static void Eval(Tensor<cpu, 1, DType> *dst,
+                          const DotExp<CSRTensor<cpu, DType>, Tensor<cpu, 1, DType>,
+                                       ltrans, false, DType> &exp) {
+    const CSRTensor<cpu, DType> &lhs = exp.lhs_;
+    const Tensor<cpu, 1, DType> &rhs = exp.rhs_;
+    const index_t m = ltrans ? lhs.size(1) : lhs.size(0);
+    const index_t k = ltrans ? lhs.size(0) : lhs.size(1);
+    CHECK(dst->size(0) == m && k == rhs.size(0))
+      << "dot-csr: matrix shape mismatch"
+      << "dst: " << dst->shape_ << "\n"
+      << "lhs: " << lhs.shape_ << "\n"
+      << "rhs: " << rhs.shape_ << "\n";
+    MSHADOW_TRACE_SCOPE("spmv", "blas", Shape2(m, k), 2.0 * lhs.nnz(),
+                        sizeof(DType) * (2.0 * lhs.nnz() + m));
+    const DType alpha = exp.scale_ * SV::AlphaBLAS(), beta = SV::BetaBLAS();
+    if (ltrans) {
+      // the transposed product scatters into dst, done as a matrix of one column
+      Tensor<cpu, 2, DType> dst2(dst->dptr_, Shape2(m, 1), 1, dst->stream_);
+      Tensor<cpu, 2, DType> rhs2(rhs.dptr_, Shape2(k, 1), 1, rhs.stream_);
+      csr::SpMMTrans(dst2, lhs, rhs2, alpha, beta);
+    } else {
+      csr::SpMV(*dst, lhs, rhs, alpha, beta);
+    }
+  }
+};
+}  // namespace expr
+/*!
+ * \brief save a sparse matrix by binary format
+ * \param fo output binary stream
+ * \param src source matrix
+ * \tparam DType type of element in tensor
+ * \tparam TStream type of stream, need to support Read, Write, one example is utils::IStream.
+ */
+template<typename DType, typename TStream>
+inline void SaveBinary(TStream &fo, const CSRTensor<cpu, DType> &src) {  // NOLINT(*)
+  const index_t nnz = src.nnz();
+  fo.Write(&src.shape_, sizeof(src.shape_));
+  fo.Write(&nnz, sizeof(nnz));
+  fo.Write(&src.indptr_[0], sizeof(index_t) * src.indptr_.size());
+  if (nnz == 0) return;
+  fo.Write(&src.indices_[0], sizeof(index_t) * nnz);
+  fo.Write(&src.data_[0], sizeof(DType) * nnz);
+}
+/*!
+ * \brief load a sparse matrix by binary format, the space of dst is allocated
+ * \param fi input binary stream
+ * \param dst destination matrix
+ * \tparam DType type of element in tensor
+ * \tparam TStream type of stream, need to support Read, Write, one example is utils::IStream.
+ */
+template<typename DType, typename TStream>
+inline void LoadBinary(TStream &fi, CSRTensor<cpu, DType> *dst) {  // NOLINT(*)
+  Shape<2> shape;
+  index_t nnz;
+  CHECK_NE(fi.Read(&shape, sizeof(shape)), 0) << "mshadow::LoadBinary";
+  CHECK_NE(fi.Read(&nnz, sizeof(nnz)), 0) << "mshadow::LoadBinary";
+  dst->Resize(shape, nnz);
+  CHECK_NE(fi.Read(&dst->indptr_[0], sizeof(index_t) * dst->indptr_.size()), 0)
+    << "mshadow::LoadBinary";
+  if (nnz != 0) {
+    CHECK_NE(fi.Read(&dst->indices_[0], sizeof(index_t) * nnz), 0) << "mshadow::LoadBinary";
+    CHECK_NE(fi.Read(&dst->data_[0], sizeof(DType) * nnz), 0) << "mshadow::LoadBinary";
+  }
+  dst->Check();
+}
+}  // namespace mshadow
+#endif  // MSHADOW_TENSOR_CSR_H_
@@ -0,0 +1,296 @@
+/*!
+ *  Copyright (c) 2014 by Contributors
+ * \file tensor_fixed.h
+ * \brief tensor whose shape is known at compile time, with inline storage,
+ *  e.g. FixedTensor<float, 3, 3> for a 3x3 transform. Assignment of expressions
+ *  and dot of fixed tensors are fully unrolled, so small math pays no loop
+ *  or stride overhead. Requires c++11.
+ * \author Tianqi Chen
+ */
+#ifndef MSHADOW_TENSOR_FIXED_H_
+#define MSHADOW_TENSOR_FIXED_H_
+#include "./tensor.h"
+
+#if MSHADOW_IN_CXX11
+namespace mshadow {
+/*!
+ * \brief shape whose extents are template parameters
+ * \tparam dims the extents, from highest dimension to lowest
+ */
+template<index_t... dims>
+struct StaticShape;
+template<>
+struct StaticShape<> {
+  static const int kDimension = 0;
+  static const index_t kSize = 1;
+  static const index_t kLast = 1;
+};
+template<index_t d0, index_t... rest>
+struct StaticShape<d0, rest...> {
+  /*! \brief dimension of the shape */
+  static const int kDimension = 1 + static_cast<int>(sizeof...(rest));
+  /*! \brief number of elements */
+  static const index_t kSize = d0 * StaticShape<rest...>::kSize;
+  /*! \brief extent of the lowest dimension */
+  static const index_t kLast = sizeof...(rest) == 0 ? d0 : StaticShape<rest...>::kLast;
+  /*! \return the shape as runtime Shape */
+  MSHADOW_XINLINE static Shape<kDimension> Get(void) {
+    const index_t v[] = {d0, rest...};
+    Shape<kDimension> s;
+    #pragma unroll
+    for (int i = 0; i < kDimension; ++i) s[i] = v[i];
+    return s;
+  }
+};
+/*!
+ * \brief tensor of fixed shape on cpu, the data is stored inside the object
+ *  and aligned for SSE, it can be used in expressions like Tensor
+ * \tparam DType the type of elements
+ * \tparam dims the extents of the shape
+ */
+template<typename DType, index_t... dims>
+struct FixedTensor
+    : public TRValue<FixedTensor<DType, dims...>, cpu,
+                     StaticShape<dims...>::kDimension, DType> {
+ public:
+  /*! \brief the static shape */
+  typedef StaticShape<dims...> TShape;
+  /*! \brief dimension of the tensor */
+  static const int kDimension = TShape::kDimension;
+  /*! \brief number of elements */
+  static const index_t kSize = TShape::kSize;
+  /*! \brief the data, row major without padding */
+  alignas(16) DType data_[kSize];
+  /*! \brief default constructor, the data is not initialized */
+  FixedTensor(void) {}
+  /*! \brief constructor, fill with initv */
+  explicit FixedTensor(DType initv) {
+    this->__assign(initv);
+  }
+  /*! \return the shape of the tensor */
+  MSHADOW_XINLINE static Shape<kDimension> shape(void) {
+    return TShape::Get();
+  }
+  /*! \return a tensor that refers to the data, used with functions taking Tensor */
+  inline Tensor<cpu, kDimension, DType> tensor(void) {
+    return Tensor<cpu, kDimension, DType>(data_, TShape::Get());
+  }
+  /*! \return a tensor that refers to the data, used with functions taking Tensor */
+  inline Tensor<cpu, kDimension, DType> tensor(void) const {
+    return Tensor<cpu, kDimension, DType>(const_cast<DType*>(data_), TShape::Get());
+  }
+  /*! \brief element at flat index i */
+  MSHADOW_XINLINE DType &operator()(index_t i) {
+    return data_[i];
+  }
+  /*! \brief element at flat index i */
+  MSHADOW_XINLINE const DType &operator()(index_t i) const {
+    return data_[i];
+  }
+  /*! \brief element at [y][x] of the tensor flattened to 2D */
+  MSHADOW_XINLINE DType &operator()(index_t y, index_t x) {
+    return data_[y * TShape::kLast + x];
+  }
+  /*! \brief element at [y][x] of the tensor flattened to 2D */
+  MSHADOW_XINLINE const DType &operator()(index_t y, index_t x) const {
+    return data_[y * TShape::kLast + x];
+  }
+  /*!\brief functions to fit expression template */
+  template<typename E, int etype>
+  inline FixedTensor &operator=(const expr::Exp<E, DType, etype> &exp) {
+    return this->__assign(exp);
+  }
+  /*!\brief functions to fit expression template */
+  inline FixedTensor &operator=(const DType &exp) {
+    return this->__assign(exp);
+  }
+};
+namespace expr {
+/*!
+ * \brief compile time loop over [begin, begin + len),
+ *  calls f.template Apply<i>() for each i, split in halves to keep
+ *  the recursion shallow
+ */
+template<index_t begin, index_t len>
+struct StaticFor {
+  template<typename F>
+  MSHADOW_XINLINE static void Run(F &f) {  // NOLINT(*)
+    StaticFor<begin, len / 2>::Run(f);
+    StaticFor<begin + len / 2, len - len / 2>::Run(f);
+  }
+};
+template<index_t begin>
+struct StaticFor<begin, 1> {
+  template<typename F>
+  MSHADOW_XINLINE static void Run(F &f) {  // NOLINT(*)
+    f.template Apply<begin>();
+  }
+};
+template<index_t begin>
+struct StaticFor<begin, 0> {
+  template<typename F>
+  MSHADOW_XINLINE static void Run(F &f) {}  // NOLINT(*)
+};
+// plan of fixed tensor, the stride is a constant
+template<typename DType, index_t... dims>
+class Plan<FixedTensor<DType, dims...>, DType> {
+ public:
+  explicit Plan(const FixedTensor<DType, dims...> &t)
+      : dptr_(const_cast<DType*>(t.data_)) {}
+  MSHADOW_XINLINE DType &REval(index_t y, index_t x) {
+    return dptr_[y * StaticShape<dims...>::kLast + x];
+  }
+  MSHADOW_XINLINE const DType &Eval(index_t y, index_t x) const {
+    return dptr_[y * StaticShape<dims...>::kLast + x];
+  }
+
+ private:
+  DType *dptr_;
+};
+template<typename DType, index_t... dims>
+inline Plan<FixedTensor<DType, dims...>, DType>
+MakePlan(const FixedTensor<DType, dims...> &t) {
+  return Plan<FixedTensor<DType, dims...>, DType>(t);
+}
+template<typename DType, index_t... dims>
+struct ExpInfo<FixedTensor<DType, dims...> > {
+  static const int kDim = StaticShape<dims...>::kDimension;
+  static const int kDevMask = cpu::kDevMask;
+};
+template<int dim, typename DType, index_t... dims>
+struct ShapeCheck<dim, FixedTensor<DType, dims...> > {
+  inline static Shape<dim> Check(const FixedTensor<DType, dims...> &t) {
+    return StaticShape<dims...>::Get();
+  }
+};
+// evaluates one element of the expression into the fixed tensor
+template<typename Saver, typename DType, index_t ncol, typename E>
+struct FixedMapper {
+  Plan<E, DType> src;
+  DType *dst;
+  template<index_t i>
+  MSHADOW_XINLINE void Apply(void) {
+    Saver::Save(dst[i], src.Eval(i / ncol, i % ncol));
+  }
+};
+// evaluates one element of dot of fixed tensors
+template<typename DType, index_t nrow, index_t ncol, index_t nred,
+         bool ltrans, bool rtrans>
+struct FixedDotElem {
+  const DType *lhs, *rhs;
+  DType sum;
+  index_t y, x;
+  template<index_t k>
+  MSHADOW_XINLINE void Apply(void) {
+    sum += lhs[ltrans ? k * nrow + y : y * nred + k] *
+        rhs[rtrans ? x * nred + k : k * ncol + x];
+  }
+};
+template<typename Saver, typename DType, index_t nrow, index_t ncol, index_t nred,
+         bool ltrans, bool rtrans>
+struct FixedDot {
+  const DType *lhs, *rhs;
+  DType *dst;
+  DType scale;
+  template<index_t i>
+  MSHADOW_XINLINE void Apply(void) {
+    FixedDotElem<DType, nrow, ncol, nred, ltrans, rtrans> e;
+    e.lhs = lhs; e.rhs = rhs; e.sum = DType(0);
+    e.y = i / ncol; e.x = i % ncol;
+    StaticFor<0, nred>::Run(e);
+    Saver::Save(dst[i], scale * e.sum);
+  }
+};
+// dot of fixed matrices into a fixed matrix, fully unrolled
+template<typename SV, typename DType, index_t m, index_t n,
+         index_t a0, index_t a1, index_t b0, index_t b1,
+         bool ltrans, bool rtrans>
+struct ExpComplexEngine<SV, FixedTensor<DType, m, n>,
+                        DotExp<FixedTensor<DType, a0, a1>,
+                               FixedTensor<DType, b0, b1>,
+                               ltrans, rtrans, DType>,
+                        DType> {
+  inline static void Eval(FixedTensor<DType, m, n> *dst,
+                          const DotExp<FixedTensor<DType, a0, a1>,
+                                       FixedTensor<DType, b0, b1>,
+                                       ltrans, rtrans, DType> &exp) {
+    static const index_t kRed = ltrans ? a0 : a1;
+    static_assert((ltrans ? a1 : a0) == m && (rtrans ? b0 : b1) == n &&
+                  (rtrans ? b1 : b0) == kRed, "dot: matrix shape mismatch");
+    FixedDot<SV, DType, m, n, kRed, ltrans, rtrans> f;
+    f.lhs = exp.lhs_.data_; f.rhs = exp.rhs_.data_;
+    f.dst = dst->data_; f.scale = exp.scale_;
+    StaticFor<0, m * n>::Run(f);
+  }
+};
+// dot of fixed vector and matrix into a fixed vector, fully unrolled
+template<typename SV, typename DType, index_t n,
+         index_t a0, index_t b0, index_t b1, bool rtrans>
+struct ExpComplexEngine<SV, FixedTensor<DType, n>,
+                        DotExp<FixedTensor<DType, a0>,
+                               FixedTensor<DType, b0, b1>,
+                               false, rtrans, DType>,
+                        DType> {
+  inline static void Eval(FixedTensor<DType, n> *dst,
+                          const DotExp<FixedTensor<DType, a0>,
+                                       FixedTensor<DType, b0, b1>,
+                                       false, rtrans, DType> &exp) {
+    static_assert((rtrans ? b0 : b1) == n && (rtrans ? b1 : b0) == a0,
+                  "dot: matrix shape mismatch");
+    FixedDot<SV, DType, 1, n, a0, false, rtrans> f;
+    f.lhs = exp.lhs_.data_; f.rhs = exp.rhs_.data_;
+    f.dst = dst->data_; f.scale = exp.scale_;
+    StaticFor<0, n>::Run(f);
+  }
+};
+// dot of fixed tensors into a tensor, evaluated by DotEngine
+template<typename SV, typename DType, int dim,
+         index_t... ldims, index_t... rdims, bool ltrans, bool rtrans>
+struct ExpComplexEngine<SV, Tensor<cpu, dim, DType>,
+                        DotExp<FixedTensor<DType, ldims...>,
+                               FixedTensor<DType, rdims...>,
+                               ltrans, rtrans, DType>,
+                        DType> {
+  inline static void Eval(Tensor<cpu, dim, DType> *dst,
+                          const DotExp<FixedTensor<DType, ldims...>,
+                                       FixedTensor<DType, rdims...>,
+                                       ltrans, rtrans, DType> &exp) {
+    DotEngine<SV, cpu, dim, sizeof...(ldims), sizeof...(rdims), ltrans, rtrans, DType>
+        ::Eval(dst, exp.lhs_.tensor(), exp.rhs_.tensor(), exp.scale_);
+  }
+};
+// dot of tensors into a fixed tensor, evaluated by DotEngine
+template<typename SV, typename DType, int ldim, int rdim,
+         index_t... dims, bool ltrans, bool rtrans>
+struct ExpComplexEngine<SV, FixedTensor<DType, dims...>,
+                        DotExp<Tensor<cpu, ldim, DType>,
+                               Tensor<cpu, rdim, DType>,
+                               ltrans, rtrans, DType>,
+                        DType> {
+  inline static void Eval(FixedTensor<DType, dims...> *dst,
+                          const DotExp<Tensor<cpu, ldim, DType>,
+                                       Tensor<cpu, rdim, DType>,
+                                       ltrans, rtrans, DType> &exp) {
+    Tensor<cpu, sizeof...(dims), DType> out = dst->tensor();
+    DotEngine<SV, cpu, sizeof...(dims), ldim, rdim, ltrans, rtrans, DType>
+        ::Eval(&out, exp.lhs_, exp.rhs_, exp.scale_);
+  }
+};
+}  // namespace expr
+// assignment to fixed tensor, fully unrolled
+template<bool pass_check, typename Saver, int dim,
+         typename DType, index_t... dims, typename E, int etype>
+struct MapExpCPUEngine<pass_check, Saver, FixedTensor<DType, dims...>,
+                       dim, DType, E, etype> {
+  inline static void Map(TRValue<FixedTensor<DType, dims...>, cpu, dim, DType> *dst,
+                         const expr::Exp<E, DType, etype> &exp) {
+    typedef StaticShape<dims...> TShape;
+    expr::FixedMapper<Saver, DType, TShape::kLast, E> f = {
+      expr::MakePlan(exp.self()), dst->ptrself()->data_
+    };
+    expr::StaticFor<0, TShape::kSize>::Run(f);
+  }
+};
+}  // namespace mshadow
+#endif  // MSHADOW_IN_CXX11
+#endif  // MSHADOW_TENSOR_FIXED_H_
@@ -50,6 +50,11 @@ inline void AllocSpace(Tensor<gpu, dim, DType> *obj, bool pad) {
   }
 }
 template<int dim, typename DType>
+inline void AllocSpace(Tensor<gpu, dim, DType> *obj, DType initv, bool pad) {
+  AllocSpace(obj, pad);
+  MapExp<sv::saveto>(obj, expr::ScalarExp<DType>(initv));
+}
+template<int dim, typename DType>
 inline void FreeSpace(Tensor<gpu, dim, DType> *obj) {
   MSHADOW_CUDA_CALL(cudaFree(obj->dptr_));
   obj->dptr_ = NULL;
@@ -60,6 +65,8 @@ inline void Copy(Tensor<A, dim, DType> _dst,
                  cudaMemcpyKind kind,
                  Stream<gpu> *stream) {
   CHECK_EQ(_dst.shape_, _src.shape_) << "Copy:shape mismatch";
+  MSHADOW_TRACE_SCOPE("Copy", "copy", _dst.shape_, 0,
+                      sizeof(DType) * _dst.shape_.Size());
   Tensor<A, 2, DType> dst = _dst.FlatTo2D();
   Tensor<B, 2, DType> src = _src.FlatTo2D();
   MSHADOW_CUDA_CALL(cudaMemcpy2DAsync(dst.dptr_, dst.stride_ * sizeof(DType),
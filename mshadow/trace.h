@@ -0,0 +1,243 @@
+/*!
+ *  Copyright (c) 2014 by Contributors
+ * \file trace.h
+ * \brief timeline tracer that records the execution of mshadow operations,
+ *  the records can be dumped in chrome trace format (chrome://tracing).
+ *  The tracer is compiled in only when MSHADOW_USE_TRACE is 1,
+ *  and records only between trace::Start and trace::Stop
+ * \author Tianqi Chen
+ */
+#ifndef MSHADOW_TRACE_H_
+#define MSHADOW_TRACE_H_
+#include <stdint.h>
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+#include "./base.h"
+#include "./logging.h"
+
+#if MSHADOW_USE_TRACE
+#if !MSHADOW_IN_CXX11
+#error "MSHADOW_USE_TRACE requires c++11"
+#endif
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#endif
+
+namespace mshadow {
+/*! \brief namespace of the timeline tracer */
+namespace trace {
+/*! \brief maximum number of dimensions recorded in an event */
+const int kMaxDim = 5;
+/*! \brief a complete event in the timeline */
+struct Event {
+  /*! \brief name of the operation, must be a string literal */
+  const char *name;
+  /*! \brief category of the operation, must be a string literal */
+  const char *cat;
+  /*! \brief begin and end time in nanoseconds */
+  int64_t tbegin, tend;
+  /*! \brief number of dimensions in shape */
+  int ndim;
+  /*! \brief shape of the operation */
+  index_t shape[kMaxDim];
+  /*! \brief estimated number of floating point operations */
+  double flops;
+  /*! \brief estimated number of bytes moved */
+  double bytes;
+};
+
+#if MSHADOW_USE_TRACE
+/*!
+ * \brief ring buffer of events recorded by one thread, the owner thread
+ *  writes it under its lock, which is only contended by Reset and Collect
+ */
+struct ThreadBuffer {
+  /*! \brief id of the thread */
+  int tid;
+  /*! \brief total number of events recorded since the last reset */
+  size_t count;
+  /*! \brief the ring of events */
+  std::vector<Event> ring;
+  /*! \brief lock of count and ring */
+  std::mutex mutex;
+};
+/*! \brief global state of the tracer */
+class Tracer {
+ public:
+  /*! \return the global tracer */
+  inline static Tracer *Get(void) {
+    static Tracer inst;
+    return &inst;
+  }
+  /*! \brief whether the tracer is recording */
+  std::atomic<bool> enabled;
+  /*! \brief number of events kept per thread, read once by each record */
+  std::atomic<size_t> capacity;
+  /*! \return the ring buffer of the current thread */
+  inline ThreadBuffer *Local(void) {
+    static thread_local ThreadBuffer *buf = NULL;
+    if (buf == NULL) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      buf = new ThreadBuffer();
+      buf->tid = static_cast<int>(buffers_.size());
+      buf->count = 0;
+      buffers_.push_back(buf);
+    }
+    return buf;
+  }
+  /*!
+   * \brief clear the events and set ring capacity of all threads,
+   *  the rings are resized by their threads on the next record
+   */
+  inline void Reset(size_t capacity) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    this->capacity.store(capacity);
+    for (size_t i = 0; i < buffers_.size(); ++i) {
+      std::lock_guard<std::mutex> block(buffers_[i]->mutex);
+      buffers_[i]->count = 0;
+    }
+  }
+  /*! \brief record an event into the ring of the current thread */
+  inline void Record(const Event &e) {
+    const size_t cap = capacity.load(std::memory_order_relaxed);
+    ThreadBuffer *b = this->Local();
+    std::lock_guard<std::mutex> lock(b->mutex);
+    if (b->ring.size() != cap) {
+      b->ring.resize(cap);
+      b->count = 0;
+    }
+    if (cap == 0) return;
+    b->ring[b->count % cap] = e;
+    b->count += 1;
+  }
+  /*! \brief get all the events in time order of each thread */
+  inline void Collect(std::vector<std::pair<int, Event> > *out) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    out->clear();
+    for (size_t i = 0; i < buffers_.size(); ++i) {
+      ThreadBuffer &b = *buffers_[i];
+      std::lock_guard<std::mutex> block(b.mutex);
+      const size_t n = std::min(b.count, b.ring.size());
+      for (size_t j = b.count - n; j < b.count; ++j) {
+        out->push_back(std::make_pair(b.tid, b.ring[j % b.ring.size()]));
+      }
+    }
+  }
+  /*! \return elapsed time in nanoseconds */
+  inline static int64_t Now(void) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+ private:
+  Tracer(void) : enabled(false), capacity(1 << 16) {}
+  // lock to protect buffer list
+  std::mutex mutex_;
+  // buffers of all the threads, kept alive until exit
+  std::vector<ThreadBuffer*> buffers_;
+};
+/*!
+ * \brief records an event from construction to destruction,
+ *  use MSHADOW_TRACE_SCOPE to create it
+ */
+class Scope {
+ public:
+  template<typename TShape>
+  Scope(const char *name, const char *cat, const TShape &shape,
+        double flops, double bytes) : active_(false) {
+    if (!Tracer::Get()->enabled.load(std::memory_order_relaxed)) return;
+    active_ = true;
+    e_.name = name; e_.cat = cat;
+    e_.ndim = TShape::kDimension < kMaxDim ? TShape::kDimension : kMaxDim;
+    for (int i = 0; i < e_.ndim; ++i) e_.shape[i] = shape[i];
+    e_.flops = flops; e_.bytes = bytes;
+    e_.tbegin = Tracer::Now();
+  }
+  ~Scope(void) {
+    if (!active_) return;
+    e_.tend = Tracer::Now();
+    Tracer::Get()->Record(e_);
+  }
+
+ private:
+  bool active_;
+  Event e_;
+};
+/*!
+ * \brief start recording, the events recorded before are cleared.
+ *  It is safe to call while other threads run traced operations, each
+ *  thread writes its own ring under a lock that Start and Dump only take
+ *  to clear or copy that ring. A scope that is open during Start is kept
+ *  in the new trace only if recording was already on when it began
+ * \param capacity number of events kept per thread, older events are overwritten
+ */
+inline void Start(size_t capacity = 1 << 16) {
+  Tracer::Get()->Reset(capacity);
+  Tracer::Get()->enabled = true;
+}
+/*! \brief stop recording */
+inline void Stop(void) {
+  Tracer::Get()->enabled = false;
+}
+/*!
+ * \brief dump the recorded events in chrome trace format, can be called
+ *  while operations run, the scopes that are still open are not included
+ * \param fname name of output file
+ */
+inline void Dump(const char *fname) {
+  std::vector<std::pair<int, Event> > events;
+  Tracer::Get()->Collect(&events);
+  FILE *fo = fopen(fname, "w");
+  CHECK(fo != NULL) << "trace::Dump: cannot open " << fname;
+  int64_t t0 = 0;
+  for (size_t i = 0; i < events.size(); ++i) {
+    if (i == 0 || events[i].second.tbegin < t0) t0 = events[i].second.tbegin;
+  }
+  fprintf(fo, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+  for (size_t i = 0; i < events.size(); ++i) {
+    const Event &e = events[i].second;
+    std::string shape = "(";
+    for (int k = 0; k < e.ndim; ++k) {
+      char buf[32];
+      snprintf(buf, sizeof(buf), k == 0 ? "%u" : ",%u", e.shape[k]);
+      shape += buf;
+    }
+    shape += ")";
+    fprintf(fo, "%s{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", "
+            "\"ts\": %.3f, \"dur\": %.3f, \"pid\": 0, \"tid\": %d, "
+            "\"args\": {\"shape\": \"%s\", \"flops\": %.0f, \"bytes\": %.0f}}",
+            i == 0 ? "" : ",\n", e.name, e.cat,
+            (e.tbegin - t0) * 1e-3, (e.tend - e.tbegin) * 1e-3, events[i].first,
+            shape.c_str(), e.flops, e.bytes);
+  }
+  fprintf(fo, "\n]}\n");
+  fclose(fo);
+}
+/*!
+ * \brief trace the current scope
+ * \param name name of the operation
+ * \param cat category of the operation, e.g. op, blas, ps
+ * \param shape shape of the operation
+ * \param flops estimated number of floating point operations
+ * \param bytes estimated number of bytes moved
+ */
+#define MSHADOW_TRACE_SCOPE(name, cat, shape, flops, bytes)               \
+  ::mshadow::trace::Scope mshadow_trace_scope_(name, cat, shape,         \
+                                               static_cast<double>(flops), \
+                                               static_cast<double>(bytes))
+#else
+inline void Start(size_t capacity = 1 << 16) {
+  LOG(INFO) << "trace::Start: tracer is not compiled in, "
+            << "compile with MSHADOW_USE_TRACE=1 to enable it";
+}
+inline void Stop(void) {}
+inline void Dump(const char *fname) {}
+#define MSHADOW_TRACE_SCOPE(name, cat, shape, flops, bytes)
+#endif  // MSHADOW_USE_TRACE
+}  // namespace trace
+}  // namespace mshadow
+#endif  // MSHADOW_TRACE_H_
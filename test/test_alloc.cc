@@ -0,0 +1,72 @@
+#include <mshadow/tensor.h>
+#include <cstring>
+
+// this namespace contains all data structures, functions
+using namespace mshadow;
+// this namespace contains all operator overloads
+using namespace mshadow::expr;
+
+// count the elements of the first nrow rows of stride that are not initv bit for bit
+template<typename DType>
+inline int Count(const DType *dptr, index_t nrow, index_t ncol, index_t stride, DType initv) {
+  int nerr = 0;
+  for (index_t i = 0; i < nrow; ++i) {
+    for (index_t j = 0; j < ncol; ++j) {
+      if (std::memcmp(dptr + i * stride + j, &initv, sizeof(DType)) != 0) ++nerr;
+    }
+  }
+  return nerr;
+}
+// the whole space of new tensors is set, the padding included
+template<typename DType>
+inline int Check(const Tensor<cpu, 3, DType> &t, DType initv, bool whole, const char *name) {
+  const index_t nrow = t.size(0) * t.size(1);
+  const int nerr = Count(t.dptr_, nrow, whole ? t.stride_ : t.size(2), t.stride_, initv);
+  if (nerr != 0) {
+    printf("%s: %u x %u x %u, initv %g, %d errors\n", name, t.size(0), t.size(1),
+           t.size(2), static_cast<double>(initv), nerr);
+  }
+  return nerr;
+}
+
+template<typename DType>
+int test_alloc(const Shape<3> &shape, DType initv) {
+  int nerr = 0;
+  for (int pad = 0; pad < 2; ++pad) {
+    Tensor<cpu, 3, DType> t = NewTensor<cpu>(shape, initv, pad != 0);
+    nerr += Check(t, initv, true, "NewTensor");
+    FreeSpace(&t);
+  }
+  TensorContainer<cpu, 3, DType> c(shape, initv);
+  nerr += Check<DType>(c, initv, true, "TensorContainer");
+  // grow, which allocates, and shrink, which keeps the space,
+  // both after garbage was written
+  c = DType(7);
+  Shape<3> large = shape;
+  large[0] += 1; large[2] += 5;
+  c.Resize(large, initv);
+  nerr += Check<DType>(c, initv, true, "Resize, grow");
+  c = DType(7);
+  c.Resize(shape, initv);
+  nerr += Check<DType>(c, initv, false, "Resize, shrink");
+  return nerr;
+}
+
+int main(void) {
+  int nerr = 0;
+  // -0.0 is not all zero bytes, so it is filled instead of taken from calloc,
+  // the last shapes are large enough to fill over the OpenMP threads
+  const index_t shapes[][3] = {{1, 1, 1}, {2, 3, 5}, {1, 4, 8}, {3, 7, 33}, {4, 300, 257},
+                               {1, 1, 1 << 17}};
+  for (int i = 0; i < 6; ++i) {
+    const Shape<3> s = Shape3(shapes[i][0], shapes[i][1], shapes[i][2]);
+    nerr += test_alloc<float>(s, 0.0f);
+    nerr += test_alloc<float>(s, -0.0f);
+    nerr += test_alloc<float>(s, 1.5f);
+    nerr += test_alloc<double>(s, 0.0);
+    nerr += test_alloc<double>(s, -2.25);
+    nerr += test_alloc<int>(s, 3);
+  }
+  printf("test_alloc: %d errors\n", nerr);
+  return nerr != 0;
+}
@@ -0,0 +1,95 @@
+#include <mshadow/tensor.h>
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+// this namespace contains all data structures, functions
+using namespace mshadow;
+// this namespace contains all operator overloads
+using namespace mshadow::expr;
+
+// the order of the plan: an element only replaces the best when it compares better
+inline index_t ArgBest(Tensor<cpu, 1, float> x, bool max) {
+  index_t best = 0;
+  for (index_t i = 1; i < x.size(0); ++i) {
+    if (max ? x[i] > x[best] : x[i] < x[best]) best = i;
+  }
+  return best;
+}
+
+int test_argreduce(index_t nrow, index_t ncol) {
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  TensorContainer<cpu, 2, float> src(Shape2(nrow, ncol)), srct(Shape2(ncol, nrow));
+  TensorContainer<cpu, 1, float> out(Shape1(nrow)), out_plan(Shape1(nrow));
+  for (index_t i = 0; i < nrow; ++i) {
+    for (index_t j = 0; j < ncol; ++j) {
+      // few distinct values, so that there are ties
+      src[i][j] = static_cast<float>((i * 13 + j * 7) % 11) - 5.0f;
+    }
+    // NaN at several places of some rows, row 1 is the case x[1] = NaN, x[9] = 5
+    if (i % 4 == 1 && ncol > 1) src[i][1] = nan;
+    if (i % 4 == 2) src[i][(i * 5) % ncol] = nan;
+    if (i % 8 == 3) src[i][0] = nan;
+    if (i % 8 == 7) src[i][ncol - 1] = nan;
+    if (i == 1 && ncol > 9) src[i][9] = 5.0f;
+  }
+  srct = src.T();
+  int nerr = 0;
+  for (int k = 0; k < 2; ++k) {
+    const bool max = k == 0;
+    // the rows are contiguous in argmax<1>, not in argmax<0>
+    if (max) {
+      out = argmax<1>(src);
+      out_plan = argmax<1>(src) * 1.0f;
+    } else {
+      out = argmin<1>(src);
+      out_plan = argmin<1>(src) * 1.0f;
+    }
+    for (index_t i = 0; i < nrow; ++i) {
+      const float expect = static_cast<float>(ArgBest(src[i], max));
+      if (out[i] != expect || out_plan[i] != expect) ++nerr;
+    }
+    if (max) {
+      out = argmax<0>(srct);
+    } else {
+      out = argmin<0>(srct);
+    }
+    for (index_t i = 0; i < nrow; ++i) {
+      if (out[i] != static_cast<float>(ArgBest(src[i], max))) ++nerr;
+    }
+  }
+  // top-k of rows without NaN, stable sort in descending order
+  for (index_t i = 0; i < nrow; ++i) {
+    for (index_t j = 0; j < ncol; ++j) {
+      if (src[i][j] != src[i][j]) src[i][j] = static_cast<float>(j % 3);
+    }
+  }
+  const index_t ks[] = {1, 3, ncol};
+  for (int t = 0; t < 3; ++t) {
+    const index_t topk = std::min(ks[t], ncol);
+    TensorContainer<cpu, 2, float> values(Shape2(nrow, topk));
+    TensorContainer<cpu, 2, int> indices(Shape2(nrow, topk));
+    TopK(values, indices, src);
+    for (index_t i = 0; i < nrow; ++i) {
+      std::vector<std::pair<float, int> > row(ncol);
+      for (index_t j = 0; j < ncol; ++j) {
+        row[j] = std::make_pair(-src[i][j], static_cast<int>(j));
+      }
+      std::stable_sort(row.begin(), row.end());
+      for (index_t j = 0; j < topk; ++j) {
+        if (values[i][j] != -row[j].first || indices[i][j] != row[j].second) ++nerr;
+      }
+    }
+  }
+  if (nerr != 0) printf("argreduce %u x %u: %d errors\n", nrow, ncol, nerr);
+  return nerr;
+}
+
+int main(void) {
+  int nerr = 0;
+  const index_t ncols[] = {1, 7, 8, 9, 16, 17, 33, 100};
+  for (int i = 0; i < 8; ++i) nerr += test_argreduce(24, ncols[i]);
+  nerr += test_argreduce(700, 128);
+  printf("test_argreduce: %d errors\n", nerr);
+  return nerr != 0;
+}
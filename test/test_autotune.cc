@@ -0,0 +1,113 @@
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <mshadow/tensor.h>
+
+// this namespace contains all data structures, functions
+using namespace mshadow;
+
+// a benchmark whose time grows with the distance of the value to best,
+// counts its calls
+struct FakeBench {
+  int best;
+  int *ncall;
+  inline void operator()(int value) {
+    *ncall += 1;
+    usleep(1000 + 3000 * std::abs(value - best));
+  }
+};
+inline std::vector<int> Candidates(void) {
+  std::vector<int> cand;
+  for (int i = 1; i <= 4; ++i) cand.push_back(i);
+  return cand;
+}
+inline bool FileExists(const char *fname) {
+  FILE *fi = fopen(fname, "r");
+  if (fi == NULL) return false;
+  fclose(fi);
+  return true;
+}
+
+// the second process loads the cache file and must not time again
+int test_reload(void) {
+  autotune::SetEnabled(true);
+  int ncall = 0;
+  FakeBench bench;
+  bench.best = 1; bench.ncall = &ncall;
+  const int ret = autotune::Tune("test_fake", "2^10", Candidates(), 0, bench);
+  int nerr = 0;
+  if (ret != 3 || ncall != 0) {
+    printf("reload: value %d after %d calls of the benchmark\n", ret, ncall);
+    ++nerr;
+  }
+  return nerr;
+}
+
+int test_autotune(const char *self) {
+  int nerr = 0;
+  const std::string fname = "test_autotune.cache";
+  remove(fname.c_str());
+  setenv("MSHADOW_TUNE_CACHE", fname.c_str(), 1);
+  unsetenv("MSHADOW_TUNE");
+  int ncall = 0;
+  FakeBench bench;
+  bench.best = 3; bench.ncall = &ncall;
+  // disabled, the default is returned without running the benchmark or a file
+  int ret = autotune::Tune("test_fake", "2^10", Candidates(), 7, bench);
+  if (autotune::Enabled() || ret != 7 || ncall != 0 || FileExists(fname.c_str())) {
+    printf("disabled: value %d after %d calls of the benchmark\n", ret, ncall);
+    ++nerr;
+  }
+  // enabled, each candidate is timed and the fastest is stored
+  autotune::SetEnabled(true);
+  ret = autotune::Tune("test_fake", "2^10", Candidates(), 7, bench);
+  if (ret != 3 || ncall != 4 * 4) {
+    printf("tune: value %d after %d calls of the benchmark\n", ret, ncall);
+    ++nerr;
+  }
+  ret = autotune::Tune("test_fake", "2^10", Candidates(), 7, bench);
+  if (ret != 3 || ncall != 4 * 4) {
+    printf("tune, again: value %d after %d calls of the benchmark\n", ret, ncall);
+    ++nerr;
+  }
+  // no candidate keeps the default, another shape class is tuned on its own
+  if (autotune::Tune("test_fake", "2^12", std::vector<int>(), 7, bench) != 7) ++nerr;
+  bench.best = 2;
+  if (autotune::Tune("test_fake", "2^12", Candidates(), 7, bench) != 2) ++nerr;
+  // the file holds both entries, under the model of this cpu
+  const std::string model = autotune::CPUModel();
+  FILE *fi = fopen(fname.c_str(), "r");
+  int nfound = 0;
+  if (fi != NULL) {
+    char line[1024];
+    while (fgets(line, sizeof(line), fi) != NULL) {
+      if (model + "\ttest_fake\t2^10\t3\n" == line) ++nfound;
+      if (model + "\ttest_fake\t2^12\t2\n" == line) ++nfound;
+    }
+    fclose(fi);
+  }
+  if (nfound != 2) {
+    printf("cache file: %d of 2 entries\n", nfound);
+    ++nerr;
+  }
+  // a new process reads the cache
+  const std::string cmd = std::string(self) + " reload";
+  if (system(cmd.c_str()) != 0) ++nerr;
+  remove(fname.c_str());
+  return nerr;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc > 1 && !strcmp(argv[1], "reload")) {
+    return test_reload() != 0;
+  }
+  int nerr = 0;
+#if MSHADOW_USE_AUTOTUNE && MSHADOW_IN_CXX11
+  nerr += test_autotune(argv[0]);
+#endif
+  printf("test_autotune: %d errors\n", nerr);
+  return nerr != 0;
+}
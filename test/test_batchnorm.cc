@@ -0,0 +1,102 @@
+#include <mshadow/tensor.h>
+#include <cmath>
+#include <vector>
+#include "./test_util.h"
+
+// this namespace contains all data structures, functions
+using namespace mshadow;
+// this namespace contains all operator overloads
+using namespace mshadow::expr;
+
+int test_batchnorm(index_t nbatch, index_t nchannel, index_t height, index_t width,
+                   float offset) {
+  const float eps = 1e-5f;
+  TensorContainer<cpu, 4, float> data(Shape4(nbatch, nchannel, height, width));
+  TensorContainer<cpu, 4, float> out(data.shape_), grad_out(data.shape_), grad_in(data.shape_);
+  TensorContainer<cpu, 1, float> gamma(Shape1(nchannel)), beta(Shape1(nchannel));
+  TensorContainer<cpu, 1, float> mean(Shape1(nchannel)), var(Shape1(nchannel));
+  TensorContainer<cpu, 1, float> grad_gamma(Shape1(nchannel)), grad_beta(Shape1(nchannel));
+  test::Fill(data, 1, 0.125, offset); test::Fill(grad_out, 2);
+  for (index_t c = 0; c < nchannel; ++c) {
+    gamma[c] = 0.5f + 0.25f * c;
+    beta[c] = 0.125f * c - 1.0f;
+  }
+  // statistics of each channel in double
+  const double count = static_cast<double>(nbatch) * height * width;
+  std::vector<double> rmean(nchannel, 0.0), rvar(nchannel, 0.0);
+  std::vector<double> rgamma(nchannel, 0.0), rbeta(nchannel, 0.0);
+  for (index_t n = 0; n < nbatch; ++n) {
+    for (index_t c = 0; c < nchannel; ++c) {
+      for (index_t y = 0; y < height; ++y) {
+        for (index_t x = 0; x < width; ++x) rmean[c] += data[n][c][y][x] / count;
+      }
+    }
+  }
+  for (index_t n = 0; n < nbatch; ++n) {
+    for (index_t c = 0; c < nchannel; ++c) {
+      for (index_t y = 0; y < height; ++y) {
+        for (index_t x = 0; x < width; ++x) {
+          const double d = data[n][c][y][x] - rmean[c];
+          rvar[c] += d * d / count;
+        }
+      }
+    }
+  }
+  std::vector<double> rout(data.shape_.Size()), rin(data.shape_.Size());
+  index_t i = 0;
+  for (index_t n = 0; n < nbatch; ++n) {
+    for (index_t c = 0; c < nchannel; ++c) {
+      const double rstd = 1.0 / std::sqrt(rvar[c] + eps);
+      for (index_t y = 0; y < height; ++y) {
+        for (index_t x = 0; x < width; ++x, ++i) {
+          const double xhat = (data[n][c][y][x] - rmean[c]) * rstd;
+          rout[i] = gamma[c] * xhat + beta[c];
+          rgamma[c] += grad_out[n][c][y][x] * xhat;
+          rbeta[c] += grad_out[n][c][y][x];
+        }
+      }
+    }
+  }
+  i = 0;
+  for (index_t n = 0; n < nbatch; ++n) {
+    for (index_t c = 0; c < nchannel; ++c) {
+      const double rstd = 1.0 / std::sqrt(rvar[c] + eps);
+      for (index_t y = 0; y < height; ++y) {
+        for (index_t x = 0; x < width; ++x, ++i) {
+          const double xhat = (data[n][c][y][x] - rmean[c]) * rstd;
+          rin[i] = gamma[c] * rstd / count *
+              (count * grad_out[n][c][y][x] - rbeta[c] - xhat * rgamma[c]);
+        }
+      }
+    }
+  }
+  int nerr = 0;
+  BatchNormForward(out, mean, var, data, gamma, beta, eps);
+  nerr += test::Check(mean, rmean, 1e-6, "batchnorm, mean");
+  nerr += test::Check(var, rvar, 1e-4, "batchnorm, var");
+  nerr += test::Check(out, rout, 1e-4, "batchnorm, forward");
+  BatchNormBackward(grad_in, grad_gamma, grad_beta, grad_out, data, mean, var, gamma, eps);
+  nerr += test::Check(grad_in, rin, 1e-4, "batchnorm, grad data");
+  nerr += test::Check(grad_gamma, rgamma, 1e-4, "batchnorm, grad gamma");
+  nerr += test::Check(grad_beta, rbeta, 1e-5, "batchnorm, grad beta");
+  // inference with the statistics of the batch gives the training output
+  BatchNormInference(grad_in, data, mean, var, gamma, beta, eps);
+  nerr += test::Check(grad_in, rout, 1e-4, "batchnorm, inference");
+  if (nerr != 0) {
+    printf("batchnorm %u x %u x %u x %u, offset %g\n", nbatch, nchannel, height, width, offset);
+  }
+  return nerr;
+}
+
+int main(void) {
+  int nerr = 0;
+  // single elements, widths that pad the rows, planes of one pixel,
+  // and data far from zero
+  nerr += test_batchnorm(1, 1, 1, 1, 0.0f);
+  nerr += test_batchnorm(2, 3, 5, 7, 0.0f);
+  nerr += test_batchnorm(4, 2, 1, 1, 0.0f);
+  nerr += test_batchnorm(3, 5, 8, 8, 1000.0f);
+  nerr += test_batchnorm(8, 16, 33, 31, 100.0f);
+  printf("test_batchnorm: %d errors\n", nerr);
+  return nerr != 0;
+}
@@ -0,0 +1,85 @@
+#include <mshadow/tensor.h>
+#include <cfloat>
+#include <cmath>
+#include "./test_util.h"
+
+// this namespace contains all data structures, functions
+using namespace mshadow;
+// this namespace contains all operator overloads
+using namespace mshadow::expr;
+
+// values in [-1, 1], the first nlarge channels are scaled by 1e7,
+// the double copy holds the same values
+inline void Fill(Tensor<cpu, 4, float> t, Tensor<cpu, 4, double> dt,
+                 index_t nlarge, int seed) {
+  test::Fill(t, seed, 1.0 / 18);
+  for (index_t n = 0; n < t.size(0); ++n) {
+    for (index_t c = 0; c < nlarge; ++c) t[n][c] *= 1e7f;
+  }
+  dt = tcast<double>(t);
+}
+struct Abs {
+  MSHADOW_XINLINE static double Map(double a) {
+    return std::fabs(a);
+  }
+};
+// dst is the sliding window evaluation, the reference is summed in double,
+// the error is allowed to be a few times that of a direct sum in float
+inline int Check(Tensor<cpu, 4, float> dst, Tensor<cpu, 4, double> ref,
+                 Tensor<cpu, 4, double> absum, index_t nsize, const char *name) {
+  Tensor<cpu, 2, float> d = dst.FlatTo2D();
+  Tensor<cpu, 2, double> r = ref.FlatTo2D(), a = absum.FlatTo2D();
+  int nerr = 0;
+  for (index_t i = 0; i < d.size(0); ++i) {
+    for (index_t j = 0; j < d.size(1); ++j) {
+      const double tol = 3.0 * nsize * FLT_EPSILON * a[i][j];
+      if (std::fabs(d[i][j] - r[i][j]) > tol) ++nerr;
+    }
+  }
+  test::Report(dst.shape_, nerr, name);
+  return nerr;
+}
+
+int test_chpool() {
+  const index_t cfg[][3] = {{5, 1, 2}, {3, 1, 1}, {4, 2, 1}, {7, 3, 0}, {1, 1, 0}};
+  const Shape<4> shape = Shape4(2, 64, 3, 7);
+  TensorContainer<cpu, 4, float> src(shape), fsrc(shape);
+  TensorContainer<cpu, 4, double> dsrc(shape), dabs(shape);
+  Fill(src, dsrc, 8, 1);
+  dabs = F<Abs>(dsrc);
+  int nerr = 0;
+  for (int i = 0; i < 5; ++i) {
+    const index_t nsize = cfg[i][0], stride = cfg[i][1], pad = cfg[i][2];
+    // the plain expressions below take the direct evaluation of each output
+    TensorContainer<cpu, 4, double> ref(chpool<red::sum>(dsrc, nsize, stride, pad).shape_);
+    TensorContainer<cpu, 4, double> absum(ref.shape_);
+    ref = chpool<red::sum>(dsrc, nsize, stride, pad) * 1.0;
+    absum = chpool<red::sum>(dabs, nsize, stride, pad) * 1.0;
+    TensorContainer<cpu, 4, float> dst(ref.shape_), old(ref.shape_);
+    old = chpool<red::sum>(src, nsize, stride, pad) * 1.0f;
+    nerr += Check(old, ref, absum, nsize, "chpool, direct");
+    dst = chpool<red::sum>(src, nsize, stride, pad);
+    nerr += Check(dst, ref, absum, nsize, "chpool");
+    dst += chpool<red::sum>(src, nsize, stride, pad);
+    dst *= 0.5f;
+    nerr += Check(dst, ref, absum, nsize, "chpool, plusto");
+    // gradient of sum pooling, the pooled gradient has the large channels
+    TensorContainer<cpu, 4, float> grad(ref.shape_), gsrc(shape);
+    TensorContainer<cpu, 4, double> dgrad(ref.shape_), gabs(ref.shape_);
+    TensorContainer<cpu, 4, double> gref(shape), gabsum(shape);
+    Fill(grad, dgrad, 4, 2);
+    gabs = F<Abs>(dgrad);
+    gref = ch_unpool<red::sum>(dsrc, dgrad, dgrad, nsize, stride, pad) * 1.0;
+    gabsum = ch_unpool<red::sum>(dsrc, gabs, gabs, nsize, stride, pad) * 1.0;
+    fsrc = ch_unpool<red::sum>(src, grad, grad, nsize, stride, pad) * 1.0f;
+    nerr += Check(fsrc, gref, gabsum, nsize, "ch_unpool, direct");
+    gsrc = ch_unpool<red::sum>(src, grad, grad, nsize, stride, pad);
+    nerr += Check(gsrc, gref, gabsum, nsize, "ch_unpool");
+  }
+  printf("test_chpool: %d errors\n", nerr);
+  return nerr;
+}
+
+int main(void) {
+  return test_chpool() != 0;
+}
@@ -0,0 +1,127 @@
+#include <mshadow/tensor.h>
+#include <cmath>
+#include <vector>
+#include "./test_util.h"
+
+// this namespace contains all data structures, functions
+using namespace mshadow;
+// this namespace contains all operator overloads
+using namespace mshadow::expr;
+
+typedef Tensor<cpu, 4, float> Img;
+
+/*!
+ * \brief direct grouped convolution in double, the weight of output channel o,
+ *  input channel c of its group and kernel position (ky, kx) is
+ *  w[o][(c * ksize + ky) * ksize + kx], calls f(n, o, oy, ox, ci, iy, ix, w index)
+ *  for each product that is inside the image
+ */
+template<typename F>
+inline void Conv(const Img &data, index_t nout, index_t num_group, index_t ksize,
+                 index_t stride, index_t pad, F *f) {
+  const index_t nin = data.size(1), cin = nin / num_group, cout = nout / num_group;
+  const index_t oh = (data.size(2) + 2 * pad - ksize) / stride + 1;
+  const index_t ow = (data.size(3) + 2 * pad - ksize) / stride + 1;
+  for (index_t n = 0; n < data.size(0); ++n) {
+    for (index_t o = 0; o < nout; ++o) {
+      for (index_t oy = 0; oy < oh; ++oy) {
+        for (index_t ox = 0; ox < ow; ++ox) {
+          for (index_t c = 0; c < cin; ++c) {
+            for (index_t ky = 0; ky < ksize; ++ky) {
+              for (index_t kx = 0; kx < ksize; ++kx) {
+                const int iy = static_cast<int>(oy * stride + ky) - static_cast<int>(pad);
+                const int ix = static_cast<int>(ox * stride + kx) - static_cast<int>(pad);
+                if (iy < 0 || ix < 0 || iy >= static_cast<int>(data.size(2)) ||
+                    ix >= static_cast<int>(data.size(3))) continue;
+                (*f)(n, o, oy, ox, (o / cout) * cin + c, iy, ix, (c * ksize + ky) * ksize + kx);
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+}
+// accumulates forward, gradient of data and gradient of weight of the products
+struct Ref {
+  Img data, grad_out;
+  Tensor<cpu, 2, float> weight;
+  std::vector<double> out, grad_data, grad_weight;
+  inline void operator()(index_t n, index_t o, index_t oy, index_t ox, index_t ci,
+                         index_t iy, index_t ix, index_t k) {
+    const index_t io = ((n * grad_out.size(1) + o) * grad_out.size(2) + oy) * grad_out.size(3);
+    const index_t ii = ((n * data.size(1) + ci) * data.size(2) + iy) * data.size(3) + ix;
+    const double x = data[n][ci][iy][ix], w = weight[o][k], g = grad_out[n][o][oy][ox];
+    out[io + ox] += w * x;
+    grad_data[ii] += w * g;
+    grad_weight[o * weight.size(1) + k] += x * g;
+  }
+};
+
+int test_conv(index_t nbatch, index_t nin, index_t nout, index_t num_group,
+              index_t height, index_t width, index_t ksize, index_t stride, index_t pad) {
+  const index_t oh = (height + 2 * pad - ksize) / stride + 1;
+  const index_t ow = (width + 2 * pad - ksize) / stride + 1;
+  const index_t kin = nin / num_group * ksize * ksize;
+  TensorContainer<cpu, 4, float> data(Shape4(nbatch, nin, height, width));
+  TensorContainer<cpu, 4, float> grad_data(data.shape_);
+  TensorContainer<cpu, 4, float> out(Shape4(nbatch, nout, oh, ow)), grad_out(out.shape_);
+  TensorContainer<cpu, 2, float> weight(Shape2(nout, kin)), grad_weight(weight.shape_);
+  test::Fill(data, 1, 1.0 / 9);
+  test::Fill(grad_out, 2, 1.0 / 9);
+  test::Fill(weight, 3, 1.0 / 9);
+  Ref ref;
+  ref.data = data; ref.grad_out = grad_out; ref.weight = weight;
+  ref.out.assign(out.shape_.Size(), 0.0);
+  ref.grad_data.assign(data.shape_.Size(), 0.0);
+  ref.grad_weight.assign(weight.shape_.Size(), 0.0);
+  Conv(data, nout, num_group, ksize, stride, pad, &ref);
+  int nerr = 0;
+  // without BLAS, the dots of each group must fit the skinny kernels
+  const index_t kout = nout / num_group;
+  if (MSHADOW_USE_CBLAS || MSHADOW_USE_MKL ||
+      (kout <= 8 && kin <= 8 && kin >= 4 * kout && oh * ow >= 4 * kin)) {
+    GroupConvForward(out, data, weight, num_group, ksize, ksize, stride, pad);
+    nerr += test::Check(out, ref.out, 1e-4, "group conv");
+    GroupConvBackward(grad_data, grad_weight, grad_out, data, weight,
+                      num_group, ksize, ksize, stride, pad);
+    nerr += test::Check(grad_data, ref.grad_data, 1e-4, "group conv, grad data");
+    nerr += test::Check(grad_weight, ref.grad_weight, 1e-4, "group conv, grad weight");
+  }
+  if (nin == num_group && nout == num_group) {
+    // depthwise, the weight of a channel as (ksize, ksize)
+    TensorContainer<cpu, 3, float> dweight(Shape3(nin, ksize, ksize));
+    TensorContainer<cpu, 3, float> dgrad_weight(dweight.shape_);
+    for (index_t c = 0; c < nin; ++c) {
+      for (index_t k = 0; k < kin; ++k) dweight[c][k / ksize][k % ksize] = weight[c][k];
+    }
+    DepthwiseConvForward(out, data, dweight, stride, pad);
+    nerr += test::Check(out, ref.out, 1e-4, "depthwise conv");
+    DepthwiseConvBackward(grad_data, dgrad_weight, grad_out, data, dweight, stride, pad);
+    nerr += test::Check(grad_data, ref.grad_data, 1e-4, "depthwise conv, grad data");
+    nerr += test::Check(dgrad_weight, ref.grad_weight, 1e-4, "depthwise conv, grad weight");
+  }
+  if (nerr != 0) {
+    printf("conv %u x %u x %u x %u -> %u, group %u, kernel %u, stride %u, pad %u\n",
+           nbatch, nin, height, width, nout, num_group, ksize, stride, pad);
+  }
+  return nerr;
+}
+
+int main(void) {
+  int nerr = 0;
+  // depthwise, with kernels larger than the padded image edge and strides
+  nerr += test_conv(2, 3, 3, 3, 7, 9, 3, 1, 1);
+  nerr += test_conv(1, 4, 4, 4, 12, 12, 3, 2, 1);
+  nerr += test_conv(2, 2, 2, 2, 5, 6, 5, 1, 2);
+  nerr += test_conv(1, 2, 2, 2, 4, 4, 1, 1, 0);
+  nerr += test_conv(4, 32, 32, 32, 28, 28, 3, 1, 1);
+  // grouped, small enough per group to run without BLAS,
+  // widths that are not a multiple of 4 pad the rows of the containers
+  nerr += test_conv(2, 4, 4, 2, 8, 8, 2, 1, 0);
+  nerr += test_conv(2, 8, 4, 4, 9, 7, 2, 1, 1);
+  nerr += test_conv(1, 6, 3, 3, 10, 10, 2, 2, 1);
+  nerr += test_conv(3, 8, 4, 4, 16, 16, 2, 1, 0);
+  printf("test_conv: %d errors\n", nerr);
+  return nerr != 0;
+}
@@ -0,0 +1,162 @@
+#include <mshadow/tensor.h>
+#include <mshadow/tensor_csr.h>
+#include <mshadow/io.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include "./test_util.h"
+
+// this namespace contains all data structures, functions
+using namespace mshadow;
+// this namespace contains all operator overloads
+using namespace mshadow::expr;
+
+// compare with dst = beta * old + scale * op(a) * b, computed in double
+inline int Check(Tensor<cpu, 2, float> dst, Tensor<cpu, 2, float> old,
+                 Tensor<cpu, 2, float> a, bool ltrans, Tensor<cpu, 2, float> b,
+                 float beta, float scale, const char *name) {
+  const index_t k = b.size(0);
+  int nerr = 0;
+  for (index_t i = 0; i < dst.size(0); ++i) {
+    for (index_t j = 0; j < dst.size(1); ++j) {
+      double s = 0.0, mag = 0.0;
+      for (index_t p = 0; p < k; ++p) {
+        const double v = static_cast<double>(ltrans ? a[p][i] : a[i][p]) * b[p][j];
+        s += v; mag += std::fabs(v);
+      }
+      const double expect = beta * old[i][j] + scale * s;
+      if (std::fabs(dst[i][j] - expect) > 1e-5 * (mag * std::fabs(scale) + 1.0)) ++nerr;
+    }
+  }
+  if (nerr != 0) {
+    printf("%s: %u x %u x %u, %d errors\n", name, dst.size(0), k, dst.size(1), nerr);
+  }
+  return nerr;
+}
+
+// about one in density entries are nonzero, some rows and columns are empty
+inline void FillSparse(Tensor<cpu, 2, float> dense, int density) {
+  for (index_t i = 0; i < dense.size(0); ++i) {
+    for (index_t j = 0; j < dense.size(1); ++j) {
+      const index_t h = (i * 7919 + j * 104729 + i * j) % 1009;
+      dense[i][j] = (h % density == 0 && i % 5 != 3 && j % 7 != 2)
+          ? static_cast<float>(h % 17) - 8.5f : 0.0f;
+    }
+  }
+}
+// a stream over a buffer in memory, reads start from the beginning
+class MemoryStream : public utils::IStream {
+ public:
+  MemoryStream(void) : pos_(0) {}
+  virtual size_t Read(void *ptr, size_t size) {
+    size = std::min(size, buf_.size() - pos_);
+    if (size != 0) std::memcpy(ptr, &buf_[pos_], size);
+    pos_ += size;
+    return size;
+  }
+  virtual void Write(const void *ptr, size_t size) {
+    if (size == 0) return;
+    buf_.resize(buf_.size() + size);
+    std::memcpy(&buf_[buf_.size() - size], ptr, size);
+  }
+
+ private:
+  std::vector<char> buf_;
+  size_t pos_;
+};
+
+int test_csr(index_t m, index_t k, index_t n, int density) {
+  TensorContainer<cpu, 2, float> dense(Shape2(m, k)), w(Shape2(k, n)), g(Shape2(m, n));
+  TensorContainer<cpu, 2, float> out(Shape2(m, n)), old(Shape2(m, n));
+  TensorContainer<cpu, 2, float> gw(Shape2(k, n)), gold(Shape2(k, n));
+  FillSparse(dense, density);
+  for (index_t i = 0; i < k; ++i) {
+    for (index_t j = 0; j < n; ++j) w[i][j] = static_cast<float>((i * 3 + j * 5) % 13) - 6.0f;
+  }
+  for (index_t i = 0; i < m; ++i) {
+    for (index_t j = 0; j < n; ++j) {
+      g[i][j] = static_cast<float>((i * 11 + j) % 9) * 0.5f;
+      old[i][j] = static_cast<float>((i + j) % 4);
+    }
+  }
+  for (index_t i = 0; i < k; ++i) {
+    for (index_t j = 0; j < n; ++j) gold[i][j] = static_cast<float>((i + 2 * j) % 5);
+  }
+  CSRTensor<cpu, float> x;
+  x.FromDense(dense);
+  x.Check();
+  int nerr = 0;
+  out = dot(x, w);
+  nerr += Check(out, old, dense, false, w, 0.0f, 1.0f, "spmm");
+  out = old;
+  out += dot(x, w) * 2.0f;
+  nerr += Check(out, old, dense, false, w, 1.0f, 2.0f, "spmm, plusto");
+  gw = dot(x.T(), g);
+  nerr += Check(gw, gold, dense, true, g, 0.0f, 1.0f, "spmm, lhs transposed");
+  gw = gold;
+  gw -= dot(x.T(), g);
+  nerr += Check(gw, gold, dense, true, g, 1.0f, -1.0f, "spmm, lhs transposed, minusto");
+  // vector rhs, checked as matrices of one column
+  TensorContainer<cpu, 1, float> v(Shape1(k)), y(Shape1(m)), u(Shape1(m));
+  TensorContainer<cpu, 1, float> z(Shape1(k)), zold(Shape1(k));
+  for (index_t i = 0; i < k; ++i) {
+    v[i] = static_cast<float>(i % 7) - 3.0f;
+    zold[i] = static_cast<float>(i % 3);
+  }
+  for (index_t i = 0; i < m; ++i) u[i] = static_cast<float>(i % 5) * 0.5f;
+  Tensor<cpu, 2, float> vm(v.dptr_, Shape2(k, 1)), ym(y.dptr_, Shape2(m, 1));
+  Tensor<cpu, 2, float> um(u.dptr_, Shape2(m, 1));
+  Tensor<cpu, 2, float> zm(z.dptr_, Shape2(k, 1)), zoldm(zold.dptr_, Shape2(k, 1));
+  y = dot(x, v);
+  nerr += Check(ym, ym, dense, false, vm, 0.0f, 1.0f, "spmv");
+  z = zold;
+  z += dot(x.T(), u);
+  nerr += Check(zm, zoldm, dense, true, um, 1.0f, 1.0f, "spmv, lhs transposed");
+  return nerr;
+}
+
+// a matrix and an empty one saved to the same stream, the empty one is loaded
+// into a matrix that holds nonzeros
+int test_save_load(index_t m, index_t k, int density) {
+  TensorContainer<cpu, 2, float> dense(Shape2(m, k)), out(Shape2(m, k));
+  TensorContainer<cpu, 2, float> zero(Shape2(3, k));
+  FillSparse(dense, density);
+  CSRTensor<cpu, float> x, empty(Shape2(3, k)), y, e;
+  x.FromDense(dense);
+  e.FromDense(dense);
+  MemoryStream fs;
+  SaveBinary(fs, x);
+  SaveBinary(fs, empty);
+  LoadBinary(fs, &y);
+  LoadBinary(fs, &e);
+  char c;
+  int nerr = 0;
+  if (y.nnz() != x.nnz() || e.nnz() != 0 || e.shape_ != empty.shape_ || fs.Read(&c, 1) != 0) {
+    printf("save load: %u x %u, wrong nnz, shape or size\n", m, k);
+    ++nerr;
+  }
+  std::vector<float> ref(m * k), zref(3 * k, 0.0f);
+  for (index_t i = 0; i < m; ++i) {
+    for (index_t j = 0; j < k; ++j) ref[i * k + j] = dense[i][j];
+  }
+  y.ToDense(out);
+  nerr += test::CheckBits(out, ref, "save load");
+  zero = 1.0f;
+  e.ToDense(zero);
+  nerr += test::CheckBits(zero, zref, "save load, nnz 0");
+  return nerr;
+}
+
+int main(void) {
+  int nerr = 0;
+  nerr += test_csr(1, 1, 1, 1);
+  nerr += test_csr(9, 13, 5, 3);
+  nerr += test_csr(40, 70, 33, 4);
+  nerr += test_csr(300, 500, 64, 7);
+  nerr += test_csr(2000, 300, 40, 5);
+  nerr += test_save_load(1, 1, 1);
+  nerr += test_save_load(40, 70, 4);
+  printf("test_csr: %d errors\n", nerr);
+  return nerr != 0;
+}
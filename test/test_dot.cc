@@ -0,0 +1,115 @@
+#include <mshadow/tensor.h>
+#include <cmath>
+#include "./test_util.h"
+
+// this namespace contains all data structures, functions
+using namespace mshadow;
+// this namespace contains all operator overloads
+using namespace mshadow::expr;
+
+// compare with dst = beta * dst + scale * op(a) * b, computed in double
+inline int CheckGemm(Tensor<cpu, 2, float> dst, Tensor<cpu, 2, float> old,
+                     Tensor<cpu, 2, float> a, bool ltrans, Tensor<cpu, 2, float> b,
+                     float beta, float scale, const char *name) {
+  const index_t k = b.size(0);
+  int nerr = 0;
+  for (index_t i = 0; i < dst.size(0); ++i) {
+    for (index_t j = 0; j < dst.size(1); ++j) {
+      double s = 0.0, mag = 0.0;
+      for (index_t p = 0; p < k; ++p) {
+        const double v = static_cast<double>(ltrans ? a[p][i] : a[i][p]) * b[p][j];
+        s += v; mag += std::fabs(v);
+      }
+      const double expect = beta * old[i][j] + scale * s;
+      if (std::fabs(dst[i][j] - expect) > 1e-5 * (mag * std::fabs(scale) + 1.0)) ++nerr;
+    }
+  }
+  if (nerr != 0) {
+    printf("%s: %u x %u x %u, %d errors\n", name, dst.size(0), k, dst.size(1), nerr);
+  }
+  return nerr;
+}
+
+int test_packed() {
+  int nerr = 0;
+  const index_t ms[] = {1, 3, 4, 5, 17};
+  const index_t ks[] = {1, 7, 64};
+  const index_t ns[] = {1, 9, 33};
+  for (int im = 0; im < 5; ++im) {
+    for (int ik = 0; ik < 3; ++ik) {
+      for (int in = 0; in < 3; ++in) {
+        const index_t m = ms[im], k = ks[ik], n = ns[in];
+        TensorContainer<cpu, 2, float> a(Shape2(m, k)), at(Shape2(k, m));
+        TensorContainer<cpu, 2, float> b(Shape2(k, n)), bt(Shape2(n, k));
+        TensorContainer<cpu, 2, float> dst(Shape2(m, n)), old(Shape2(m, n));
+        test::Fill(a, 1, 1.0 / 18); test::Fill(b, 2, 1.0 / 18); test::Fill(old, 3, 1.0 / 18);
+        at = a.T(); bt = b.T();
+        PackedMatrix<float> pb(b), pbt(bt, true);
+        dst = dot(a, pb);
+        nerr += CheckGemm(dst, old, a, false, b, 0.0f, 1.0f, "packed");
+        dst = dot(a, pbt);
+        nerr += CheckGemm(dst, old, a, false, b, 0.0f, 1.0f, "packed, rhs transposed");
+        dst = dot(at.T(), pb) * 0.5f;
+        nerr += CheckGemm(dst, old, at, true, b, 0.0f, 0.5f, "packed, lhs transposed");
+        dst = old;
+        dst += dot(a, pb);
+        nerr += CheckGemm(dst, old, a, false, b, 1.0f, 1.0f, "packed, plusto");
+        dst = old;
+        dst -= dot(a, pb) * 2.0f;
+        nerr += CheckGemm(dst, old, a, false, b, 1.0f, -2.0f, "packed, minusto");
+        // vector lhs
+        TensorContainer<cpu, 1, float> y(Shape1(n));
+        y = dot(a[0], pb);
+        nerr += CheckGemm(Tensor<cpu, 2, float>(y.dptr_, Shape2(1, n)), old,
+                          a.Slice(0, 1), false, b, 0.0f, 1.0f, "packed, vector");
+      }
+    }
+  }
+  printf("test_packed: %d errors\n", nerr);
+  return nerr;
+}
+
+// dot with few rows of lhs, which takes the skinny kernels or BLAS
+int test_skinny() {
+  int nerr = 0;
+  const index_t ks[] = {1, 6, 35, 300};
+  const index_t ns[] = {32, 33, 700};
+  for (index_t m = 1; m <= 8; ++m) {
+    for (int ik = 0; ik < 4; ++ik) {
+      for (int in = 0; in < 3; ++in) {
+        const index_t k = ks[ik], n = ns[in];
+        TensorContainer<cpu, 2, float> a(Shape2(m, k)), at(Shape2(k, m));
+        TensorContainer<cpu, 2, float> b(Shape2(k, n)), bt(Shape2(n, k));
+        TensorContainer<cpu, 2, float> dst(Shape2(m, n)), old(Shape2(m, n));
+        test::Fill(a, 4, 1.0 / 18); test::Fill(b, 5, 1.0 / 18); test::Fill(old, 6, 1.0 / 18);
+        at = a.T(); bt = b.T();
+        dst = dot(a, b);
+        nerr += CheckGemm(dst, old, a, false, b, 0.0f, 1.0f, "skinny nn");
+        dst = dot(a, bt.T());
+        nerr += CheckGemm(dst, old, a, false, b, 0.0f, 1.0f, "skinny nt");
+        dst = old;
+        dst += dot(at.T(), b) * 0.5f;
+        nerr += CheckGemm(dst, old, at, true, b, 1.0f, 0.5f, "skinny tn, plusto");
+        dst = old;
+        dst -= dot(at.T(), bt.T());
+        nerr += CheckGemm(dst, old, at, true, b, 1.0f, -1.0f, "skinny tt, minusto");
+        if (m == 1) {
+          TensorContainer<cpu, 1, float> y(Shape1(n));
+          y = dot(a[0], b);
+          nerr += CheckGemm(Tensor<cpu, 2, float>(y.dptr_, Shape2(1, n)), old,
+                            a, false, b, 0.0f, 1.0f, "skinny gemv");
+          y = dot(a[0], bt.T());
+          nerr += CheckGemm(Tensor<cpu, 2, float>(y.dptr_, Shape2(1, n)), old,
+                            a, false, b, 0.0f, 1.0f, "skinny gemv, rhs transposed");
+        }
+      }
+    }
+  }
+  printf("test_skinny: %d errors\n", nerr);
+  return nerr;
+}
+
+int main(void) {
+  const int nerr = test_packed() + test_skinny();
+  return nerr != 0;
+}
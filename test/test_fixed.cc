@@ -0,0 +1,51 @@
+#include <mshadow/tensor.h>
+
+// this namespace contains all data structures, functions
+using namespace mshadow;
+// this namespace contains all operator overloads
+using namespace mshadow::expr;
+
+int test_fixed() {
+  // fixed shape tensors hold their data, no allocation is needed
+  FixedTensor<float, 3, 3> a, b, c;
+  FixedTensor<float, 3> v, w;
+  for (index_t i = 0; i < 9; ++i) {
+    a(i) = static_cast<float>(i); b(i) = static_cast<float>(9 - i);
+  }
+  for (index_t i = 0; i < 3; ++i) v(i) = static_cast<float>(i + 1);
+  int nerr = 0;
+  // elementwise operations are fully unrolled
+  c = a * b + 1.0f;
+  for (index_t i = 0; i < 9; ++i) {
+    if (c(i) != a(i) * b(i) + 1.0f) ++nerr;
+  }
+  // small dot is unrolled as well
+  c = dot(a, b);
+  c += dot(a.T(), b.T());
+  for (index_t y = 0; y < 3; ++y) {
+    for (index_t x = 0; x < 3; ++x) {
+      float s = 0.0f;
+      for (index_t k = 0; k < 3; ++k) s += a(y, k) * b(k, x) + a(k, y) * b(x, k);
+      if (c(y, x) != s) ++nerr;
+    }
+  }
+  w = dot(v, a.T());
+  for (index_t x = 0; x < 3; ++x) {
+    float s = 0.0f;
+    for (index_t k = 0; k < 3; ++k) s += v(k) * a(x, k);
+    if (w(x) != s) ++nerr;
+  }
+  // fixed tensors can be mixed with tensors
+  TensorContainer<cpu, 2> t(Shape2(3, 3), 2.0f);
+  c = a + t;
+  t = F<op::identity>(c) * 3.0f;
+  for (index_t i = 0; i < 9; ++i) {
+    if (t[i / 3][i % 3] != (a(i) + 2.0f) * 3.0f) ++nerr;
+  }
+  printf("test_fixed: %d errors\n", nerr);
+  return nerr;
+}
+
+int main(void) {
+  return test_fixed();
+}
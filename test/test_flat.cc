@@ -0,0 +1,87 @@
+#include <mshadow/tensor.h>
+#include <vector>
+#include "./test_util.h"
+
+// this namespace contains all data structures, functions
+using namespace mshadow;
+// this namespace contains all operator overloads
+using namespace mshadow::expr;
+
+typedef Tensor<cpu, 2, float> Mat;
+
+// a map without an sse version, it keeps the scalar flat path
+struct square {
+  MSHADOW_XINLINE static float Map(float a) {
+    return a * a;
+  }
+};
+
+// the maps of out, a, b of the same shape, contiguous or not
+int test_expr(Mat out, Mat a, Mat b, const char *layout) {
+  const index_t nrow = out.size(0), ncol = out.size(1);
+  std::vector<double> ra(nrow * ncol), rb(nrow * ncol), ref(nrow * ncol);
+  test::Fill(a, 1, 0.25); test::Fill(b, 2, 0.25);
+  for (index_t i = 0; i < nrow; ++i) {
+    for (index_t j = 0; j < ncol; ++j) {
+      ra[i * ncol + j] = a[i][j]; rb[i * ncol + j] = b[i][j];
+    }
+  }
+  int nerr = 0;
+  out = a * b + 1.0f;
+  for (size_t k = 0; k < ref.size(); ++k) ref[k] = ra[k] * rb[k] + 1.0;
+  nerr += test::Check(out, ref, 1e-6, layout);
+  out += a;
+  for (size_t k = 0; k < ref.size(); ++k) ref[k] += ra[k];
+  nerr += test::Check(out, ref, 1e-6, layout);
+  out = F<square>(a) - b;
+  for (size_t k = 0; k < ref.size(); ++k) ref[k] = ra[k] * ra[k] - rb[k];
+  nerr += test::Check(out, ref, 1e-6, layout);
+  // a broadcast is not flat, it keeps the rows
+  TensorContainer<cpu, 1, float> v(Shape1(ncol));
+  for (index_t j = 0; j < ncol; ++j) v[j] = static_cast<float>(j % 5);
+  out = a + repmat(v, nrow);
+  for (size_t k = 0; k < ref.size(); ++k) ref[k] = ra[k] + (k % ncol) % 5;
+  nerr += test::Check(out, ref, 1e-6, layout);
+  // a typecast takes the scalar flat path
+  Tensor<cpu, 2, int> ia = NewTensor<cpu>(Shape2(nrow, ncol), 0, false);
+  for (index_t i = 0; i < nrow; ++i) {
+    for (index_t j = 0; j < ncol; ++j) ia[i][j] = static_cast<int>(i * ncol + j) % 23 - 11;
+  }
+  out = tcast<float>(ia) * 0.5f;
+  for (size_t k = 0; k < ref.size(); ++k) ref[k] = (static_cast<int>(k) % 23 - 11) * 0.5;
+  nerr += test::Check(out, ref, 1e-6, layout);
+  FreeSpace(&ia);
+  return nerr;
+}
+
+int test_flat(index_t nrow, index_t ncol) {
+  int nerr = 0;
+  // contiguous and aligned tensors take the sse flat path
+  Mat out = NewTensor<cpu>(Shape2(nrow, ncol), 0.0f, false);
+  Mat a = NewTensor<cpu>(Shape2(nrow, ncol), 0.0f, false);
+  Mat b = NewTensor<cpu>(Shape2(nrow, ncol), 0.0f, false);
+  nerr += test_expr(out, a, b, "flat");
+  // contiguous tensors that start off the alignment take the scalar flat path
+  std::vector<float> buf(3 * nrow * ncol + 4);
+  Mat uout(&buf[1], Shape2(nrow, ncol));
+  Mat ua(&buf[1] + nrow * ncol, Shape2(nrow, ncol));
+  Mat ub(&buf[1] + 2 * nrow * ncol, Shape2(nrow, ncol));
+  nerr += test_expr(uout, ua, ub, "flat, unaligned");
+  // a padded operand keeps the rows
+  TensorContainer<cpu, 2, float> pa(Shape2(nrow, ncol));
+  nerr += test_expr(out, pa, b, "padded");
+  FreeSpace(&out); FreeSpace(&a); FreeSpace(&b);
+  return nerr;
+}
+
+int main(void) {
+  int nerr = 0;
+  // short rows, sizes around the chunk and past the parallel size, with tails
+  const index_t shapes[][2] = {{1, 1}, {5, 3}, {1000, 3}, {(1 << 14) / 7 + 1, 7},
+                               {(1 << 16) / 3 + 5, 3}, {100, 2049}};
+  for (int i = 0; i < 6; ++i) {
+    nerr += test_flat(shapes[i][0], shapes[i][1]);
+  }
+  printf("test_flat: %d errors\n", nerr);
+  return nerr != 0;
+}
@@ -0,0 +1,130 @@
+#include <mshadow/tensor.h>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include "./test_util.h"
+
+// this namespace contains all data structures, functions
+using namespace mshadow;
+// this namespace contains all operator overloads
+using namespace mshadow::expr;
+
+// a * b + c rounded once with MSHADOW_USE_FMA, else rounded after the product
+template<typename DType>
+inline DType Ref(DType a, DType b, DType c) {
+#if MSHADOW_USE_FMA
+  return std::fma(a, b, c);
+#else
+  volatile DType p = a * b;
+  return p + c;
+#endif
+}
+// a * b + c rounded after the product
+template<typename DType>
+inline DType Unfused(DType a, DType b, DType c) {
+  volatile DType p = a * b;
+  return p + c;
+}
+// a * b is 1 - (k * delta)^2, whose low bits are lost when it is rounded
+template<typename DType>
+inline void Fill(Tensor<cpu, 2, DType> a, Tensor<cpu, 2, DType> b, int seed) {
+  const DType delta = std::sqrt(std::numeric_limits<DType>::epsilon()) / 8;
+  for (index_t i = 0; i < a.size(0); ++i) {
+    for (index_t j = 0; j < a.size(1); ++j) {
+      const int k = static_cast<int>((i * 5 + j * 3 + seed) % 17) - 8;
+      a[i][j] = 1 + k * delta;
+      b[i][j] = 1 - k * delta;
+    }
+  }
+}
+// compare exactly with ref(a, b) in each element, one of which must be
+// different from the unfused result when the plans fuse
+template<typename DType, typename F>
+inline int Check(Tensor<cpu, 2, DType> out, Tensor<cpu, 2, DType> a,
+                 Tensor<cpu, 2, DType> b, F ref, const char *name) {
+  std::vector<double> expect(out.shape_.Size());
+  bool fused = false;
+  for (index_t i = 0; i < out.size(0); ++i) {
+    for (index_t j = 0; j < out.size(1); ++j) {
+      expect[i * out.size(1) + j] = ref(a[i][j], b[i][j], false);
+      if (out[i][j] != ref(a[i][j], b[i][j], true)) fused = true;
+    }
+  }
+  int nerr = test::Check(out, expect, 0.0, name);
+  if (MSHADOW_USE_FMA && !fused && out.shape_.Size() >= 17) {
+    printf("%s: %s, not fused\n", name, sizeof(DType) == 4 ? "float" : "double");
+    ++nerr;
+  }
+  return nerr;
+}
+// the references of the expressions, with or without fusion
+template<typename DType>
+struct MulAdd {
+  DType operator()(DType a, DType b, bool unfused) const {
+    return unfused ? Unfused<DType>(a, b, -1) : Ref<DType>(a, b, -1);
+  }
+};
+template<typename DType>
+struct SubMul {
+  DType operator()(DType a, DType b, bool unfused) const {
+    return unfused ? Unfused<DType>(-a, b, 1) : Ref<DType>(-a, b, 1);
+  }
+};
+
+template<typename DType>
+int test_expr(Tensor<cpu, 2, DType> out, Tensor<cpu, 2, DType> a, Tensor<cpu, 2, DType> b,
+              Tensor<cpu, 2, DType> c, const char *layout) {
+  int nerr = 0;
+  Fill(a, b, static_cast<int>(out.size(1)));
+  c = scalar<DType>(-1);
+  out = a * b + c;
+  nerr += Check(out, a, b, MulAdd<DType>(), layout);
+  out = c + a * b;
+  nerr += Check(out, a, b, MulAdd<DType>(), layout);
+  out = a * b - scalar<DType>(1);
+  nerr += Check(out, a, b, MulAdd<DType>(), layout);
+  out = scalar<DType>(1) - a * b;
+  nerr += Check(out, a, b, SubMul<DType>(), layout);
+  // the right product is rounded, c * 1 is exact
+  out = a * b + c * scalar<DType>(1);
+  nerr += Check(out, a, b, MulAdd<DType>(), layout);
+  out = a * b + c * F<op::identity>(c * c);
+  nerr += Check(out, a, b, MulAdd<DType>(), layout);
+  return nerr;
+}
+
+template<typename DType>
+int test_fma(index_t nrow, index_t ncol) {
+  int nerr = 0;
+  // aligned and padded rows use the sse plans, their tails the scalar plans
+  TensorContainer<cpu, 2, DType> out(Shape2(nrow, ncol)), a(out.shape_), b(out.shape_);
+  TensorContainer<cpu, 2, DType> c(out.shape_);
+  nerr += test_expr<DType>(out, a, b, c, "aligned");
+  // the update of aligned tensors is rewritten to a fused assignment
+  Fill<DType>(a, b, 1);
+  out = scalar<DType>(-1);
+  out += a * b;
+  nerr += Check<DType>(out, a, b, MulAdd<DType>(), "plusto");
+  out = scalar<DType>(1);
+  out -= a * b;
+  nerr += Check<DType>(out, a, b, SubMul<DType>(), "minusto");
+  // tensors that start off the alignment take the scalar plans
+  std::vector<DType> buf(4 * nrow * ncol + 4);
+  Tensor<cpu, 2, DType> uout(&buf[1], Shape2(nrow, ncol));
+  Tensor<cpu, 2, DType> ua(&buf[1] + nrow * ncol, Shape2(nrow, ncol));
+  Tensor<cpu, 2, DType> ub(&buf[1] + 2 * nrow * ncol, Shape2(nrow, ncol));
+  Tensor<cpu, 2, DType> uc(&buf[1] + 3 * nrow * ncol, Shape2(nrow, ncol));
+  nerr += test_expr<DType>(uout, ua, ub, uc, "unaligned");
+  return nerr;
+}
+
+int main(void) {
+  int nerr = 0;
+  const index_t shapes[][2] = {{1, 1}, {3, 5}, {1, 8}, {7, 33}, {4, 4}, {100, 257}};
+  for (int i = 0; i < 6; ++i) {
+    nerr += test_fma<float>(shapes[i][0], shapes[i][1]);
+    nerr += test_fma<double>(shapes[i][0], shapes[i][1]);
+  }
+  printf("test_fma: %d errors\n", nerr);
+  return nerr != 0;
+}
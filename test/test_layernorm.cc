@@ -0,0 +1,87 @@
+#include <mshadow/tensor.h>
+#include <cmath>
+#include <vector>
+#include "./test_util.h"
+
+// this namespace contains all data structures, functions
+using namespace mshadow;
+// this namespace contains all operator overloads
+using namespace mshadow::expr;
+
+// reference of layer norm, or RMS norm when rms, in double
+int test_norm(index_t nrow, index_t ncol, float offset, bool rms) {
+  const float eps = 1e-5f;
+  TensorContainer<cpu, 2, float> data(Shape2(nrow, ncol)), out(data.shape_);
+  TensorContainer<cpu, 2, float> grad_out(data.shape_), grad_in(data.shape_);
+  TensorContainer<cpu, 1, float> gamma(Shape1(ncol)), beta(Shape1(ncol));
+  TensorContainer<cpu, 1, float> grad_gamma(Shape1(ncol)), grad_beta(Shape1(ncol));
+  TensorContainer<cpu, 1, float> mean(Shape1(nrow)), rstd(Shape1(nrow));
+  test::Fill(data, 1, 1.0 / 9, offset); test::Fill(grad_out, 2, 1.0 / 9);
+  for (index_t j = 0; j < ncol; ++j) {
+    gamma[j] = 0.5f + 0.125f * (j % 11);
+    beta[j] = 0.25f * (j % 5) - 0.5f;
+  }
+  std::vector<double> rmean(nrow, 0.0), rrstd(nrow), rout(nrow * ncol), rin(nrow * ncol);
+  std::vector<double> rgamma(ncol, 0.0), rbeta(ncol, 0.0);
+  for (index_t i = 0; i < nrow; ++i) {
+    if (!rms) {
+      for (index_t j = 0; j < ncol; ++j) rmean[i] += data[i][j] / static_cast<double>(ncol);
+    }
+    double m2 = 0.0;
+    for (index_t j = 0; j < ncol; ++j) {
+      const double d = data[i][j] - rmean[i];
+      m2 += d * d;
+    }
+    rrstd[i] = 1.0 / std::sqrt(m2 / ncol + eps);
+    // dx = rstd * (dy * gamma - a - xhat * b), a = mean(dy * gamma) without rms,
+    // b = mean(dy * gamma * xhat)
+    double a = 0.0, b = 0.0;
+    for (index_t j = 0; j < ncol; ++j) {
+      const double xhat = (data[i][j] - rmean[i]) * rrstd[i], g = grad_out[i][j] * gamma[j];
+      rout[i * ncol + j] = gamma[j] * xhat + (rms ? 0.0 : beta[j]);
+      rgamma[j] += grad_out[i][j] * xhat;
+      rbeta[j] += grad_out[i][j];
+      a += rms ? 0.0 : g / ncol;
+      b += g * xhat / ncol;
+    }
+    for (index_t j = 0; j < ncol; ++j) {
+      const double xhat = (data[i][j] - rmean[i]) * rrstd[i];
+      rin[i * ncol + j] = rrstd[i] * (grad_out[i][j] * gamma[j] - a - xhat * b);
+    }
+  }
+  int nerr = 0;
+  if (rms) {
+    RMSNormForward<float>(out, rstd, data, gamma, eps);
+    nerr += test::Check(rstd, rrstd, 1e-4, "rmsnorm, rstd");
+    nerr += test::Check(out, rout, 1e-4, "rmsnorm, forward");
+    RMSNormBackward<float>(grad_in, grad_gamma, grad_out, data, rstd, gamma);
+    nerr += test::Check(grad_in, rin, 1e-4, "rmsnorm, grad data");
+    nerr += test::Check(grad_gamma, rgamma, 1e-4, "rmsnorm, grad gamma");
+  } else {
+    LayerNormForward<float>(out, mean, rstd, data, gamma, beta, eps);
+    nerr += test::Check(mean, rmean, 1e-4, "layernorm, mean");
+    nerr += test::Check(rstd, rrstd, 1e-4, "layernorm, rstd");
+    nerr += test::Check(out, rout, 1e-4, "layernorm, forward");
+    LayerNormBackward<float>(grad_in, grad_gamma, grad_beta, grad_out, data, mean, rstd, gamma);
+    nerr += test::Check(grad_in, rin, 1e-4, "layernorm, grad data");
+    nerr += test::Check(grad_gamma, rgamma, 1e-4, "layernorm, grad gamma");
+    nerr += test::Check(grad_beta, rbeta, 1e-4, "layernorm, grad beta");
+  }
+  return nerr;
+}
+
+int main(void) {
+  int nerr = 0;
+  // a single element, widths below, at and past the sse width with a scalar tail,
+  // many rows for the parallel loop, and rows far from zero
+  const index_t shapes[][2] = {{1, 1}, {3, 3}, {2, 4}, {5, 7}, {4, 33}, {7, 1000},
+                               {300, 257}, {1, 4099}};
+  for (int i = 0; i < 8; ++i) {
+    for (int rms = 0; rms < 2; ++rms) {
+      nerr += test_norm(shapes[i][0], shapes[i][1], 0.0f, rms != 0);
+      nerr += test_norm(shapes[i][0], shapes[i][1], 100.0f, rms != 0);
+    }
+  }
+  printf("test_layernorm: %d errors\n", nerr);
+  return nerr != 0;
+}
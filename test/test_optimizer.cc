@@ -0,0 +1,148 @@
+#include <mshadow/tensor.h>
+#include <cmath>
+#include <vector>
+#include "./test_util.h"
+
+// this namespace contains all data structures, functions
+using namespace mshadow;
+// this namespace contains all operator overloads
+using namespace mshadow::expr;
+
+typedef Tensor<cpu, 2, float> Mat;
+
+// weight, grad, mean, var of each tensor and their reference in double
+struct State {
+  std::vector<TensorContainer<cpu, 2, float>*> x[4];
+  std::vector<std::vector<double> > ref[4];
+  std::vector<Mat> list[4];
+  explicit State(const std::vector<Shape<2> > &shapes) {
+    for (int k = 0; k < 4; ++k) {
+      for (size_t t = 0; t < shapes.size(); ++t) {
+        // the containers of 2D shapes are padded, so the rows are not contiguous
+        TensorContainer<cpu, 2, float> *c = new TensorContainer<cpu, 2, float>(shapes[t]);
+        ref[k].push_back(std::vector<double>(shapes[t].Size()));
+        for (index_t i = 0; i < c->size(0); ++i) {
+          for (index_t j = 0; j < c->size(1); ++j) {
+            const int h = static_cast<int>((i * 131 + j * 7 + t * 17 + k * 29) % 97) - 48;
+            // second moments are positive
+            const float v = k == 3 ? (h + 48) / 1000.0f : h / 50.0f;
+            (*c)[i][j] = v;
+            ref[k][t][i * c->size(1) + j] = v;
+          }
+        }
+        x[k].push_back(c);
+        list[k].push_back(*c);
+      }
+    }
+  }
+  ~State(void) {
+    for (int k = 0; k < 4; ++k) {
+      for (size_t t = 0; t < x[k].size(); ++t) delete x[k][t];
+    }
+  }
+  // the new gradients of a step
+  inline void Grad(int step) {
+    for (size_t t = 0; t < x[1].size(); ++t) {
+      Mat g = *x[1][t];
+      for (index_t i = 0; i < g.size(0); ++i) {
+        for (index_t j = 0; j < g.size(1); ++j) {
+          const float v = static_cast<float>(static_cast<int>((i * 3 + j * 11 + step * 5) % 23)
+                                             - 11) / 7.0f;
+          g[i][j] = v;
+          ref[1][t][i * g.size(1) + j] = v;
+        }
+      }
+    }
+  }
+  // compare role k with its reference
+  inline int Check(int k, const char *name) {
+    int nerr = 0;
+    for (size_t t = 0; t < x[k].size(); ++t) {
+      nerr += test::Check(*x[k][t], ref[k][t], 1e-5, name);
+    }
+    return nerr;
+  }
+};
+
+int test_sgd(const std::vector<Shape<2> > &shapes) {
+  SGDParam param;
+  param.lr = 0.1f; param.wd = 0.01f; param.momentum = 0.8f; param.rescale_grad = 0.5f;
+  int nerr = 0;
+  State s(shapes), sm(shapes);
+  for (int step = 0; step < 3; ++step) {
+    s.Grad(step); sm.Grad(step);
+    MultiSGDUpdate(s.list[0], s.list[1], param);
+    MultiSGDMomUpdate(sm.list[0], sm.list[1], sm.list[2], param);
+    for (size_t t = 0; t < shapes.size(); ++t) {
+      std::vector<double> &w = s.ref[0][t], &g = s.ref[1][t];
+      for (size_t j = 0; j < w.size(); ++j) {
+        w[j] -= param.lr * (param.rescale_grad * g[j] + param.wd * w[j]);
+      }
+      std::vector<double> &wm = sm.ref[0][t], &gm = sm.ref[1][t], &m = sm.ref[2][t];
+      for (size_t j = 0; j < wm.size(); ++j) {
+        m[j] = param.momentum * m[j] - param.lr * (param.rescale_grad * gm[j] + param.wd * wm[j]);
+        wm[j] += m[j];
+      }
+    }
+  }
+  nerr += s.Check(0, "sgd");
+  nerr += sm.Check(0, "sgd momentum, weight");
+  nerr += sm.Check(2, "sgd momentum, mom");
+  return nerr;
+}
+
+int test_adam(const std::vector<Shape<2> > &shapes, bool lamb) {
+  AdamParam param;
+  param.lr = 0.01f; param.wd = 0.1f; param.rescale_grad = 0.5f;
+  int nerr = 0;
+  State s(shapes);
+  for (int step = 1; step <= 3; ++step) {
+    param.t = step;
+    s.Grad(step);
+    if (lamb) {
+      MultiLAMBUpdate(s.list[0], s.list[1], s.list[2], s.list[3], param);
+    } else {
+      MultiAdamUpdate(s.list[0], s.list[1], s.list[2], s.list[3], param);
+    }
+    const double c1 = 1.0 / (1.0 - std::pow(static_cast<double>(param.beta1), step));
+    const double c2 = 1.0 / (1.0 - std::pow(static_cast<double>(param.beta2), step));
+    for (size_t t = 0; t < shapes.size(); ++t) {
+      std::vector<double> &w = s.ref[0][t], &g = s.ref[1][t], &m = s.ref[2][t], &v = s.ref[3][t];
+      std::vector<double> r(w.size());
+      double sw = 0, sr = 0;
+      for (size_t j = 0; j < w.size(); ++j) {
+        const double gj = param.rescale_grad * g[j] + (lamb ? 0.0 : param.wd * w[j]);
+        m[j] = param.beta1 * m[j] + (1.0 - param.beta1) * gj;
+        v[j] = param.beta2 * v[j] + (1.0 - param.beta2) * gj * gj;
+        r[j] = m[j] * c1 / (std::sqrt(v[j] * c2) + param.epsilon) + (lamb ? param.wd * w[j] : 0.0);
+        sw += w[j] * w[j]; sr += r[j] * r[j];
+      }
+      const double trust = (lamb && sw > 0 && sr > 0) ? std::sqrt(sw / sr) : 1.0;
+      for (size_t j = 0; j < w.size(); ++j) w[j] -= param.lr * trust * r[j];
+    }
+  }
+  const char *name = lamb ? "lamb" : "adam";
+  nerr += s.Check(0, name);
+  nerr += s.Check(2, name);
+  nerr += s.Check(3, name);
+  return nerr;
+}
+
+int main(void) {
+  int nerr = 0;
+  // small tensors grouped into one task, odd sizes for the scalar tail,
+  // and tensors cut into several segments
+  std::vector<Shape<2> > shapes;
+  shapes.push_back(Shape2(1, 1));
+  shapes.push_back(Shape2(3, 5));
+  shapes.push_back(Shape2(1, 8));
+  shapes.push_back(Shape2(7, 33));
+  shapes.push_back(Shape2(1, 70001));
+  shapes.push_back(Shape2(300, 257));
+  shapes.push_back(Shape2(2, 3));
+  nerr += test_sgd(shapes);
+  nerr += test_adam(shapes, false);
+  nerr += test_adam(shapes, true);
+  printf("test_optimizer: %d errors\n", nerr);
+  return nerr != 0;
+}
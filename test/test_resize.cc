@@ -0,0 +1,139 @@
+#include <mshadow/tensor.h>
+#include <cmath>
+#include <vector>
+#include "./test_util.h"
+
+// this namespace contains all data structures, functions
+using namespace mshadow;
+// this namespace contains all operator overloads
+using namespace mshadow::expr;
+
+typedef Tensor<cpu, 4, float> Img;
+
+// pixel center weights of dst coordinate o: src[i0] * (1 - l) + src[i1] * l
+inline void Weight(index_t o, index_t isize, index_t osize,
+                   index_t *i0, index_t *i1, double *l) {
+  double s = (o + 0.5) * isize / osize - 0.5;
+  if (s < 0.0) s = 0.0;
+  index_t i = static_cast<index_t>(s);
+  if (i > isize - 1) i = isize - 1;
+  *i0 = i;
+  *i1 = i + 1 < isize ? i + 1 : i;
+  *l = s - i;
+}
+// reference of resize_bilinear, or its gradient when backward
+inline void Bilinear(std::vector<double> *out, const Img &in, const Img &dout, bool backward) {
+  const index_t ih = in.size(2), iw = in.size(3), oh = dout.size(2), ow = dout.size(3);
+  out->assign(backward ? in.shape_.Size() : dout.shape_.Size(), 0.0);
+  for (index_t n = 0; n < in.size(0); ++n) {
+    for (index_t c = 0; c < in.size(1); ++c) {
+      for (index_t y = 0; y < oh; ++y) {
+        for (index_t x = 0; x < ow; ++x) {
+          index_t y0, y1, x0, x1;
+          double ly, lx;
+          Weight(y, ih, oh, &y0, &y1, &ly);
+          Weight(x, iw, ow, &x0, &x1, &lx);
+          const index_t ys[2] = {y0, y1}, xs[2] = {x0, x1};
+          const double wy[2] = {1 - ly, ly}, wx[2] = {1 - lx, lx};
+          const index_t o = ((n * in.size(1) + c) * oh + y) * ow + x;
+          for (int a = 0; a < 2; ++a) {
+            for (int b = 0; b < 2; ++b) {
+              const index_t i = ((n * in.size(1) + c) * ih + ys[a]) * iw + xs[b];
+              if (backward) {
+                (*out)[i] += wy[a] * wx[b] * dout[n][c][y][x];
+              } else {
+                (*out)[o] += wy[a] * wx[b] * in[n][c][ys[a]][xs[b]];
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+}
+// ref + old in the order of the shape
+inline std::vector<double> Plus(const std::vector<double> &ref, Img old) {
+  std::vector<double> sum(ref);
+  Tensor<cpu, 2, float> m = old.FlatTo2D();
+  for (index_t i = 0; i < m.size(0); ++i) {
+    for (index_t j = 0; j < m.size(1); ++j) sum[i * m.size(1) + j] += m[i][j];
+  }
+  return sum;
+}
+
+int test_bilinear(index_t nbatch, index_t nchannel, index_t ih, index_t iw,
+                  index_t oh, index_t ow) {
+  TensorContainer<cpu, 4, float> in(Shape4(nbatch, nchannel, ih, iw));
+  TensorContainer<cpu, 4, float> out(Shape4(nbatch, nchannel, oh, ow));
+  TensorContainer<cpu, 4, float> old(Shape4(nbatch, nchannel, oh, ow));
+  TensorContainer<cpu, 4, float> grad_in(Shape4(nbatch, nchannel, ih, iw));
+  test::Fill(in, 1); test::Fill(old, 2);
+  std::vector<double> ref, ref_grad;
+  Bilinear(&ref, in, old, false);
+  int nerr = 0;
+  // the plane path of a tensor and the plan of an expression
+  out = resize_bilinear(in, oh, ow);
+  nerr += test::Check(out, ref, 1e-5, "resize_bilinear");
+  out = old;
+  out += resize_bilinear(in, oh, ow);
+  nerr += test::Check(out, Plus(ref, old), 1e-5, "resize_bilinear, plusto");
+  out = resize_bilinear(in * 1.0f, oh, ow);
+  nerr += test::Check(out, ref, 1e-5, "resize_bilinear, plan");
+  // gradient with old as the gradient of the output
+  Bilinear(&ref_grad, in, old, true);
+  ResizeBilinearBackward(grad_in, old);
+  nerr += test::Check(grad_in, ref_grad, 1e-5, "resize_bilinear, backward");
+  return nerr;
+}
+
+int test_nearest(index_t nbatch, index_t nchannel, index_t ih, index_t iw, index_t scale) {
+  const index_t oh = ih * scale, ow = iw * scale;
+  TensorContainer<cpu, 4, float> in(Shape4(nbatch, nchannel, ih, iw));
+  TensorContainer<cpu, 4, float> out(Shape4(nbatch, nchannel, oh, ow));
+  TensorContainer<cpu, 4, float> old(Shape4(nbatch, nchannel, oh, ow));
+  TensorContainer<cpu, 4, float> grad_in(Shape4(nbatch, nchannel, ih, iw));
+  test::Fill(in, 3); test::Fill(old, 4);
+  std::vector<double> ref(out.shape_.Size()), ref_grad(in.shape_.Size(), 0.0);
+  index_t i = 0;
+  for (index_t n = 0; n < nbatch; ++n) {
+    for (index_t c = 0; c < nchannel; ++c) {
+      for (index_t y = 0; y < oh; ++y) {
+        for (index_t x = 0; x < ow; ++x, ++i) {
+          ref[i] = in[n][c][y / scale][x / scale];
+          ref_grad[((n * nchannel + c) * ih + y / scale) * iw + x / scale] += old[n][c][y][x];
+        }
+      }
+    }
+  }
+  int nerr = 0;
+  out = upsample_nearest(in, scale);
+  nerr += test::Check(out, ref, 1e-5, "upsample_nearest");
+  out = old;
+  out -= upsample_nearest(in, scale);
+  std::vector<double> neg(ref.size());
+  for (size_t k = 0; k < ref.size(); ++k) neg[k] = -ref[k];
+  nerr += test::Check(out, Plus(neg, old), 1e-5, "upsample_nearest, minusto");
+  out = upsample_nearest(in * 1.0f, scale);
+  nerr += test::Check(out, ref, 1e-5, "upsample_nearest, plan");
+  UpSampleNearestBackward(grad_in, old, scale);
+  nerr += test::Check(grad_in, ref_grad, 1e-5, "upsample_nearest, backward");
+  return nerr;
+}
+
+int main(void) {
+  int nerr = 0;
+  // up, down, same size, a single pixel, non-integer ratios and odd widths
+  nerr += test_bilinear(1, 1, 1, 1, 3, 5);
+  nerr += test_bilinear(2, 3, 4, 4, 8, 8);
+  nerr += test_bilinear(2, 3, 8, 8, 4, 4);
+  nerr += test_bilinear(1, 2, 5, 7, 5, 7);
+  nerr += test_bilinear(2, 2, 7, 9, 13, 6);
+  nerr += test_bilinear(1, 3, 13, 6, 5, 17);
+  nerr += test_bilinear(4, 16, 32, 32, 64, 64);
+  nerr += test_nearest(1, 1, 1, 1, 1);
+  nerr += test_nearest(2, 3, 5, 7, 2);
+  nerr += test_nearest(1, 2, 4, 3, 3);
+  nerr += test_nearest(4, 16, 32, 32, 2);
+  printf("test_resize: %d errors\n", nerr);
+  return nerr != 0;
+}
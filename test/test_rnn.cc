@@ -0,0 +1,176 @@
+#include <mshadow/tensor.h>
+#include <cmath>
+#include <limits>
+#include "./test_util.h"
+
+// this namespace contains all data structures, functions
+using namespace mshadow;
+// this namespace contains all operator overloads
+using namespace mshadow::expr;
+
+typedef Tensor<cpu, 2, double> DMat;
+typedef Tensor<cpu, 1, double> DVec;
+
+// the float copy of a double tensor
+template<int dim>
+inline void Copy(Tensor<cpu, dim, float> dst, Tensor<cpu, dim, double> src) {
+  Tensor<cpu, 2, float> d = dst.FlatTo2D();
+  Tensor<cpu, 2, double> s = src.FlatTo2D();
+  for (index_t i = 0; i < d.size(0); ++i) {
+    for (index_t j = 0; j < d.size(1); ++j) d[i][j] = static_cast<float>(s[i][j]);
+  }
+}
+
+// loss sum(wh * h) + sum(wc * c) of LSTMCellForward from the gates before activation
+inline double LSTMLoss(DMat pre, DMat c_prev, DVec bias, DMat wh, DMat wc) {
+  TensorContainer<cpu, 2, double> gates(pre.shape_), c(c_prev.shape_), h(c_prev.shape_);
+  Copy(gates, pre);
+  LSTMCellForward(c, h, gates, c_prev, bias);
+  double loss = 0.0;
+  for (index_t i = 0; i < c.size(0); ++i) {
+    for (index_t j = 0; j < c.size(1); ++j) loss += wh[i][j] * h[i][j] + wc[i][j] * c[i][j];
+  }
+  return loss;
+}
+// central difference of the loss on each element of x
+template<typename Loss>
+inline int CheckGrad(DMat x, DMat grad, const Loss &loss, const char *name) {
+  const double eps = 1e-6;
+  int nerr = 0;
+  for (index_t i = 0; i < x.size(0); ++i) {
+    for (index_t j = 0; j < x.size(1); ++j) {
+      const double v = x[i][j];
+      x[i][j] = v + eps;
+      const double lp = loss();
+      x[i][j] = v - eps;
+      const double lm = loss();
+      x[i][j] = v;
+      const double fd = (lp - lm) / (2 * eps);
+      if (std::fabs(fd - grad[i][j]) > 1e-6 * (std::fabs(fd) + 1.0)) ++nerr;
+    }
+  }
+  if (nerr != 0) printf("%s: %d errors\n", name, nerr);
+  return nerr;
+}
+struct LSTMLossFn {
+  DMat pre, c_prev, wh, wc;
+  DVec bias;
+  double operator()() const {
+    return LSTMLoss(pre, c_prev, bias, wh, wc);
+  }
+};
+
+int test_lstm(index_t batch, index_t nhidden, double scale) {
+  const Shape<2> sc = Shape2(batch, nhidden), sg = Shape2(batch, 4 * nhidden);
+  TensorContainer<cpu, 2, double> pre(sg), gates(sg), grad_gates(sg);
+  TensorContainer<cpu, 2, double> c_prev(sc), c(sc), h(sc), wh(sc), wc(sc), grad_c_prev(sc);
+  TensorContainer<cpu, 1, double> bias(Shape1(4 * nhidden));
+  // inputs in [-scale, scale], c_prev in [-2, 2] and the loss weights in [-1, 1]
+  test::Fill(pre, 1, scale / 18); test::Fill(c_prev, 2, 1.0 / 9);
+  test::Fill(bias, 3, scale / 36); test::Fill(wh, 4, 1.0 / 18); test::Fill(wc, 5, 1.0 / 18);
+  Copy(gates, pre);
+  LSTMCellForward(c, h, gates, c_prev, bias);
+  LSTMCellBackward(grad_gates, grad_c_prev, wh, wc, gates, c_prev, c);
+  int nerr = 0;
+  // gradient of the double version against finite difference
+  LSTMLossFn fn;
+  fn.pre = pre; fn.c_prev = c_prev; fn.bias = bias; fn.wh = wh; fn.wc = wc;
+  nerr += CheckGrad(pre, grad_gates, fn, "lstm, grad gates");
+  nerr += CheckGrad(c_prev, grad_c_prev, fn, "lstm, grad c_prev");
+  // the float version, vectorized with a scalar tail, against the double one
+  TensorContainer<cpu, 2, float> fgates(sg), fgrad_gates(sg);
+  TensorContainer<cpu, 2, float> fc_prev(sc), fc(sc), fh(sc), fwh(sc), fwc(sc), fgrad_c_prev(sc);
+  TensorContainer<cpu, 1, float> fbias(Shape1(4 * nhidden));
+  Copy(fgates, pre); Copy(fc_prev, c_prev); Copy(fbias, bias); Copy(fwh, wh); Copy(fwc, wc);
+  LSTMCellForward(fc, fh, fgates, fc_prev, fbias);
+  LSTMCellBackward(fgrad_gates, fgrad_c_prev, fwh, fwc, fgates, fc_prev, fc);
+  nerr += test::Check(fgates, gates, 1e-6, "lstm float, gates");
+  nerr += test::Check(fc, c, 1e-6, "lstm float, c");
+  nerr += test::Check(fh, h, 1e-6, "lstm float, h");
+  nerr += test::Check(fgrad_gates, grad_gates, 1e-5, "lstm float, grad gates");
+  nerr += test::Check(fgrad_c_prev, grad_c_prev, 1e-5, "lstm float, grad c_prev");
+  return nerr;
+}
+
+struct GRULossFn {
+  DMat x, gh, h_prev, wh;
+  DVec bx, bh;
+  double operator()() const {
+    TensorContainer<cpu, 2, double> gates(x.shape_), h(h_prev.shape_);
+    Copy(gates, x);
+    GRUCellForward(h, gates, gh, h_prev, bx, bh);
+    double loss = 0.0;
+    for (index_t i = 0; i < h.size(0); ++i) {
+      for (index_t j = 0; j < h.size(1); ++j) loss += wh[i][j] * h[i][j];
+    }
+    return loss;
+  }
+};
+
+int test_gru(index_t batch, index_t nhidden, double scale) {
+  const Shape<2> sh = Shape2(batch, nhidden), sg = Shape2(batch, 3 * nhidden);
+  TensorContainer<cpu, 2, double> x(sg), gates(sg), gh(sg), grad_x(sg), grad_gh(sg);
+  TensorContainer<cpu, 2, double> h_prev(sh), h(sh), wh(sh), grad_h_prev(sh);
+  TensorContainer<cpu, 1, double> bx(Shape1(3 * nhidden)), bh(Shape1(3 * nhidden));
+  test::Fill(x, 6, scale / 18); test::Fill(gh, 7, scale / 18); test::Fill(h_prev, 8, 1.0 / 18);
+  test::Fill(bx, 9, scale / 36); test::Fill(bh, 10, scale / 36); test::Fill(wh, 11, 1.0 / 18);
+  Copy(gates, x);
+  GRUCellForward(h, gates, gh, h_prev, bx, bh);
+  GRUCellBackward(grad_x, grad_gh, grad_h_prev, wh, gates, gh, bh, h_prev);
+  int nerr = 0;
+  GRULossFn fn;
+  fn.x = x; fn.gh = gh; fn.h_prev = h_prev; fn.wh = wh; fn.bx = bx; fn.bh = bh;
+  nerr += CheckGrad(x, grad_x, fn, "gru, grad gates_x");
+  nerr += CheckGrad(gh, grad_gh, fn, "gru, grad gates_h");
+  // gates_h is given, so h_prev only acts through the update gate
+  nerr += CheckGrad(h_prev, grad_h_prev, fn, "gru, grad h_prev");
+  TensorContainer<cpu, 2, float> fgates(sg), fgh(sg), fgrad_x(sg), fgrad_gh(sg);
+  TensorContainer<cpu, 2, float> fh_prev(sh), fh(sh), fwh(sh), fgrad_h_prev(sh);
+  TensorContainer<cpu, 1, float> fbx(Shape1(3 * nhidden)), fbh(Shape1(3 * nhidden));
+  Copy(fgates, x); Copy(fgh, gh); Copy(fh_prev, h_prev);
+  Copy(fbx, bx); Copy(fbh, bh); Copy(fwh, wh);
+  GRUCellForward(fh, fgates, fgh, fh_prev, fbx, fbh);
+  GRUCellBackward(fgrad_x, fgrad_gh, fgrad_h_prev, fwh, fgates, fgh, fbh, fh_prev);
+  nerr += test::Check(fgates, gates, 1e-6, "gru float, gates");
+  nerr += test::Check(fh, h, 1e-6, "gru float, h");
+  nerr += test::Check(fgrad_x, grad_x, 1e-5, "gru float, grad gates_x");
+  nerr += test::Check(fgrad_gh, grad_gh, 1e-5, "gru float, grad gates_h");
+  nerr += test::Check(fgrad_h_prev, grad_h_prev, 1e-5, "gru float, grad h_prev");
+  return nerr;
+}
+
+// tanh of small values keeps its relative accuracy, NaN is kept
+int test_tanh() {
+  TensorContainer<cpu, 2, float> c(Shape2(1, 8)), h(Shape2(1, 8)), gates(Shape2(1, 32));
+  TensorContainer<cpu, 2, float> c_prev(Shape2(1, 8));
+  TensorContainer<cpu, 1, float> bias(Shape1(32));
+  bias = 0.0f; c_prev = 0.0f;
+  int nerr = 0;
+  const float xs[] = {1e-7f, -3e-5f, 1e-3f, 0.3f, -0.6f, 0.65f, 5.0f, -20.0f};
+  gates = 0.0f;
+  for (index_t j = 0; j < 8; ++j) gates[0][16 + j] = xs[j];
+  gates[0][24 + 7] = std::numeric_limits<float>::quiet_NaN();
+  LSTMCellForward(c, h, gates, c_prev, bias);
+  for (index_t j = 0; j < 8; ++j) {
+    const double expect = std::tanh(static_cast<double>(xs[j]));
+    if (std::fabs(gates[0][16 + j] - expect) > 2e-7 * std::fabs(expect)) ++nerr;
+  }
+  // the output gate of the last column is NaN, so is h
+  if (!(h[0][7] != h[0][7])) ++nerr;
+  if (nerr != 0) printf("tanh: %d errors\n", nerr);
+  return nerr;
+}
+
+int main(void) {
+  int nerr = 0;
+  const index_t nhiddens[] = {1, 4, 7, 13};
+  for (int i = 0; i < 4; ++i) {
+    nerr += test_lstm(3, nhiddens[i], 2.0);
+    nerr += test_lstm(2, nhiddens[i], 12.0);
+    nerr += test_gru(3, nhiddens[i], 2.0);
+    nerr += test_gru(2, nhiddens[i], 12.0);
+  }
+  nerr += test_tanh();
+  printf("test_rnn: %d errors\n", nerr);
+  return nerr != 0;
+}
@@ -0,0 +1,121 @@
+#include <mshadow/tensor.h>
+#include <limits>
+#include <vector>
+#include "./test_util.h"
+
+// this namespace contains all data structures, functions
+using namespace mshadow;
+// this namespace contains all operator overloads
+using namespace mshadow::expr;
+
+// the documented results, NaN compares false except in ne
+template<typename DType> DType RefMax(DType a, DType b, DType c) { return a > b ? a : b; }
+template<typename DType> DType RefMin(DType a, DType b, DType c) { return a < b ? a : b; }
+template<typename DType> DType RefGt(DType a, DType b, DType c) { return a > b ? 1 : 0; }
+template<typename DType> DType RefGe(DType a, DType b, DType c) { return a >= b ? 1 : 0; }
+template<typename DType> DType RefLt(DType a, DType b, DType c) { return a < b ? 1 : 0; }
+template<typename DType> DType RefLe(DType a, DType b, DType c) { return a <= b ? 1 : 0; }
+template<typename DType> DType RefEq(DType a, DType b, DType c) { return a == b ? 1 : 0; }
+template<typename DType> DType RefNe(DType a, DType b, DType c) { return a != b ? 1 : 0; }
+template<typename DType> DType RefSign(DType a, DType b, DType c) {
+  return a > 0 ? 1 : (a < 0 ? -1 : 0);
+}
+template<typename DType> DType RefWhere(DType a, DType b, DType c) { return c != 0 ? a : b; }
+template<typename DType> DType RefMask(DType a, DType b, DType c) { return a > b ? a : 0; }
+template<typename DType> DType RefFill(DType a, DType b, DType c) { return c != 0 ? 2 : b; }
+template<typename DType> DType RefClip(DType a, DType b, DType c) {
+  return RefMin<DType>(RefMax<DType>(a, -1, 0), 1, 0);
+}
+template<typename DType> DType RefClipT(DType a, DType b, DType c) {
+  return RefMin<DType>(RefMax<DType>(a, b, 0), c, 0);
+}
+
+// NaN, infinities, signed zeros, equal pairs and a subnormal number
+template<typename DType>
+inline void Fill(Tensor<cpu, 2, DType> t, int seed) {
+  const DType v[] = {std::numeric_limits<DType>::quiet_NaN(),
+                     -std::numeric_limits<DType>::infinity(), -2, -1, DType(-0.5), DType(-0.0),
+                     0, DType(0.5), 1, 1, 2, std::numeric_limits<DType>::infinity(),
+                     std::numeric_limits<DType>::denorm_min()};
+  for (index_t i = 0; i < t.size(0); ++i) {
+    for (index_t j = 0; j < t.size(1); ++j) {
+      t[i][j] = v[(i * 7 + j * (seed + 2) + seed) % 13];
+    }
+  }
+}
+// bit for bit, so that signed zeros and the NaN that is kept count
+template<typename DType>
+inline int Check(Tensor<cpu, 2, DType> out, Tensor<cpu, 2, DType> a, Tensor<cpu, 2, DType> b,
+                 Tensor<cpu, 2, DType> c, DType (*ref)(DType, DType, DType), const char *name) {
+  std::vector<DType> expect(out.shape_.Size());
+  for (index_t i = 0; i < out.size(0); ++i) {
+    for (index_t j = 0; j < out.size(1); ++j) {
+      expect[i * out.size(1) + j] = ref(a[i][j], b[i][j], c[i][j]);
+    }
+  }
+  return test::CheckBits(out, expect, name);
+}
+
+template<typename DType>
+int test_expr(Tensor<cpu, 2, DType> out, Tensor<cpu, 2, DType> a, Tensor<cpu, 2, DType> b,
+              Tensor<cpu, 2, DType> c) {
+  int nerr = 0;
+  Fill(a, 0); Fill(b, 1); Fill(c, 2);
+  out = F<op::maximum>(a, b);
+  nerr += Check(out, a, b, c, RefMax<DType>, "maximum");
+  out = F<op::minimum>(a, b);
+  nerr += Check(out, a, b, c, RefMin<DType>, "minimum");
+  out = F<op::gt>(a, b);
+  nerr += Check(out, a, b, c, RefGt<DType>, "gt");
+  out = F<op::ge>(a, b);
+  nerr += Check(out, a, b, c, RefGe<DType>, "ge");
+  out = F<op::lt>(a, b);
+  nerr += Check(out, a, b, c, RefLt<DType>, "lt");
+  out = F<op::le>(a, b);
+  nerr += Check(out, a, b, c, RefLe<DType>, "le");
+  out = F<op::eq>(a, b);
+  nerr += Check(out, a, b, c, RefEq<DType>, "eq");
+  out = F<op::ne>(a, b);
+  nerr += Check(out, a, b, c, RefNe<DType>, "ne");
+  out = F<op::sign>(a);
+  nerr += Check(out, a, b, c, RefSign<DType>, "sign");
+  out = where(c, a, b);
+  nerr += Check(out, a, b, c, RefWhere<DType>, "where");
+  out = where(F<op::gt>(a, b), a, scalar<DType>(0));
+  nerr += Check(out, a, b, c, RefMask<DType>, "where, mask");
+  out = where(c, scalar<DType>(2), b);
+  nerr += Check(out, a, b, c, RefFill<DType>, "where, fill");
+  out = clip(a, scalar<DType>(-1), scalar<DType>(1));
+  nerr += Check(out, a, b, c, RefClip<DType>, "clip");
+  out = clip(a, b, c);
+  nerr += Check(out, a, b, c, RefClipT<DType>, "clip, tensor bounds");
+  return nerr;
+}
+
+template<typename DType>
+int test_select(index_t nrow, index_t ncol) {
+  int nerr = 0;
+  // aligned and padded rows use the sse plans, their tails the scalar plans
+  TensorContainer<cpu, 2, DType> out(Shape2(nrow, ncol)), a(out.shape_), b(out.shape_);
+  TensorContainer<cpu, 2, DType> c(out.shape_);
+  nerr += test_expr<DType>(out, a, b, c);
+  // tensors that start off the alignment take the scalar plans
+  std::vector<DType> buf(4 * nrow * ncol + 4);
+  Tensor<cpu, 2, DType> uout(&buf[1], Shape2(nrow, ncol));
+  Tensor<cpu, 2, DType> ua(&buf[1] + nrow * ncol, Shape2(nrow, ncol));
+  Tensor<cpu, 2, DType> ub(&buf[1] + 2 * nrow * ncol, Shape2(nrow, ncol));
+  Tensor<cpu, 2, DType> uc(&buf[1] + 3 * nrow * ncol, Shape2(nrow, ncol));
+  nerr += test_expr<DType>(uout, ua, ub, uc);
+  return nerr;
+}
+
+int main(void) {
+  int nerr = 0;
+  const index_t shapes[][2] = {{1, 1}, {3, 5}, {1, 8}, {7, 33}, {4, 4}, {13, 257}};
+  for (int i = 0; i < 6; ++i) {
+    nerr += test_select<float>(shapes[i][0], shapes[i][1]);
+    nerr += test_select<double>(shapes[i][0], shapes[i][1]);
+  }
+  printf("test_select: %d errors\n", nerr);
+  return nerr != 0;
+}
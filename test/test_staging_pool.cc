@@ -0,0 +1,147 @@
+#include <unistd.h>
+#include <cstdio>
+#include "../mshadow-ps/staging_pool.h"
+
+// this namespace contains all data structures, functions
+using namespace mshadow;
+
+typedef ps::StagingPool<cpu, float> Pool;
+
+// a lease of owner 0 taken in another thread, done is set when Alloc returns
+struct Lease {
+  Pool *pool;
+  size_t size;
+  int max_lease;
+  float *dptr;
+  bool done;
+  utils::Mutex lock;
+};
+MSHADOW_THREAD_PREFIX LeaseThread(void *param) {
+  Lease *l = static_cast<Lease*>(param);
+  float *dptr = l->pool->Alloc(l->size, 0, l->max_lease);
+  l->lock.Lock();
+  l->dptr = dptr; l->done = true;
+  l->lock.Unlock();
+  return NULL;
+}
+inline bool IsDone(Lease *l) {
+  l->lock.Lock();
+  bool done = l->done;
+  l->lock.Unlock();
+  return done;
+}
+
+// an owner at max_lease blocks until one of its leases is released,
+// then takes the released block
+int test_max_lease(void) {
+  Pool pool;
+  pool.Init(false);
+  int nerr = 0;
+  float *a = pool.Alloc(100, 0, 2);
+  float *b = pool.Alloc(100, 0, 2);
+  // another owner does not count against owner 0
+  float *c = pool.Alloc(100, 1, 1);
+  Lease l;
+  l.pool = &pool; l.size = 100; l.max_lease = 2; l.dptr = NULL; l.done = false;
+  l.lock.Init();
+  utils::Thread thread;
+  thread.Start(LeaseThread, &l);
+  usleep(100000);
+  if (IsDone(&l)) {
+    printf("max_lease: Alloc did not block\n"); ++nerr;
+  }
+  pool.Release(c);
+  usleep(50000);
+  if (IsDone(&l)) {
+    printf("max_lease: release of another owner unblocked Alloc\n"); ++nerr;
+  }
+  pool.Release(a);
+  thread.Join();
+  if (!IsDone(&l) || l.dptr != a) {
+    printf("max_lease: the released block is not reused\n"); ++nerr;
+  }
+  pool.Release(l.dptr); pool.Release(b);
+  // abort wakes up the blocked leases with NULL
+  a = pool.Alloc(100, 0, 1);
+  l.done = false; l.max_lease = 1;
+  thread.Start(LeaseThread, &l);
+  usleep(50000);
+  pool.Abort();
+  thread.Join();
+  if (l.dptr != NULL) {
+    printf("max_lease: aborted Alloc returned a block\n"); ++nerr;
+  }
+  l.lock.Destroy();
+  pool.Destroy();
+  return nerr;
+}
+
+// a freed block is reused by any size of its class, other classes allocate
+int test_size_class(void) {
+  Pool pool;
+  pool.Init(false);
+  int nerr = 0;
+  if (Pool::SizeClass(1) != 64 || Pool::SizeClass(100) != 112 ||
+      Pool::SizeClass(112) != 112 || Pool::SizeClass(113) != 128 ||
+      Pool::SizeClass(1000) != 1024) {
+    printf("size class: wrong class\n"); ++nerr;
+  }
+  float *a = pool.Alloc(100, 0, 4);
+  const size_t nbyte = pool.BytesAllocated();
+  if (nbyte != 112 * sizeof(float)) {
+    printf("size class: %lu bytes allocated\n", static_cast<unsigned long>(nbyte)); ++nerr;
+  }
+  pool.Release(a);
+  float *b = pool.Alloc(112, 0, 4);
+  if (b != a || pool.BytesAllocated() != nbyte) {
+    printf("size class: free block of the same class not reused\n"); ++nerr;
+  }
+  float *c = pool.Alloc(113, 0, 4);
+  if (c == a || pool.BytesAllocated() != nbyte + 128 * sizeof(float)) {
+    printf("size class: block of another class reused\n"); ++nerr;
+  }
+  pool.Release(b); pool.Release(c);
+  pool.Destroy();
+  return nerr;
+}
+
+// a lease retained by a second owner is freed once, when both released it
+int test_retain(void) {
+  Pool pool;
+  pool.Init(false);
+  int nerr = 0;
+  float *a = pool.Alloc(1000, 0, 1);
+  // the second holder refers to the middle of the block
+  pool.Retain(a + 10);
+  pool.Release(a);
+  float *b = pool.Alloc(1000, 1, 1);
+  if (b == a) {
+    printf("retain: block freed while referenced\n"); ++nerr;
+  }
+  pool.Release(a + 10);
+  // releases after the last reference do nothing, nor do foreign pointers
+  float other;
+  pool.Release(a); pool.Release(&other); pool.Retain(&other);
+  float *c = pool.Alloc(1000, 0, 1);
+  float *d = pool.Alloc(1000, 1, 2);
+  if (c != a || d == a || d == b) {
+    printf("retain: block not freed exactly once\n"); ++nerr;
+  }
+  if (pool.BytesAllocated() != 3 * 1024 * sizeof(float)) {
+    printf("retain: %lu bytes allocated\n",
+           static_cast<unsigned long>(pool.BytesAllocated()));
+    ++nerr;
+  }
+  pool.Release(b); pool.Release(c); pool.Release(d);
+  pool.Destroy();
+  return nerr;
+}
+
+int main(void) {
+  int nerr = 0;
+  nerr += test_max_lease();
+  nerr += test_size_class();
+  nerr += test_retain();
+  printf("test_staging_pool: %d errors\n", nerr);
+  return nerr != 0;
+}
@@ -0,0 +1,80 @@
+#include <mshadow/tensor.h>
+#include <vector>
+#include "./test_util.h"
+
+// this namespace contains all data structures, functions
+using namespace mshadow;
+// this namespace contains all operator overloads
+using namespace mshadow::expr;
+
+typedef Tensor<cpu, 1, float> Vec;
+
+// flat assignments with and without streaming stores, in place or not
+int test_stream(index_t n, size_t threshold) {
+  TensorContainer<cpu, 1, float> x(Shape1(n)), y(Shape1(n)), z(Shape1(n));
+  std::vector<double> rx(n), ry(n), rz(n);
+  test::Fill(x, 1, 0.25); test::Fill(y, 2, 1.0);
+  for (index_t i = 0; i < n; ++i) {
+    rx[i] = x[i]; ry[i] = y[i];
+  }
+#if MSHADOW_USE_SSE
+  const size_t saved = sse2::StreamThreshold();
+  sse2::StreamThreshold() = threshold;
+#endif
+  int nerr = 0;
+  z = x * 2.0f + y;
+  for (index_t i = 0; i < n; ++i) rz[i] = rx[i] * 2.0 + ry[i];
+  nerr += test::Check(z, rz, 1e-6, "z = x * 2 + y");
+  x = x * 0.5f + y;
+  for (index_t i = 0; i < n; ++i) rx[i] = rx[i] * 0.5 + ry[i];
+  nerr += test::Check(x, rx, 1e-6, "x = x * 0.5 + y");
+  y = F<op::identity>(x) - y;
+  for (index_t i = 0; i < n; ++i) ry[i] = rx[i] - ry[i];
+  nerr += test::Check(y, ry, 1e-6, "y = x - y");
+  z += x * y;
+  for (index_t i = 0; i < n; ++i) rz[i] += rx[i] * ry[i];
+  nerr += test::Check(z, rz, 1e-6, "z += x * y");
+  z = 1.5f;
+  for (index_t i = 0; i < n; ++i) rz[i] = 1.5;
+  nerr += test::Check(z, rz, 1e-6, "z = 1.5");
+#if MSHADOW_USE_SSE
+  sse2::StreamThreshold() = saved;
+#endif
+  return nerr;
+}
+
+#if MSHADOW_USE_SSE
+// whether an expression reads the memory of dst
+template<typename E>
+inline bool Overlap(const E &exp, const Vec &dst) {
+  return SSEOverlapCheck<E>::Check(exp, dst.dptr_, dst.dptr_ + dst.size(0));
+}
+// the destinations that keep cached stores
+int test_overlap(void) {
+  TensorContainer<cpu, 1, float> buf(Shape1(64)), w(Shape1(16));
+  Vec a = buf.Slice(0, 16), b = buf.Slice(16, 32), c = buf.Slice(12, 28);
+  Vec d = buf.Slice(32, 48);
+  int nerr = 0;
+  if (!Overlap(a, a) || Overlap(b, a) || !Overlap(c, a) || !Overlap(c, b)) ++nerr;
+  // b ends where d starts
+  if (Overlap(b, d) || Overlap(scalar(1.0f), a)) ++nerr;
+  if (Overlap(b * 2.0f + w, a) || !Overlap(b * 2.0f + w, b)) ++nerr;
+  if (!Overlap(F<op::identity>(w) - c, b) || Overlap(F<op::identity>(w) - c, d)) ++nerr;
+  if (nerr != 0) printf("overlap: %d errors\n", nerr);
+  return nerr;
+}
+#endif
+
+int main(void) {
+  int nerr = 0;
+  const index_t sizes[] = {1, 7, 64, 1001, (1 << 14) + 3, (1 << 17) + 5};
+  for (int i = 0; i < 6; ++i) {
+    nerr += test_stream(sizes[i], 0);
+    nerr += test_stream(sizes[i], static_cast<size_t>(-1));
+  }
+#if MSHADOW_USE_SSE
+  nerr += test_overlap();
+#endif
+  printf("test_stream: %d errors\n", nerr);
+  return nerr != 0;
+}
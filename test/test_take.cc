@@ -0,0 +1,84 @@
+#include <mshadow/tensor.h>
+#include <vector>
+
+// this namespace contains all data structures, functions
+using namespace mshadow;
+// this namespace contains all operator overloads
+using namespace mshadow::expr;
+
+template<typename IType>
+int test_take(index_t nrow, index_t n, index_t ncol) {
+  TensorContainer<cpu, 2, float> table(Shape2(nrow, ncol)), out(Shape2(n, ncol));
+  TensorContainer<cpu, 2, float> src(Shape2(n, ncol)), grad(Shape2(nrow, ncol));
+  TensorContainer<cpu, 1, IType> index(Shape1(n));
+  for (index_t i = 0; i < nrow; ++i) {
+    for (index_t j = 0; j < ncol; ++j) table[i][j] = static_cast<float>(i * 1000 + j);
+  }
+  // few rows are hit many times, in no order
+  for (index_t i = 0; i < n; ++i) {
+    index[i] = static_cast<IType>((i * 7919 + i / 3) % nrow);
+    for (index_t j = 0; j < ncol; ++j) {
+      src[i][j] = static_cast<float>((i * 31 + j * 17) % 64) * 0.25f;
+    }
+  }
+  int nerr = 0;
+  out = take(table, index);
+  for (index_t i = 0; i < n; ++i) {
+    for (index_t j = 0; j < ncol; ++j) {
+      if (out[i][j] != table[static_cast<index_t>(index[i])][j]) ++nerr;
+    }
+  }
+  // in a larger expression take is evaluated by its plan
+  out = take(table, index) * 2.0f;
+  for (index_t i = 0; i < n; ++i) {
+    for (index_t j = 0; j < ncol; ++j) {
+      if (out[i][j] != 2.0f * table[static_cast<index_t>(index[i])][j]) ++nerr;
+    }
+  }
+  // the sums are exact, so they equal the serial order
+  std::vector<float> expect(nrow * ncol, 1.0f);
+  for (index_t i = 0; i < n; ++i) {
+    for (index_t j = 0; j < ncol; ++j) {
+      expect[static_cast<index_t>(index[i]) * ncol + j] += src[i][j];
+    }
+  }
+  grad = 1.0f;
+  ScatterAdd(grad, index, src);
+  for (index_t i = 0; i < nrow; ++i) {
+    for (index_t j = 0; j < ncol; ++j) {
+      if (grad[i][j] != expect[i * ncol + j]) ++nerr;
+    }
+  }
+#if DMLC_LOG_FATAL_THROW
+  // an index out of the table is an error
+  const IType bad[] = {static_cast<IType>(nrow), static_cast<IType>(-1)};
+  for (int k = 0; k < 2; ++k) {
+    index[n / 2] = bad[k];
+    int nthrow = 0;
+    try {
+      out = take(table, index);
+    } catch (const dmlc::Error &) {
+      ++nthrow;
+    }
+    try {
+      ScatterAdd(grad, index, src);
+    } catch (const dmlc::Error &) {
+      ++nthrow;
+    }
+    if (nthrow != 2) ++nerr;
+  }
+#endif
+  return nerr;
+}
+
+int main(void) {
+  int nerr = 0;
+  nerr += test_take<int>(13, 40, 5);
+  nerr += test_take<float>(13, 40, 9);
+  nerr += test_take<int>(1, 3, 17);
+  nerr += test_take<int>(300, 5000, 33);
+  nerr += test_take<unsigned>(4000, 3000, 64);
+  nerr += test_take<float>(50, 2000, 100);
+  printf("test_take: %d errors\n", nerr);
+  return nerr != 0;
+}
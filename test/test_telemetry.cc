@@ -0,0 +1,122 @@
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "../mshadow-ps/telemetry.h"
+
+// this namespace contains all data structures, functions
+using namespace mshadow::ps::telemetry;
+
+inline int Expect(bool cond, const char *name) {
+  if (!cond) printf("%s: wrong\n", name);
+  return cond ? 0 : 1;
+}
+inline int Contains(const std::string &text, const std::string &line, const char *name) {
+  if (text.find(line) != std::string::npos) return 0;
+  printf("%s: missing %s\n", name, line.c_str());
+  return 1;
+}
+
+// each value falls into a bucket whose bounds are within 1 / kSub of it
+int test_bucket(void) {
+  int nerr = 0;
+  for (uint64_t v = 0; v < (1 << 20); v += 1 + v / 64) {
+    const int idx = Histogram::BucketIndex(v);
+    const uint64_t lo = Histogram::BucketLowerBound(idx);
+    const uint64_t hi = Histogram::BucketLowerBound(idx + 1);
+    if (!(lo <= v && v < hi && (hi - lo) * Histogram::kSub <= lo + Histogram::kSub)) ++nerr;
+  }
+  const uint64_t vmax = ~static_cast<uint64_t>(0);
+  nerr += Expect(Histogram::BucketIndex(vmax) == Histogram::kNumBucket - 1, "bucket, max");
+  if (nerr != 0) printf("bucket: %d errors\n", nerr);
+  return nerr;
+}
+
+// the quantiles of 1, 2, ..., 1000 are the upper bounds of their buckets
+int test_quantile(void) {
+  Histogram h;
+  int nerr = 0;
+  nerr += Expect(h.Quantile(0.5) == 0, "quantile, empty");
+  for (uint64_t v = 1000; v >= 1; --v) h.Add(v);
+  nerr += Expect(h.count() == 1000 && h.sum() == 500500 && h.max() == 1000, "quantile, stats");
+  // 500 is in [480, 512), 900 in [896, 960), 990 in [960, 1024) clipped by the max
+  nerr += Expect(h.Quantile(0.5) == 511, "quantile, p50");
+  nerr += Expect(h.Quantile(0.9) == 959, "quantile, p90");
+  nerr += Expect(h.Quantile(0.99) == 1000, "quantile, p99");
+  nerr += Expect(h.Quantile(0.0) == 1 && h.Quantile(1.0) == 1000, "quantile, bounds");
+  return nerr;
+}
+
+// concurrent updates are not lost
+struct Adder {
+  Histogram *h;
+  Counter *c;
+  int seed;
+};
+MSHADOW_THREAD_PREFIX AddThread(void *param) {
+  Adder *a = static_cast<Adder*>(param);
+  for (int i = 0; i < 20000; ++i) {
+    a->h->Add(static_cast<uint64_t>(i % 100 + a->seed));
+    a->c->Add(i % 2 == 0 ? 1 : -1);
+  }
+  return NULL;
+}
+int test_concurrent(void) {
+  Histogram h;
+  Counter c;
+  Adder adder[4];
+  mshadow::utils::Thread thread[4];
+  for (int i = 0; i < 4; ++i) {
+    adder[i].h = &h; adder[i].c = &c; adder[i].seed = i * 1000;
+    thread[i].Start(AddThread, &adder[i]);
+  }
+  for (int i = 0; i < 4; ++i) thread[i].Join();
+  int nerr = 0;
+  nerr += Expect(h.count() == 80000 && h.max() == 3099, "concurrent, histogram");
+  nerr += Expect(c.value == 0 && c.max_value >= 1 && c.max_value <= 4, "concurrent, counter");
+  return nerr;
+}
+
+// the exported text of one key and one device
+int test_export(void) {
+  Registry reg;
+  reg.Init(std::vector<int>(1, 3));
+  KeyStats *s = reg.Key(7);
+  for (int i = 0; i < 1000; ++i) s->push_queue.Add(2000);
+  s->bytes_push.Add(4096);
+  DeviceStats *d = reg.Device(0);
+  d->push_queue_depth.Add(1); d->push_queue_depth.Add(1); d->push_queue_depth.Add(-1);
+  int nerr = 0;
+  nerr += Expect(reg.Key(7) == s, "export, same key");
+  const std::string json = reg.ExportJSON();
+  nerr += Contains(json, "\"7\": {\"push_queue_us\": {\"count\": 1000, \"mean\": 2, "
+                   "\"p50\": 2, \"p90\": 2, \"p99\": 2, \"max\": 2}, ", "json");
+  nerr += Contains(json, "\"copy_in_us\": {\"count\": 0, \"mean\": 0, \"p50\": 0, "
+                   "\"p90\": 0, \"p99\": 0, \"max\": 0}", "json");
+  nerr += Contains(json, "\"bytes_push\": 4096, \"bytes_pull\": 0}", "json");
+  nerr += Contains(json, "\"3\": {\"copy_in_us\": {", "json");
+  nerr += Contains(json, "\"push_queue_depth\": 1, \"push_queue_depth_max\": 2, ", "json");
+  const std::string prom = reg.ExportPrometheus();
+  nerr += Contains(prom, "# TYPE mshadow_ps_push_queue_seconds summary\n"
+                   "mshadow_ps_push_queue_seconds{key=\"7\",quantile=\"0.5\"} 2e-06\n"
+                   "mshadow_ps_push_queue_seconds{key=\"7\",quantile=\"0.9\"} 2e-06\n"
+                   "mshadow_ps_push_queue_seconds{key=\"7\",quantile=\"0.99\"} 2e-06\n"
+                   "mshadow_ps_push_queue_seconds_sum{key=\"7\"} 0.002\n"
+                   "mshadow_ps_push_queue_seconds_count{key=\"7\"} 1000\n", "prometheus");
+  nerr += Contains(prom, "# TYPE mshadow_ps_push_bytes_total counter\n"
+                   "mshadow_ps_push_bytes_total{key=\"7\"} 4096\n", "prometheus");
+  nerr += Contains(prom, "# TYPE mshadow_ps_push_queue_depth gauge\n"
+                   "mshadow_ps_push_queue_depth{device=\"3\"} 1\n", "prometheus");
+  nerr += Contains(prom, "mshadow_ps_device_pull_wait_seconds_count{device=\"3\"} 0\n",
+                   "prometheus");
+  return nerr;
+}
+
+int main(void) {
+  int nerr = 0;
+  nerr += test_bucket();
+  nerr += test_quantile();
+  nerr += test_concurrent();
+  nerr += test_export();
+  printf("test_telemetry: %d errors\n", nerr);
+  return nerr != 0;
+}
@@ -0,0 +1,147 @@
+#include <cstdio>
+#include <utility>
+#include <vector>
+#include "../mshadow-ps/thread_util.h"
+
+// this namespace contains all data structures, functions
+using namespace mshadow::utils;
+
+// counts the runs of each part and the calls of Done
+class CountJob : public ThreadPool::Job {
+ public:
+  explicit CountJob(int npart) : count(npart, 0), ndone(0), done(NULL) {}
+  virtual void Run(int i) {
+    __sync_add_and_fetch(&count[i], 1);
+  }
+  virtual void Done(void) {
+    __sync_add_and_fetch(&ndone, 1);
+    if (done != NULL) done->Post();
+  }
+  inline bool Once(void) const {
+    for (size_t i = 0; i < count.size(); ++i) {
+      if (count[i] != 1) return false;
+    }
+    return true;
+  }
+  std::vector<int> count;
+  int ndone;
+  Semaphore *done;
+};
+
+// a thread that runs and submits jobs to a shared pool
+struct Caller {
+  ThreadPool *pool;
+  int nerr;
+};
+MSHADOW_THREAD_PREFIX CallerThread(void *param) {
+  Caller *c = static_cast<Caller*>(param);
+  Semaphore done;
+  done.Init(0);
+  std::vector<CountJob*> submitted;
+  for (int iter = 0; iter < 50; ++iter) {
+    CountJob run(iter % 7 + 1);
+    c->pool->Run(&run, iter % 7 + 1);
+    if (!run.Once() || run.ndone != 0) ++c->nerr;
+    CountJob *job = new CountJob(iter % 5 + 1);
+    job->done = &done;
+    submitted.push_back(job);
+    c->pool->Submit(job, iter % 5 + 1);
+  }
+  for (size_t i = 0; i < submitted.size(); ++i) done.Wait();
+  for (size_t i = 0; i < submitted.size(); ++i) {
+    if (!submitted[i]->Once() || submitted[i]->ndone != 1) ++c->nerr;
+    delete submitted[i];
+  }
+  done.Destroy();
+  return NULL;
+}
+
+// jobs from several threads run each part exactly once, Done once per submit
+int test_pool(int nworker) {
+  ThreadPool pool;
+  pool.Init(nworker);
+  Caller caller[4];
+  Thread thread[4];
+  for (int i = 0; i < 4; ++i) {
+    caller[i].pool = &pool; caller[i].nerr = 0;
+    thread[i].Start(CallerThread, &caller[i]);
+  }
+  int nerr = 0;
+  for (int i = 0; i < 4; ++i) {
+    thread[i].Join();
+    nerr += caller[i].nerr;
+  }
+  // a job submitted without workers is done before Submit returns
+  if (nworker == 0) {
+    CountJob job(3);
+    pool.Submit(&job, 3);
+    if (!job.Once() || job.ndone != 1) ++nerr;
+  }
+  pool.Destroy();
+  if (nerr != 0) printf("pool: %d workers, %d errors\n", nworker, nerr);
+  return nerr;
+}
+
+// the batches take the highest priority first and at most max_batch elements
+int test_pop_batch(void) {
+  int nerr = 0;
+  ThreadPQueue<std::pair<int, int> > pq;
+  pq.Init(false);
+  const int prio[] = {3, 9, 1, 7, 5, 10, 2, 8, 4, 6};
+  for (int i = 0; i < 10; ++i) pq.Push(std::make_pair(prio[i], i), prio[i]);
+  std::vector<std::pair<int, int> > batch;
+  int expect = 10;
+  const size_t sizes[] = {4, 4, 2};
+  for (int b = 0; b < 3; ++b) {
+    if (!pq.PopBatch(&batch, 4) || batch.size() != sizes[b]) {
+      printf("pop batch: batch %d of size %lu\n", b, static_cast<unsigned long>(batch.size()));
+      ++nerr; continue;
+    }
+    for (size_t i = 0; i < batch.size(); ++i) {
+      if (batch[i].first != expect--) ++nerr;
+    }
+  }
+  // a batch of one, then abort wakes up the consumer with an empty queue
+  pq.Push(std::make_pair(0, 0), 0);
+  if (!pq.PopBatch(&batch, 1) || batch.size() != 1) ++nerr;
+  pq.Abort(1);
+  if (pq.PopBatch(&batch, 4) || batch.size() != 0) ++nerr;
+  pq.Destroy();
+  // a fifo queue keeps the order of push
+  ThreadPQueue<int> fq;
+  fq.Init(true);
+  for (int i = 0; i < 5; ++i) fq.Push(i, 5 - i);
+  std::vector<int> fbatch;
+  if (!fq.PopBatch(&fbatch, 3) || fbatch.size() != 3 || fbatch[0] != 0 || fbatch[2] != 2) ++nerr;
+  if (!fq.PopBatch(&fbatch, 3) || fbatch.size() != 2 || fbatch[0] != 3 || fbatch[1] != 4) ++nerr;
+  fq.Destroy();
+  if (nerr != 0) printf("pop batch: %d errors\n", nerr);
+  return nerr;
+}
+
+// TryWait takes a count without blocking, and fails when there is none
+int test_try_wait(void) {
+  int nerr = 0;
+  Semaphore sem;
+  sem.Init(2);
+  if (!sem.TryWait() || !sem.TryWait() || sem.TryWait()) ++nerr;
+  sem.Post();
+  if (!sem.TryWait() || sem.TryWait()) ++nerr;
+  sem.Post(); sem.Post();
+  sem.Wait();
+  if (!sem.TryWait() || sem.TryWait()) ++nerr;
+  sem.Destroy();
+  if (nerr != 0) printf("try wait: %d errors\n", nerr);
+  return nerr;
+}
+
+int main(void) {
+  int nerr = 0;
+  nerr += test_pool(0);
+  nerr += test_pool(1);
+  nerr += test_pool(3);
+  nerr += test_pop_batch();
+  nerr += test_try_wait();
+  printf("test_thread: %d errors\n", nerr);
+  return nerr != 0;
+}
@@ -0,0 +1,128 @@
+// the tracer is compiled in for this test only
+#define MSHADOW_USE_TRACE 1
+#include <mshadow/tensor.h>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+// this namespace contains all data structures, functions
+using namespace mshadow;
+
+// an event read back from the dump
+struct Record {
+  std::string name, shape;
+  double ts, dur;
+  int tid;
+};
+// read the events of a dump, one per line
+inline std::vector<Record> Load(const char *fname) {
+  std::vector<Record> ret;
+  FILE *fi = fopen(fname, "r");
+  if (fi == NULL) return ret;
+  char line[1024], name[64], cat[64], shape[64];
+  while (fgets(line, sizeof(line), fi) != NULL) {
+    Record r;
+    if (sscanf(line, "{\"name\": \"%63[^\"]\", \"cat\": \"%63[^\"]\", \"ph\": \"X\", "
+               "\"ts\": %lf, \"dur\": %lf, \"pid\": 0, \"tid\": %d, "
+               "\"args\": {\"shape\": \"%63[^\"]\"",
+               name, cat, &r.ts, &r.dur, &r.tid, shape) == 6) {
+      r.name = name; r.shape = shape;
+      ret.push_back(r);
+    }
+  }
+  fclose(fi);
+  return ret;
+}
+// each outer scope holds two inner ones, the shape is (seed, i)
+inline void Work(int seed, int n) {
+  for (int i = 0; i < n; ++i) {
+    MSHADOW_TRACE_SCOPE("outer", "test", Shape2(seed, i), 0, 0);
+    for (int j = 0; j < 2; ++j) {
+      MSHADOW_TRACE_SCOPE("inner", "test", Shape2(seed, i), 0, 0);
+    }
+  }
+}
+
+// nested scopes of two threads, each thread has its own tid
+int test_nested(void) {
+  trace::Start(1024);
+  std::thread t1(Work, 1, 100), t2(Work, 2, 100);
+  t1.join(); t2.join();
+  trace::Stop();
+  Work(3, 10);
+  trace::Dump("test_trace.json");
+  std::vector<Record> ev = Load("test_trace.json");
+  int nerr = 0;
+  if (ev.size() != 600) {
+    printf("nested: %lu events\n", static_cast<unsigned long>(ev.size()));
+    return 1;
+  }
+  std::map<int, int> ntid;
+  std::map<std::string, int> nname;
+  for (size_t i = 0; i < ev.size(); ++i) {
+    ntid[ev[i].tid] += 1;
+    nname[ev[i].name] += 1;
+  }
+  if (ntid.size() != 2 || ntid.begin()->second != 300) ++nerr;
+  if (nname["outer"] != 200 || nname["inner"] != 400) ++nerr;
+  // in each thread the inner scopes close first, inside the outer one
+  for (size_t i = 0; i + 2 < ev.size(); i += 3) {
+    const Record &a = ev[i], &b = ev[i + 1], &o = ev[i + 2];
+    if (a.name != "inner" || b.name != "inner" || o.name != "outer" ||
+        a.tid != o.tid || b.tid != o.tid || a.shape != o.shape ||
+        a.ts < o.ts || b.ts + b.dur > o.ts + o.dur + 1e-3 || a.ts + a.dur > b.ts + 1e-3) {
+      ++nerr;
+    }
+  }
+  if (nerr != 0) printf("nested: %d errors\n", nerr);
+  return nerr;
+}
+
+// a new start clears the old events, a full ring keeps the latest ones
+int test_ring(void) {
+  trace::Start(30);
+  std::thread t(Work, 4, 100);
+  t.join();
+  trace::Stop();
+  trace::Dump("test_trace.json");
+  std::vector<Record> ev = Load("test_trace.json");
+  int nerr = 0;
+  if (ev.size() != 30 || ev.back().shape != "(4,99)" || ev.front().shape != "(4,90)") {
+    printf("ring: %lu events\n", static_cast<unsigned long>(ev.size()));
+    ++nerr;
+  }
+  return nerr;
+}
+
+// restart and dump while two threads record
+int test_concurrent(void) {
+  trace::Start(64);
+  std::thread t1(Work, 5, 20000), t2(Work, 6, 20000);
+  for (int i = 0; i < 20; ++i) {
+    trace::Start(i % 2 == 0 ? 32 : 64);
+    trace::Dump("test_trace.json");
+  }
+  t1.join(); t2.join();
+  trace::Stop();
+  trace::Dump("test_trace.json");
+  std::vector<Record> ev = Load("test_trace.json");
+  int nerr = 0;
+  if (ev.size() == 0 || ev.size() > 2 * 64) {
+    printf("concurrent: %lu events\n", static_cast<unsigned long>(ev.size()));
+    ++nerr;
+  }
+  return nerr;
+}
+
+int main(void) {
+  int nerr = 0;
+  nerr += test_nested();
+  nerr += test_ring();
+  nerr += test_concurrent();
+  remove("test_trace.json");
+  printf("test_trace: %d errors\n", nerr);
+  return nerr != 0;
+}
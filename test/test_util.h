@@ -0,0 +1,91 @@
+/*!
+ * \file test_util.h
+ * \brief deterministic inputs and comparison with a reference for the cpu tests
+ */
+#ifndef TEST_UTIL_H_
+#define TEST_UTIL_H_
+#include <mshadow/tensor.h>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace test {
+using mshadow::cpu;
+using mshadow::index_t;
+using mshadow::Tensor;
+/*!
+ * \brief fill t with offset + scale * v, where v is an integer in [-18, 18]
+ *  that depends on the position and the seed, the padding is not touched
+ */
+template<int dim, typename DType>
+inline void Fill(Tensor<cpu, dim, DType> t, int seed, double scale = 0.125,
+                 double offset = 0.0) {
+  Tensor<cpu, 2, DType> m = t.FlatTo2D();
+  for (index_t i = 0; i < m.size(0); ++i) {
+    for (index_t j = 0; j < m.size(1); ++j) {
+      const int v = static_cast<int>((i * 29 + j * 13 + seed * 7) % 37) - 18;
+      m[i][j] = static_cast<DType>(offset + scale * v);
+    }
+  }
+}
+/*! \brief print the errors of a check, with the shape of the tensor */
+template<int dim>
+inline void Report(const mshadow::Shape<dim> &shape, int nerr, const char *name) {
+  if (nerr == 0) return;
+  printf("%s: (", name);
+  for (int k = 0; k < dim; ++k) printf(k == 0 ? "%u" : ", %u", shape[k]);
+  printf("), %d errors\n", nerr);
+}
+/*!
+ * \brief number of elements of a with |a - ref| > tol * (|ref| + 1), ref holds
+ *  the elements in the order of the shape, without padding
+ */
+template<int dim, typename DType>
+inline int Check(Tensor<cpu, dim, DType> a, const std::vector<double> &ref, double tol,
+                 const char *name) {
+  Tensor<cpu, 2, DType> m = a.FlatTo2D();
+  int nerr = 0;
+  for (index_t i = 0; i < m.size(0); ++i) {
+    for (index_t j = 0; j < m.size(1); ++j) {
+      const double expect = ref[i * m.size(1) + j];
+      if (!(std::fabs(m[i][j] - expect) <= tol * (std::fabs(expect) + 1.0))) ++nerr;
+    }
+  }
+  Report(a.shape_, nerr, name);
+  return nerr;
+}
+/*! \brief same as Check, with the reference in a tensor of double */
+template<int dim, typename DType>
+inline int Check(Tensor<cpu, dim, DType> a, Tensor<cpu, dim, double> ref, double tol,
+                 const char *name) {
+  Tensor<cpu, 2, DType> m = a.FlatTo2D();
+  Tensor<cpu, 2, double> r = ref.FlatTo2D();
+  int nerr = 0;
+  for (index_t i = 0; i < m.size(0); ++i) {
+    for (index_t j = 0; j < m.size(1); ++j) {
+      if (!(std::fabs(m[i][j] - r[i][j]) <= tol * (std::fabs(r[i][j]) + 1.0))) ++nerr;
+    }
+  }
+  Report(a.shape_, nerr, name);
+  return nerr;
+}
+/*!
+ * \brief number of elements of a that differ from ref bit for bit, so that
+ *  signed zeros and NaN count, ref is in the order of the shape
+ */
+template<int dim, typename DType>
+inline int CheckBits(Tensor<cpu, dim, DType> a, const std::vector<DType> &ref,
+                     const char *name) {
+  Tensor<cpu, 2, DType> m = a.FlatTo2D();
+  int nerr = 0;
+  for (index_t i = 0; i < m.size(0); ++i) {
+    for (index_t j = 0; j < m.size(1); ++j) {
+      if (std::memcmp(&m[i][j], &ref[i * m.size(1) + j], sizeof(DType)) != 0) ++nerr;
+    }
+  }
+  Report(a.shape_, nerr, name);
+  return nerr;
+}
+}  // namespace test
+#endif  // TEST_UTIL_H_